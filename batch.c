@@ -0,0 +1,354 @@
+/**********************************************************************************************
+ * File   : batch.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      Batched GEMM. Many independent GEMMs of one shape, e.g. one per attention head.
+ *
+ *      A call on its own threads only inside the GEMM, which doesn't pay off for small
+ *      matrices: the barriers between KC blocks cost more than the work between them.
+ *      gemm_batch_run rather gives each thread whole GEMMs of the batch, on a worker
+ *      context (see [ctx.c]) whose packing buffers stay allocated from one GEMM, and one
+ *      call, to the next. Large GEMMs still run one after another on all the threads.
+ *
+**********************************************************************************************/
+
+#include "gemm.h"
+
+/* a GEMM is small with fewer MR x NR tiles or flops than these for each thread */
+#define BATCH_TILES_PER_THREAD  4
+#define BATCH_FLOPS_PER_THREAD  (1 << 23)
+
+/* the matrices of a batch, from pointer arrays or from base pointers and strides */
+typedef struct {
+    D_TYPE d_type;
+    int M, N, K;
+    const void* const* A_array;
+    const void* const* B_array;
+    void* const* C_array;
+    const char* A, * B;
+    char* C;
+    size_t strideA, strideB, strideC;   /* in bytes */
+} gemm_batch_t;
+
+/* runs GEMM [i] of [b] on [ctx] */
+typedef void (*gemm_batch_fn)(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i);
+
+static const void* batch_A(const gemm_batch_t* b, const int i) {
+    return (b->A_array != NULL) ? b->A_array[i] : b->A + i * b->strideA;
+}
+
+static const void* batch_B(const gemm_batch_t* b, const int i) {
+    return (b->B_array != NULL) ? b->B_array[i] : b->B + i * b->strideB;
+}
+
+static void* batch_C(const gemm_batch_t* b, const int i) {
+    return (b->C_array != NULL) ? b->C_array[i] : b->C + i * b->strideC;
+}
+
+static BOOL batch_is_small(const gemm_ctx_t* ctx, const gemm_batch_t* b) {
+    const gemm_blk_t* blk = &ctx->blk[b->d_type];
+    const int64_t tiles = (int64_t)((b->M + blk->MR - 1) / blk->MR) * ((b->N + blk->NR - 1) / blk->NR);
+    const double flops = 2.0 * b->M * b->N * b->K;
+    return tiles < (int64_t)BATCH_TILES_PER_THREAD * ctx->NTHREADS
+        || flops < (double)BATCH_FLOPS_PER_THREAD * ctx->NTHREADS;
+}
+
+static void gemm_batch_run(gemm_ctx_t* ctx, const gemm_batch_t* b, const int batch, gemm_batch_fn fn) {
+    if(batch <= 0)
+        return;
+
+    int nthreads = 1;
+    if(ctx->NTHREADS > 1 && batch > 1 && batch_is_small(ctx, b)) {
+        gemm_ctx_worker(ctx, 0);
+        nthreads = min(min(ctx->NTHREADS, ctx->nworkers), batch);
+    }
+    if(nthreads <= 1) {
+        for(int i = 0; i < batch; i++)
+            fn(ctx, b, i);
+        return;
+    }
+
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+#pragma omp parallel num_threads(nthreads)
+    {
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+#pragma omp for schedule(dynamic)
+        for(int i = 0; i < batch; i++)
+            fn(worker, b, i);
+    }
+}
+
+static void sgemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    sgemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void sgemm_batched(const float* const A[], const float* const B[], float* const C[],
+        const int M, const int N, const int K, const int batch) {
+    sgemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void sgemm_batched_ctx(gemm_ctx_t* ctx, const float* const A[], const float* const B[],
+        float* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_FP32, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, sgemm_batch_entry);
+}
+
+void sgemm_strided_batched(const float* A, const size_t strideA, const float* B, const size_t strideB,
+        float* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    sgemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void sgemm_strided_batched_ctx(gemm_ctx_t* ctx, const float* A, const size_t strideA,
+        const float* B, const size_t strideB, float* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_FP32, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(float), strideB * sizeof(float), strideC * sizeof(float)};
+    gemm_batch_run(ctx, &b, batch, sgemm_batch_entry);
+}
+
+static void dgemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    dgemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void dgemm_batched(const double* const A[], const double* const B[], double* const C[],
+        const int M, const int N, const int K, const int batch) {
+    dgemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void dgemm_batched_ctx(gemm_ctx_t* ctx, const double* const A[], const double* const B[],
+        double* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_FP64, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, dgemm_batch_entry);
+}
+
+void dgemm_strided_batched(const double* A, const size_t strideA, const double* B, const size_t strideB,
+        double* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    dgemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void dgemm_strided_batched_ctx(gemm_ctx_t* ctx, const double* A, const size_t strideA,
+        const double* B, const size_t strideB, double* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_FP64, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(double), strideB * sizeof(double), strideC * sizeof(double)};
+    gemm_batch_run(ctx, &b, batch, dgemm_batch_entry);
+}
+
+static void igemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    igemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void igemm_batched(const int* const A[], const int* const B[], int* const C[],
+        const int M, const int N, const int K, const int batch) {
+    igemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void igemm_batched_ctx(gemm_ctx_t* ctx, const int* const A[], const int* const B[],
+        int* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT32, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, igemm_batch_entry);
+}
+
+void igemm_strided_batched(const int* A, const size_t strideA, const int* B, const size_t strideB,
+        int* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    igemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void igemm_strided_batched_ctx(gemm_ctx_t* ctx, const int* A, const size_t strideA,
+        const int* B, const size_t strideB, int* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT32, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(int), strideB * sizeof(int), strideC * sizeof(int)};
+    gemm_batch_run(ctx, &b, batch, igemm_batch_entry);
+}
+
+static void hqgemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    hqgemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void hqgemm_batched(const int16_t* const A[], const int16_t* const B[], int16_t* const C[],
+        const int M, const int N, const int K, const int batch) {
+    hqgemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void hqgemm_batched_ctx(gemm_ctx_t* ctx, const int16_t* const A[], const int16_t* const B[],
+        int16_t* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT16, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, hqgemm_batch_entry);
+}
+
+void hqgemm_strided_batched(const int16_t* A, const size_t strideA, const int16_t* B, const size_t strideB,
+        int16_t* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    hqgemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void hqgemm_strided_batched_ctx(gemm_ctx_t* ctx, const int16_t* A, const size_t strideA,
+        const int16_t* B, const size_t strideB, int16_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT16, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(int16_t), strideB * sizeof(int16_t), strideC * sizeof(int16_t)};
+    gemm_batch_run(ctx, &b, batch, hqgemm_batch_entry);
+}
+
+static void qgemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    qgemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void qgemm_batched(const int8_t* const A[], const int8_t* const B[], int8_t* const C[],
+        const int M, const int N, const int K, const int batch) {
+    qgemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void qgemm_batched_ctx(gemm_ctx_t* ctx, const int8_t* const A[], const int8_t* const B[],
+        int8_t* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT8, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, qgemm_batch_entry);
+}
+
+void qgemm_strided_batched(const int8_t* A, const size_t strideA, const int8_t* B, const size_t strideB,
+        int8_t* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    qgemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void qgemm_strided_batched_ctx(gemm_ctx_t* ctx, const int8_t* A, const size_t strideA,
+        const int8_t* B, const size_t strideB, int8_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT8, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(int8_t), strideB * sizeof(int8_t), strideC * sizeof(int8_t)};
+    gemm_batch_run(ctx, &b, batch, qgemm_batch_entry);
+}
+
+static void qgemm_s32_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    qgemm_s32_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void qgemm_s32_batched(const uint8_t* const A[], const int8_t* const B[], int32_t* const C[],
+        const int M, const int N, const int K, const int batch) {
+    qgemm_s32_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void qgemm_s32_batched_ctx(gemm_ctx_t* ctx, const uint8_t* const A[], const int8_t* const B[],
+        int32_t* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT8_S32, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, qgemm_s32_batch_entry);
+}
+
+void qgemm_s32_strided_batched(const uint8_t* A, const size_t strideA, const int8_t* B, const size_t strideB,
+        int32_t* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    qgemm_s32_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void qgemm_s32_strided_batched_ctx(gemm_ctx_t* ctx, const uint8_t* A, const size_t strideA,
+        const int8_t* B, const size_t strideB, int32_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT8_S32, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(uint8_t), strideB * sizeof(int8_t), strideC * sizeof(int32_t)};
+    gemm_batch_run(ctx, &b, batch, qgemm_s32_batch_entry);
+}
+
+static void hqgemm_s32_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    hqgemm_s32_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void hqgemm_s32_batched(const int16_t* const A[], const int16_t* const B[], int32_t* const C[],
+        const int M, const int N, const int K, const int batch) {
+    hqgemm_s32_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void hqgemm_s32_batched_ctx(gemm_ctx_t* ctx, const int16_t* const A[], const int16_t* const B[],
+        int32_t* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT16_S32, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, hqgemm_s32_batch_entry);
+}
+
+void hqgemm_s32_strided_batched(const int16_t* A, const size_t strideA, const int16_t* B, const size_t strideB,
+        int32_t* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    hqgemm_s32_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void hqgemm_s32_strided_batched_ctx(gemm_ctx_t* ctx, const int16_t* A, const size_t strideA,
+        const int16_t* B, const size_t strideB, int32_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_INT16_S32, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(int16_t), strideB * sizeof(int16_t), strideC * sizeof(int32_t)};
+    gemm_batch_run(ctx, &b, batch, hqgemm_s32_batch_entry);
+}
+
+static void bf16gemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    bf16gemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void bf16gemm_batched(const uint16_t* const A[], const uint16_t* const B[], float* const C[],
+        const int M, const int N, const int K, const int batch) {
+    bf16gemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void bf16gemm_batched_ctx(gemm_ctx_t* ctx, const uint16_t* const A[], const uint16_t* const B[],
+        float* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_BF16, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, bf16gemm_batch_entry);
+}
+
+void bf16gemm_strided_batched(const uint16_t* A, const size_t strideA, const uint16_t* B, const size_t strideB,
+        float* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    bf16gemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void bf16gemm_strided_batched_ctx(gemm_ctx_t* ctx, const uint16_t* A, const size_t strideA,
+        const uint16_t* B, const size_t strideB, float* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_BF16, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(uint16_t), strideB * sizeof(uint16_t), strideC * sizeof(float)};
+    gemm_batch_run(ctx, &b, batch, bf16gemm_batch_entry);
+}
+
+static void hgemm_batch_entry(gemm_ctx_t* ctx, const gemm_batch_t* b, const int i) {
+    hgemm_ctx(ctx, batch_A(b, i), batch_B(b, i), batch_C(b, i), b->M, b->N, b->K);
+}
+
+void hgemm_batched(const uint16_t* const A[], const uint16_t* const B[], float* const C[],
+        const int M, const int N, const int K, const int batch) {
+    hgemm_batched_ctx(gemm_ctx_default(), A, B, C, M, N, K, batch);
+}
+
+void hgemm_batched_ctx(gemm_ctx_t* ctx, const uint16_t* const A[], const uint16_t* const B[],
+        float* const C[], const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_FP16, M, N, K,
+        (const void* const* )A, (const void* const* )B, (void* const* )C};
+    gemm_batch_run(ctx, &b, batch, hgemm_batch_entry);
+}
+
+void hgemm_strided_batched(const uint16_t* A, const size_t strideA, const uint16_t* B, const size_t strideB,
+        float* C, const size_t strideC, const int M, const int N, const int K, const int batch) {
+    hgemm_strided_batched_ctx(gemm_ctx_default(), A, strideA, B, strideB, C, strideC, M, N, K, batch);
+}
+
+void hgemm_strided_batched_ctx(gemm_ctx_t* ctx, const uint16_t* A, const size_t strideA,
+        const uint16_t* B, const size_t strideB, float* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch) {
+    const gemm_batch_t b = {D_FP16, M, N, K, NULL, NULL, NULL,
+        (const char* )A, (const char* )B, (char* )C,
+        strideA * sizeof(uint16_t), strideB * sizeof(uint16_t), strideC * sizeof(float)};
+    gemm_batch_run(ctx, &b, batch, hgemm_batch_entry);
+}
@@ -0,0 +1,51 @@
+/**********************************************************************************************
+ * File   : cblas.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      CBLAS shim over sgemm_ex, dgemm_ex, sgemv and dgemv. Matrices are real, so
+ *      CblasConjTrans is the same as CblasTrans.
+ *
+**********************************************************************************************/
+
+#include "gemm.h"
+#include "cblas.h"
+
+static TRANSPOSE to_transpose(const enum CBLAS_TRANSPOSE trans) {
+    return (trans == CblasNoTrans) ? T_NO_TRANS : T_TRANS;
+}
+
+void cblas_sgemm(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+                 const float alpha, const float* A, const int lda,
+                 const float* B, const int ldb,
+                 const float beta, float* C, const int ldc) {
+    sgemm_ex((LAYOUT)Order, to_transpose(TransA), to_transpose(TransB),
+             M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void cblas_dgemm(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+                 const double alpha, const double* A, const int lda,
+                 const double* B, const int ldb,
+                 const double beta, double* C, const int ldc) {
+    dgemm_ex((LAYOUT)Order, to_transpose(TransA), to_transpose(TransB),
+             M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void cblas_sgemv(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const int M, const int N,
+                 const float alpha, const float* A, const int lda,
+                 const float* X, const int incX,
+                 const float beta, float* Y, const int incY) {
+    sgemv((LAYOUT)Order, to_transpose(TransA), M, N, alpha, A, lda, X, incX, beta, Y, incY);
+}
+
+void cblas_dgemv(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const int M, const int N,
+                 const double alpha, const double* A, const int lda,
+                 const double* X, const int incX,
+                 const double beta, double* Y, const int incY) {
+    dgemv((LAYOUT)Order, to_transpose(TransA), M, N, alpha, A, lda, X, incX, beta, Y, incY);
+}
@@ -0,0 +1,43 @@
+/**********************************************************************************************
+ * File   : cblas.h
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      CBLAS-compatible declarations, so code written against cblas_sgemm,
+ *      cblas_dgemm, cblas_sgemv and cblas_dgemv can link with gemm.h without changes.
+ *
+**********************************************************************************************/
+
+#ifndef CBLAS_H
+#define CBLAS_H
+
+#pragma once
+
+enum CBLAS_ORDER     {CblasRowMajor = 101, CblasColMajor = 102};
+enum CBLAS_TRANSPOSE {CblasNoTrans = 111, CblasTrans = 112, CblasConjTrans = 113};
+typedef enum CBLAS_ORDER CBLAS_LAYOUT;
+
+void cblas_sgemm(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+                 const float alpha, const float* A, const int lda,
+                 const float* B, const int ldb,
+                 const float beta, float* C, const int ldc);
+void cblas_dgemm(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+                 const double alpha, const double* A, const int lda,
+                 const double* B, const int ldb,
+                 const double beta, double* C, const int ldc);
+
+void cblas_sgemv(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const int M, const int N,
+                 const float alpha, const float* A, const int lda,
+                 const float* X, const int incX,
+                 const float beta, float* Y, const int incY);
+void cblas_dgemv(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA,
+                 const int M, const int N,
+                 const double alpha, const double* A, const int lda,
+                 const double* X, const int incX,
+                 const double beta, double* Y, const int incY);
+
+#endif // CBLAS_H
@@ -0,0 +1,260 @@
+/**********************************************************************************************
+ * File   : ctx.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      GEMM context. Thread count, instruction level and block sizes are computed
+ *      once when the context is created, so the gemm functions in [gemm.c] don't have
+ *      to run CPUID and allocate packing buffers on every call.
+ *
+ *      The plain gemm functions (sgemm, dgemm, ...) use a process-wide default context.
+ *
+ *      GEMM_SMALL_MNK in the environment overrides the size up to which sgemm and dgemm
+ *      skip the packing (small_mnk); 0 turns the small path off.
+ *
+**********************************************************************************************/
+
+#include "gemm.h"
+
+static gemm_ctx_t* default_ctx = NULL;
+
+static void set_kernel_size(const int inst_level, D_TYPE d_type, int* MR, int* NR) {
+    (*MR) = 6, (*NR) = 16;
+
+    switch(d_type) {
+        case D_FP32:
+        case D_INT32:
+        case D_BF16:                    /* skernel, or bf16kernel */
+        case D_FP16:                    /* skernel, hkernel */
+            if(inst_level >= 8)         /* AVX512F */
+                (*MR) = 14, (*NR) = 32;
+            break;
+        case D_FP64:
+            if(inst_level >= 8)         /* AVX512F */
+                (*MR) = 6,  (*NR) = 16;
+            else                        /* AVX, AVX2 */
+                (*MR) = 6,  (*NR) = 8;
+            break;
+        case D_INT16:
+            if(inst_level >= 9)         /* AVX512BW */
+                (*MR) = 30, (*NR) = 32;
+            else if(inst_level >= 7)    /* AVX2 */
+                (*MR) = 5,  (*NR) = 32;
+            else                        /* AVX */
+                (*MR) = 5,  (*NR) = 16;
+            break;
+        case D_INT8:
+            if(inst_level >= 9)         /* AVX512BW */
+                (*MR) = 30, (*NR) = 64;
+            else if(inst_level >= 7)    /* AVX2, int16 lanes */
+                (*MR) = 5,  (*NR) = 32;
+            else                        /* AVX */
+                (*MR) = 5,  (*NR) = 16;
+            break;
+        case D_INT8_S32:                /* see qikernel */
+            if(inst_level >= 10)        /* AVX512VNNI */
+                (*MR) = 14, (*NR) = 32;
+            else if(inst_level >= 9)    /* AVX512BW */
+                (*MR) = 10, (*NR) = 32;
+            else if(inst_level >= 7)    /* AVX2 */
+                (*MR) = 4,  (*NR) = 16;
+            else                        /* AVX */
+                (*MR) = 4,  (*NR) = 8;
+            break;
+        case D_INT16_S32:               /* see hqikernel */
+            if(inst_level >= 10)        /* AVX512VNNI */
+                (*MR) = 14, (*NR) = 32;
+            else if(inst_level >= 9)    /* AVX512BW */
+                (*MR) = 12, (*NR) = 32;
+            else if(inst_level >= 7)    /* AVX2 */
+                (*MR) = 6,  (*NR) = 16;
+            else                        /* AVX */
+                (*MR) = 6,  (*NR) = 8;
+            break;
+        default:
+            break;
+    }
+}
+
+gemm_ctx_t* gemm_ctx_create() {
+    gemm_ctx_t* ctx = (gemm_ctx_t* )calloc(1, sizeof(gemm_ctx_t));
+    if(ctx == NULL)
+        return NULL;
+
+    get_topology(&ctx->topo);
+    ctx->NTHREADS = ctx->topo.nthreads;
+    ctx->isa = gemm_isa_select(gemm_isa_detect());
+    if(ctx->isa == NULL) {
+        fprintf(stderr, "gemm.h: the kernels need at least AVX\n");
+        free(ctx);
+        return NULL;
+    }
+    ctx->inst_level = ctx->isa->inst_level;
+
+    size_t cache_size[32];
+    get_cache_size(cache_size);
+
+    for(int d_type = D_FP32; d_type < D_NUM; d_type++) {
+        gemm_blk_t* blk = &ctx->blk[d_type];
+
+        set_kernel_size(ctx->inst_level, d_type, &blk->MR, &blk->NR);
+
+        /* fallback when the cache size can't be read */
+        blk->MC = blk->MR * ctx->NTHREADS;
+        blk->KC = 256;
+        blk->NC = blk->NR * ctx->NTHREADS;
+        set_block_size(cache_size, ctx->NTHREADS, &ctx->topo, blk->MR, blk->NR,
+                       &blk->MC, &blk->KC, &blk->NC, d_type);
+        if(d_type == D_INT8_S32)        /* whole k-groups of 4 */
+            blk->KC = max(4, blk->KC / 4 * 4);
+        if(d_type == D_INT16_S32 || d_type == D_BF16)   /* whole k-pairs */
+            blk->KC = max(2, blk->KC / 2 * 2);
+    }
+    omp_init_lock(&ctx->ws_lock);
+
+    /* below about 64 x 64 x 64 the packing costs more than it saves, see *gemm_small */
+    ctx->small_mnk = GEMM_SMALL_MNK;
+    const char* env = getenv("GEMM_SMALL_MNK");
+    if(env != NULL && atoll(env) >= 0)
+        ctx->small_mnk = atoll(env);
+
+#if DEBUG
+    printf("NTHREADS: %d\n", ctx->NTHREADS);
+    printf("INSTLEVEL: %d\n", ctx->inst_level);
+    printf("SMALL_MNK: %lld\n", (long long)ctx->small_mnk);
+#endif
+    return ctx;
+}
+
+void gemm_ctx_destroy(gemm_ctx_t* ctx) {
+    if(ctx == NULL)
+        return;
+    for(int i = 0; i < ctx->nworkers; i++)
+        gemm_ctx_destroy(ctx->workers[i]);
+    free(ctx->workers);
+    omp_destroy_lock(&ctx->ws_lock);
+    free(ctx->ws.packed_A);
+    free(ctx->ws.packed_B);
+    free(ctx);
+}
+
+static void release_default_ctx() {
+    gemm_ctx_destroy(default_ctx);
+    default_ctx = NULL;
+}
+
+gemm_ctx_t* gemm_ctx_default() {
+    gemm_ctx_t* ctx;
+#pragma omp critical (gemm_default_ctx)
+    {
+        if(default_ctx == NULL) {
+            default_ctx = gemm_ctx_create();
+            atexit(release_default_ctx);
+        }
+        ctx = default_ctx;
+    }
+    return ctx;
+}
+
+/**
+ * Context of thread [tid] in the batched calls, which run a whole gemm per thread, and
+ * in the 5th loop split of the *gemm_run functions, which run a slab of C per thread.
+ * It has the block sizes of [ctx], one thread and a workspace of its own, kept from
+ * one call to the next. The workers are made on the first call that needs them.
+ */
+gemm_ctx_t* gemm_ctx_worker(gemm_ctx_t* ctx, const int tid) {
+#pragma omp critical (gemm_ctx_workers)
+    {
+        if(ctx->workers == NULL) {
+            gemm_ctx_t** workers = (gemm_ctx_t** )calloc(ctx->NTHREADS, sizeof(gemm_ctx_t* ));
+            for(int i = 0; workers != NULL && i < ctx->NTHREADS; i++) {
+                workers[i] = (gemm_ctx_t* )malloc(sizeof(gemm_ctx_t));
+                if(workers[i] == NULL)
+                    break;
+                *workers[i] = *ctx;
+                workers[i]->NTHREADS = 1;
+                memset(&workers[i]->ws, 0, sizeof(gemm_ws_t));
+                omp_init_lock(&workers[i]->ws_lock);
+                workers[i]->collect_stats = FALSE;
+                workers[i]->workers = NULL;
+                workers[i]->nworkers = 0;
+                ctx->nworkers = i + 1;
+            }
+            ctx->workers = workers;
+        }
+    }
+    return (tid < ctx->nworkers) ? ctx->workers[tid] : NULL;
+}
+
+/**
+ * Take the workspace of the context.
+ * If another call is using it, [scratch] is handed out instead.
+ */
+gemm_ws_t* gemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch) {
+    memset(scratch, 0, sizeof(gemm_ws_t));
+    if(omp_test_lock(&ctx->ws_lock))
+        return &ctx->ws;
+    return scratch;
+}
+
+void gemm_ws_release(gemm_ctx_t* ctx, gemm_ws_t* ws, gemm_ws_t* scratch) {
+    if(ws == NULL)
+        return;
+    if(ws == scratch) {
+        free(scratch->packed_A);
+        free(scratch->packed_B);
+        return;
+    }
+    omp_unset_lock(&ctx->ws_lock);
+}
+
+/**
+ * Grow the packing buffers to at least [size_A] and [size_B] bytes.
+ * Buffers are never shrunk, so the steady state doesn't allocate at all.
+ * FALSE if one can't be allocated; it is then left empty, so the next call tries again.
+ */
+BOOL gemm_ws_reserve(gemm_ws_t* ws, const size_t size_A, const size_t size_B) {
+    if(ws->size_A < size_A) {
+        size_t size = (size_A + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+        free(ws->packed_A);
+        ws->packed_A = aligned_alloc(MEM_ALIGN, size);
+        ws->size_A = (ws->packed_A != NULL) ? size : 0;
+    }
+    if(ws->size_B < size_B) {
+        size_t size = (size_B + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+        free(ws->packed_B);
+        ws->packed_B = aligned_alloc(MEM_ALIGN, size);
+        ws->size_B = (ws->packed_B != NULL) ? size : 0;
+    }
+    if(ws->size_A < size_A || ws->size_B < size_B) {
+        fprintf(stderr, "gemm.h: out of memory for the packing workspace\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Barrier for the [nthreads] threads of one gemm call, inside its parallel region.
+ * Nothing to wait for on one thread; timed while the context collects statistics.
+ */
+void gemm_barrier(gemm_ctx_t* ctx, const int nthreads) {
+    if(nthreads <= 1)
+        return;
+    if(!ctx->collect_stats) {
+#pragma omp barrier
+        return;
+    }
+
+    double start = omp_get_wtime();
+#pragma omp barrier
+    double wait = omp_get_wtime() - start;
+#pragma omp atomic
+    ctx->stats.barriers++;
+#pragma omp atomic
+    ctx->stats.barrier_wait += wait;
+}
+
+void gemm_stats_reset(gemm_ctx_t* ctx) {
+    memset(&ctx->stats, 0, sizeof(gemm_stats_t));
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+/**********************************************************************************************
+ * File   : dispatch.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      Run-time choice of the instruction set. The binary carries kernels and pack
+ *      functions for every ISA in [Makefile]; CPUID and XGETBV tell which of them the
+ *      CPU and the OS (saved register state) support, and the best one goes into the
+ *      context.
+ *
+ *      GEMM_ISA=avx|avx2|avx512f|avx512bw|vnni|bf16 in the environment caps the choice,
+ *      e.g. to test the AVX2 path on an AVX-512 machine.
+ *
+ * Reference:
+ *      https://github.com/vectorclass/version2/blob/master/instrset_detect.cpp
+ *
+**********************************************************************************************/
+
+#include "gemm.h"
+
+extern const gemm_isa_t isa_table_avx;
+extern const gemm_isa_t isa_table_avx2;
+extern const gemm_isa_t isa_table_avx512f;
+extern const gemm_isa_t isa_table_avx512bw;
+extern const gemm_isa_t isa_table_vnni;
+extern const gemm_isa_t isa_table_bf16;
+
+/* best first */
+static const gemm_isa_t* isa_tables[] = {
+    &isa_table_bf16, &isa_table_vnni, &isa_table_avx512bw, &isa_table_avx512f,
+    &isa_table_avx2, &isa_table_avx
+};
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    uint32_t eax = leaf, ebx = 0, ecx = subleaf, edx = 0;
+    __asm__ (
+        "cpuid"
+        : "+a" (eax) , "=b" (ebx) , "+c" (ecx) , "=d" (edx)
+    );
+    regs[0] = eax, regs[1] = ebx, regs[2] = ecx, regs[3] = edx;
+}
+
+/* register state the OS saves on context switch */
+static uint64_t xgetbv() {
+    uint32_t eax, edx;
+    __asm__ (
+        "xgetbv"
+        : "=a" (eax) , "=d" (edx)
+        : "c" (0)
+    );
+    return ((uint64_t)edx << 32) | eax;
+}
+
+static int isa_level(const char* name) {
+    static const char* names[] = {"avx", "avx2", "avx512f", "avx512bw", "vnni", "bf16"};
+    for(int i = 0; i < 6; i++)
+        if(!strcmp(name, names[i]))
+            return 6 + i;
+    return -1;
+}
+
+/**
+ * INSTLEVEL (see [sse.h]) the CPU can run, 0 below AVX.
+ * GEMM_ISA in the environment lowers it.
+ */
+int gemm_isa_detect() {
+    uint32_t regs[4];
+    int level = 0;
+
+    cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+    cpuid(1, 0, regs);
+    const BOOL osxsave = (regs[2] >> 27) & 1, avx = (regs[2] >> 28) & 1;
+    const BOOL fma = (regs[2] >> 12) & 1, f16c = (regs[2] >> 29) & 1;
+    if(!osxsave || !avx)
+        return 0;
+
+    const uint64_t xcr0 = xgetbv();
+    if((xcr0 & 0x6) != 0x6)                     /* XMM and YMM state */
+        return 0;
+    level = 6;                                  /* AVX */
+
+    if(max_leaf >= 7) {
+        cpuid(7, 0, regs);
+        const uint32_t max_subleaf = regs[0], ebx = regs[1], ecx = regs[2];
+        if(((ebx >> 5) & 1) && fma && f16c)     /* AVX2, with FMA and F16C */
+            level = 7;
+        if(level == 7 && ((ebx >> 16) & 1)
+            && (xcr0 & 0xE0) == 0xE0)           /* AVX512F, opmask and ZMM state */
+            level = 8;
+        if(level == 8 && ((ebx >> 30) & 1)      /* AVX512BW */
+            && ((ebx >> 17) & 1)                /* AVX512DQ */
+            && ((ebx >> 31) & 1))               /* AVX512VL */
+            level = 9;
+        if(level == 9 && ((ecx >> 11) & 1))     /* AVX512_VNNI */
+            level = 10;
+        if(level == 10 && max_subleaf >= 1) {
+            cpuid(7, 1, regs);
+            if((regs[0] >> 5) & 1)              /* AVX512_BF16 */
+                level = 11;
+        }
+    }
+
+    const char* env = getenv("GEMM_ISA");
+    if(env != NULL) {
+        int env_level = isa_level(env);
+        if(env_level < 0)
+            fprintf(stderr, "gemm.h: unknown GEMM_ISA=%s, ignored\n", env);
+        else
+            level = min(level, env_level);
+    }
+    return level;
+}
+
+/* functions of the best ISA not above [inst_level], NULL below AVX */
+const gemm_isa_t* gemm_isa_select(const int inst_level) {
+    for(int i = 0; i < (int)(sizeof(isa_tables) / sizeof(isa_tables[0])); i++)
+        if(isa_tables[i]->inst_level <= inst_level)
+            return isa_tables[i];
+    return NULL;
+}
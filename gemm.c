@@ -20,216 +20,2234 @@
 
 #include "gemm.h"
 
+/* [epi] for the part of C that starts at (row, col), bias elements of [size] bytes */
+static gemm_epilogue_t epilogue_at(const gemm_epilogue_t* epi, const size_t size,
+        const int row, const int col) {
+    gemm_epilogue_t at = *epi;
+    if(epi->bias_mode == BIAS_ROW)
+        at.bias = (const char* )epi->bias + row * size;
+    else if(epi->bias_mode == BIAS_COL)
+        at.bias = (const char* )epi->bias + col * size;
+    return at;
+}
+
+/* [epi] for the transposed C */
+static gemm_epilogue_t epilogue_transpose(const gemm_epilogue_t* epi) {
+    gemm_epilogue_t t = *epi;
+    if(epi->bias_mode == BIAS_ROW)
+        t.bias_mode = BIAS_COL;
+    else if(epi->bias_mode == BIAS_COL)
+        t.bias_mode = BIAS_ROW;
+    return t;
+}
+
+/* kernels built for this shape, see GEMM_FIXED_SHAPES; NULL if it has none */
+static const gemm_fixed_t* sgemm_fixed_find(const gemm_ctx_t* ctx, const int M, const int N, const int K) {
+    for(const gemm_fixed_t* fixed = ctx->isa->s.fixed; fixed->M != 0; fixed++)
+        if(fixed->M == M && fixed->N == N && fixed->K == K)
+            return fixed;
+    return NULL;
+}
+
+/* [epi] on element (r, c), for the calls that never reach a kernel; see vs_epilogue */
+static float sepilogue(const gemm_epilogue_t* epi, float x, const int r, const int c) {
+    if(epi->bias_mode == BIAS_ROW)
+        x += ((const float* )epi->bias)[r];
+    else if(epi->bias_mode == BIAS_COL)
+        x += ((const float* )epi->bias)[c];
+    if(epi->act == ACT_RELU)
+        x = (x > 0) ? x : 0;
+    else if(epi->act == ACT_GELU)
+        x = x / (1 + expf(-1.5957691216f * x * (1 + 0.044715f * x * x)));
+    else if(epi->act == ACT_SILU)
+        x = x / (1 + expf(-x));
+    if(epi->clamp)
+        x = fminf(fmaxf(x, epi->clamp_min), epi->clamp_max);
+    return x;
+}
+
+static double depilogue(const gemm_epilogue_t* epi, double x, const int r, const int c) {
+    if(epi->bias_mode == BIAS_ROW)
+        x += ((const double* )epi->bias)[r];
+    else if(epi->bias_mode == BIAS_COL)
+        x += ((const double* )epi->bias)[c];
+    if(epi->act == ACT_RELU)
+        x = (x > 0) ? x : 0;
+    else if(epi->act == ACT_GELU)
+        x = x / (1 + exp(-1.5957691216057308 * x * (1 + 0.044715 * x * x)));
+    else if(epi->act == ACT_SILU)
+        x = x / (1 + exp(-x));
+    if(epi->clamp)
+        x = fmin(fmax(x, epi->clamp_min), epi->clamp_max);
+    return x;
+}
+
 void sgemm(const float* A, const float* B, float* C,
         const int M, const int N, const int K) {
+    sgemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void sgemm_ctx(gemm_ctx_t* ctx, const float* A, const float* B, float* C,
+               const int M, const int N, const int K) {
+    sgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void sgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    sgemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void sgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    sgemm_ex_epi_ctx(ctx, layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, NULL);
+}
+
+void sgemm_ex_epi(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc, const gemm_epilogue_t* epi) {
+    sgemm_ex_epi_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epi);
+}
+
+void sgemm_ex_epi_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc, const gemm_epilogue_t* epi) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        gemm_epilogue_t epi_t;
+        if(epi != NULL)         /* rows of C are columns of C' */
+            epi_t = epilogue_transpose(epi);
+        sgemm_ex_epi_ctx(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, ldc, (epi != NULL) ? &epi_t : NULL);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++) {
+                C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+                if(epi != NULL)
+                    C[r * ldc + c] = sepilogue(epi, C[r * ldc + c], r, c);
+            }
+        return;
+    }
+
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
 
-#if INSTLEVEL >= 8    /* AVX512F */
-    int MR = 14, NR = 32;
-#elif INSTLEVEL >= 6  /* AVX, AVX2 */
-    int MR = 6,  NR = 16;
-#endif
-
-    int MC, KC, NC;
-    int NTHREADS = get_core_num();
-    cache_opt(NTHREADS, MR, NR, &MC, &KC, &NC, D_FP32);
-
-    /* packing for TLB efficiency */
-    float* packed_A = (float* )aligned_alloc(MEM_ALIGN, sizeof(float)* (MC * KC));
-    float* packed_B = (float* )aligned_alloc(MEM_ALIGN, sizeof(float)* (KC * NC));
-
-    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) { /* 5th loop */
-        const int nc = min(NC, N - Bm_col);         
-        for(int k = 0; k < K; k += KC) {            /* 4th loop */
-            const int kc = min(KC, K - k);     
-            spack_blockB(&B[k * N + Bm_col], packed_B, NR, nc, NC, N, kc, NTHREADS);
-            for(int Am_row = 0; Am_row < M; Am_row += MC) { /* 3rd loop */
+    /**
+     * Small enough for the packing, the workspace and the parallel region to cost more
+     * than the product: straight from A and B, when the rows of B are contiguous
+     */
+    if(epi == NULL && csB == 1 && (int64_t)M * N * K <= ctx->small_mnk) {
+        const gemm_fixed_t* fixed = sgemm_fixed_find(ctx, M, N, K);
+        if(fixed != NULL && fixed->small != NULL)
+            fixed->small(alpha, A, rsA, csA, B, rsB, beta, C, ldc);
+        else
+            ctx->isa->s.small(M, N, K, alpha, A, rsA, csA, B, rsB, beta, C, ldc);
+        return;
+    }
+    /* a single row or column of C is a matrix-vector product, see [gemv.c] */
+    if(epi == NULL && (M == 1 || N == 1)) {
+        sgemm_gemv(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc);
+        return;
+    }
+    sgemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, NULL, beta, C, ldc, epi, NULL, NULL);
+}
+
+void sgemm_gather(const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda, const int* A_rows,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc, const int* C_rows) {
+    sgemm_gather_ctx(gemm_ctx_default(), transA, transB,
+        M, N, K, alpha, A, lda, A_rows, B, ldb, beta, C, ldc, C_rows);
+}
+
+void sgemm_gather_ctx(gemm_ctx_t* ctx, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda, const int* A_rows,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc, const int* C_rows) {
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++) {
+            float* C_r = &C[((C_rows != NULL) ? C_rows[r] : r) * ldc];
+            for(int c = 0; c < N; c++)
+                C_r[c] = (beta == 0) ? 0 : beta * C_r[c];
+        }
+        return;
+    }
+
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
+
+    sgemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, NULL, beta, C, ldc, NULL, A_rows, C_rows);
+}
+
+/**
+ * 5-loop nest, run by thread [tid] of the [nthreads] threads in the parallel region
+ * of sgemm_run. Each thread packs its share of every block; A and B are packed into
+ * alternating buffers, so one barrier per block is enough: a buffer is only packed
+ * again after every thread has passed the barrier that follows the next block.
+ */
+static void sgemm_nest(gemm_ctx_t* ctx, const gemm_part_t* part,
+        float* const buf_A[2], float* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int rsA, const int csA,
+        const float* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const gemm_fixed_t* fixed,
+        const float beta, float* C, const int ldc, const gemm_epilogue_t* epi,
+        const int* A_rows, const int* C_rows) {
+    const int MR = ctx->blk[D_FP32].MR, MC = ctx->blk[D_FP32].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_FP32].NR;
+    const int KC = (packed != NULL) ? packed->KC : (fixed != NULL) ? fixed->KC : ctx->blk[D_FP32].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_FP32].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    /* the kernel built for this shape falls back to skernel by itself */
+    void (*kernel)(const float*, const float*, float*, const int, const int, const int, const int,
+                   const float, const float, const gemm_epilogue_t*, const int*)
+        = (fixed != NULL) ? fixed->kernel : ctx->isa->s.kernel;
+    int flip_A = 0, flip_B = 0;
+
+    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
+        const int nc = min(NC, N - Bm_col);
+        for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
+            const int kc = min(KC, K - k);
+            /* C is scaled by beta only once, on the first KC block */
+            const float beta_k = (k == 0) ? beta : 1;
+            /* and the epilogue is applied on the last one, when C is final */
+            const gemm_epilogue_t* epi_k = (k + kc >= K) ? epi : NULL;
+            const float* packed_B;
+            if(packed != NULL)
+                packed_B = (const float* )packed->data + gemm_packed_offset(packed, Bm_col, k);
+            else {
+                ctx->isa->s.pack_blockB_part(&B[k * rsB + Bm_col * csB], buf_B[flip_B], NR, nc, rsB, csB, kc,
+                    tid, nthreads);
+                packed_B = buf_B[flip_B], flip_B ^= 1;
+            }
+            for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
                 const int mc = min(MC, M - Am_row);
-                spack_blockA(&A[(Am_row * K) + k], packed_A, MR, mc, kc, KC, K, NTHREADS);
-#pragma omp parallel for num_threads(NTHREADS) schedule(static)
-                for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) {    /* 1st loop */
-                    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) {    /* 2nd loop */
-                        const int nr = min(NR, nc - Bb_col);
-                        const int mr = min(MR, mc - Ab_row);
-                        skernel(&packed_A[Ab_row * KC], &packed_B[Bb_col], 
-                        &C[((Am_row + Ab_row) * N) + (Bm_col + Bb_col)], mr, kc, KC, nr, NC, N);
+                const float* packed_A = buf_A[flip_A];
+                if(A_rows != NULL)
+                    ctx->isa->s.pack_blockA_rows_part(&A[k * csA], &A_rows[Am_row], buf_A[flip_A], MR, mc, kc,
+                        rsA, csA, tid, nthreads);
+                else
+                    ctx->isa->s.pack_blockA_part(&A[Am_row * rsA + k * csA], buf_A[flip_A], MR, mc, kc, rsA, csA,
+                        tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            gemm_epilogue_t epi_tile;
+                            if(epi_k != NULL)
+                                epi_tile = epilogue_at(epi_k, sizeof(float), Am_row + Ab_row, Bm_col + Bb_col);
+                            /* scattered rows are found by the kernel from the start of C */
+                            kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                            (C_rows != NULL) ? &C[Bm_col + Bb_col] : &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)],
+                            mr, kc, nr, ldc, alpha, beta_k, (epi_k != NULL) ? &epi_tile : NULL,
+                            (C_rows != NULL) ? &C_rows[Am_row + Ab_row] : NULL);
+                        }
                     }
                 }
             }
         }
     }
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see sgemm_nest; NULL out of memory */
+static gemm_ws_t* sgemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch,
+        const int M, const int N, const int K, const gemm_packed_t* packed,
+        const gemm_fixed_t* fixed, float* buf_A[2], float* buf_B[2]) {
+    const int MR = ctx->blk[D_FP32].MR, MC = ctx->blk[D_FP32].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_FP32].NR;
+    const int KC = (packed != NULL) ? packed->KC : (fixed != NULL) ? fixed->KC : ctx->blk[D_FP32].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_FP32].NC;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(float) * min(MC, (M + MR - 1) / MR * MR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (packed != NULL) ? 0 : (sizeof(float) * min(NC, (N + NR - 1) / NR * NR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (float* )ws->packed_A, buf_A[1] = (float* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (float* )ws->packed_B, buf_B[1] = (float* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/**
+ * 5-loop nest for row-major C. B is packed block by block, unless [packed]
+ * already holds all of it (see [prepack.c]), in which case [B] isn't read.
+ * Rows of A and C are gathered from and scattered to [A_rows] and [C_rows] if set.
+ */
+void sgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const float alpha, const float* A, const int rsA, const int csA,
+        const float* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const float beta, float* C, const int ldc, const gemm_epilogue_t* epi,
+        const int* A_rows, const int* C_rows) {
+    const int MR = ctx->blk[D_FP32].MR, MC = ctx->blk[D_FP32].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_FP32].NR;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_FP32].NC;
+    const int NTHREADS = ctx->NTHREADS;
+    /* pre-packed B keeps its own KC */
+    const gemm_fixed_t* fixed = (packed == NULL) ? sgemm_fixed_find(ctx, M, N, K) : NULL;
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, packed == NULL, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        float* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = sgemm_ws_acquire(ctx, &scratch, M, N, K, packed, fixed, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        sgemm_nest(ctx, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, packed, fixed, beta, C, ldc, epi, A_rows, C_rows);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        float* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = sgemm_ws_acquire(worker, &scratch, M, n1 - n0, K, NULL, fixed, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        gemm_epilogue_t epi_slab;
+        if(epi != NULL)
+            epi_slab = epilogue_at(epi, sizeof(float), 0, n0);
+        sgemm_nest(ctx, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, NULL, fixed, beta, &C[n0], ldc, (epi != NULL) ? &epi_slab : NULL, A_rows, C_rows);
+        gemm_ws_release(worker, ws, &scratch);
+    }
+}
+
+/* a group is cut into at least this many tiles for each thread, see sgemm_grouped_ctx */
+#define GROUP_TILES_PER_THREAD 4
+
+/* a tile of C in problem [p] of a group, with what it costs to pack and multiply */
+typedef struct {
+    int p;
+    int row, col, m, n;
+    double cost;
+} group_tile_t;
+
+static int group_tile_cmp(const void* a, const void* b) {
+    const double ca = ((const group_tile_t* )a)->cost, cb = ((const group_tile_t* )b)->cost;
+    return (ca < cb) - (ca > cb);       /* costliest first */
+}
+
+static int group_tile_count(const gemm_problem_t* problems, const int count, const int tm, const int tn) {
+    int ntiles = 0;
+    for(int p = 0; p < count; p++)
+        ntiles += ((problems[p].M + tm - 1) / tm) * ((problems[p].N + tn - 1) / tn);
+    return ntiles;
+}
+
+void sgemm_grouped(const gemm_problem_t* problems, const int count) {
+    sgemm_grouped_ctx(gemm_ctx_default(), problems, count);
+}
+
+/**
+ * Tiles start as MC x NC blocks and are halved, the longer side first, until there
+ * are enough of them to go round; a tile is at least MR x NR. Each one runs the whole
+ * nest of its part of C on one thread, so tiles need no barriers, and the buffers a
+ * thread packs into are those of its worker context, sized once for the largest tile.
+ */
+void sgemm_grouped_ctx(gemm_ctx_t* ctx, const gemm_problem_t* problems, const int count) {
+    const int MR = ctx->blk[D_FP32].MR, MC = ctx->blk[D_FP32].MC;
+    const int NR = ctx->blk[D_FP32].NR, NC = ctx->blk[D_FP32].NC;
+
+    /* row-major and non-empty, the others are done here */
+    gemm_problem_t* group = (gemm_problem_t* )malloc(max(count, 1) * sizeof(gemm_problem_t));
+    int ngroup = 0, K_max = 0;
+    for(int p = 0; p < count; p++) {
+        gemm_problem_t pr = problems[p];
+        if(pr.M <= 0 || pr.N <= 0)
+            continue;
+        if(pr.K <= 0 || pr.alpha == 0 || group == NULL) {
+            sgemm_ex_ctx(ctx, pr.layout, pr.transA, pr.transB, pr.M, pr.N, pr.K,
+                pr.alpha, pr.A, pr.lda, pr.B, pr.ldb, pr.beta, pr.C, pr.ldc);
+            continue;
+        }
+        if(pr.layout == L_COL_MAJOR) {      /* C' = B'A', as in sgemm_ex_ctx */
+            const gemm_problem_t t = {L_ROW_MAJOR, pr.transB, pr.transA, pr.N, pr.M, pr.K,
+                pr.alpha, pr.B, pr.ldb, pr.A, pr.lda, pr.beta, pr.C, pr.ldc};
+            pr = t;
+        }
+        group[ngroup++] = pr;
+        K_max = max(K_max, pr.K);
+    }
+    if(ngroup == 0) {
+        free(group);
+        return;
+    }
+
+    int tm = MC, tn = NC;
+    while(group_tile_count(group, ngroup, tm, tn) < GROUP_TILES_PER_THREAD * ctx->NTHREADS
+          && (tm > MR || tn > NR)) {
+        if(tn > NR && (tn >= tm || tm <= MR))
+            tn = max(NR, (tn / 2 + NR - 1) / NR * NR);
+        else
+            tm = max(MR, (tm / 2 + MR - 1) / MR * MR);
+    }
+
+    const int ntiles = group_tile_count(group, ngroup, tm, tn);
+    group_tile_t* tiles = (group_tile_t* )malloc(ntiles * sizeof(group_tile_t));
+    if(tiles == NULL) {
+        for(int p = 0; p < ngroup; p++)
+            sgemm_ex_ctx(ctx, L_ROW_MAJOR, group[p].transA, group[p].transB, group[p].M, group[p].N,
+                group[p].K, group[p].alpha, group[p].A, group[p].lda, group[p].B, group[p].ldb,
+                group[p].beta, group[p].C, group[p].ldc);
+        free(group);
+        return;
+    }
+    int t = 0;
+    for(int p = 0; p < ngroup; p++) {
+        for(int row = 0; row < group[p].M; row += tm) {
+            for(int col = 0; col < group[p].N; col += tn) {
+                const int m = min(tm, group[p].M - row), n = min(tn, group[p].N - col);
+                /* the kernel runs on whole MR x NR tiles; packing reads m + n rows of K */
+                const double m_up = (m + MR - 1) / MR * MR, n_up = (n + NR - 1) / NR * NR;
+                tiles[t++] = (group_tile_t){p, row, col, m, n, (double)group[p].K * (m_up * n_up + m + n)};
+            }
+        }
+    }
+    qsort(tiles, ntiles, sizeof(group_tile_t), group_tile_cmp);
+
+    int nthreads = min(ctx->NTHREADS, ntiles);
+    if(nthreads > 1) {
+        gemm_ctx_worker(ctx, 0);
+        nthreads = min(nthreads, ctx->nworkers);
+    }
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    const gemm_part_t tile_part = {1, 1, 1};
+#pragma omp parallel num_threads(max(nthreads, 1))
+    {
+        gemm_ctx_t* worker = (nthreads > 1) ? gemm_ctx_worker(ctx, omp_get_thread_num()) : ctx;
+        gemm_ws_t scratch;
+        float* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = sgemm_ws_acquire(worker, &scratch, tm, tn, K_max, NULL, NULL, buf_A, buf_B);
 
-    free(packed_A);
-    free(packed_B);
+#pragma omp for schedule(dynamic, 1)
+        for(int i = 0; i < ntiles; i++) {
+            if(ws == NULL)
+                continue;
+            const gemm_problem_t* pr = &group[tiles[i].p];
+            /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+            const int rsA = (pr->transA == T_NO_TRANS) ? pr->lda : 1;
+            const int csA = (pr->transA == T_NO_TRANS) ? 1 : pr->lda;
+            const int rsB = (pr->transB == T_NO_TRANS) ? pr->ldb : 1;
+            const int csB = (pr->transB == T_NO_TRANS) ? 1 : pr->ldb;
+            sgemm_nest(worker, &tile_part, buf_A, buf_B, 0, 1, tiles[i].m, tiles[i].n, pr->K,
+                pr->alpha, &pr->A[tiles[i].row * rsA], rsA, csA, &pr->B[tiles[i].col * csB], rsB, csB,
+                NULL, NULL, pr->beta, &pr->C[tiles[i].row * pr->ldc + tiles[i].col], pr->ldc, NULL, NULL, NULL);
+        }
+        gemm_ws_release(worker, ws, &scratch);
+    }
+    free(tiles);
+    free(group);
 }
 
 void dgemm(const double* A, const double* B, double* C,
         const int M, const int N, const int K) {
+    dgemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void dgemm_ctx(gemm_ctx_t* ctx, const double* A, const double* B, double* C,
+               const int M, const int N, const int K) {
+    dgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void dgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const double alpha, const double* A, const int lda,
+        const double* B, const int ldb,
+        const double beta, double* C, const int ldc) {
+    dgemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void dgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const double alpha, const double* A, const int lda,
+        const double* B, const int ldb,
+        const double beta, double* C, const int ldc) {
+    dgemm_ex_epi_ctx(ctx, layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, NULL);
+}
+
+void dgemm_ex_epi(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const double alpha, const double* A, const int lda,
+        const double* B, const int ldb,
+        const double beta, double* C, const int ldc, const gemm_epilogue_t* epi) {
+    dgemm_ex_epi_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epi);
+}
+
+void dgemm_ex_epi_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const double alpha, const double* A, const int lda,
+        const double* B, const int ldb,
+        const double beta, double* C, const int ldc, const gemm_epilogue_t* epi) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        gemm_epilogue_t epi_t;
+        if(epi != NULL)         /* rows of C are columns of C' */
+            epi_t = epilogue_transpose(epi);
+        dgemm_ex_epi_ctx(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, ldc, (epi != NULL) ? &epi_t : NULL);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++) {
+                C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+                if(epi != NULL)
+                    C[r * ldc + c] = depilogue(epi, C[r * ldc + c], r, c);
+            }
+        return;
+    }
 
-#if INSTLEVEL >= 8    /* AVX512F */
-    int MR = 6, NR = 16;
-#elif INSTLEVEL >= 6  /* AVX, AVX2 */
-    int MR = 6, NR = 8;
-#endif
-
-    int MC, KC, NC;
-    int NTHREADS = get_core_num();
-    cache_opt(NTHREADS, MR, NR, &MC, &KC, &NC, D_FP64);
-
-    /* packing for TLB efficiency */
-    double* packed_A = (double* )aligned_alloc(MEM_ALIGN, sizeof(double)* (MC * KC));
-    double* packed_B = (double* )aligned_alloc(MEM_ALIGN, sizeof(double)* (KC * NC));
-
-    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) { /* 5th loop */
-        const int nc = min(NC, N - Bm_col);         
-        for(int k = 0; k < K; k += KC) {            /* 4th loop */
-            const int kc = min(KC, K - k);     
-            dpack_blockB(&B[k * N + Bm_col], packed_B, NR, nc, NC, N, kc, NTHREADS);
-            for(int Am_row = 0; Am_row < M; Am_row += MC) { /* 3rd loop */
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
+
+    /**
+     * Small enough for the packing, the workspace and the parallel region to cost more
+     * than the product: straight from A and B, when the rows of B are contiguous
+     */
+    if(epi == NULL && csB == 1 && (int64_t)M * N * K <= ctx->small_mnk) {
+        ctx->isa->d.small(M, N, K, alpha, A, rsA, csA, B, rsB, beta, C, ldc);
+        return;
+    }
+    /* a single row or column of C is a matrix-vector product, see [gemv.c] */
+    if(epi == NULL && (M == 1 || N == 1)) {
+        dgemm_gemv(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc);
+        return;
+    }
+    dgemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, NULL, beta, C, ldc, epi);
+}
+
+/**
+ * 5-loop nest, run by thread [tid] of the [nthreads] threads in the parallel region
+ * of dgemm_run. Each thread packs its share of every block; A and B are packed into
+ * alternating buffers, so one barrier per block is enough: a buffer is only packed
+ * again after every thread has passed the barrier that follows the next block.
+ */
+static void dgemm_nest(gemm_ctx_t* ctx, const gemm_part_t* part,
+        double* const buf_A[2], double* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const double alpha, const double* A, const int rsA, const int csA,
+        const double* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const double beta, double* C, const int ldc, const gemm_epilogue_t* epi) {
+    const int MR = ctx->blk[D_FP64].MR, MC = ctx->blk[D_FP64].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_FP64].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_FP64].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_FP64].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
+
+    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
+        const int nc = min(NC, N - Bm_col);
+        for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
+            const int kc = min(KC, K - k);
+            /* C is scaled by beta only once, on the first KC block */
+            const double beta_k = (k == 0) ? beta : 1;
+            /* and the epilogue is applied on the last one, when C is final */
+            const gemm_epilogue_t* epi_k = (k + kc >= K) ? epi : NULL;
+            const double* packed_B;
+            if(packed != NULL)
+                packed_B = (const double* )packed->data + gemm_packed_offset(packed, Bm_col, k);
+            else {
+                ctx->isa->d.pack_blockB_part(&B[k * rsB + Bm_col * csB], buf_B[flip_B], NR, nc, rsB, csB, kc,
+                    tid, nthreads);
+                packed_B = buf_B[flip_B], flip_B ^= 1;
+            }
+            for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
                 const int mc = min(MC, M - Am_row);
-                dpack_blockA(&A[(Am_row * K) + k], packed_A, MR, mc, kc, KC, K, NTHREADS);
-#pragma omp parallel for num_threads(NTHREADS) schedule(static)
-                for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) {    /* 1st loop */
-                    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) {    /* 2nd loop */
-                        const int nr = min(NR, nc - Bb_col);
-                        const int mr = min(MR, mc - Ab_row);
-                        dkernel(&packed_A[Ab_row * KC], &packed_B[Bb_col], 
-                        &C[((Am_row + Ab_row) * N) + (Bm_col + Bb_col)], mr, kc, KC, nr, NC, N);
+                const double* packed_A = buf_A[flip_A];
+                ctx->isa->d.pack_blockA_part(&A[Am_row * rsA + k * csA], buf_A[flip_A], MR, mc, kc, rsA, csA,
+                    tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            gemm_epilogue_t epi_tile;
+                            if(epi_k != NULL)
+                                epi_tile = epilogue_at(epi_k, sizeof(double), Am_row + Ab_row, Bm_col + Bb_col);
+                            ctx->isa->d.kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                            &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)], mr, kc, nr, ldc,
+                            alpha, beta_k, (epi_k != NULL) ? &epi_tile : NULL);
+                        }
                     }
                 }
             }
         }
     }
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see dgemm_nest; NULL out of memory */
+static gemm_ws_t* dgemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch,
+        const int M, const int N, const int K, const gemm_packed_t* packed,
+        double* buf_A[2], double* buf_B[2]) {
+    const int MR = ctx->blk[D_FP64].MR, MC = ctx->blk[D_FP64].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_FP64].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_FP64].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_FP64].NC;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(double) * min(MC, (M + MR - 1) / MR * MR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (packed != NULL) ? 0 : (sizeof(double) * min(NC, (N + NR - 1) / NR * NR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (double* )ws->packed_A, buf_A[1] = (double* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (double* )ws->packed_B, buf_B[1] = (double* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/**
+ * 5-loop nest for row-major C. B is packed block by block, unless [packed]
+ * already holds all of it (see [prepack.c]), in which case [B] isn't read.
+ */
+void dgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const double alpha, const double* A, const int rsA, const int csA,
+        const double* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const double beta, double* C, const int ldc, const gemm_epilogue_t* epi) {
+    const int MR = ctx->blk[D_FP64].MR, MC = ctx->blk[D_FP64].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_FP64].NR;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_FP64].NC;
+    const int NTHREADS = ctx->NTHREADS;
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, packed == NULL, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        double* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = dgemm_ws_acquire(ctx, &scratch, M, N, K, packed, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        dgemm_nest(ctx, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, packed, beta, C, ldc, epi);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
 
-    free(packed_A);
-    free(packed_B);
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        double* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = dgemm_ws_acquire(worker, &scratch, M, n1 - n0, K, NULL, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        gemm_epilogue_t epi_slab;
+        if(epi != NULL)
+            epi_slab = epilogue_at(epi, sizeof(double), 0, n0);
+        dgemm_nest(ctx, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, NULL, beta, &C[n0], ldc, (epi != NULL) ? &epi_slab : NULL);
+        gemm_ws_release(worker, ws, &scratch);
+    }
 }
 
 void igemm(const int* A, const int* B, int* C,
-           const int M, const int N, const int K) {
+        const int M, const int N, const int K) {
+    igemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void igemm_ctx(gemm_ctx_t* ctx, const int* A, const int* B, int* C,
+               const int M, const int N, const int K) {
+    igemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void igemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const int alpha, const int* A, const int lda,
+        const int* B, const int ldb,
+        const int beta, int* C, const int ldc) {
+    igemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void igemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const int alpha, const int* A, const int lda,
+        const int* B, const int ldb,
+        const int beta, int* C, const int ldc) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        igemm_ex_ctx(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, ldc);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++)
+                C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+        return;
+    }
 
-#if INSTLEVEL >= 8    /* AVX512F */
-    int MR = 14, NR = 32;
-#elif INSTLEVEL >= 6  /* AVX, AVX2 */
-    int MR = 6,  NR = 16;
-#endif
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
 
-    int MC, KC, NC;
-    int NTHREADS = get_core_num();
-    cache_opt(NTHREADS, MR, NR, &MC, &KC, &NC, D_INT32);
+    igemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, NULL, beta, C, ldc);
+}
 
-    /* packing for TLB efficiency */
-    int* packed_A = (int* )aligned_alloc(MEM_ALIGN, sizeof(int)* (MC * KC));
-    int* packed_B = (int* )aligned_alloc(MEM_ALIGN, sizeof(int)* (KC * NC));
+/**
+ * 5-loop nest, run by thread [tid] of the [nthreads] threads in the parallel region
+ * of igemm_run. Each thread packs its share of every block; A and B are packed into
+ * alternating buffers, so one barrier per block is enough: a buffer is only packed
+ * again after every thread has passed the barrier that follows the next block.
+ */
+static void igemm_nest(gemm_ctx_t* ctx, const gemm_part_t* part,
+        int* const buf_A[2], int* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const int alpha, const int* A, const int rsA, const int csA,
+        const int* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const int beta, int* C, const int ldc) {
+    const int MR = ctx->blk[D_INT32].MR, MC = ctx->blk[D_INT32].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT32].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_INT32].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT32].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
 
     for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
-        const int nc = min(NC, N - Bm_col);         
+        const int nc = min(NC, N - Bm_col);
         for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
-            const int kc = min(KC, K - k);     
-            ipack_blockB(&B[k * N + Bm_col], packed_B, NR, nc, NC, N, kc, NTHREADS);
+            const int kc = min(KC, K - k);
+            /* C is scaled by beta only once, on the first KC block */
+            const int beta_k = (k == 0) ? beta : 1;
+            const int* packed_B;
+            if(packed != NULL)
+                packed_B = (const int* )packed->data + gemm_packed_offset(packed, Bm_col, k);
+            else {
+                ctx->isa->i.pack_blockB_part(&B[k * rsB + Bm_col * csB], buf_B[flip_B], NR, nc, rsB, csB, kc,
+                    tid, nthreads);
+                packed_B = buf_B[flip_B], flip_B ^= 1;
+            }
             for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
                 const int mc = min(MC, M - Am_row);
-                ipack_blockA(&A[(Am_row * K) + k], packed_A, MR, mc, kc, KC, K, NTHREADS);
-#pragma omp parallel for num_threads(NTHREADS) schedule(static)
-                for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) {            /* 2nd loop */
-                    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) {        /* 1st loop */
-                        const int nr = min(NR, nc - Bb_col);
-                        const int mr = min(MR, mc - Ab_row);
-                        ikernel(&packed_A[Ab_row * KC], &packed_B[Bb_col], 
-                        &C[((Am_row + Ab_row) * N) + (Bm_col + Bb_col)], mr, kc, KC, nr, NC, N);
+                const int* packed_A = buf_A[flip_A];
+                ctx->isa->i.pack_blockA_part(&A[Am_row * rsA + k * csA], buf_A[flip_A], MR, mc, kc, rsA, csA,
+                    tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            ctx->isa->i.kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                            &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)], mr, kc, nr, ldc,
+                            alpha, beta_k);
+                        }
                     }
                 }
             }
         }
     }
-    
-    free(packed_A);
-    free(packed_B);
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see igemm_nest; NULL out of memory */
+static gemm_ws_t* igemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch,
+        const int M, const int N, const int K, const gemm_packed_t* packed,
+        int* buf_A[2], int* buf_B[2]) {
+    const int MR = ctx->blk[D_INT32].MR, MC = ctx->blk[D_INT32].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT32].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_INT32].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT32].NC;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(int) * min(MC, (M + MR - 1) / MR * MR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (packed != NULL) ? 0 : (sizeof(int) * min(NC, (N + NR - 1) / NR * NR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (int* )ws->packed_A, buf_A[1] = (int* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (int* )ws->packed_B, buf_B[1] = (int* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/**
+ * 5-loop nest for row-major C. B is packed block by block, unless [packed]
+ * already holds all of it (see [prepack.c]), in which case [B] isn't read.
+ */
+void igemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const int alpha, const int* A, const int rsA, const int csA,
+        const int* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const int beta, int* C, const int ldc) {
+    const int MR = ctx->blk[D_INT32].MR, MC = ctx->blk[D_INT32].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT32].NR;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT32].NC;
+    const int NTHREADS = ctx->NTHREADS;
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, packed == NULL, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        int* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = igemm_ws_acquire(ctx, &scratch, M, N, K, packed, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        igemm_nest(ctx, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, packed, beta, C, ldc);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        int* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = igemm_ws_acquire(worker, &scratch, M, n1 - n0, K, NULL, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        igemm_nest(ctx, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, NULL, beta, &C[n0], ldc);
+        gemm_ws_release(worker, ws, &scratch);
+    }
 }
 
 void hqgemm(const int16_t* A, const int16_t* B, int16_t* C,
-           const int M, const int N, const int K) {
+        const int M, const int N, const int K) {
+    hqgemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void hqgemm_ctx(gemm_ctx_t* ctx, const int16_t* A, const int16_t* B, int16_t* C,
+               const int M, const int N, const int K) {
+    hqgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void hqgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const int16_t alpha, const int16_t* A, const int lda,
+        const int16_t* B, const int ldb,
+        const int16_t beta, int16_t* C, const int ldc) {
+    hqgemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
 
-#if INSTLEVEL >= 9    /* AVX512BW */
-    int MR = 30, NR = 32;
-#elif INSTLEVEL >= 7  /* AVX2 */
-    int MR = 6,  NR = 16;
-#elif INSTLEVEL >= 6
-    int MR = 6,  NR = 16;
-#endif
+void hqgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const int16_t alpha, const int16_t* A, const int lda,
+        const int16_t* B, const int ldb,
+        const int16_t beta, int16_t* C, const int ldc) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        hqgemm_ex_ctx(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, ldc);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++)
+                C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+        return;
+    }
+
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
 
-    int MC, KC, NC;
-    int NTHREADS = 8;
-    cache_opt(NTHREADS, MR, NR, &MC, &KC, &NC, D_INT16);
+    hqgemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, NULL, beta, C, ldc);
+}
 
-    /* packing for TLB efficiency */
-    int16_t* packed_A = (int16_t* )aligned_alloc(MEM_ALIGN, sizeof(int16_t)* (MC * KC));
-    int16_t* packed_B = (int16_t* )aligned_alloc(MEM_ALIGN, sizeof(int16_t)* (KC * NC));
+/**
+ * 5-loop nest, run by thread [tid] of the [nthreads] threads in the parallel region
+ * of hqgemm_run. Each thread packs its share of every block; A and B are packed into
+ * alternating buffers, so one barrier per block is enough: a buffer is only packed
+ * again after every thread has passed the barrier that follows the next block.
+ */
+static void hqgemm_nest(gemm_ctx_t* ctx, const gemm_part_t* part,
+        int16_t* const buf_A[2], int16_t* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const int16_t alpha, const int16_t* A, const int rsA, const int csA,
+        const int16_t* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const int16_t beta, int16_t* C, const int ldc) {
+    const int MR = ctx->blk[D_INT16].MR, MC = ctx->blk[D_INT16].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT16].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_INT16].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT16].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
 
     for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
-        const int nc = min(NC, N - Bm_col);         
+        const int nc = min(NC, N - Bm_col);
         for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
-            const int kc = min(KC, K - k);     
-            hqpack_blockB(&B[k * N + Bm_col], packed_B, NR, nc, NC, N, kc);
+            const int kc = min(KC, K - k);
+            /* C is scaled by beta only once, on the first KC block */
+            const int16_t beta_k = (k == 0) ? beta : 1;
+            const int16_t* packed_B;
+            if(packed != NULL)
+                packed_B = (const int16_t* )packed->data + gemm_packed_offset(packed, Bm_col, k);
+            else {
+                ctx->isa->hq.pack_blockB_part(&B[k * rsB + Bm_col * csB], buf_B[flip_B], NR, nc, rsB, csB, kc,
+                    tid, nthreads);
+                packed_B = buf_B[flip_B], flip_B ^= 1;
+            }
             for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
                 const int mc = min(MC, M - Am_row);
-                hqpack_blockA(&A[(Am_row * K) + k], packed_A, MR, mc, kc, KC, K);
-#pragma omp parallel for num_threads(NTHREADS) schedule(static)
-                for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) {            /* 2nd loop */
-                    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) {        /* 1st loop */
-                        const int nr = min(NR, nc - Bb_col);
-                        const int mr = min(MR, mc - Ab_row);
-                        hqkernel(&packed_A[Ab_row * KC], &packed_B[Bb_col], 
-                        &C[((Am_row + Ab_row) * N) + (Bm_col + Bb_col)], mr, kc, KC, nr, NC, N);
+                const int16_t* packed_A = buf_A[flip_A];
+                ctx->isa->hq.pack_blockA_part(&A[Am_row * rsA + k * csA], buf_A[flip_A], MR, mc, kc, rsA, csA,
+                    tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            ctx->isa->hq.kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                            &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)], mr, kc, nr, ldc,
+                            alpha, beta_k);
+                        }
                     }
                 }
             }
         }
     }
-    
-    free(packed_A);
-    free(packed_B);
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see hqgemm_nest; NULL out of memory */
+static gemm_ws_t* hqgemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch,
+        const int M, const int N, const int K, const gemm_packed_t* packed,
+        int16_t* buf_A[2], int16_t* buf_B[2]) {
+    const int MR = ctx->blk[D_INT16].MR, MC = ctx->blk[D_INT16].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT16].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_INT16].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT16].NC;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(int16_t) * min(MC, (M + MR - 1) / MR * MR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (packed != NULL) ? 0 : (sizeof(int16_t) * min(NC, (N + NR - 1) / NR * NR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (int16_t* )ws->packed_A, buf_A[1] = (int16_t* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (int16_t* )ws->packed_B, buf_B[1] = (int16_t* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/**
+ * 5-loop nest for row-major C. B is packed block by block, unless [packed]
+ * already holds all of it (see [prepack.c]), in which case [B] isn't read.
+ */
+void hqgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const int16_t alpha, const int16_t* A, const int rsA, const int csA,
+        const int16_t* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const int16_t beta, int16_t* C, const int ldc) {
+    const int MR = ctx->blk[D_INT16].MR, MC = ctx->blk[D_INT16].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT16].NR;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT16].NC;
+    const int NTHREADS = ctx->NTHREADS;
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, packed == NULL, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        int16_t* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = hqgemm_ws_acquire(ctx, &scratch, M, N, K, packed, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        hqgemm_nest(ctx, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, packed, beta, C, ldc);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        int16_t* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = hqgemm_ws_acquire(worker, &scratch, M, n1 - n0, K, NULL, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        hqgemm_nest(ctx, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, NULL, beta, &C[n0], ldc);
+        gemm_ws_release(worker, ws, &scratch);
+    }
 }
 
 void qgemm(const int8_t* A, const int8_t* B, int8_t* C,
-           const int M, const int N, const int K) {
+        const int M, const int N, const int K) {
+    qgemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void qgemm_ctx(gemm_ctx_t* ctx, const int8_t* A, const int8_t* B, int8_t* C,
+               const int M, const int N, const int K) {
+    qgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void qgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const int8_t alpha, const int8_t* A, const int lda,
+        const int8_t* B, const int ldb,
+        const int8_t beta, int8_t* C, const int ldc) {
+    qgemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void qgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const int8_t alpha, const int8_t* A, const int lda,
+        const int8_t* B, const int ldb,
+        const int8_t beta, int8_t* C, const int ldc) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        qgemm_ex_ctx(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, ldc);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++)
+                C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+        return;
+    }
+
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
+
+    qgemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, NULL, beta, C, ldc);
+}
+
+/**
+ * 5-loop nest, run by thread [tid] of the [nthreads] threads in the parallel region
+ * of qgemm_run. Each thread packs its share of every block; A and B are packed into
+ * alternating buffers, so one barrier per block is enough: a buffer is only packed
+ * again after every thread has passed the barrier that follows the next block.
+ */
+static void qgemm_nest(gemm_ctx_t* ctx, const gemm_part_t* part,
+        int8_t* const buf_A[2], int8_t* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const int8_t alpha, const int8_t* A, const int rsA, const int csA,
+        const int8_t* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const int8_t beta, int8_t* C, const int ldc) {
+    const int MR = ctx->blk[D_INT8].MR, MC = ctx->blk[D_INT8].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT8].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_INT8].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT8].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
+
+    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
+        const int nc = min(NC, N - Bm_col);
+        for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
+            const int kc = min(KC, K - k);
+            /* C is scaled by beta only once, on the first KC block */
+            const int8_t beta_k = (k == 0) ? beta : 1;
+            const int8_t* packed_B;
+            if(packed != NULL)
+                packed_B = (const int8_t* )packed->data + gemm_packed_offset(packed, Bm_col, k);
+            else {
+                ctx->isa->q.pack_blockB_part(&B[k * rsB + Bm_col * csB], buf_B[flip_B], NR, nc, rsB, csB, kc,
+                    tid, nthreads);
+                packed_B = buf_B[flip_B], flip_B ^= 1;
+            }
+            for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
+                const int mc = min(MC, M - Am_row);
+                const int8_t* packed_A = buf_A[flip_A];
+                ctx->isa->q.pack_blockA_part(&A[Am_row * rsA + k * csA], buf_A[flip_A], MR, mc, kc, rsA, csA,
+                    tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            ctx->isa->q.kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                            &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)], mr, kc, nr, ldc,
+                            alpha, beta_k);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see qgemm_nest; NULL out of memory */
+static gemm_ws_t* qgemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch,
+        const int M, const int N, const int K, const gemm_packed_t* packed,
+        int8_t* buf_A[2], int8_t* buf_B[2]) {
+    const int MR = ctx->blk[D_INT8].MR, MC = ctx->blk[D_INT8].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT8].NR;
+    const int KC = (packed != NULL) ? packed->KC : ctx->blk[D_INT8].KC;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT8].NC;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(int8_t) * min(MC, (M + MR - 1) / MR * MR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (packed != NULL) ? 0 : (sizeof(int8_t) * min(NC, (N + NR - 1) / NR * NR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (int8_t* )ws->packed_A, buf_A[1] = (int8_t* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (int8_t* )ws->packed_B, buf_B[1] = (int8_t* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/**
+ * 5-loop nest for row-major C. B is packed block by block, unless [packed]
+ * already holds all of it (see [prepack.c]), in which case [B] isn't read.
+ */
+void qgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const int8_t alpha, const int8_t* A, const int rsA, const int csA,
+        const int8_t* B, const int rsB, const int csB, const gemm_packed_t* packed,
+        const int8_t beta, int8_t* C, const int ldc) {
+    const int MR = ctx->blk[D_INT8].MR, MC = ctx->blk[D_INT8].MC;
+    const int NR = (packed != NULL) ? packed->NR : ctx->blk[D_INT8].NR;
+    const int NC = (packed != NULL) ? packed->NC : ctx->blk[D_INT8].NC;
+    const int NTHREADS = ctx->NTHREADS;
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, packed == NULL, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        int8_t* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = qgemm_ws_acquire(ctx, &scratch, M, N, K, packed, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        qgemm_nest(ctx, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, packed, beta, C, ldc);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        int8_t* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = qgemm_ws_acquire(worker, &scratch, M, n1 - n0, K, NULL, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        qgemm_nest(ctx, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, NULL, beta, &C[n0], ldc);
+        gemm_ws_release(worker, ws, &scratch);
+    }
+}
+void qgemm_s32(const uint8_t* A, const int8_t* B, int32_t* C,
+        const int M, const int N, const int K) {
+    qgemm_s32_ex_ctx(gemm_ctx_default(), M, N, K, A, K, 0, B, N, 0, C, N);
+}
+
+void qgemm_s32_ctx(gemm_ctx_t* ctx, const uint8_t* A, const int8_t* B, int32_t* C,
+               const int M, const int N, const int K) {
+    qgemm_s32_ex_ctx(ctx, M, N, K, A, K, 0, B, N, 0, C, N);
+}
+
+void qgemm_s32_ex(const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero,
+        int32_t* C, const int ldc) {
+    qgemm_s32_ex_ctx(gemm_ctx_default(), M, N, K, A, lda, a_zero, B, ldb, b_zero, C, ldc);
+}
+
+void qgemm_s32_ex_ctx(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero,
+        int32_t* C, const int ldc) {
+    qgemm_s32_run(ctx, M, N, K, A, lda, 0, a_zero, B, ldb, b_zero, C, NULL, ldc, NULL);
+}
+
+void qgemm_requant(const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero,
+        void* C, const int ldc, const gemm_requant_t* rq) {
+    qgemm_requant_ctx(gemm_ctx_default(), M, N, K, A, lda, a_zero, B, ldb, b_zero, C, ldc, rq);
+}
+
+void qgemm_requant_ctx(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero,
+        void* C, const int ldc, const gemm_requant_t* rq) {
+    qgemm_s32_run(ctx, M, N, K, A, lda, 0, a_zero, B, ldb, b_zero, NULL, (uint8_t* )C, ldc, rq);
+}
+
+void qgemm_s8s8_s32(const int8_t* A, const int8_t* B, int32_t* C,
+        const int M, const int N, const int K) {
+    qgemm_s8s8_s32_ctx(gemm_ctx_default(), A, B, C, M, N, K);
+}
+
+/* vpdpbusd wants an unsigned A: A + 128 is packed, 128 is its zero point */
+void qgemm_s8s8_s32_ctx(gemm_ctx_t* ctx, const int8_t* A, const int8_t* B, int32_t* C,
+        const int M, const int N, const int K) {
+    qgemm_s32_run(ctx, M, N, K, (const uint8_t* )A, K, 0x80, 128, B, N, 0, C, NULL, N, NULL);
+}
+
+/**
+ * Zero-point terms of (A - a_zero)(B - b_zero) = AB - b_zero * rowsum(A) - a_zero * colsum(B)
+ * + K * a_zero * b_zero, split into row_off[M] and col_off[N] for the kernel.
+ */
+static void qgemm_s32_offsets(const int NTHREADS, const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const uint8_t flip, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero,
+        int32_t* row_off, int32_t* col_off) {
+#pragma omp parallel num_threads(NTHREADS)
+    {
+#pragma omp for schedule(static) nowait
+        for(int r = 0; r < M; r++) {
+            int64_t sum = 0;
+            for(int k = 0; k < K; k++)
+                sum += (uint8_t)(A[r * lda + k] ^ flip);
+            row_off[r] = (int32_t)((int64_t)K * a_zero * b_zero - b_zero * sum);
+        }
+        /* B is read row by row, 64 columns at a time */
+#pragma omp for schedule(static)
+        for(int c0 = 0; c0 < N; c0 += 64) {
+            int64_t sum[64] = {0};
+            const int cn = min(64, N - c0);
+            for(int k = 0; k < K; k++)
+                for(int c = 0; c < cn; c++)
+                    sum[c] += B[k * ldb + c0 + c];
+            for(int c = 0; c < cn; c++)
+                col_off[c0 + c] = (int32_t)(-a_zero * sum[c]);
+        }
+    }
+}
+
+/* [rq] for the columns of C from [col] on */
+static gemm_requant_t requant_at(const gemm_requant_t* rq, const int col) {
+    gemm_requant_t at = *rq;
+    if(rq->per_channel) {
+        at.scale = &rq->scale[col];
+        at.bias = (rq->bias != NULL) ? &rq->bias[col] : NULL;
+    }
+    return at;
+}
+
+/* [rq] on one accumulator of column [c], as the kernel does it */
+static uint8_t requant_one(const gemm_requant_t* rq, const int32_t acc, const int c) {
+    const int i = rq->per_channel ? c : 0;
+    const int32_t lo = rq->out_signed ? -128 : 0, hi = rq->out_signed ? 127 : 255;
+    float y = (float)(int32_t)((uint32_t)acc + (uint32_t)((rq->bias != NULL) ? rq->bias[i] : 0)) * rq->scale[i];
+    y = fminf(fmaxf(y, lo - (float)rq->zero_point), hi - (float)rq->zero_point);
+    return (uint8_t)((int32_t)rintf(y) + rq->zero_point);
+}
+
+/**
+ * 5-loop nest of qgemm_s32, run by thread [tid] of the [nthreads] threads, as in
+ * sgemm_nest, with the block sizes of [blk]. Packed slivers hold kc rounded up to
+ * k-groups of 4. With [rq], [blk] has K in one KC block and the kernel writes C_q.
+ */
+static void qgemm_s32_nest(gemm_ctx_t* ctx, const gemm_blk_t* blk, const gemm_part_t* part,
+        uint8_t* const buf_A[2], int8_t* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const uint8_t flip,
+        const int8_t* B, const int ldb,
+        const int32_t* row_off, const int32_t* col_off,
+        int32_t* C, uint8_t* C_q, const int ldc, const gemm_requant_t* rq) {
+    const int MR = blk->MR, MC = blk->MC;
+    const int NR = blk->NR;
+    const int KC = blk->KC;
+    const int NC = blk->NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
+
+    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
+        const int nc = min(NC, N - Bm_col);
+        for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
+            const int kc = min(KC, K - k), kc4 = (kc + 3) / 4 * 4;
+            /* C is overwritten on the first KC block, with the zero-point terms */
+            const int beta_k = (k == 0) ? 0 : 1;
+            const int8_t* packed_B = buf_B[flip_B];
+            ctx->isa->qi.pack_blockB_part(&B[k * ldb + Bm_col], buf_B[flip_B], NR, nc, ldb, 1, kc,
+                tid, nthreads);
+            flip_B ^= 1;
+            for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
+                const int mc = min(MC, M - Am_row);
+                const uint8_t* packed_A = buf_A[flip_A];
+                ctx->isa->qi.pack_blockA_part(&A[Am_row * lda + k], buf_A[flip_A], MR, mc, kc, lda, 1,
+                    flip, tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            const size_t C_off = (size_t)(Am_row + Ab_row) * ldc + (Bm_col + Bb_col);
+                            gemm_requant_t rq_tile;
+                            if(rq != NULL)
+                                rq_tile = requant_at(rq, Bm_col + Bb_col);
+                            ctx->isa->qi.kernel(&packed_A[Ab_row * kc4], &packed_B[Bb_col * kc4],
+                            (C != NULL) ? &C[C_off] : NULL, mr, kc, nr, ldc,
+                            (row_off != NULL) ? &row_off[Am_row + Ab_row] : NULL,
+                            (col_off != NULL) ? &col_off[Bm_col + Bb_col] : NULL, beta_k,
+                            (rq != NULL) ? &C_q[C_off] : NULL, (rq != NULL) ? &rq_tile : NULL);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see qgemm_s32_nest; NULL out of memory */
+static gemm_ws_t* qgemm_s32_ws_acquire(gemm_ctx_t* ctx, const gemm_blk_t* blk, gemm_ws_t* scratch,
+        const int M, const int N, const int K,
+        uint8_t* buf_A[2], int8_t* buf_B[2]) {
+    const int MR = blk->MR, MC = blk->MC;
+    const int NR = blk->NR;
+    const int KC = blk->KC;
+    const int NC = blk->NC;
+    const int kc4 = (min(KC, K) + 3) / 4 * 4;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(uint8_t) * min(MC, (M + MR - 1) / MR * MR) * kc4
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (sizeof(int8_t) * min(NC, (N + NR - 1) / NR * NR) * kc4
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (uint8_t* )ws->packed_A, buf_A[1] = (uint8_t* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (int8_t* )ws->packed_B, buf_B[1] = (int8_t* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/* row-major A (M x K), B (K x N) and C (M x N); A is xor-ed with [flip] while packed */
+void qgemm_s32_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const uint8_t* A, const int lda, const uint8_t flip, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero,
+        int32_t* C, uint8_t* C_q, const int ldc, const gemm_requant_t* rq) {
+    const int NTHREADS = ctx->NTHREADS;
+
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0) {
+        for(int r = 0; r < M; r++) {
+            if(rq == NULL)
+                memset(&C[r * ldc], 0, N * sizeof(int32_t));
+            else
+                for(int c = 0; c < N; c++)
+                    C_q[r * ldc + c] = requant_one(rq, 0, c);
+        }
+        return;
+    }
+
+    /**
+     * Requantized C must be final when the kernel stores it, so all of K goes in one
+     * KC block; MC and NC shrink by as much to keep the packed blocks in their caches.
+     */
+    gemm_blk_t blk = ctx->blk[D_INT8_S32];
+    if(rq != NULL && K > blk.KC) {
+        const int K4 = (K + 3) / 4 * 4;
+        blk.MC = max(blk.MR, (int)((int64_t)blk.MC * blk.KC / K4 / blk.MR * blk.MR));
+        blk.NC = max(blk.NR, (int)((int64_t)blk.NC * blk.KC / K4 / blk.NR * blk.NR));
+        blk.KC = K4;
+    }
+    /* a single row of A is a matrix-vector product, see [gemv.c] */
+    if(M == 1 && rq == NULL && qgemm_s32_gemv(ctx, N, K, A, flip, a_zero, B, ldb, b_zero, C))
+        return;
+    const int MR = blk.MR, MC = blk.MC;
+    const int NR = blk.NR, NC = blk.NC;
+
+    int32_t* offsets = NULL, * row_off = NULL, * col_off = NULL;
+    if(a_zero != 0 || b_zero != 0) {
+        offsets = (int32_t* )malloc((M + N) * sizeof(int32_t));
+        row_off = offsets, col_off = offsets + M;
+        qgemm_s32_offsets(NTHREADS, M, N, K, A, lda, flip, a_zero, B, ldb, b_zero, row_off, col_off);
+    }
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, TRUE, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        uint8_t* buf_A[2];
+        int8_t* buf_B[2];
+        gemm_ws_t* ws = qgemm_s32_ws_acquire(ctx, &blk, &scratch, M, N, K, buf_A, buf_B);
+        if(ws == NULL) {
+            free(offsets);
+            return;
+        }
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        qgemm_s32_nest(ctx, &blk, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, A, lda, flip, B, ldb, row_off, col_off, C, C_q, ldc, rq);
+        gemm_ws_release(ctx, ws, &scratch);
+        free(offsets);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        uint8_t* buf_A[2];
+        int8_t* buf_B[2];
+        gemm_ws_t* ws = qgemm_s32_ws_acquire(worker, &blk, &scratch, M, n1 - n0, K, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        gemm_requant_t rq_slab;
+        if(rq != NULL)
+            rq_slab = requant_at(rq, n0);
+        qgemm_s32_nest(ctx, &blk, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, A, lda, flip,
+            &B[n0], ldb, row_off, (col_off != NULL) ? &col_off[n0] : NULL,
+            (C != NULL) ? &C[n0] : NULL, (C_q != NULL) ? &C_q[n0] : NULL, ldc,
+            (rq != NULL) ? &rq_slab : NULL);
+        gemm_ws_release(worker, ws, &scratch);
+    }
+    free(offsets);
+}
+
+void hqgemm_s32(const int16_t* A, const int16_t* B, int32_t* C,
+        const int M, const int N, const int K) {
+    hqgemm_s32_ex_ctx(gemm_ctx_default(), M, N, K, A, K, B, N, C, N);
+}
+
+void hqgemm_s32_ctx(gemm_ctx_t* ctx, const int16_t* A, const int16_t* B, int32_t* C,
+               const int M, const int N, const int K) {
+    hqgemm_s32_ex_ctx(ctx, M, N, K, A, K, B, N, C, N);
+}
+
+void hqgemm_s32_ex(const int M, const int N, const int K,
+        const int16_t* A, const int lda, const int16_t* B, const int ldb,
+        int32_t* C, const int ldc) {
+    hqgemm_s32_ex_ctx(gemm_ctx_default(), M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+/**
+ * 5-loop nest of hqgemm_s32, run by thread [tid] of the [nthreads] threads, as in
+ * sgemm_nest. Packed slivers hold kc rounded up to k-pairs.
+ */
+static void hqgemm_s32_nest(gemm_ctx_t* ctx, const gemm_part_t* part,
+        int16_t* const buf_A[2], int16_t* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const int16_t* A, const int lda, const int16_t* B, const int ldb,
+        int32_t* C, const int ldc) {
+    const int MR = ctx->blk[D_INT16_S32].MR, MC = ctx->blk[D_INT16_S32].MC;
+    const int NR = ctx->blk[D_INT16_S32].NR;
+    const int KC = ctx->blk[D_INT16_S32].KC;
+    const int NC = ctx->blk[D_INT16_S32].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
+
+    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
+        const int nc = min(NC, N - Bm_col);
+        for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
+            const int kc = min(KC, K - k), kc2 = (kc + 1) / 2 * 2;
+            const int beta_k = (k == 0) ? 0 : 1;    /* C is overwritten on the first KC block */
+            const int16_t* packed_B = buf_B[flip_B];
+            ctx->isa->hqi.pack_blockB_part(&B[k * ldb + Bm_col], buf_B[flip_B], NR, nc, ldb, 1, kc,
+                tid, nthreads);
+            flip_B ^= 1;
+            for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
+                const int mc = min(MC, M - Am_row);
+                const int16_t* packed_A = buf_A[flip_A];
+                ctx->isa->hqi.pack_blockA_part(&A[Am_row * lda + k], buf_A[flip_A], MR, mc, kc, lda, 1,
+                    tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            ctx->isa->hqi.kernel(&packed_A[Ab_row * kc2], &packed_B[Bb_col * kc2],
+                            &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)], mr, kc, nr, ldc, beta_k);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see hqgemm_s32_nest; NULL out of memory */
+static gemm_ws_t* hqgemm_s32_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch,
+        const int M, const int N, const int K,
+        int16_t* buf_A[2], int16_t* buf_B[2]) {
+    const int MR = ctx->blk[D_INT16_S32].MR, MC = ctx->blk[D_INT16_S32].MC;
+    const int NR = ctx->blk[D_INT16_S32].NR;
+    const int KC = ctx->blk[D_INT16_S32].KC;
+    const int NC = ctx->blk[D_INT16_S32].NC;
+    const int kc2 = (min(KC, K) + 1) / 2 * 2;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(int16_t) * min(MC, (M + MR - 1) / MR * MR) * kc2
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (sizeof(int16_t) * min(NC, (N + NR - 1) / NR * NR) * kc2
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (int16_t* )ws->packed_A, buf_A[1] = (int16_t* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (int16_t* )ws->packed_B, buf_B[1] = (int16_t* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/* row-major A (M x K), B (K x N) and C (M x N) */
+void hqgemm_s32_ex_ctx(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const int16_t* A, const int lda, const int16_t* B, const int ldb,
+        int32_t* C, const int ldc) {
+    const int MR = ctx->blk[D_INT16_S32].MR, MC = ctx->blk[D_INT16_S32].MC;
+    const int NR = ctx->blk[D_INT16_S32].NR, NC = ctx->blk[D_INT16_S32].NC;
+    const int NTHREADS = ctx->NTHREADS;
+
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0) {
+        for(int r = 0; r < M; r++)
+            memset(&C[r * ldc], 0, N * sizeof(int32_t));
+        return;
+    }
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, TRUE, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        int16_t* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = hqgemm_s32_ws_acquire(ctx, &scratch, M, N, K, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        hqgemm_s32_nest(ctx, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, A, lda, B, ldb, C, ldc);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        int16_t* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = hqgemm_s32_ws_acquire(worker, &scratch, M, n1 - n0, K, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        hqgemm_s32_nest(ctx, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, A, lda,
+            &B[n0], ldb, &C[n0], ldc);
+        gemm_ws_release(worker, ws, &scratch);
+    }
+}
+void bf16gemm(const uint16_t* A, const uint16_t* B, float* C,
+        const int M, const int N, const int K) {
+    bf16gemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void bf16gemm_ctx(gemm_ctx_t* ctx, const uint16_t* A, const uint16_t* B, float* C,
+               const int M, const int N, const int K) {
+    bf16gemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void bf16gemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    bf16gemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void bf16gemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        bf16gemm_ex_ctx(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, ldc);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++)
+                C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+        return;
+    }
+
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
+
+    bf16gemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc);
+}
+
+/**
+ * 5-loop nest of bf16gemm, run by thread [tid] of the [nthreads] threads, as in
+ * sgemm_nest. If [native], A and B are packed as bf16 k-pairs (slivers of kc2) for
+ * bf16.kernel; otherwise they are widened into fp32 blocks for s.kernel.
+ */
+static void bf16gemm_nest(gemm_ctx_t* ctx, const gemm_part_t* part, const BOOL native,
+        void* const buf_A[2], void* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int rsA, const int csA,
+        const uint16_t* B, const int rsB, const int csB,
+        const float beta, float* C, const int ldc) {
+    const int MR = ctx->blk[D_BF16].MR, MC = ctx->blk[D_BF16].MC;
+    const int NR = ctx->blk[D_BF16].NR;
+    const int KC = ctx->blk[D_BF16].KC;
+    const int NC = ctx->blk[D_BF16].NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
+
+    for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
+        const int nc = min(NC, N - Bm_col);
+        for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
+            const int kc = min(KC, K - k), kc2 = (kc + 1) / 2 * 2;
+            /* C is scaled by beta only once, on the first KC block */
+            const float beta_k = (k == 0) ? beta : 1;
+            const void* packed_B = buf_B[flip_B];
+            if(native)
+                ctx->isa->hqi.pack_blockB_part((const int16_t* )&B[k * rsB + Bm_col * csB], (int16_t* )buf_B[flip_B],
+                    NR, nc, rsB, csB, kc, tid, nthreads);
+            else
+                ctx->isa->bf16.pack_blockB_part(&B[k * rsB + Bm_col * csB], (float* )buf_B[flip_B],
+                    NR, nc, rsB, csB, kc, tid, nthreads);
+            flip_B ^= 1;
+            for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
+                const int mc = min(MC, M - Am_row);
+                const void* packed_A = buf_A[flip_A];
+                if(native)
+                    ctx->isa->hqi.pack_blockA_part((const int16_t* )&A[Am_row * rsA + k * csA], (int16_t* )buf_A[flip_A],
+                        MR, mc, kc, rsA, csA, tid, nthreads);
+                else
+                    ctx->isa->bf16.pack_blockA_part(&A[Am_row * rsA + k * csA], (float* )buf_A[flip_A],
+                        MR, mc, kc, rsA, csA, tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            float* C_tile = &C[((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col)];
+                            if(native)
+                                ctx->isa->bf16.kernel(&((const uint16_t* )packed_A)[Ab_row * kc2],
+                                    &((const uint16_t* )packed_B)[Bb_col * kc2], C_tile, mr, kc, nr, ldc,
+                                    alpha, beta_k);
+                            else
+                                ctx->isa->s.kernel(&((const float* )packed_A)[Ab_row * kc],
+                                    &((const float* )packed_B)[Bb_col * kc], C_tile, mr, kc, nr, ldc,
+                                    alpha, beta_k, NULL, NULL);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see bf16gemm_nest; NULL out of memory */
+static gemm_ws_t* bf16gemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch, const BOOL native,
+        const int M, const int N, const int K,
+        void* buf_A[2], void* buf_B[2]) {
+    const int MR = ctx->blk[D_BF16].MR, MC = ctx->blk[D_BF16].MC;
+    const int NR = ctx->blk[D_BF16].NR;
+    const int KC = ctx->blk[D_BF16].KC;
+    const int NC = ctx->blk[D_BF16].NC;
+    /* bf16 k-pairs, or widened fp32 */
+    const size_t d_size = native ? sizeof(uint16_t) : sizeof(float);
+    const int kc = native ? (min(KC, K) + 1) / 2 * 2 : min(KC, K);
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (d_size * min(MC, (M + MR - 1) / MR * MR) * kc
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (d_size * min(NC, (N + NR - 1) / NR * NR) * kc
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = ws->packed_A, buf_A[1] = (char* )ws->packed_A + size_A;
+    buf_B[0] = ws->packed_B, buf_B[1] = (char* )ws->packed_B + size_B;
+    return ws;
+}
+
+/**
+ * vdpbf16ps retires at half the rate of fp32 FMA on Sapphire Rapids, so it only wins
+ * while packing B is most of the work, i.e. A is a few micro-panels; taller A is
+ * widened and runs on s.kernel.
+ */
+#define BF16_NATIVE_PANELS 2
+
+/* 5-loop nest for row-major C, see sgemm_run */
+void bf16gemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int rsA, const int csA,
+        const uint16_t* B, const int rsB, const int csB,
+        const float beta, float* C, const int ldc) {
+    const int MR = ctx->blk[D_BF16].MR, MC = ctx->blk[D_BF16].MC;
+    const int NR = ctx->blk[D_BF16].NR, NC = ctx->blk[D_BF16].NC;
+    const int NTHREADS = ctx->NTHREADS;
+    const BOOL native = (ctx->isa->bf16.kernel != NULL && M <= BF16_NATIVE_PANELS * MR);
 
-#if INSTLEVEL >= 9    /* AVX512BW */
-    int MR = 30, NR = 32;
-#elif INSTLEVEL >= 7  /* AVX2 */
-    int MR = 6,  NR = 16;
-#elif INSTLEVEL >= 6
-    int MR = 6,  NR = 16;
-#endif
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, TRUE, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        void* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = bf16gemm_ws_acquire(ctx, &scratch, native, M, N, K, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        bf16gemm_nest(ctx, &part, native, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, beta, C, ldc);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        void* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = bf16gemm_ws_acquire(worker, &scratch, native, M, n1 - n0, K, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        bf16gemm_nest(ctx, &slab_part, native, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, beta, &C[n0], ldc);
+        gemm_ws_release(worker, ws, &scratch);
+    }
+}
+
+void hgemm(const uint16_t* A, const uint16_t* B, float* C,
+        const int M, const int N, const int K) {
+    hgemm_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void hgemm_ctx(gemm_ctx_t* ctx, const uint16_t* A, const uint16_t* B, float* C,
+               const int M, const int N, const int K) {
+    hgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void hgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    hgemm_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void hgemm_f16(const uint16_t* A, const uint16_t* B, uint16_t* C,
+        const int M, const int N, const int K) {
+    hgemm_f16_ex_ctx(gemm_ctx_default(), L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void hgemm_f16_ctx(gemm_ctx_t* ctx, const uint16_t* A, const uint16_t* B, uint16_t* C,
+               const int M, const int N, const int K) {
+    hgemm_f16_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS,
+        M, N, K, 1, A, K, B, N, 1, C, N);
+}
+
+void hgemm_f16_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, uint16_t* C, const int ldc) {
+    hgemm_f16_ex_ctx(gemm_ctx_default(), layout, transA, transB,
+        M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+/* hgemm_ex_ctx into fp32 [C] or hgemm_f16_ex_ctx into fp16 [C_h] */
+static void hgemm_ex_any(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, float* C, uint16_t* C_h, const int ldc) {
+    /* C' = B'A' in row-major is the same as C = AB in column-major */
+    if(layout == L_COL_MAJOR) {
+        hgemm_ex_any(ctx, L_ROW_MAJOR, transB, transA,
+            N, M, K, alpha, B, ldb, A, lda, beta, C, C_h, ldc);
+        return;
+    }
+    if(M <= 0 || N <= 0)
+        return;
+    if(K <= 0 || alpha == 0) {
+        for(int r = 0; r < M; r++)
+            for(int c = 0; c < N; c++) {
+                if(C != NULL)
+                    C[r * ldc + c] = (beta == 0) ? 0 : beta * C[r * ldc + c];
+                else
+                    C_h[r * ldc + c] = (beta == 0) ? 0 : fp32_to_fp16(beta * fp16_to_fp32(C_h[r * ldc + c]));
+            }
+        return;
+    }
+
+    /* element (r, c) of op(A) and op(B) is at [r * rs + c * cs] */
+    const int rsA = (transA == T_NO_TRANS) ? lda : 1;
+    const int csA = (transA == T_NO_TRANS) ? 1 : lda;
+    const int rsB = (transB == T_NO_TRANS) ? ldb : 1;
+    const int csB = (transB == T_NO_TRANS) ? 1 : ldb;
+
+    hgemm_run(ctx, M, N, K, alpha, A, rsA, csA, B, rsB, csB, beta, C, C_h, ldc);
+}
+
+void hgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    hgemm_ex_any(ctx, layout, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, NULL, ldc);
+}
 
-    int MC, KC, NC;
-    int NTHREADS = 8;
-    cache_opt(NTHREADS, MR, NR, &MC, &KC, &NC, D_INT8);
+void hgemm_f16_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+        const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int lda,
+        const uint16_t* B, const int ldb,
+        const float beta, uint16_t* C, const int ldc) {
+    hgemm_ex_any(ctx, layout, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, NULL, C, ldc);
+}
 
-    /* packing for TLB efficiency */
-    int8_t* packed_A = (int8_t* )aligned_alloc(MEM_ALIGN, sizeof(int8_t)* (MC * KC));
-    int8_t* packed_B = (int8_t* )aligned_alloc(MEM_ALIGN, sizeof(int8_t)* (KC * NC));
+/**
+ * 5-loop nest of hgemm, run by thread [tid] of the [nthreads] threads, as in
+ * sgemm_nest, with the block sizes of [blk]. A and B are converted into fp32 blocks;
+ * s.kernel writes fp32 [C], h.kernel fp16 [C_h]. With [C_h], [blk] has K in one KC
+ * block, so the kernel rounds C to fp16 only once.
+ */
+static void hgemm_nest(gemm_ctx_t* ctx, const gemm_blk_t* blk, const gemm_part_t* part,
+        float* const buf_A[2], float* const buf_B[2], const int tid, const int nthreads,
+        const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int rsA, const int csA,
+        const uint16_t* B, const int rsB, const int csB,
+        const float beta, float* C, uint16_t* C_h, const int ldc) {
+    const int MR = blk->MR, MC = blk->MC;
+    const int NR = blk->NR;
+    const int KC = blk->KC;
+    const int NC = blk->NC;
+    const int ways = part->ir_ways * part->jr_ways;
+    int flip_A = 0, flip_B = 0;
 
     for(int Bm_col = 0; Bm_col < N; Bm_col += NC) {                         /* 5th loop */
-        const int nc = min(NC, N - Bm_col);         
+        const int nc = min(NC, N - Bm_col);
         for(int k = 0; k < K; k += KC) {                                    /* 4th loop */
-            const int kc = min(KC, K - k);     
-            qpack_blockB(&B[k * N + Bm_col], packed_B, NR, nc, NC, N, kc);
+            const int kc = min(KC, K - k);
+            /* C is scaled by beta only once, on the first KC block */
+            const float beta_k = (k == 0) ? beta : 1;
+            const float* packed_B = buf_B[flip_B];
+            ctx->isa->h.pack_blockB_part(&B[k * rsB + Bm_col * csB], buf_B[flip_B], NR, nc, rsB, csB, kc,
+                tid, nthreads);
+            flip_B ^= 1;
             for(int Am_row = 0; Am_row < M; Am_row += MC) {                 /* 3rd loop */
                 const int mc = min(MC, M - Am_row);
-                qpack_blockA(&A[(Am_row * K) + k], packed_A, MR, mc, kc, KC, K);
-#pragma omp parallel for num_threads(NTHREADS) schedule(static)
-                for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) {            /* 2nd loop */
-                    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) {        /* 1st loop */
-                        const int nr = min(NR, nc - Bb_col);
-                        const int mr = min(MR, mc - Ab_row);
-                        qkernel(&packed_A[Ab_row * KC], &packed_B[Bb_col], 
-                        &C[((Am_row + Ab_row) * N) + (Bm_col + Bb_col)], mr, kc, KC, nr, NC, N);
+                const float* packed_A = buf_A[flip_A];
+                ctx->isa->h.pack_blockA_part(&A[Am_row * rsA + k * csA], buf_A[flip_A], MR, mc, kc, rsA, csA,
+                    tid, nthreads);
+                flip_A ^= 1;
+                gemm_barrier(ctx, nthreads);    /* packed A and B are complete */
+
+                for(int t = tid; t < ways; t += nthreads) {
+                    /* this thread's rectangle of MR x NR tiles */
+                    int ir_start, ir_end, jr_start, jr_end;
+                    set_range((mc + MR - 1) / MR, part->ir_ways, t / part->jr_ways, &ir_start, &ir_end);
+                    set_range((nc + NR - 1) / NR, part->jr_ways, t % part->jr_ways, &jr_start, &jr_end);
+                    for(int Ab_row = ir_start * MR; Ab_row < min(mc, ir_end * MR); Ab_row += MR) {     /* 2nd loop */
+                        for(int Bb_col = jr_start * NR; Bb_col < min(nc, jr_end * NR); Bb_col += NR) { /* 1st loop */
+                            const int nr = min(NR, nc - Bb_col);
+                            const int mr = min(MR, mc - Ab_row);
+                            const int C_off = ((Am_row + Ab_row) * ldc) + (Bm_col + Bb_col);
+                            if(C_h != NULL)
+                                ctx->isa->h.kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                                &C_h[C_off], mr, kc, nr, ldc, alpha, beta_k);
+                            else
+                                ctx->isa->s.kernel(&packed_A[Ab_row * kc], &packed_B[Bb_col * kc],
+                                &C[C_off], mr, kc, nr, ldc, alpha, beta_k, NULL, NULL);
+                        }
                     }
                 }
             }
         }
     }
-    
-    free(packed_A);
-    free(packed_B);
-}
\ No newline at end of file
+}
+
+/* packing for TLB efficiency; two buffers each for A and B, see hgemm_nest; NULL out of memory */
+static gemm_ws_t* hgemm_ws_acquire(gemm_ctx_t* ctx, const gemm_blk_t* blk, gemm_ws_t* scratch,
+        const int M, const int N, const int K,
+        float* buf_A[2], float* buf_B[2]) {
+    const int MR = blk->MR, MC = blk->MC;
+    const int NR = blk->NR;
+    const int KC = blk->KC;
+    const int NC = blk->NC;
+    /* the second buffers stay MEM_ALIGN aligned */
+    const size_t size_A = (sizeof(float) * min(MC, (M + MR - 1) / MR * MR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+    const size_t size_B = (sizeof(float) * min(NC, (N + NR - 1) / NR * NR) * min(KC, K)
+                           + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN;
+
+    gemm_ws_t* ws = gemm_ws_acquire(ctx, scratch);
+    if(!gemm_ws_reserve(ws, 2 * size_A, 2 * size_B)) {
+        gemm_ws_release(ctx, ws, scratch);
+        return NULL;
+    }
+    buf_A[0] = (float* )ws->packed_A, buf_A[1] = (float* )((char* )ws->packed_A + size_A);
+    buf_B[0] = (float* )ws->packed_B, buf_B[1] = (float* )((char* )ws->packed_B + size_B);
+    return ws;
+}
+
+/* 5-loop nest for row-major C, see sgemm_run */
+void hgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const float alpha, const uint16_t* A, const int rsA, const int csA,
+        const uint16_t* B, const int rsB, const int csB,
+        const float beta, float* C, uint16_t* C_h, const int ldc) {
+    const int NTHREADS = ctx->NTHREADS;
+
+    /**
+     * fp16 C must be final when the kernel stores it, or the partial sums of every
+     * KC block would be rounded to fp16 (and could overflow): all of K goes in one
+     * KC block, as in qgemm_s32_run, with MC and NC shrunk by as much.
+     */
+    gemm_blk_t blk = ctx->blk[D_FP16];
+    if(C_h != NULL && K > blk.KC) {
+        blk.MC = max(blk.MR, (int)((int64_t)blk.MC * blk.KC / K / blk.MR * blk.MR));
+        blk.NC = max(blk.NR, (int)((int64_t)blk.NC * blk.KC / K / blk.NR * blk.NR));
+        blk.KC = K;
+    }
+    const int MR = blk.MR, MC = blk.MC;
+    const int NR = blk.NR, NC = blk.NC;
+
+    gemm_part_t part;
+    set_partition(NTHREADS, M, N, MR, NR, MC, NC, TRUE, &part);
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    if(part.jc_ways == 1) {
+        gemm_ws_t scratch;
+        float* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = hgemm_ws_acquire(ctx, &blk, &scratch, M, N, K, buf_A, buf_B);
+        if(ws == NULL)
+            return;
+#pragma omp parallel num_threads(part.ir_ways * part.jr_ways)
+        hgemm_nest(ctx, &blk, &part, buf_A, buf_B, omp_get_thread_num(), omp_get_num_threads(),
+            M, N, K, alpha, A, rsA, csA, B, rsB, csB, beta, C, C_h, ldc);
+        gemm_ws_release(ctx, ws, &scratch);
+        return;
+    }
+
+    /**
+     * 5th loop split: each thread packs B and runs the nest for its own slab of columns,
+     * in the workspace of its worker context, kept from one call to the next
+     */
+    const gemm_part_t slab_part = {1, 1, 1};
+    gemm_ctx_worker(ctx, 0);
+#pragma omp parallel num_threads(part.jc_ways)
+    for(int jc = omp_get_thread_num(); jc < part.jc_ways; jc += omp_get_num_threads()) {
+        int jc_start, jc_end;
+        set_range((N + NR - 1) / NR, part.jc_ways, jc, &jc_start, &jc_end);
+        const int n0 = jc_start * NR, n1 = min(N, jc_end * NR);
+        if(n0 >= n1)
+            continue;
+
+        gemm_ctx_t* worker = gemm_ctx_worker(ctx, omp_get_thread_num());
+        if(worker == NULL)
+            worker = ctx;
+        gemm_ws_t scratch;
+        float* buf_A[2], * buf_B[2];
+        gemm_ws_t* ws = hgemm_ws_acquire(worker, &blk, &scratch, M, n1 - n0, K, buf_A, buf_B);
+        if(ws == NULL)
+            continue;
+        hgemm_nest(ctx, &blk, &slab_part, buf_A, buf_B, 0, 1, M, n1 - n0, K, alpha, A, rsA, csA,
+            &B[n0 * csB], rsB, csB, beta, (C != NULL) ? &C[n0] : NULL,
+            (C_h != NULL) ? &C_h[n0] : NULL, ldc);
+        gemm_ws_release(worker, ws, &scratch);
+    }
+}
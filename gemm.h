@@ -16,8 +16,399 @@
 
 #include "util.h"
 #include "sse.h"
+#ifdef GEMM_ISA     /* a per-ISA file, see [isa.h] */
+#include "isa.h"
+#endif
 
 #define MEM_ALIGN 64
+#define GEMM_SMALL_MNK (64 * 64 * 64)  /* default small_mnk of gemm_ctx_t */
+
+/* Same values as CBLAS_ORDER and CBLAS_TRANSPOSE */
+typedef enum {L_ROW_MAJOR = 101, L_COL_MAJOR = 102} LAYOUT;
+typedef enum {T_NO_TRANS = 111, T_TRANS = 112} TRANSPOSE;
+
+/* GELU is the tanh approximation, 0.5x(1 + tanh(sqrt(2/pi)(x + 0.044715x^3))) */
+typedef enum {ACT_NONE, ACT_RELU, ACT_GELU, ACT_SILU} ACTIVATION;
+typedef enum {BIAS_NONE, BIAS_ROW, BIAS_COL} BIAS_MODE;
+
+/**
+ * Epilogue of sgemm_ex_epi / dgemm_ex_epi, applied to each element of C as the kernel
+ * stores it for the last time:
+ *      C = act(alpha * AB + beta * C + bias), then clamped to [clamp_min, clamp_max]
+ * [bias] holds float for sgemm and double for dgemm, one value per row of C (BIAS_ROW,
+ * M values) or per column (BIAS_COL, N values).
+ */
+typedef struct {
+    BIAS_MODE bias_mode;
+    const void* bias;
+    ACTIVATION act;
+    BOOL clamp;
+    double clamp_min, clamp_max;
+} gemm_epilogue_t;
+
+/**
+ * Requantization of the int32 accumulators of qgemm_requant to 8-bit C:
+ *      C = saturate(round((acc + bias) * scale) + zero_point)
+ * in fp32, rounding half to even, saturating to int8 ([out_signed]) or uint8.
+ * [scale] and [bias] hold one value per column of C (output channel) if [per_channel],
+ * a single one otherwise; [bias] may be NULL.
+ */
+typedef struct {
+    const float* scale;
+    const int32_t* bias;
+    BOOL per_channel;
+    int32_t zero_point;
+    BOOL out_signed;
+} gemm_requant_t;
+
+/* one GEMM of sgemm_grouped, with the arguments of sgemm_ex */
+typedef struct {
+    LAYOUT layout;
+    TRANSPOSE transA, transB;
+    int M, N, K;
+    float alpha;
+    const float* A;
+    int lda;
+    const float* B;
+    int ldb;
+    float beta;
+    float* C;
+    int ldc;
+} gemm_problem_t;
+
+/**
+ * Shapes that get sgemm kernels of their own in every ISA (see [kernel.c]): X(M, N, K,
+ * KC, KU) for a row-major M x N x K product, run in K blocks of KC with the k loops
+ * unrolled KU times; KU == KC unrolls them fully. KC must divide K and KU must divide KC.
+ * Shapes above GEMM_SMALL_MNK, like 128 x 4096 x 4096, only get the packed-path kernel.
+ * Define GEMM_FIXED_SHAPES when building to replace this list.
+ */
+#ifndef GEMM_FIXED_SHAPES
+#define GEMM_FIXED_SHAPES(X) \
+    X(64, 64, 64, 64, 4) \
+    X(128, 4096, 4096, 256, 8)
+#endif
+
+/* kernels of one of GEMM_FIXED_SHAPES */
+typedef struct {
+    int M, N, K, KC;
+    /* sgemm_small for this shape, NULL above GEMM_SMALL_MNK */
+    void (*small)(const float alpha, const float* A, const int rsA, const int csA,
+                  const float* B, const int ldb, const float beta, float* C, const int ldc);
+    /* skernel for this KC */
+    void (*kernel)(const float* packed_blockA, const float* packed_blockB, float* C,
+                   const int m, const int kc, const int n, const int ldc,
+                   const float alpha, const float beta, const gemm_epilogue_t* epi,
+                   const int* C_rows);
+} gemm_fixed_t;
+
+/********************************************************
+ *                                                      
+ *          GEMM Context
+ *                                                      
+*********************************************************/
+/* CPUs this process may run on and how they share cores, caches and memory */
+typedef struct {
+    int ncpus;          /* CPUs in the affinity mask */
+    int ncores;         /* physical cores among them */
+    int smt;            /* hardware threads per core */
+    int npackages;      /* sockets */
+    int nl2, nl3;       /* groups of CPUs sharing an L2 / L3, 0 if unknown */
+    int nnuma;          /* NUMA nodes */
+    int quota;          /* CPUs granted by the cgroup quota, 0 without a quota */
+    int nthreads;       /* threads a gemm call runs on */
+} gemm_topo_t;
+
+/**
+ * Kernels and pack functions of one instruction set, chosen at run time (see [dispatch.c]).
+ * Each data type has its own group, e.g. isa->s.kernel is skernel built for that ISA.
+ */
+typedef struct {
+    int inst_level;     /* INSTLEVEL the functions were compiled for */
+    const char* name;
+    struct {
+        /* row r of C is at C[C_rows[r] * ldc] if [C_rows] is set */
+        void (*kernel)(const float* packed_blockA, const float* packed_blockB, float* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const float alpha, const float beta, const gemm_epilogue_t* epi,
+                       const int* C_rows);
+        void (*pack_blockB)(const float* B, float* packed_B, const int NR,
+                            const int nc, const int rs, const int cs,
+                            const int kc, const int NTHREADS);
+        void (*pack_blockA_part)(const float* A, float* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const float* B, float* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+        /* pack_blockA_part on rows [rows] of A, for sgemm_gather */
+        void (*pack_blockA_rows_part)(const float* A, const int* rows, float* packed_A, const int MR,
+                                      const int mc, const int kc, const int rs, const int cs,
+                                      const int id, const int ways);
+        /* unpacked GEMV, see [gemv.c] */
+        void (*gemv_n)(const float* B, const int ldb, const float* x, const int incx,
+                       float* y, const int k, const int n, const float alpha, const float beta);
+        void (*gemv_t)(const float* A, const int lda, const float* x, float* y, const int incy,
+                       const int m, const int k, const float alpha, const float beta);
+        /* unpacked small GEMM, see small_mnk of gemm_ctx_t */
+        void (*small)(const int M, const int N, const int K, const float alpha,
+                      const float* A, const int rsA, const int csA, const float* B, const int ldb,
+                      const float beta, float* C, const int ldc);
+        const gemm_fixed_t* fixed;  /* GEMM_FIXED_SHAPES, ends with M == 0 */
+    } s;
+    struct {
+        void (*kernel)(const double* packed_blockA, const double* packed_blockB, double* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const double alpha, const double beta, const gemm_epilogue_t* epi);
+        void (*pack_blockB)(const double* B, double* packed_B, const int NR,
+                            const int nc, const int rs, const int cs,
+                            const int kc, const int NTHREADS);
+        void (*pack_blockA_part)(const double* A, double* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const double* B, double* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+        void (*gemv_n)(const double* B, const int ldb, const double* x, const int incx,
+                       double* y, const int k, const int n, const double alpha, const double beta);
+        void (*gemv_t)(const double* A, const int lda, const double* x, double* y, const int incy,
+                       const int m, const int k, const double alpha, const double beta);
+        void (*small)(const int M, const int N, const int K, const double alpha,
+                      const double* A, const int rsA, const int csA, const double* B, const int ldb,
+                      const double beta, double* C, const int ldc);
+    } d;
+    struct {
+        void (*kernel)(const int* packed_blockA, const int* packed_blockB, int* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const int alpha, const int beta);
+        void (*pack_blockB)(const int* B, int* packed_B, const int NR,
+                            const int nc, const int rs, const int cs,
+                            const int kc, const int NTHREADS);
+        void (*pack_blockA_part)(const int* A, int* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const int* B, int* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+    } i;
+    struct {
+        void (*kernel)(const int16_t* packed_blockA, const int16_t* packed_blockB, int16_t* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const int16_t alpha, const int16_t beta);
+        void (*pack_blockB)(const int16_t* B, int16_t* packed_B, const int NR,
+                            const int nc, const int rs, const int cs,
+                            const int kc, const int NTHREADS);
+        void (*pack_blockA_part)(const int16_t* A, int16_t* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const int16_t* B, int16_t* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+    } hq;
+    struct {
+        void (*kernel)(const int8_t* packed_blockA, const int8_t* packed_blockB, int8_t* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const int8_t alpha, const int8_t beta);
+        void (*pack_blockB)(const int8_t* B, int8_t* packed_B, const int NR,
+                            const int nc, const int rs, const int cs,
+                            const int kc, const int NTHREADS);
+        void (*pack_blockA_part)(const int8_t* A, int8_t* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const int8_t* B, int8_t* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+    } q;
+    struct {
+        void (*kernel)(const uint8_t* packed_blockA, const int8_t* packed_blockB, int* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const int* row_off, const int* col_off, const int beta,
+                       uint8_t* C_q, const gemm_requant_t* rq);
+        void (*pack_blockA_part)(const uint8_t* A, uint8_t* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const uint8_t flip, const int id, const int ways);
+        void (*pack_blockB_part)(const int8_t* B, int8_t* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+        /* one row of A, as int16 less its zero point */
+        void (*gemv_n)(const int16_t* x, const int8_t* B, const int ldb, int* y,
+                       const int k, const int n);
+    } qi;               /* uint8 x int8 -> int32, qgemm_s32 */
+    struct {
+        void (*kernel)(const int16_t* packed_blockA, const int16_t* packed_blockB, int* C,
+                       const int m, const int kc, const int n, const int ldc, const int beta);
+        void (*pack_blockA_part)(const int16_t* A, int16_t* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const int16_t* B, int16_t* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+    } hqi;              /* int16 x int16 -> int32, hqgemm_s32 */
+    struct {
+        /* vdpbf16ps on bf16 k-pairs packed by hqi.pack_*, NULL without AVX512_BF16;
+           only used for short A, see bf16gemm_run */
+        void (*kernel)(const uint16_t* packed_blockA, const uint16_t* packed_blockB, float* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const float alpha, const float beta);
+        /* otherwise bf16 is widened into the fp32 blocks of s.kernel */
+        void (*pack_blockA_part)(const uint16_t* A, float* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const uint16_t* B, float* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+    } bf16;             /* bfloat16 x bfloat16 -> fp32, bf16gemm */
+    struct {
+        /* s.kernel with fp16 C, on the fp32 blocks of pack_* */
+        void (*kernel)(const float* packed_blockA, const float* packed_blockB, uint16_t* C,
+                       const int m, const int kc, const int n, const int ldc,
+                       const float alpha, const float beta);
+        void (*pack_blockA_part)(const uint16_t* A, float* packed_A, const int MR,
+                                 const int mc, const int kc, const int rs, const int cs,
+                                 const int id, const int ways);
+        void (*pack_blockB_part)(const uint16_t* B, float* packed_B, const int NR,
+                                 const int nc, const int rs, const int cs,
+                                 const int kc, const int id, const int ways);
+    } h;                /* fp16 x fp16 -> fp32 or fp16, hgemm */
+} gemm_isa_t;
+
+const gemm_isa_t* gemm_isa_select(const int inst_level);
+int gemm_isa_detect();
+
+typedef struct {
+    int MR, NR;         /* register block (kernel shape) */
+    int MC, KC, NC;     /* cache blocks */
+} gemm_blk_t;
+
+typedef struct {
+    void*  packed_A;
+    size_t size_A;
+    void*  packed_B;
+    size_t size_B;
+} gemm_ws_t;
+
+/**
+ * Counters filled while [collect_stats] of the context is set.
+ * Every gemm call opens one parallel region; its threads meet only at barriers.
+ */
+typedef struct {
+    uint64_t regions;       /* parallel regions opened */
+    uint64_t barriers;      /* barriers passed, counted once per thread */
+    double   barrier_wait;  /* seconds spent waiting at barriers, summed over threads */
+} gemm_stats_t;
+
+/**
+ * Everything a gemm call needs before the 5-loop nest starts: thread count,
+ * instruction level, block sizes for each data type and the packing workspace.
+ * Create it once and pass it to the *gemm_ctx functions.
+ * 
+ * The workspace grows on demand and is reused between calls. A context can be
+ * shared between threads; a call that finds the workspace busy packs into its
+ * own temporary buffers instead of waiting.
+ */
+typedef struct gemm_ctx_s {
+    int NTHREADS;
+    int inst_level;
+    const gemm_isa_t* isa;
+    gemm_topo_t topo;
+    gemm_blk_t blk[D_NUM];
+    gemm_ws_t ws;
+    omp_lock_t ws_lock;
+    BOOL collect_stats;
+    gemm_stats_t stats;
+    struct gemm_ctx_s** workers;    /* one per thread of the batched calls and of the 5th loop
+                                       split, see gemm_ctx_worker */
+    int nworkers;
+    int64_t small_mnk;  /* sgemm and dgemm up to this M * N * K run unpacked on one thread,
+                           see *gemm_small; GEMM_SMALL_MNK, 0 turns it off */
+} gemm_ctx_t;
+
+gemm_ctx_t* gemm_ctx_create();
+void gemm_ctx_destroy(gemm_ctx_t* ctx);
+gemm_ctx_t* gemm_ctx_default();
+gemm_ctx_t* gemm_ctx_worker(gemm_ctx_t* ctx, const int tid);
+
+gemm_ws_t* gemm_ws_acquire(gemm_ctx_t* ctx, gemm_ws_t* scratch);
+void gemm_ws_release(gemm_ctx_t* ctx, gemm_ws_t* ws, gemm_ws_t* scratch);
+BOOL gemm_ws_reserve(gemm_ws_t* ws, const size_t size_A, const size_t size_B);
+
+void gemm_barrier(gemm_ctx_t* ctx, const int nthreads);
+void gemm_stats_reset(gemm_ctx_t* ctx);
+
+/********************************************************
+ *                                                      
+ *          Pre-packed B
+ *                                                      
+*********************************************************/
+/**
+ * Whole B matrix (K x N, row-major) packed once in the order the kernels read it,
+ * for B that is multiplied many times, e.g. model weights.
+ * Block (col, k) of the 5-loop nest starts at gemm_packed_offset(packed, col, k).
+ * 
+ * The blocking is fixed when the handle is made, so *gemm_compute needs a context
+ * with the same kernel shape.
+ */
+typedef struct {
+    D_TYPE d_type;
+    int K, N;
+    int inst_level;
+    int NR, KC, NC;
+    size_t size;        /* bytes of data */
+    void* data;
+    void* map;          /* file mapping that holds data, or NULL */
+    size_t map_size;
+} gemm_packed_t;
+
+size_t gemm_packed_offset(const gemm_packed_t* packed, const int col, const int k);
+void gemm_packed_free(gemm_packed_t* packed);
+int gemm_packed_save(const gemm_packed_t* packed, const char* path);
+gemm_packed_t* gemm_packed_load(gemm_ctx_t* ctx, const char* path, D_TYPE d_type,
+                                const int K, const int N);
+
+gemm_packed_t* sgemm_pack_B(const float* B, const int K, const int N);
+gemm_packed_t* sgemm_pack_B_ctx(gemm_ctx_t* ctx, const float* B, const int K, const int N);
+gemm_packed_t* sgemm_pack_B_file(const char* path, const float* B, const int K, const int N);
+gemm_packed_t* sgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const float* B,
+               const int K, const int N);
+int sgemm_compute(const float* A, const gemm_packed_t* packed, float* C, const int M);
+int sgemm_compute_ctx(gemm_ctx_t* ctx, const float* A, const gemm_packed_t* packed,
+               float* C, const int M);
+
+gemm_packed_t* dgemm_pack_B(const double* B, const int K, const int N);
+gemm_packed_t* dgemm_pack_B_ctx(gemm_ctx_t* ctx, const double* B, const int K, const int N);
+gemm_packed_t* dgemm_pack_B_file(const char* path, const double* B, const int K, const int N);
+gemm_packed_t* dgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const double* B,
+               const int K, const int N);
+int dgemm_compute(const double* A, const gemm_packed_t* packed, double* C, const int M);
+int dgemm_compute_ctx(gemm_ctx_t* ctx, const double* A, const gemm_packed_t* packed,
+               double* C, const int M);
+
+gemm_packed_t* igemm_pack_B(const int* B, const int K, const int N);
+gemm_packed_t* igemm_pack_B_ctx(gemm_ctx_t* ctx, const int* B, const int K, const int N);
+gemm_packed_t* igemm_pack_B_file(const char* path, const int* B, const int K, const int N);
+gemm_packed_t* igemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const int* B,
+               const int K, const int N);
+int igemm_compute(const int* A, const gemm_packed_t* packed, int* C, const int M);
+int igemm_compute_ctx(gemm_ctx_t* ctx, const int* A, const gemm_packed_t* packed,
+               int* C, const int M);
+
+gemm_packed_t* hqgemm_pack_B(const int16_t* B, const int K, const int N);
+gemm_packed_t* hqgemm_pack_B_ctx(gemm_ctx_t* ctx, const int16_t* B, const int K, const int N);
+gemm_packed_t* hqgemm_pack_B_file(const char* path, const int16_t* B, const int K, const int N);
+gemm_packed_t* hqgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const int16_t* B,
+               const int K, const int N);
+int hqgemm_compute(const int16_t* A, const gemm_packed_t* packed, int16_t* C, const int M);
+int hqgemm_compute_ctx(gemm_ctx_t* ctx, const int16_t* A, const gemm_packed_t* packed,
+               int16_t* C, const int M);
+
+gemm_packed_t* qgemm_pack_B(const int8_t* B, const int K, const int N);
+gemm_packed_t* qgemm_pack_B_ctx(gemm_ctx_t* ctx, const int8_t* B, const int K, const int N);
+gemm_packed_t* qgemm_pack_B_file(const char* path, const int8_t* B, const int K, const int N);
+gemm_packed_t* qgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const int8_t* B,
+               const int K, const int N);
+int qgemm_compute(const int8_t* A, const gemm_packed_t* packed, int8_t* C, const int M);
+int qgemm_compute_ctx(gemm_ctx_t* ctx, const int8_t* A, const gemm_packed_t* packed,
+               int8_t* C, const int M);
 
 /********************************************************
  *                                                      
@@ -26,93 +417,502 @@
 *********************************************************/
 void sgemm(const float* A, const float* B, float* C,
            const int M, const int N, const int K);
+void sgemm_ctx(gemm_ctx_t* ctx, const float* A, const float* B, float* C,
+               const int M, const int N, const int K);
+void sgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const float* A, const int lda,
+               const float* B, const int ldb,
+               const float beta, float* C, const int ldc);
+void sgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const float* A, const int lda,
+               const float* B, const int ldb,
+               const float beta, float* C, const int ldc);
+void sgemm_ex_epi(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const float* A, const int lda,
+               const float* B, const int ldb,
+               const float beta, float* C, const int ldc, const gemm_epilogue_t* epi);
+void sgemm_ex_epi_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const float* A, const int lda,
+               const float* B, const int ldb,
+               const float beta, float* C, const int ldc, const gemm_epilogue_t* epi);
+/**
+ * Row-major sgemm_ex on gathered and scattered rows: row r of op(A) is row [A_rows[r]]
+ * of op(A) and row r of the product is added to row [C_rows[r]] of C, read straight
+ * from and written straight to those rows. Either list may be NULL for rows 0 .. M-1.
+ * A row of A may be used more than once, a row of C may not.
+ */
+void sgemm_gather(const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda, const int* A_rows,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc, const int* C_rows);
+void sgemm_gather_ctx(gemm_ctx_t* ctx, const TRANSPOSE transA, const TRANSPOSE transB,
+        const int M, const int N, const int K,
+        const float alpha, const float* A, const int lda, const int* A_rows,
+        const float* B, const int ldb,
+        const float beta, float* C, const int ldc, const int* C_rows);
+void sgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const float alpha, const float* A, const int rsA, const int csA,
+               const float* B, const int rsB, const int csB, const gemm_packed_t* packed,
+               const float beta, float* C, const int ldc, const gemm_epilogue_t* epi,
+               const int* A_rows, const int* C_rows);
+/**
+ * [count] GEMMs of any shapes, e.g. the experts of a mixture-of-experts layer, in one
+ * parallel region. All of them are cut into tiles of C that are handed out to the
+ * threads costliest first; each thread packs into the same buffers for every tile.
+ */
+void sgemm_grouped(const gemm_problem_t* problems, const int count);
+void sgemm_grouped_ctx(gemm_ctx_t* ctx, const gemm_problem_t* problems, const int count);
+
 void dgemm(const double* A, const double* B, double* C,
            const int M, const int N, const int K);
+void dgemm_ctx(gemm_ctx_t* ctx, const double* A, const double* B, double* C,
+               const int M, const int N, const int K);
+void dgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const double alpha, const double* A, const int lda,
+               const double* B, const int ldb,
+               const double beta, double* C, const int ldc);
+void dgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const double alpha, const double* A, const int lda,
+               const double* B, const int ldb,
+               const double beta, double* C, const int ldc);
+void dgemm_ex_epi(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const double alpha, const double* A, const int lda,
+               const double* B, const int ldb,
+               const double beta, double* C, const int ldc, const gemm_epilogue_t* epi);
+void dgemm_ex_epi_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const double alpha, const double* A, const int lda,
+               const double* B, const int ldb,
+               const double beta, double* C, const int ldc, const gemm_epilogue_t* epi);
+void dgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const double alpha, const double* A, const int rsA, const int csA,
+               const double* B, const int rsB, const int csB, const gemm_packed_t* packed,
+               const double beta, double* C, const int ldc, const gemm_epilogue_t* epi);
+
 void igemm(const int* A, const int* B, int* C,
            const int M, const int N, const int K);
+void igemm_ctx(gemm_ctx_t* ctx, const int* A, const int* B, int* C,
+               const int M, const int N, const int K);
+void igemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const int alpha, const int* A, const int lda,
+               const int* B, const int ldb,
+               const int beta, int* C, const int ldc);
+void igemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const int alpha, const int* A, const int lda,
+               const int* B, const int ldb,
+               const int beta, int* C, const int ldc);
+void igemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const int alpha, const int* A, const int rsA, const int csA,
+               const int* B, const int rsB, const int csB, const gemm_packed_t* packed,
+               const int beta, int* C, const int ldc);
+
 void hqgemm(const int16_t* A, const int16_t* B, int16_t* C,
            const int M, const int N, const int K);
+void hqgemm_ctx(gemm_ctx_t* ctx, const int16_t* A, const int16_t* B, int16_t* C,
+               const int M, const int N, const int K);
+void hqgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const int16_t alpha, const int16_t* A, const int lda,
+               const int16_t* B, const int ldb,
+               const int16_t beta, int16_t* C, const int ldc);
+void hqgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const int16_t alpha, const int16_t* A, const int lda,
+               const int16_t* B, const int ldb,
+               const int16_t beta, int16_t* C, const int ldc);
+void hqgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const int16_t alpha, const int16_t* A, const int rsA, const int csA,
+               const int16_t* B, const int rsB, const int csB, const gemm_packed_t* packed,
+               const int16_t beta, int16_t* C, const int ldc);
+
 void qgemm(const int8_t* A, const int8_t* B, int8_t* C,
            const int M, const int N, const int K);
+void qgemm_ctx(gemm_ctx_t* ctx, const int8_t* A, const int8_t* B, int8_t* C,
+               const int M, const int N, const int K);
+void qgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const int8_t alpha, const int8_t* A, const int lda,
+               const int8_t* B, const int ldb,
+               const int8_t beta, int8_t* C, const int ldc);
+void qgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const int8_t alpha, const int8_t* A, const int lda,
+               const int8_t* B, const int ldb,
+               const int8_t beta, int8_t* C, const int ldc);
+void qgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const int8_t alpha, const int8_t* A, const int rsA, const int csA,
+               const int8_t* B, const int rsB, const int csB, const gemm_packed_t* packed,
+               const int8_t beta, int8_t* C, const int ldc);
+
+/**
+ * uint8 x int8 -> int32, C = (A - a_zero)(B - b_zero), exact whenever C fits in int32
+ * (any K up to 32768). Without zero points this is plain A * B. qgemm_s8s8_s32 takes
+ * an int8 A: it's packed as A + 128 and the 128 * column sums of B are taken off again.
+ */
+void qgemm_s32(const uint8_t* A, const int8_t* B, int32_t* C,
+               const int M, const int N, const int K);
+void qgemm_s32_ctx(gemm_ctx_t* ctx, const uint8_t* A, const int8_t* B, int32_t* C,
+               const int M, const int N, const int K);
+void qgemm_s32_ex(const int M, const int N, const int K,
+               const uint8_t* A, const int lda, const int32_t a_zero,
+               const int8_t* B, const int ldb, const int32_t b_zero,
+               int32_t* C, const int ldc);
+void qgemm_s32_ex_ctx(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const uint8_t* A, const int lda, const int32_t a_zero,
+               const int8_t* B, const int ldb, const int32_t b_zero,
+               int32_t* C, const int ldc);
+void qgemm_s8s8_s32(const int8_t* A, const int8_t* B, int32_t* C,
+               const int M, const int N, const int K);
+void qgemm_s8s8_s32_ctx(gemm_ctx_t* ctx, const int8_t* A, const int8_t* B, int32_t* C,
+               const int M, const int N, const int K);
+/**
+ * qgemm_s32 with 8-bit C: the int32 accumulators are requantized (see gemm_requant_t)
+ * in registers as the kernel stores them, and never reach memory. A long K runs as a
+ * single KC block, with smaller MC and NC, so that no partial sum is stored.
+ */
+void qgemm_requant(const int M, const int N, const int K,
+               const uint8_t* A, const int lda, const int32_t a_zero,
+               const int8_t* B, const int ldb, const int32_t b_zero,
+               void* C, const int ldc, const gemm_requant_t* rq);
+void qgemm_requant_ctx(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const uint8_t* A, const int lda, const int32_t a_zero,
+               const int8_t* B, const int ldb, const int32_t b_zero,
+               void* C, const int ldc, const gemm_requant_t* rq);
+/* [C_q] with [rq], or [C] */
+void qgemm_s32_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const uint8_t* A, const int lda, const uint8_t flip, const int32_t a_zero,
+               const int8_t* B, const int ldb, const int32_t b_zero,
+               int32_t* C, uint8_t* C_q, const int ldc, const gemm_requant_t* rq);
+
+/**
+ * int16 x int16 -> int32 on vpmaddwd (vpdpwssd with AVX512VNNI), two products per
+ * int32 lane and instruction. Exact modulo 2^32, so exact whenever C fits in int32;
+ * hqgemm keeps only the low 16 bits.
+ */
+void hqgemm_s32(const int16_t* A, const int16_t* B, int32_t* C,
+               const int M, const int N, const int K);
+void hqgemm_s32_ctx(gemm_ctx_t* ctx, const int16_t* A, const int16_t* B, int32_t* C,
+               const int M, const int N, const int K);
+void hqgemm_s32_ex(const int M, const int N, const int K,
+               const int16_t* A, const int lda, const int16_t* B, const int ldb,
+               int32_t* C, const int ldc);
+void hqgemm_s32_ex_ctx(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const int16_t* A, const int lda, const int16_t* B, const int ldb,
+               int32_t* C, const int ldc);
+
+/**
+ * bfloat16 x bfloat16 -> fp32, C = alpha * AB + beta * C as sgemm. A and B hold the bf16
+ * bits, and are read once: they are widened to fp32 while packing and run on the sgemm
+ * kernel, or, with AVX512_BF16 and a short A, packed as they are for vdpbf16ps.
+ */
+void bf16gemm(const uint16_t* A, const uint16_t* B, float* C,
+               const int M, const int N, const int K);
+void bf16gemm_ctx(gemm_ctx_t* ctx, const uint16_t* A, const uint16_t* B, float* C,
+               const int M, const int N, const int K);
+void bf16gemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int lda,
+               const uint16_t* B, const int ldb,
+               const float beta, float* C, const int ldc);
+void bf16gemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int lda,
+               const uint16_t* B, const int ldb,
+               const float beta, float* C, const int ldc);
+void bf16gemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int rsA, const int csA,
+               const uint16_t* B, const int rsB, const int csB,
+               const float beta, float* C, const int ldc);
+
+/**
+ * IEEE fp16 x fp16 with fp32 accumulation, C = alpha * AB + beta * C as sgemm. A and B
+ * hold the fp16 bits and are converted to fp32 (F16C) while packing, then run on the
+ * sgemm kernel. hgemm writes fp32 C; hgemm_f16 writes fp16 C, converted in the store
+ * of the kernel, once: K runs in a single KC block, so no partial sum is rounded.
+ */
+void hgemm(const uint16_t* A, const uint16_t* B, float* C,
+               const int M, const int N, const int K);
+void hgemm_ctx(gemm_ctx_t* ctx, const uint16_t* A, const uint16_t* B, float* C,
+               const int M, const int N, const int K);
+void hgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int lda,
+               const uint16_t* B, const int ldb,
+               const float beta, float* C, const int ldc);
+void hgemm_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int lda,
+               const uint16_t* B, const int ldb,
+               const float beta, float* C, const int ldc);
+void hgemm_f16(const uint16_t* A, const uint16_t* B, uint16_t* C,
+               const int M, const int N, const int K);
+void hgemm_f16_ctx(gemm_ctx_t* ctx, const uint16_t* A, const uint16_t* B, uint16_t* C,
+               const int M, const int N, const int K);
+void hgemm_f16_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int lda,
+               const uint16_t* B, const int ldb,
+               const float beta, uint16_t* C, const int ldc);
+void hgemm_f16_ex_ctx(gemm_ctx_t* ctx, const LAYOUT layout,
+               const TRANSPOSE transA, const TRANSPOSE transB,
+               const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int lda,
+               const uint16_t* B, const int ldb,
+               const float beta, uint16_t* C, const int ldc);
+/* exactly one of [C] (fp32) and [C_h] (fp16) is written */
+void hgemm_run(gemm_ctx_t* ctx, const int M, const int N, const int K,
+               const float alpha, const uint16_t* A, const int rsA, const int csA,
+               const uint16_t* B, const int rsB, const int csB,
+               const float beta, float* C, uint16_t* C_h, const int ldc);
 
 /********************************************************
  *                                                      
- *          Kernel
+ *          Batched GEMM
  *                                                      
 *********************************************************/
-void skernel(const float* packed_blockA, const float* packed_blockB, float* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N);
-void dkernel(const double* packed_blockA, const double* packed_blockB, double* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N);
-void ikernel(const int* packed_blockA, const int* packed_blockB, int* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N);
-void hqkernel(const int16_t* packed_blockA, const int16_t* packed_blockB, int16_t* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N);
-void qkernel(const int8_t* packed_blockA, const int8_t* packed_blockB, int8_t* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N);
+/**
+ * [batch] independent GEMMs of the same shape, each one as the plain *gemm function:
+ * C[i] += A[i]B[i] in row-major. The matrices come from pointer arrays (*_batched) or
+ * from base pointers and strides in elements (*_strided_batched); a stride of 0 reuses
+ * the same matrix for every GEMM.
+ *
+ * Small GEMMs are spread across the threads, a whole GEMM per thread at a time, on the
+ * packing buffers each thread keeps between calls. Large ones run one after another
+ * with every thread inside each GEMM. See [batch.c].
+ */
+void sgemm_batched(const float* const A[], const float* const B[], float* const C[],
+        const int M, const int N, const int K, const int batch);
+void sgemm_batched_ctx(gemm_ctx_t* ctx, const float* const A[], const float* const B[],
+        float* const C[], const int M, const int N, const int K, const int batch);
+void sgemm_strided_batched(const float* A, const size_t strideA, const float* B, const size_t strideB,
+        float* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void sgemm_strided_batched_ctx(gemm_ctx_t* ctx, const float* A, const size_t strideA,
+        const float* B, const size_t strideB, float* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void dgemm_batched(const double* const A[], const double* const B[], double* const C[],
+        const int M, const int N, const int K, const int batch);
+void dgemm_batched_ctx(gemm_ctx_t* ctx, const double* const A[], const double* const B[],
+        double* const C[], const int M, const int N, const int K, const int batch);
+void dgemm_strided_batched(const double* A, const size_t strideA, const double* B, const size_t strideB,
+        double* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void dgemm_strided_batched_ctx(gemm_ctx_t* ctx, const double* A, const size_t strideA,
+        const double* B, const size_t strideB, double* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void igemm_batched(const int* const A[], const int* const B[], int* const C[],
+        const int M, const int N, const int K, const int batch);
+void igemm_batched_ctx(gemm_ctx_t* ctx, const int* const A[], const int* const B[],
+        int* const C[], const int M, const int N, const int K, const int batch);
+void igemm_strided_batched(const int* A, const size_t strideA, const int* B, const size_t strideB,
+        int* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void igemm_strided_batched_ctx(gemm_ctx_t* ctx, const int* A, const size_t strideA,
+        const int* B, const size_t strideB, int* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void hqgemm_batched(const int16_t* const A[], const int16_t* const B[], int16_t* const C[],
+        const int M, const int N, const int K, const int batch);
+void hqgemm_batched_ctx(gemm_ctx_t* ctx, const int16_t* const A[], const int16_t* const B[],
+        int16_t* const C[], const int M, const int N, const int K, const int batch);
+void hqgemm_strided_batched(const int16_t* A, const size_t strideA, const int16_t* B, const size_t strideB,
+        int16_t* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void hqgemm_strided_batched_ctx(gemm_ctx_t* ctx, const int16_t* A, const size_t strideA,
+        const int16_t* B, const size_t strideB, int16_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void qgemm_batched(const int8_t* const A[], const int8_t* const B[], int8_t* const C[],
+        const int M, const int N, const int K, const int batch);
+void qgemm_batched_ctx(gemm_ctx_t* ctx, const int8_t* const A[], const int8_t* const B[],
+        int8_t* const C[], const int M, const int N, const int K, const int batch);
+void qgemm_strided_batched(const int8_t* A, const size_t strideA, const int8_t* B, const size_t strideB,
+        int8_t* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void qgemm_strided_batched_ctx(gemm_ctx_t* ctx, const int8_t* A, const size_t strideA,
+        const int8_t* B, const size_t strideB, int8_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+/* C[i] = A[i]B[i], as qgemm_s32 and hqgemm_s32 */
+void qgemm_s32_batched(const uint8_t* const A[], const int8_t* const B[], int32_t* const C[],
+        const int M, const int N, const int K, const int batch);
+void qgemm_s32_batched_ctx(gemm_ctx_t* ctx, const uint8_t* const A[], const int8_t* const B[],
+        int32_t* const C[], const int M, const int N, const int K, const int batch);
+void qgemm_s32_strided_batched(const uint8_t* A, const size_t strideA, const int8_t* B, const size_t strideB,
+        int32_t* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void qgemm_s32_strided_batched_ctx(gemm_ctx_t* ctx, const uint8_t* A, const size_t strideA,
+        const int8_t* B, const size_t strideB, int32_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void hqgemm_s32_batched(const int16_t* const A[], const int16_t* const B[], int32_t* const C[],
+        const int M, const int N, const int K, const int batch);
+void hqgemm_s32_batched_ctx(gemm_ctx_t* ctx, const int16_t* const A[], const int16_t* const B[],
+        int32_t* const C[], const int M, const int N, const int K, const int batch);
+void hqgemm_s32_strided_batched(const int16_t* A, const size_t strideA, const int16_t* B, const size_t strideB,
+        int32_t* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void hqgemm_s32_strided_batched_ctx(gemm_ctx_t* ctx, const int16_t* A, const size_t strideA,
+        const int16_t* B, const size_t strideB, int32_t* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void bf16gemm_batched(const uint16_t* const A[], const uint16_t* const B[], float* const C[],
+        const int M, const int N, const int K, const int batch);
+void bf16gemm_batched_ctx(gemm_ctx_t* ctx, const uint16_t* const A[], const uint16_t* const B[],
+        float* const C[], const int M, const int N, const int K, const int batch);
+void bf16gemm_strided_batched(const uint16_t* A, const size_t strideA, const uint16_t* B, const size_t strideB,
+        float* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void bf16gemm_strided_batched_ctx(gemm_ctx_t* ctx, const uint16_t* A, const size_t strideA,
+        const uint16_t* B, const size_t strideB, float* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
+
+void hgemm_batched(const uint16_t* const A[], const uint16_t* const B[], float* const C[],
+        const int M, const int N, const int K, const int batch);
+void hgemm_batched_ctx(gemm_ctx_t* ctx, const uint16_t* const A[], const uint16_t* const B[],
+        float* const C[], const int M, const int N, const int K, const int batch);
+void hgemm_strided_batched(const uint16_t* A, const size_t strideA, const uint16_t* B, const size_t strideB,
+        float* C, const size_t strideC, const int M, const int N, const int K, const int batch);
+void hgemm_strided_batched_ctx(gemm_ctx_t* ctx, const uint16_t* A, const size_t strideA,
+        const uint16_t* B, const size_t strideB, float* C, const size_t strideC,
+        const int M, const int N, const int K, const int batch);
 
 /********************************************************
  *                                                      
- *          Arithmetic Operation
+ *          GEMV
  *                                                      
 *********************************************************/
-#if INSTLEVEL >= 9 /* AVX512BW */
-#if (defined (__AVX512__) || defined (__AVX512F__))
-__m512i qmul(__m512i a, __m512i b);
-#endif // AVX512F
-#endif          /* INSTLEVEL */
-
-/* FMA */
-#if INSTLEVEL >= 9   /* AVX512BW */
-#if defined (__AVX512__) || defined (__AVX512F__)
-__m512  sfma(__m512 a, __m512 b, __m512 c)   ;
-__m512d dfma(__m512d a, __m512d b, __m512d c);
-__m512i ifma(__m512i a, __m512i b, __m512i c);
-#endif
-__m512i qfma(__m512i a, __m512i b, __m512i c);
-#elif INSTLEVEL >= 8 /* AVX512F */
-__m512  sfma(__m512 a, __m512 b, __m512 c)   ;
-__m512d dfma(__m512d a, __m512d b, __m512d c);
-__m512i ifma(__m512i a, __m512i b, __m512i c);
-#elif INSTLEVEL >= 7 /* AVX2 */
-#if defined (__FMA__)
-__m256  sfma(__m256 a, __m256 b, __m256 c)   ;  
-__m256d dfma(__m256d a, __m256d b, __m256d c); 
-__m256i ifma(__m256i a, __m256i b, __m256i c);
-#else  // No FMA
-__m256  sfma(__m256 a, __m256 b, __m256 c)   ;  
-__m256d dfma(__m256d a, __m256d b, __m256d c);
-__m256i ifma(__m256i a, __m256i b, __m256i c);
-#endif // AVX2, FMA
-#elif INSTLEVEL >= 6 /* AVX */
-#if defined (__FMA__)
-__m256  sfma(__m256 a, __m256 b, __m256 c)   ;
-__m256d dfma(__m256d a, __m256d b, __m256d c);
-__m128i ifma(__m128i a, __m128i b, __m128i c);
-#else  // No FMA
-__m256  sfma(__m256 a, __m256 b, __m256 c)   ;
-__m256d dfma(__m256d a, __m256d b, __m256d c);
-__m128i ifma(__m128i a, __m128i b, __m128i c);
-#endif // AVX, FMA
-#endif              /* INSTLEVEL */
+/**
+ * y = alpha * op(A)x + beta * y as in BLAS: op(A) is M x N or N x M, x and y are
+ * [incx] and [incy] apart, counted from the end when negative. The matrix is read
+ * once without packing, split across the threads, see [gemv.c].
+ *
+ * The *gemm functions take this path by themselves when M or N is 1.
+ */
+void sgemv(const LAYOUT layout, const TRANSPOSE trans, const int M, const int N,
+        const float alpha, const float* A, const int lda,
+        const float* x, const int incx,
+        const float beta, float* y, const int incy);
+void sgemv_ctx(gemm_ctx_t* ctx, const LAYOUT layout, const TRANSPOSE trans,
+        const int M, const int N,
+        const float alpha, const float* A, const int lda,
+        const float* x, const int incx,
+        const float beta, float* y, const int incy);
+void dgemv(const LAYOUT layout, const TRANSPOSE trans, const int M, const int N,
+        const double alpha, const double* A, const int lda,
+        const double* x, const int incx,
+        const double beta, double* y, const int incy);
+void dgemv_ctx(gemm_ctx_t* ctx, const LAYOUT layout, const TRANSPOSE trans,
+        const int M, const int N,
+        const double alpha, const double* A, const int lda,
+        const double* x, const int incx,
+        const double beta, double* y, const int incy);
+/* y = alpha * xB + beta * y for the K x N row-major B, y contiguous */
+void sgemv_n_run(gemm_ctx_t* ctx, const int K, const int N,
+        const float alpha, const float* x, const int incx,
+        const float* B, const int ldb,
+        const float beta, float* y);
+/* y = alpha * Ax + beta * y for the M x K row-major A, x contiguous */
+void sgemv_t_run(gemm_ctx_t* ctx, const int M, const int K,
+        const float alpha, const float* A, const int lda, const float* x,
+        const float beta, float* y, const int incy);
+void dgemv_n_run(gemm_ctx_t* ctx, const int K, const int N,
+        const double alpha, const double* x, const int incx,
+        const double* B, const int ldb,
+        const double beta, double* y);
+void dgemv_t_run(gemm_ctx_t* ctx, const int M, const int K,
+        const double alpha, const double* A, const int lda, const double* x,
+        const double beta, double* y, const int incy);
+/* *gemm_run with M or N of 1 */
+void sgemm_gemv(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const float alpha, const float* A, const int rsA, const int csA,
+        const float* B, const int rsB, const int csB,
+        const float beta, float* C, const int ldc);
+void dgemm_gemv(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const double alpha, const double* A, const int rsA, const int csA,
+        const double* B, const int rsB, const int csB,
+        const double beta, double* C, const int ldc);
+/* qgemm_s32_run with M of 1; FALSE when a_zero is out of the int16 range */
+BOOL qgemm_s32_gemv(gemm_ctx_t* ctx, const int N, const int K,
+        const uint8_t* A, const uint8_t flip, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero, int32_t* C);
 
 /********************************************************
  *                                                      
- *          Memory operation
+ *          Kernel
  *                                                      
 *********************************************************/
-#if INSTLEVEL >= 9   /* AVX512BW */
-#elif INSTLEVEL >= 8 /* AVX512 */
-#elif INSTLEVEL >= 7 /* AVX2 */
-#elif INSTLEVEL >= 6 /* AVX*/
-__m128i maskload(int* C, int8_t mask);
-void maskstore(int* C, int8_t mask, __m128i packed_C);
-#endif              /* INSTLEVEL */
+/* [epi] is NULL, or the epilogue with its bias starting at the tile */
+void skernel(const float* packed_blockA, const float* packed_blockB, float* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const float alpha, const float beta, const gemm_epilogue_t* epi,
+              const int* C_rows);
+void dkernel(const double* packed_blockA, const double* packed_blockB, double* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const double alpha, const double beta, const gemm_epilogue_t* epi);
+void ikernel(const int* packed_blockA, const int* packed_blockB, int* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int alpha, const int beta);
+void hqkernel(const int16_t* packed_blockA, const int16_t* packed_blockB, int16_t* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int16_t alpha, const int16_t beta);
+void qkernel(const int8_t* packed_blockA, const int8_t* packed_blockB, int8_t* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int8_t alpha, const int8_t beta);
+/* with [rq], the tile is requantized into the 8-bit [C_q] instead of C, same ldc */
+void qikernel(const uint8_t* packed_blockA, const int8_t* packed_blockB, int* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int* row_off, const int* col_off, const int beta,
+              uint8_t* C_q, const gemm_requant_t* rq);
+void hqikernel(const int16_t* packed_blockA, const int16_t* packed_blockB, int* C,
+              const int m, const int kc,
+              const int n, const int ldc, const int beta);
+void bf16kernel(const uint16_t* packed_blockA, const uint16_t* packed_blockB, float* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const float alpha, const float beta);
+void hkernel(const float* packed_blockA, const float* packed_blockB, uint16_t* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const float alpha, const float beta);
+/* y = alpha * xB + beta * y and y = alpha * Ax + beta * y, unpacked */
+void sgemv_n(const float* B, const int ldb, const float* x, const int incx,
+              float* y, const int k, const int n, const float alpha, const float beta);
+void sgemv_t(const float* A, const int lda, const float* x, float* y, const int incy,
+              const int m, const int k, const float alpha, const float beta);
+void dgemv_n(const double* B, const int ldb, const double* x, const int incx,
+              double* y, const int k, const int n, const double alpha, const double beta);
+void dgemv_t(const double* A, const int lda, const double* x, double* y, const int incy,
+              const int m, const int k, const double alpha, const double beta);
+void qigemv_n(const int16_t* x, const int8_t* B, const int ldb, int* y,
+              const int k, const int n);
+/* C = alpha * op(A)B + beta * C, no packing, no threads */
+void sgemm_small(const int M, const int N, const int K, const float alpha,
+              const float* A, const int rsA, const int csA, const float* B, const int ldb,
+              const float beta, float* C, const int ldc);
+void dgemm_small(const int M, const int N, const int K, const double alpha,
+              const double* A, const int rsA, const int csA, const double* B, const int ldb,
+              const double beta, double* C, const int ldc);
+extern const gemm_fixed_t sgemm_fixed[];
 
 /********************************************************
  *                                                      
@@ -120,55 +920,138 @@ void maskstore(int* C, int8_t mask, __m128i packed_C);
  *                                                      
 *********************************************************/
 void spack_blockB(const float* B, float* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, 
+                  const int nc, const int rs, const int cs,
                   const int kc, const int NTHREADS);
 void spack_blockA(const float* A, float* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, 
-                  const int K, const int NTHREADS);
-void spack_panelB(const float* B, float* packed_B, 
-                  const int nr, const int NC, const int N, const int kc);
-void spack_panelA(const float* A, float* packed_A, 
-                  const int mr, const int kc, const int KC, const int K);
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS);
+void spack_blockB_part(const float* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void spack_blockA_part(const float* A, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
+void spack_panelB(const float* B, float* packed_B, const int nr, 
+                  const int NR, const int rs, const int cs, const int kc);
+void spack_panelA(const float* A, float* packed_A, const int mr, 
+                  const int kc, const int MR, const int rs, const int cs);
+void spack_blockA_rows_part(const float* A, const int* rows, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
+void spack_panelA_rows(const float* A, const int* rows, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs);
 
 void dpack_blockB(const double* B, double* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, 
+                  const int nc, const int rs, const int cs,
                   const int kc, const int NTHREADS);
 void dpack_blockA(const double* A, double* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, 
-                  const int K, const int NTHREADS);
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS);
+void dpack_blockB_part(const double* B, double* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void dpack_blockA_part(const double* A, double* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
 void dpack_panelB(const double* B, double* packed_B, const int nr, 
-                  const int NC, const int N, const int kc);
+                  const int NR, const int rs, const int cs, const int kc);
 void dpack_panelA(const double* A, double* packed_A, const int mr, 
-                  const int kc, const int KC, const int K);
+                  const int kc, const int MR, const int rs, const int cs);
 
 void ipack_blockB(const int* B, int* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, 
+                  const int nc, const int rs, const int cs,
                   const int kc, const int NTHREADS);
 void ipack_blockA(const int* A, int* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, 
-                  const int K, const int NTHREADS);
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS);
+void ipack_blockB_part(const int* B, int* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void ipack_blockA_part(const int* A, int* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
 void ipack_panelB(const int* B, int* packed_B, const int nr, 
-                  const int NC, const int N, const int kc);
+                  const int NR, const int rs, const int cs, const int kc);
 void ipack_panelA(const int* A, int* packed_A, const int mr, 
-                  const int kc, const int KC, const int K);
+                  const int kc, const int MR, const int rs, const int cs);
 
 void hqpack_blockB(const int16_t* B, int16_t* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, const int kc);
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int NTHREADS);
 void hqpack_blockA(const int16_t* A, int16_t* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, const int K);
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS);
+void hqpack_blockB_part(const int16_t* B, int16_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void hqpack_blockA_part(const int16_t* A, int16_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
 void hqpack_panelB(const int16_t* B, int16_t* packed_B, const int nr, 
-                  const int NC, const int N, const int kc);
+                  const int NR, const int rs, const int cs, const int kc);
 void hqpack_panelA(const int16_t* A, int16_t* packed_A, const int mr, 
-                  const int kc, const int KC, const int K);
+                  const int kc, const int MR, const int rs, const int cs);
 
 void qpack_blockB(const int8_t* B, int8_t* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, const int kc);
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int NTHREADS);
 void qpack_blockA(const int8_t* A, int8_t* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, const int K);
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS);
+void qpack_blockB_part(const int8_t* B, int8_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void qpack_blockA_part(const int8_t* A, int8_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
 void qpack_panelB(const int8_t* B, int8_t* packed_B, const int nr, 
-                  const int NC, const int N, const int kc);
+                  const int NR, const int rs, const int cs, const int kc);
 void qpack_panelA(const int8_t* A, int8_t* packed_A, const int mr, 
-                  const int kc, const int KC, const int K);
+                  const int kc, const int MR, const int rs, const int cs);
+
+void qipack_blockB_part(const int8_t* B, int8_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void qipack_blockA_part(const uint8_t* A, uint8_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const uint8_t flip, const int id, const int ways);
+void qipack_panelB(const int8_t* B, int8_t* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc);
+void qipack_panelA(const uint8_t* A, uint8_t* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs, const uint8_t flip);
+
+void hqipack_blockB_part(const int16_t* B, int16_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void hqipack_blockA_part(const int16_t* A, int16_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
+void hqipack_panelB(const int16_t* B, int16_t* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc);
+void hqipack_panelA(const int16_t* A, int16_t* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs);
+
+void bf16pack_blockB_part(const uint16_t* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void bf16pack_blockA_part(const uint16_t* A, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
+void bf16pack_panelB(const uint16_t* B, float* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc);
+void bf16pack_panelA(const uint16_t* A, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs);
+
+void hpack_blockB_part(const uint16_t* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways);
+void hpack_blockA_part(const uint16_t* A, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways);
+void hpack_panelB(const uint16_t* B, float* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc);
+void hpack_panelA(const uint16_t* A, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs);
 
 /********************************************************
  *                                                      
@@ -177,11 +1060,25 @@ void qpack_panelA(const int8_t* A, int8_t* packed_A, const int mr,
 *********************************************************/
 void show_cache(size_t* cache_size);
 void get_cache_size(size_t* cache_size);
-void set_block_size(size_t* cache_size, const int NTHREADS,
+void set_block_size(size_t* cache_size, const int NTHREADS, const gemm_topo_t* topo,
                     const int MR, const int NR,
                     int* MC, int* KC, int* NC, D_TYPE d_type);
 void cache_opt(const int NTHREADS, const int MR, const int NR,
                int* MC, int* KC, int* NC, D_TYPE d_type);
 int get_core_num();
 
+void get_topology(gemm_topo_t* topo);
+/* get_topology with every /sys and /proc path read under [root], e.g. a test fixture */
+void get_topology_at(gemm_topo_t* topo, const char* root);
+
+/* number of threads on the 5th (jc), 2nd (ir) and 1st (jr) loops */
+typedef struct {
+    int jc_ways, ir_ways, jr_ways;
+} gemm_part_t;
+
+void set_partition(const int NTHREADS, const int M, const int N,
+                   const int MR, const int NR, const int MC, const int NC,
+                   const BOOL pack_B, gemm_part_t* part);
+void set_range(const int n, const int ways, const int id, int* start, int* end);
+
 #endif // GEMM_H
\ No newline at end of file
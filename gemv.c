@@ -0,0 +1,500 @@
+/**********************************************************************************************
+ * File   : gemv.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      Matrix-vector products, and the GEMMs that are one: a single row or column of C.
+ *
+ *      Packing pays off when every element of A and B is used many times; in a GEMV each
+ *      element of the matrix is used once, so packing it only adds a second pass over
+ *      memory. The *gemv_n and *gemv_t kernels (see [kernel.c]) read it once, straight
+ *      from where it is, and the threads share the memory bandwidth:
+ *
+ *          *gemv_n_run     y = alpha * xB + beta * y, the columns of B split across the
+ *                          threads in whole cache lines, or the rows of B when there are
+ *                          too few columns, each thread summing into its own copy of y
+ *          *gemv_t_run     y = alpha * Ax + beta * y, the rows of A split across the
+ *                          threads, or the columns of A as above
+ *
+ *      sgemm_ex and dgemm_ex come here by themselves for M or N of 1 (see *gemm_gemv),
+ *      and qgemm_s32 for M of 1 (see qgemm_s32_gemv).
+ *
+**********************************************************************************************/
+
+#include "gemm.h"
+
+/* a GEMV runs on one more thread for every this many elements of the matrix */
+#define GEMV_WORK_PER_THREAD    (1 << 15)
+/* and splits y only with this many cache lines or rows of it for each thread */
+#define GEMV_LINES_PER_THREAD   4
+#define GEMV_ROWS_PER_THREAD    4
+#define GEMV_LINE               64
+
+static int gemv_threads(const gemm_ctx_t* ctx, const int m, const int n) {
+    const int64_t work = (int64_t)m * n / GEMV_WORK_PER_THREAD;
+    return (int)max(1, min((int64_t)ctx->NTHREADS, work));
+}
+
+/* [n] elements of [size] bytes, [inc] apart as in BLAS (from the end for inc < 0), copied together */
+static void* vec_gather(const void* x, const int n, const int inc, const size_t size) {
+    char* buf = (char* )malloc((size_t)max(n, 1) * size);
+    const char* base = (const char* )x + ((inc < 0) ? (size_t)(n - 1) * -inc * size : 0);
+    for(int i = 0; i < n; i++)
+        memcpy(buf + i * size, base + (ptrdiff_t)i * inc * size, size);
+    return buf;
+}
+
+/* the other way around */
+static void vec_scatter(void* y, const void* buf, const int n, const int inc, const size_t size) {
+    char* base = (char* )y + ((inc < 0) ? (size_t)(n - 1) * -inc * size : 0);
+    for(int i = 0; i < n; i++)
+        memcpy(base + (ptrdiff_t)i * inc * size, (const char* )buf + i * size, size);
+}
+
+/********************************************************
+ *
+ *          FP32
+ *
+*********************************************************/
+void sgemv(const LAYOUT layout, const TRANSPOSE trans, const int M, const int N,
+        const float alpha, const float* A, const int lda,
+        const float* x, const int incx,
+        const float beta, float* y, const int incy) {
+    sgemv_ctx(gemm_ctx_default(), layout, trans, M, N, alpha, A, lda, x, incx, beta, y, incy);
+}
+
+void sgemv_ctx(gemm_ctx_t* ctx, const LAYOUT layout, const TRANSPOSE trans,
+        const int M, const int N,
+        const float alpha, const float* A, const int lda,
+        const float* x, const int incx,
+        const float beta, float* y, const int incy) {
+    /* the rows of row-major A are the columns of column-major A */
+    if(layout == L_COL_MAJOR) {
+        sgemv_ctx(ctx, L_ROW_MAJOR, (trans == T_NO_TRANS) ? T_TRANS : T_NO_TRANS,
+            N, M, alpha, A, lda, x, incx, beta, y, incy);
+        return;
+    }
+    const int m = (trans == T_NO_TRANS) ? M : N;    /* length of y */
+    const int k = (trans == T_NO_TRANS) ? N : M;    /* length of x */
+    if(m <= 0)
+        return;
+
+    float* y_buf = y;
+    if(incy != 1)
+        y_buf = (beta != 0) ? (float* )vec_gather(y, m, incy, sizeof(float))
+                            : (float* )malloc((size_t)m * sizeof(float));
+    if(k <= 0 || alpha == 0) {
+        for(int i = 0; i < m; i++)
+            y_buf[i] = (beta == 0) ? 0 : beta * y_buf[i];
+    }
+    else if(trans == T_NO_TRANS) {
+        const float* x_buf = (incx != 1) ? (const float* )vec_gather(x, k, incx, sizeof(float)) : x;
+        sgemv_t_run(ctx, m, k, alpha, A, lda, x_buf, beta, y_buf, 1);
+        if(x_buf != x)
+            free((void* )x_buf);
+    }
+    else {
+        const float* x_0 = (incx < 0) ? &x[(size_t)(k - 1) * -incx] : x;
+        sgemv_n_run(ctx, k, m, alpha, x_0, incx, A, lda, beta, y_buf);
+    }
+    if(y_buf != y) {
+        vec_scatter(y, y_buf, m, incy, sizeof(float));
+        free(y_buf);
+    }
+}
+
+void sgemv_n_run(gemm_ctx_t* ctx, const int K, const int N,
+        const float alpha, const float* x, const int incx,
+        const float* B, const int ldb,
+        const float beta, float* y) {
+    const int nthreads = gemv_threads(ctx, K, N);
+    if(nthreads == 1) {
+        ctx->isa->s.gemv_n(B, ldb, x, incx, y, K, N, alpha, beta);
+        return;
+    }
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    const int line = GEMV_LINE / sizeof(float);
+    const int lines = (N + line - 1) / line;
+    if(lines >= GEMV_LINES_PER_THREAD * nthreads) {
+#pragma omp parallel num_threads(nthreads)
+        {
+            int start, end;
+            set_range(lines, omp_get_num_threads(), omp_get_thread_num(), &start, &end);
+            const int n0 = start * line, n1 = min(N, end * line);
+            if(n0 < n1)
+                ctx->isa->s.gemv_n(&B[n0], ldb, x, incx, &y[n0], K, n1 - n0, alpha, beta);
+        }
+        return;
+    }
+
+    /* few columns: each thread sums its rows of B into its own y, then they are added up */
+    float* part = (float* )malloc((size_t)nthreads * N * sizeof(float));
+#pragma omp parallel num_threads(nthreads)
+    {
+        const int tid = omp_get_thread_num(), ways = omp_get_num_threads();
+        int k0, k1;
+        set_range(K, ways, tid, &k0, &k1);
+        ctx->isa->s.gemv_n(&B[(size_t)k0 * ldb], ldb, &x[(ptrdiff_t)k0 * incx], incx,
+            &part[(size_t)tid * N], k1 - k0, N, alpha, 0);
+        gemm_barrier(ctx, ways);
+#pragma omp for schedule(static)
+        for(int c = 0; c < N; c++) {
+            float sum = (beta == 0) ? 0 : beta * y[c];
+            for(int t = 0; t < ways; t++)
+                sum += part[(size_t)t * N + c];
+            y[c] = sum;
+        }
+    }
+    free(part);
+}
+
+void sgemv_t_run(gemm_ctx_t* ctx, const int M, const int K,
+        const float alpha, const float* A, const int lda, const float* x,
+        const float beta, float* y, const int incy) {
+    const int nthreads = gemv_threads(ctx, M, K);
+    if(nthreads == 1) {
+        ctx->isa->s.gemv_t(A, lda, x, y, incy, M, K, alpha, beta);
+        return;
+    }
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    const int line = GEMV_LINE / sizeof(float);
+    if(M >= GEMV_ROWS_PER_THREAD * nthreads) {
+#pragma omp parallel num_threads(nthreads)
+        {
+            int m0, m1;
+            set_range(M, omp_get_num_threads(), omp_get_thread_num(), &m0, &m1);
+            if(m0 < m1)
+                ctx->isa->s.gemv_t(&A[(size_t)m0 * lda], lda, x, &y[(size_t)m0 * incy], incy,
+                    m1 - m0, K, alpha, beta);
+        }
+        return;
+    }
+
+    /* few rows: each thread takes whole cache lines of every row, then the dot products are added up */
+    const int lines = (K + line - 1) / line;
+    float* part = (float* )malloc((size_t)nthreads * M * sizeof(float));
+#pragma omp parallel num_threads(nthreads)
+    {
+        const int tid = omp_get_thread_num(), ways = omp_get_num_threads();
+        int start, end;
+        set_range(lines, ways, tid, &start, &end);
+        const int k0 = min(K, start * line), k1 = min(K, end * line);
+        ctx->isa->s.gemv_t(&A[k0], lda, &x[k0], &part[(size_t)tid * M], 1, M, k1 - k0, alpha, 0);
+        gemm_barrier(ctx, ways);
+#pragma omp for schedule(static)
+        for(int r = 0; r < M; r++) {
+            float sum = (beta == 0) ? 0 : beta * y[(size_t)r * incy];
+            for(int t = 0; t < ways; t++)
+                sum += part[(size_t)t * M + r];
+            y[(size_t)r * incy] = sum;
+        }
+    }
+    free(part);
+}
+
+/**
+ * Row-major C = alpha * op(A)op(B) + beta * C with M or N of 1, op(A) and op(B) as
+ * in sgemm_run. Whichever of A and B is the matrix is read along its rows.
+ */
+void sgemm_gemv(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const float alpha, const float* A, const int rsA, const int csA,
+        const float* B, const int rsB, const int csB,
+        const float beta, float* C, const int ldc) {
+    if(M == 1) {
+        if(csB == 1)            /* C = A B, the rows of B */
+            sgemv_n_run(ctx, K, N, alpha, A, csA, B, rsB, beta, C);
+        else {                  /* C' = B' A', the rows of B' */
+            const float* x = (csA != 1) ? (const float* )vec_gather(A, K, csA, sizeof(float)) : A;
+            sgemv_t_run(ctx, N, K, alpha, B, csB, x, beta, C, 1);
+            if(x != A)
+                free((void* )x);
+        }
+        return;
+    }
+
+    if(csA == 1) {              /* C = A B, the rows of A */
+        const float* x = (rsB != 1) ? (const float* )vec_gather(B, K, rsB, sizeof(float)) : B;
+        sgemv_t_run(ctx, M, K, alpha, A, rsA, x, beta, C, ldc);
+        if(x != B)
+            free((void* )x);
+        return;
+    }
+    /* C' = B' A', the rows of A' */
+    float* y = C;
+    if(ldc != 1)
+        y = (beta != 0) ? (float* )vec_gather(C, M, ldc, sizeof(float))
+                        : (float* )malloc((size_t)M * sizeof(float));
+    sgemv_n_run(ctx, K, M, alpha, B, rsB, A, csA, beta, y);
+    if(y != C) {
+        vec_scatter(C, y, M, ldc, sizeof(float));
+        free(y);
+    }
+}
+
+/********************************************************
+ *
+ *          FP64
+ *
+*********************************************************/
+void dgemv(const LAYOUT layout, const TRANSPOSE trans, const int M, const int N,
+        const double alpha, const double* A, const int lda,
+        const double* x, const int incx,
+        const double beta, double* y, const int incy) {
+    dgemv_ctx(gemm_ctx_default(), layout, trans, M, N, alpha, A, lda, x, incx, beta, y, incy);
+}
+
+void dgemv_ctx(gemm_ctx_t* ctx, const LAYOUT layout, const TRANSPOSE trans,
+        const int M, const int N,
+        const double alpha, const double* A, const int lda,
+        const double* x, const int incx,
+        const double beta, double* y, const int incy) {
+    /* the rows of row-major A are the columns of column-major A */
+    if(layout == L_COL_MAJOR) {
+        dgemv_ctx(ctx, L_ROW_MAJOR, (trans == T_NO_TRANS) ? T_TRANS : T_NO_TRANS,
+            N, M, alpha, A, lda, x, incx, beta, y, incy);
+        return;
+    }
+    const int m = (trans == T_NO_TRANS) ? M : N;    /* length of y */
+    const int k = (trans == T_NO_TRANS) ? N : M;    /* length of x */
+    if(m <= 0)
+        return;
+
+    double* y_buf = y;
+    if(incy != 1)
+        y_buf = (beta != 0) ? (double* )vec_gather(y, m, incy, sizeof(double))
+                            : (double* )malloc((size_t)m * sizeof(double));
+    if(k <= 0 || alpha == 0) {
+        for(int i = 0; i < m; i++)
+            y_buf[i] = (beta == 0) ? 0 : beta * y_buf[i];
+    }
+    else if(trans == T_NO_TRANS) {
+        const double* x_buf = (incx != 1) ? (const double* )vec_gather(x, k, incx, sizeof(double)) : x;
+        dgemv_t_run(ctx, m, k, alpha, A, lda, x_buf, beta, y_buf, 1);
+        if(x_buf != x)
+            free((void* )x_buf);
+    }
+    else {
+        const double* x_0 = (incx < 0) ? &x[(size_t)(k - 1) * -incx] : x;
+        dgemv_n_run(ctx, k, m, alpha, x_0, incx, A, lda, beta, y_buf);
+    }
+    if(y_buf != y) {
+        vec_scatter(y, y_buf, m, incy, sizeof(double));
+        free(y_buf);
+    }
+}
+
+void dgemv_n_run(gemm_ctx_t* ctx, const int K, const int N,
+        const double alpha, const double* x, const int incx,
+        const double* B, const int ldb,
+        const double beta, double* y) {
+    const int nthreads = gemv_threads(ctx, K, N);
+    if(nthreads == 1) {
+        ctx->isa->d.gemv_n(B, ldb, x, incx, y, K, N, alpha, beta);
+        return;
+    }
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    const int line = GEMV_LINE / sizeof(double);
+    const int lines = (N + line - 1) / line;
+    if(lines >= GEMV_LINES_PER_THREAD * nthreads) {
+#pragma omp parallel num_threads(nthreads)
+        {
+            int start, end;
+            set_range(lines, omp_get_num_threads(), omp_get_thread_num(), &start, &end);
+            const int n0 = start * line, n1 = min(N, end * line);
+            if(n0 < n1)
+                ctx->isa->d.gemv_n(&B[n0], ldb, x, incx, &y[n0], K, n1 - n0, alpha, beta);
+        }
+        return;
+    }
+
+    /* few columns: each thread sums its rows of B into its own y, then they are added up */
+    double* part = (double* )malloc((size_t)nthreads * N * sizeof(double));
+#pragma omp parallel num_threads(nthreads)
+    {
+        const int tid = omp_get_thread_num(), ways = omp_get_num_threads();
+        int k0, k1;
+        set_range(K, ways, tid, &k0, &k1);
+        ctx->isa->d.gemv_n(&B[(size_t)k0 * ldb], ldb, &x[(ptrdiff_t)k0 * incx], incx,
+            &part[(size_t)tid * N], k1 - k0, N, alpha, 0);
+        gemm_barrier(ctx, ways);
+#pragma omp for schedule(static)
+        for(int c = 0; c < N; c++) {
+            double sum = (beta == 0) ? 0 : beta * y[c];
+            for(int t = 0; t < ways; t++)
+                sum += part[(size_t)t * N + c];
+            y[c] = sum;
+        }
+    }
+    free(part);
+}
+
+void dgemv_t_run(gemm_ctx_t* ctx, const int M, const int K,
+        const double alpha, const double* A, const int lda, const double* x,
+        const double beta, double* y, const int incy) {
+    const int nthreads = gemv_threads(ctx, M, K);
+    if(nthreads == 1) {
+        ctx->isa->d.gemv_t(A, lda, x, y, incy, M, K, alpha, beta);
+        return;
+    }
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    const int line = GEMV_LINE / sizeof(double);
+    if(M >= GEMV_ROWS_PER_THREAD * nthreads) {
+#pragma omp parallel num_threads(nthreads)
+        {
+            int m0, m1;
+            set_range(M, omp_get_num_threads(), omp_get_thread_num(), &m0, &m1);
+            if(m0 < m1)
+                ctx->isa->d.gemv_t(&A[(size_t)m0 * lda], lda, x, &y[(size_t)m0 * incy], incy,
+                    m1 - m0, K, alpha, beta);
+        }
+        return;
+    }
+
+    /* few rows: each thread takes whole cache lines of every row, then the dot products are added up */
+    const int lines = (K + line - 1) / line;
+    double* part = (double* )malloc((size_t)nthreads * M * sizeof(double));
+#pragma omp parallel num_threads(nthreads)
+    {
+        const int tid = omp_get_thread_num(), ways = omp_get_num_threads();
+        int start, end;
+        set_range(lines, ways, tid, &start, &end);
+        const int k0 = min(K, start * line), k1 = min(K, end * line);
+        ctx->isa->d.gemv_t(&A[k0], lda, &x[k0], &part[(size_t)tid * M], 1, M, k1 - k0, alpha, 0);
+        gemm_barrier(ctx, ways);
+#pragma omp for schedule(static)
+        for(int r = 0; r < M; r++) {
+            double sum = (beta == 0) ? 0 : beta * y[(size_t)r * incy];
+            for(int t = 0; t < ways; t++)
+                sum += part[(size_t)t * M + r];
+            y[(size_t)r * incy] = sum;
+        }
+    }
+    free(part);
+}
+
+/* see sgemm_gemv */
+void dgemm_gemv(gemm_ctx_t* ctx, const int M, const int N, const int K,
+        const double alpha, const double* A, const int rsA, const int csA,
+        const double* B, const int rsB, const int csB,
+        const double beta, double* C, const int ldc) {
+    if(M == 1) {
+        if(csB == 1)            /* C = A B, the rows of B */
+            dgemv_n_run(ctx, K, N, alpha, A, csA, B, rsB, beta, C);
+        else {                  /* C' = B' A', the rows of B' */
+            const double* x = (csA != 1) ? (const double* )vec_gather(A, K, csA, sizeof(double)) : A;
+            dgemv_t_run(ctx, N, K, alpha, B, csB, x, beta, C, 1);
+            if(x != A)
+                free((void* )x);
+        }
+        return;
+    }
+
+    if(csA == 1) {              /* C = A B, the rows of A */
+        const double* x = (rsB != 1) ? (const double* )vec_gather(B, K, rsB, sizeof(double)) : B;
+        dgemv_t_run(ctx, M, K, alpha, A, rsA, x, beta, C, ldc);
+        if(x != B)
+            free((void* )x);
+        return;
+    }
+    /* C' = B' A', the rows of A' */
+    double* y = C;
+    if(ldc != 1)
+        y = (beta != 0) ? (double* )vec_gather(C, M, ldc, sizeof(double))
+                        : (double* )malloc((size_t)M * sizeof(double));
+    dgemv_n_run(ctx, K, M, alpha, B, rsB, A, csA, beta, y);
+    if(y != C) {
+        vec_scatter(C, y, M, ldc, sizeof(double));
+        free(y);
+    }
+}
+
+/********************************************************
+ *
+ *          UINT8 x INT8 -> INT32
+ *
+*********************************************************/
+/**
+ * qgemm_s32_run with a single row of A: x = (A ^ flip) - a_zero in int16, and
+ * C = xB - b_zero * sum(x), which is the sum over k of (A - a_zero)(B - b_zero).
+ * Returns FALSE, having done nothing, when x doesn't fit in int16.
+ */
+BOOL qgemm_s32_gemv(gemm_ctx_t* ctx, const int N, const int K,
+        const uint8_t* A, const uint8_t flip, const int32_t a_zero,
+        const int8_t* B, const int ldb, const int32_t b_zero, int32_t* C) {
+    if(a_zero < 255 - 32767 || a_zero > 32768)
+        return FALSE;
+
+    int16_t* x = (int16_t* )malloc(((size_t)K + 1) * sizeof(int16_t));
+    int64_t sum = 0;
+    for(int k = 0; k < K; k++) {
+        x[k] = (int16_t)((A[k] ^ flip) - a_zero);
+        sum += x[k];
+    }
+    const uint32_t off = (uint32_t)(int32_t)(-b_zero * sum);
+
+    const int nthreads = gemv_threads(ctx, K, N);
+    const int line = GEMV_LINE / sizeof(int32_t);
+    const int lines = (N + line - 1) / line;
+    if(nthreads == 1 || lines >= GEMV_LINES_PER_THREAD * nthreads) {
+        if(nthreads > 1 && ctx->collect_stats) {
+#pragma omp atomic
+            ctx->stats.regions++;
+        }
+#pragma omp parallel num_threads(nthreads) if(nthreads > 1)
+        {
+            int start, end;
+            set_range(lines, omp_get_num_threads(), omp_get_thread_num(), &start, &end);
+            const int n0 = start * line, n1 = min(N, end * line);
+            if(n0 < n1) {
+                ctx->isa->qi.gemv_n(x, &B[n0], ldb, &C[n0], K, n1 - n0);
+                if(off != 0)
+                    for(int c = n0; c < n1; c++)
+                        C[c] = (int32_t)((uint32_t)C[c] + off);
+            }
+        }
+        free(x);
+        return TRUE;
+    }
+    if(ctx->collect_stats) {
+#pragma omp atomic
+        ctx->stats.regions++;
+    }
+
+    /* few columns: each thread sums its rows of B into its own C, then they are added up */
+    int32_t* part = (int32_t* )malloc((size_t)nthreads * N * sizeof(int32_t));
+#pragma omp parallel num_threads(nthreads)
+    {
+        const int tid = omp_get_thread_num(), ways = omp_get_num_threads();
+        int k0, k1;
+        set_range(K, ways, tid, &k0, &k1);
+        ctx->isa->qi.gemv_n(&x[k0], &B[(size_t)k0 * ldb], ldb, &part[(size_t)tid * N], k1 - k0, N);
+        gemm_barrier(ctx, ways);
+#pragma omp for schedule(static)
+        for(int c = 0; c < N; c++) {
+            uint32_t acc = off;
+            for(int t = 0; t < ways; t++)
+                acc += (uint32_t)part[(size_t)t * N + c];
+            C[c] = (int32_t)acc;
+        }
+    }
+    free(part);
+    free(x);
+    return TRUE;
+}
@@ -0,0 +1,79 @@
+/**********************************************************************************************
+ * File   : isa.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      Function table of one instruction set. Like [kernel.c] and [pack.c], this file is
+ *      compiled once per instruction set, so isa_table becomes isa_table_avx2 and so on
+ *      (see [isa.h]).
+ *
+**********************************************************************************************/
+
+#include "gemm.h"
+
+const gemm_isa_t isa_table = {
+    .inst_level = INSTLEVEL,
+    .name       = ISA_STR(GEMM_ISA),
+    .s = {
+        .kernel           = skernel,
+        .pack_blockB      = spack_blockB,
+        .pack_blockA_part = spack_blockA_part,
+        .pack_blockB_part = spack_blockB_part,
+        .pack_blockA_rows_part = spack_blockA_rows_part,
+        .gemv_n           = sgemv_n,
+        .gemv_t           = sgemv_t,
+        .small            = sgemm_small,
+        .fixed            = sgemm_fixed,
+    },
+    .d = {
+        .kernel           = dkernel,
+        .pack_blockB      = dpack_blockB,
+        .pack_blockA_part = dpack_blockA_part,
+        .pack_blockB_part = dpack_blockB_part,
+        .gemv_n           = dgemv_n,
+        .gemv_t           = dgemv_t,
+        .small            = dgemm_small,
+    },
+    .i = {
+        .kernel           = ikernel,
+        .pack_blockB      = ipack_blockB,
+        .pack_blockA_part = ipack_blockA_part,
+        .pack_blockB_part = ipack_blockB_part,
+    },
+    .hq = {
+        .kernel           = hqkernel,
+        .pack_blockB      = hqpack_blockB,
+        .pack_blockA_part = hqpack_blockA_part,
+        .pack_blockB_part = hqpack_blockB_part,
+    },
+    .q = {
+        .kernel           = qkernel,
+        .pack_blockB      = qpack_blockB,
+        .pack_blockA_part = qpack_blockA_part,
+        .pack_blockB_part = qpack_blockB_part,
+    },
+    .qi = {
+        .kernel           = qikernel,
+        .pack_blockA_part = qipack_blockA_part,
+        .pack_blockB_part = qipack_blockB_part,
+        .gemv_n           = qigemv_n,
+    },
+    .hqi = {
+        .kernel           = hqikernel,
+        .pack_blockA_part = hqipack_blockA_part,
+        .pack_blockB_part = hqipack_blockB_part,
+    },
+    .bf16 = {
+#if INSTLEVEL >= 11
+        .kernel           = bf16kernel,
+#endif
+        .pack_blockA_part = bf16pack_blockA_part,
+        .pack_blockB_part = bf16pack_blockB_part,
+    },
+    .h = {
+        .kernel           = hkernel,
+        .pack_blockA_part = hpack_blockA_part,
+        .pack_blockB_part = hpack_blockB_part,
+    },
+};
\ No newline at end of file
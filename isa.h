@@ -0,0 +1,95 @@
+/**********************************************************************************************
+ * File   : isa.h
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      Kernels and pack functions are compiled once per instruction set
+ *      (see [Makefile]), with -DGEMM_ISA=<isa> next to the matching -m flags.
+ *      This header gives every name those files export an _<isa> suffix, e.g. skernel
+ *      becomes skernel_avx2, so all of them link into one binary. [dispatch.c] picks
+ *      one of them at run time.
+ *
+ *      A function added to [kernel.c] or [pack.c] has to be added here too.
+ *
+**********************************************************************************************/
+
+#ifndef ISA_H
+#define ISA_H 1
+
+#pragma once
+
+#define ISA_CAT_(name, isa) name##_##isa
+#define ISA_CAT(name, isa)  ISA_CAT_(name, isa)
+#define ISA_NAME(name)      ISA_CAT(name, GEMM_ISA)
+#define ISA_STR_(isa)       #isa
+#define ISA_STR(isa)        ISA_STR_(isa)
+
+#define skernel            ISA_NAME(skernel)
+#define dkernel            ISA_NAME(dkernel)
+#define ikernel            ISA_NAME(ikernel)
+#define hqkernel           ISA_NAME(hqkernel)
+#define qkernel            ISA_NAME(qkernel)
+#define spack_blockB       ISA_NAME(spack_blockB)
+#define spack_blockA       ISA_NAME(spack_blockA)
+#define spack_blockB_part  ISA_NAME(spack_blockB_part)
+#define spack_blockA_part  ISA_NAME(spack_blockA_part)
+#define spack_panelB       ISA_NAME(spack_panelB)
+#define spack_panelA       ISA_NAME(spack_panelA)
+#define spack_blockA_rows_part ISA_NAME(spack_blockA_rows_part)
+#define spack_panelA_rows  ISA_NAME(spack_panelA_rows)
+#define dpack_blockB       ISA_NAME(dpack_blockB)
+#define dpack_blockA       ISA_NAME(dpack_blockA)
+#define dpack_blockB_part  ISA_NAME(dpack_blockB_part)
+#define dpack_blockA_part  ISA_NAME(dpack_blockA_part)
+#define dpack_panelB       ISA_NAME(dpack_panelB)
+#define dpack_panelA       ISA_NAME(dpack_panelA)
+#define ipack_blockB       ISA_NAME(ipack_blockB)
+#define ipack_blockA       ISA_NAME(ipack_blockA)
+#define ipack_blockB_part  ISA_NAME(ipack_blockB_part)
+#define ipack_blockA_part  ISA_NAME(ipack_blockA_part)
+#define ipack_panelB       ISA_NAME(ipack_panelB)
+#define ipack_panelA       ISA_NAME(ipack_panelA)
+#define hqpack_blockB      ISA_NAME(hqpack_blockB)
+#define hqpack_blockA      ISA_NAME(hqpack_blockA)
+#define hqpack_blockB_part ISA_NAME(hqpack_blockB_part)
+#define hqpack_blockA_part ISA_NAME(hqpack_blockA_part)
+#define hqpack_panelB      ISA_NAME(hqpack_panelB)
+#define hqpack_panelA      ISA_NAME(hqpack_panelA)
+#define qpack_blockB       ISA_NAME(qpack_blockB)
+#define qpack_blockA       ISA_NAME(qpack_blockA)
+#define qpack_blockB_part  ISA_NAME(qpack_blockB_part)
+#define qpack_blockA_part  ISA_NAME(qpack_blockA_part)
+#define qpack_panelB       ISA_NAME(qpack_panelB)
+#define qpack_panelA       ISA_NAME(qpack_panelA)
+#define qikernel           ISA_NAME(qikernel)
+#define qipack_blockB_part ISA_NAME(qipack_blockB_part)
+#define qipack_blockA_part ISA_NAME(qipack_blockA_part)
+#define qipack_panelB      ISA_NAME(qipack_panelB)
+#define qipack_panelA      ISA_NAME(qipack_panelA)
+#define hqikernel           ISA_NAME(hqikernel)
+#define hqipack_blockB_part ISA_NAME(hqipack_blockB_part)
+#define hqipack_blockA_part ISA_NAME(hqipack_blockA_part)
+#define hqipack_panelB      ISA_NAME(hqipack_panelB)
+#define hqipack_panelA      ISA_NAME(hqipack_panelA)
+#define bf16kernel           ISA_NAME(bf16kernel)
+#define bf16pack_blockB_part ISA_NAME(bf16pack_blockB_part)
+#define bf16pack_blockA_part ISA_NAME(bf16pack_blockA_part)
+#define bf16pack_panelB      ISA_NAME(bf16pack_panelB)
+#define bf16pack_panelA      ISA_NAME(bf16pack_panelA)
+#define hkernel            ISA_NAME(hkernel)
+#define hpack_blockB_part  ISA_NAME(hpack_blockB_part)
+#define hpack_blockA_part  ISA_NAME(hpack_blockA_part)
+#define hpack_panelB       ISA_NAME(hpack_panelB)
+#define hpack_panelA       ISA_NAME(hpack_panelA)
+#define sgemv_n            ISA_NAME(sgemv_n)
+#define sgemv_t            ISA_NAME(sgemv_t)
+#define dgemv_n            ISA_NAME(dgemv_n)
+#define dgemv_t            ISA_NAME(dgemv_t)
+#define qigemv_n           ISA_NAME(qigemv_n)
+#define sgemm_small        ISA_NAME(sgemm_small)
+#define dgemm_small        ISA_NAME(dgemm_small)
+#define sgemm_fixed        ISA_NAME(sgemm_fixed)
+#define isa_table          ISA_NAME(isa_table)
+
+#endif // ISA_H
\ No newline at end of file
@@ -7,8 +7,8 @@
  *      Our gemm basically based on divide and conquer approach, which follows GotoBLAS.
  *      These kernels are the smallest ones that do matrix multiplication.
  * 
- *      They are all implemented with Intel SIMD intrisic, based on INSTLEVEL macro in
- *      [sse.h]
+ *      They are all written against the vector layer in [simd.h], whose width follows
+ *      the INSTLEVEL macro in [sse.h]
  *      
  *      The letter in front of kernel means a data type. For example, "s" in "skernel" means
  *      32-bit floating point data type.
@@ -18,668 +18,1728 @@
 **********************************************************************************************/
 
 #include "gemm.h"
+#include "simd.h"
+
+#if INSTLEVEL >= 6
+/**
+ * Bias, activation and clamp of [epi] on row [r] of a tile, for the lanes of [mask]
+ * starting at column [c]. The bias of [epi] starts at the tile. GELU and SiLU are both
+ * x * sigmoid(z), with z = 2 sqrt(2/pi)(x + 0.044715x^3) and z = x.
+ */
+SIMD_INLINE vs_t vs_epilogue(const gemm_epilogue_t* epi, vs_t v, const int r, const int c,
+                             vs_mask_t mask) {
+    const float* bias = (const float* )epi->bias;
+    if(epi->bias_mode == BIAS_ROW)
+        v = vs_add(v, vs_set1(bias[r]));
+    else if(epi->bias_mode == BIAS_COL)
+        v = vs_add(v, vs_maskz_loadu(mask, &bias[c]));
+
+    vs_t z;
+    switch(epi->act) {
+        case ACT_RELU:
+            v = vs_max(v, vs_zero());
+            break;
+        case ACT_GELU:
+        case ACT_SILU:
+            z = (epi->act == ACT_SILU) ? v :
+                vs_mul(vs_mul(v, vs_set1(1.5957691216057308f)),
+                       vs_fma(vs_mul(v, v), vs_set1(0.044715f), vs_set1(1)));
+            v = vs_div(v, vs_add(vs_set1(1), vs_exp(vs_mul(z, vs_set1(-1)))));
+            break;
+        default:
+            break;
+    }
+    if(epi->clamp)
+        v = vs_min(vs_max(v, vs_set1(epi->clamp_min)), vs_set1(epi->clamp_max));
+    return v;
+}
 
+/* see vs_epilogue */
+SIMD_INLINE vd_t vd_epilogue(const gemm_epilogue_t* epi, vd_t v, const int r, const int c,
+                             vd_mask_t mask) {
+    const double* bias = (const double* )epi->bias;
+    if(epi->bias_mode == BIAS_ROW)
+        v = vd_add(v, vd_set1(bias[r]));
+    else if(epi->bias_mode == BIAS_COL)
+        v = vd_add(v, vd_maskz_loadu(mask, &bias[c]));
+
+    vd_t z;
+    switch(epi->act) {
+        case ACT_RELU:
+            v = vd_max(v, vd_zero());
+            break;
+        case ACT_GELU:
+        case ACT_SILU:
+            z = (epi->act == ACT_SILU) ? v :
+                vd_mul(vd_mul(v, vd_set1(1.5957691216057308)),
+                       vd_fma(vd_mul(v, v), vd_set1(0.044715), vd_set1(1)));
+            v = vd_div(v, vd_add(vd_set1(1), vd_exp(vd_mul(z, vd_set1(-1)))));
+            break;
+        default:
+            break;
+    }
+    if(epi->clamp)
+        v = vd_min(vd_max(v, vd_set1(epi->clamp_min)), vd_set1(epi->clamp_max));
+    return v;
+}
+#endif              /* INSTLEVEL */
+
+/* row r of C is at C[C_rows[r] * ldc] if [C_rows] is set, see sgemm_gather */
 void skernel(const float* packed_blockA, const float* packed_blockB, float* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N) {
+              const int m, const int kc,
+              const int n, const int ldc,
+              const float alpha, const float beta, const gemm_epilogue_t* epi,
+              const int* C_rows) {
 #if INSTLEVEL >= 8 /* AVX512F */ /* 14x32 kernel */
-    __m512 packed_C[14][2]; /* 14x32 */
-    __m512 a_blockA, b0_blockB, b1_blockB;
-    __mmask16 packed_mask_0 = (n < 16)  ? 0xFFFF >> (16 - n) : 0xFFFF;
-    __mmask16 packed_mask_1 = (n >= 16) ? 0xFFFF >> (32 - n) : 0x0000;
-
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = _mm512_maskz_loadu_ps(packed_mask_0, &C[r * N + 0]);
-        packed_C[r][1] = _mm512_maskz_loadu_ps(packed_mask_1, &C[r * N + 16]);
+    vs_t packed_C[14][2]; /* 14x32 */
+    vs_t a_blockA, b0_blockB, b1_blockB;
+    vs_mask_t packed_mask_0 = vs_mask(n);
+    vs_mask_t packed_mask_1 = vs_mask(n - 16);
+
+    for (int r = 0; r < 14; r++) {
+        packed_C[r][0] = vs_zero();
+        packed_C[r][1] = vs_zero();
     }
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm512_load_ps(packed_blockB + 0);
-        b1_blockB = _mm512_load_ps(packed_blockB + 16);
+        b0_blockB = vs_load(packed_blockB + 0);
+        b1_blockB = vs_load(packed_blockB + 16);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 0]); 
-        packed_C[0][0] = sfma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = sfma(a_blockA, b1_blockB, packed_C[0][1]);
+        a_blockA = vs_bcast(packed_blockA + 0); 
+        packed_C[0][0] = vs_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vs_fma(a_blockA, b1_blockB, packed_C[0][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 1]); 
-        packed_C[1][0] = sfma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = sfma(a_blockA, b1_blockB, packed_C[1][1]);
+        a_blockA = vs_bcast(packed_blockA + 1); 
+        packed_C[1][0] = vs_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vs_fma(a_blockA, b1_blockB, packed_C[1][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 2]); 
-        packed_C[2][0] = sfma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = sfma(a_blockA, b1_blockB, packed_C[2][1]);
+        a_blockA = vs_bcast(packed_blockA + 2); 
+        packed_C[2][0] = vs_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vs_fma(a_blockA, b1_blockB, packed_C[2][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 3]); 
-        packed_C[3][0] = sfma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = sfma(a_blockA, b1_blockB, packed_C[3][1]);
+        a_blockA = vs_bcast(packed_blockA + 3); 
+        packed_C[3][0] = vs_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vs_fma(a_blockA, b1_blockB, packed_C[3][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 4]); 
-        packed_C[4][0] = sfma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = sfma(a_blockA, b1_blockB, packed_C[4][1]);
+        a_blockA = vs_bcast(packed_blockA + 4); 
+        packed_C[4][0] = vs_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vs_fma(a_blockA, b1_blockB, packed_C[4][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 5]); 
-        packed_C[5][0] = sfma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = sfma(a_blockA, b1_blockB, packed_C[5][1]);
+        a_blockA = vs_bcast(packed_blockA + 5); 
+        packed_C[5][0] = vs_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vs_fma(a_blockA, b1_blockB, packed_C[5][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 6]); 
-        packed_C[6][0] = sfma(a_blockA, b0_blockB, packed_C[6][0]);
-        packed_C[6][1] = sfma(a_blockA, b1_blockB, packed_C[6][1]);
+        a_blockA = vs_bcast(packed_blockA + 6); 
+        packed_C[6][0] = vs_fma(a_blockA, b0_blockB, packed_C[6][0]);
+        packed_C[6][1] = vs_fma(a_blockA, b1_blockB, packed_C[6][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 7]); 
-        packed_C[7][0] = sfma(a_blockA, b0_blockB, packed_C[7][0]);
-        packed_C[7][1] = sfma(a_blockA, b1_blockB, packed_C[7][1]);
+        a_blockA = vs_bcast(packed_blockA + 7); 
+        packed_C[7][0] = vs_fma(a_blockA, b0_blockB, packed_C[7][0]);
+        packed_C[7][1] = vs_fma(a_blockA, b1_blockB, packed_C[7][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 8]); 
-        packed_C[8][0] = sfma(a_blockA, b0_blockB, packed_C[8][0]);
-        packed_C[8][1] = sfma(a_blockA, b1_blockB, packed_C[8][1]);
+        a_blockA = vs_bcast(packed_blockA + 8); 
+        packed_C[8][0] = vs_fma(a_blockA, b0_blockB, packed_C[8][0]);
+        packed_C[8][1] = vs_fma(a_blockA, b1_blockB, packed_C[8][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 9]); 
-        packed_C[9][0] = sfma(a_blockA, b0_blockB, packed_C[9][0]);
-        packed_C[9][1] = sfma(a_blockA, b1_blockB, packed_C[9][1]);
+        a_blockA = vs_bcast(packed_blockA + 9); 
+        packed_C[9][0] = vs_fma(a_blockA, b0_blockB, packed_C[9][0]);
+        packed_C[9][1] = vs_fma(a_blockA, b1_blockB, packed_C[9][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 10]); 
-        packed_C[10][0] = sfma(a_blockA, b0_blockB, packed_C[10][0]);
-        packed_C[10][1] = sfma(a_blockA, b1_blockB, packed_C[10][1]);
+        a_blockA = vs_bcast(packed_blockA + 10); 
+        packed_C[10][0] = vs_fma(a_blockA, b0_blockB, packed_C[10][0]);
+        packed_C[10][1] = vs_fma(a_blockA, b1_blockB, packed_C[10][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 11]); 
-        packed_C[11][0] = sfma(a_blockA, b0_blockB, packed_C[11][0]);
-        packed_C[11][1] = sfma(a_blockA, b1_blockB, packed_C[11][1]);
+        a_blockA = vs_bcast(packed_blockA + 11); 
+        packed_C[11][0] = vs_fma(a_blockA, b0_blockB, packed_C[11][0]);
+        packed_C[11][1] = vs_fma(a_blockA, b1_blockB, packed_C[11][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 12]); 
-        packed_C[12][0] = sfma(a_blockA, b0_blockB, packed_C[12][0]);
-        packed_C[12][1] = sfma(a_blockA, b1_blockB, packed_C[12][1]);
+        a_blockA = vs_bcast(packed_blockA + 12); 
+        packed_C[12][0] = vs_fma(a_blockA, b0_blockB, packed_C[12][0]);
+        packed_C[12][1] = vs_fma(a_blockA, b1_blockB, packed_C[12][1]);
 
-        a_blockA = _mm512_set1_ps(packed_blockA[KC * 13]); 
-        packed_C[13][0] = sfma(a_blockA, b0_blockB, packed_C[13][0]);
-        packed_C[13][1] = sfma(a_blockA, b1_blockB, packed_C[13][1]);
+        a_blockA = vs_bcast(packed_blockA + 13); 
+        packed_C[13][0] = vs_fma(a_blockA, b0_blockB, packed_C[13][0]);
+        packed_C[13][1] = vs_fma(a_blockA, b1_blockB, packed_C[13][1]);
 
-        packed_blockA += 1; /* next column */
-        packed_blockB += NC; /* next 32 elements*/
+        packed_blockA += 14; /* next column */
+        packed_blockB += 32; /* next row */
     }
+    vs_t alpha_v = vs_set1(alpha);
+    vs_t beta_v  = vs_set1(beta);
     for(int r = 0; r < m; r++) {
-        _mm512_mask_storeu_ps(&C[r * N + 0], packed_mask_0, packed_C[r][0]);
-        _mm512_mask_storeu_ps(&C[r * N + 16], packed_mask_1, packed_C[r][1]);
+        float* C_r = &C[((C_rows != NULL) ? C_rows[r] : r) * ldc];
+        packed_C[r][0] = vs_mul(alpha_v, packed_C[r][0]);
+        packed_C[r][1] = vs_mul(alpha_v, packed_C[r][1]);
+        if(beta != 0) {
+            packed_C[r][0] = vs_fma(beta_v, vs_maskz_loadu(packed_mask_0, &C_r[0]),  packed_C[r][0]);
+            packed_C[r][1] = vs_fma(beta_v, vs_maskz_loadu(packed_mask_1, &C_r[16]), packed_C[r][1]);
+        }
+        if(epi != NULL) {
+            packed_C[r][0] = vs_epilogue(epi, packed_C[r][0], r, 0,  packed_mask_0);
+            packed_C[r][1] = vs_epilogue(epi, packed_C[r][1], r, 16, packed_mask_1);
+        }
+        vs_mask_storeu(&C_r[0],  packed_mask_0, packed_C[r][0]);
+        vs_mask_storeu(&C_r[16], packed_mask_1, packed_C[r][1]);
     }
 #elif INSTLEVEL >= 6 /* AVX, AVX2 */ /* 6x16 kernel */
-    __m256 packed_C[6][2]; /* 6x16 */
-    __m256 a_blockA, b0_blockB, b1_blockB;
-    __m256i packed_mask[2];
-
-    static int32_t mask[32] __attribute__((aligned(32))) = {
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
-    };
-
-    packed_mask[0] = _mm256_loadu_si256((__m256i_u*)&mask[16 - n + 0]);
-    packed_mask[1] = _mm256_loadu_si256((__m256i_u*)&mask[16 - n + 8]);
-    
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = _mm256_maskload_ps(&C[r * N + 0], packed_mask[0]);
-        packed_C[r][1] = _mm256_maskload_ps(&C[r * N + 8], packed_mask[1]);
+    vs_t packed_C[6][2]; /* 6x16 */
+    vs_t a_blockA, b0_blockB, b1_blockB;
+
+    for (int r = 0; r < 6; r++) {
+        packed_C[r][0] = vs_zero();
+        packed_C[r][1] = vs_zero();
     }
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm256_loadu_ps(packed_blockB + 0);
-        b1_blockB = _mm256_loadu_ps(packed_blockB + 8);
+        b0_blockB = vs_loadu(packed_blockB + 0);
+        b1_blockB = vs_loadu(packed_blockB + 8);
         
-        a_blockA = _mm256_broadcast_ss(packed_blockA + (KC * 0)); 
-        packed_C[0][0] = sfma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = sfma(a_blockA, b1_blockB, packed_C[0][1]);
+        a_blockA = vs_bcast(packed_blockA + 0); 
+        packed_C[0][0] = vs_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vs_fma(a_blockA, b1_blockB, packed_C[0][1]);
 
-        a_blockA = _mm256_broadcast_ss(packed_blockA + (KC * 1)); 
-        packed_C[1][0] = sfma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = sfma(a_blockA, b1_blockB, packed_C[1][1]);
+        a_blockA = vs_bcast(packed_blockA + 1); 
+        packed_C[1][0] = vs_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vs_fma(a_blockA, b1_blockB, packed_C[1][1]);
 
-        a_blockA = _mm256_broadcast_ss(packed_blockA + (KC * 2)); 
-        packed_C[2][0] = sfma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = sfma(a_blockA, b1_blockB, packed_C[2][1]);
+        a_blockA = vs_bcast(packed_blockA + 2); 
+        packed_C[2][0] = vs_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vs_fma(a_blockA, b1_blockB, packed_C[2][1]);
 
-        a_blockA = _mm256_broadcast_ss(packed_blockA + (KC * 3)); 
-        packed_C[3][0] = sfma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = sfma(a_blockA, b1_blockB, packed_C[3][1]);
+        a_blockA = vs_bcast(packed_blockA + 3); 
+        packed_C[3][0] = vs_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vs_fma(a_blockA, b1_blockB, packed_C[3][1]);
 
-        a_blockA = _mm256_broadcast_ss(packed_blockA + (KC * 4)); 
-        packed_C[4][0] = sfma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = sfma(a_blockA, b1_blockB, packed_C[4][1]);
+        a_blockA = vs_bcast(packed_blockA + 4); 
+        packed_C[4][0] = vs_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vs_fma(a_blockA, b1_blockB, packed_C[4][1]);
 
-        a_blockA = _mm256_broadcast_ss(packed_blockA + (KC * 5)); 
-        packed_C[5][0] = sfma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = sfma(a_blockA, b1_blockB, packed_C[5][1]);
+        a_blockA = vs_bcast(packed_blockA + 5); 
+        packed_C[5][0] = vs_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vs_fma(a_blockA, b1_blockB, packed_C[5][1]);
 
-        packed_blockA += 1; /* next column */
-        packed_blockB += NC; /* next 16 elements*/
+        packed_blockA += 6;  /* next column */
+        packed_blockB += 16; /* next row */
     }
+    vs_t alpha_v = vs_set1(alpha);
+    vs_t beta_v  = vs_set1(beta);
+    if(m == 6 && n == 16) {    /* full tile, no masking */
+        for(int r = 0; r < 6; r++) {
+            float* C_r = &C[((C_rows != NULL) ? C_rows[r] : r) * ldc];
+            packed_C[r][0] = vs_mul(alpha_v, packed_C[r][0]);
+            packed_C[r][1] = vs_mul(alpha_v, packed_C[r][1]);
+            if(beta != 0) {
+                packed_C[r][0] = vs_fma(beta_v, vs_loadu(&C_r[0]), packed_C[r][0]);
+                packed_C[r][1] = vs_fma(beta_v, vs_loadu(&C_r[8]), packed_C[r][1]);
+            }
+            if(epi != NULL) {
+                packed_C[r][0] = vs_epilogue(epi, packed_C[r][0], r, 0, vs_mask(8));
+                packed_C[r][1] = vs_epilogue(epi, packed_C[r][1], r, 8, vs_mask(8));
+            }
+            vs_storeu(&C_r[0], packed_C[r][0]);
+            vs_storeu(&C_r[8], packed_C[r][1]);
+        }
+        return;
+    }
+
+    vs_mask_t packed_mask[2];
+    packed_mask[0] = vs_mask(n);
+    packed_mask[1] = vs_mask(n - 8);
+
     for(int r = 0; r < m; r++) {
-        _mm256_maskstore_ps(&C[r * N + 0], packed_mask[0], packed_C[r][0]);
-        _mm256_maskstore_ps(&C[r * N + 8], packed_mask[1], packed_C[r][1]);
+        float* C_r = &C[((C_rows != NULL) ? C_rows[r] : r) * ldc];
+        packed_C[r][0] = vs_mul(alpha_v, packed_C[r][0]);
+        packed_C[r][1] = vs_mul(alpha_v, packed_C[r][1]);
+        if(beta != 0) {
+            packed_C[r][0] = vs_fma(beta_v, vs_maskz_loadu(packed_mask[0], &C_r[0]), packed_C[r][0]);
+            packed_C[r][1] = vs_fma(beta_v, vs_maskz_loadu(packed_mask[1], &C_r[8]), packed_C[r][1]);
+        }
+        if(epi != NULL) {
+            packed_C[r][0] = vs_epilogue(epi, packed_C[r][0], r, 0, packed_mask[0]);
+            packed_C[r][1] = vs_epilogue(epi, packed_C[r][1], r, 8, packed_mask[1]);
+        }
+        vs_mask_storeu(&C_r[0], packed_mask[0], packed_C[r][0]);
+        vs_mask_storeu(&C_r[8], packed_mask[1], packed_C[r][1]);
     }
 #endif // skernel
 }
 
 void dkernel(const double* packed_blockA, const double* packed_blockB, double* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N) {
+              const int m, const int kc,
+              const int n, const int ldc,
+              const double alpha, const double beta, const gemm_epilogue_t* epi) {
 #if INSTLEVEL >= 8 /* AVX512F */ /* 6x16 kernel */
-    __m512d packed_C[6][4]; /* 6x16 */
-    __m512d a_blockA, b0_blockB, b1_blockB;
-    __mmask16 packed_mask_0 = (n < 8)  ? 0xFFFF >> (8 - n)  : 0xFFFF;
-    __mmask16 packed_mask_1 = (n >= 8) ? 0xFFFF >> (16 - n) : 0x0000;
-
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = _mm512_maskz_loadu_pd(packed_mask_0, &C[r * N + 0]);
-        packed_C[r][1] = _mm512_maskz_loadu_pd(packed_mask_1, &C[r * N + 8]);
+    vd_t packed_C[6][4]; /* 6x16 */
+    vd_t a_blockA, b0_blockB, b1_blockB;
+    vd_mask_t packed_mask_0 = vd_mask(n);
+    vd_mask_t packed_mask_1 = vd_mask(n - 8);
+
+    for (int r = 0; r < 6; r++) {
+        packed_C[r][0] = vd_zero();
+        packed_C[r][1] = vd_zero();
     }
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm512_load_pd(packed_blockB + 0);
-        b1_blockB = _mm512_load_pd(packed_blockB + 8);
+        b0_blockB = vd_load(packed_blockB + 0);
+        b1_blockB = vd_load(packed_blockB + 8);
 
-        a_blockA = _mm512_set1_pd(packed_blockA[KC * 0]); 
-        packed_C[0][0] = dfma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = dfma(a_blockA, b1_blockB, packed_C[0][1]);
+        a_blockA = vd_bcast(packed_blockA + 0); 
+        packed_C[0][0] = vd_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vd_fma(a_blockA, b1_blockB, packed_C[0][1]);
 
-        a_blockA = _mm512_set1_pd(packed_blockA[KC * 1]); 
-        packed_C[1][0] = dfma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = dfma(a_blockA, b1_blockB, packed_C[1][1]);
+        a_blockA = vd_bcast(packed_blockA + 1); 
+        packed_C[1][0] = vd_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vd_fma(a_blockA, b1_blockB, packed_C[1][1]);
         
-        a_blockA = _mm512_set1_pd(packed_blockA[KC * 2]); 
-        packed_C[2][0] = dfma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = dfma(a_blockA, b1_blockB, packed_C[2][1]);
+        a_blockA = vd_bcast(packed_blockA + 2); 
+        packed_C[2][0] = vd_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vd_fma(a_blockA, b1_blockB, packed_C[2][1]);
 
-        a_blockA = _mm512_set1_pd(packed_blockA[KC * 3]); 
-        packed_C[3][0] = dfma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = dfma(a_blockA, b1_blockB, packed_C[3][1]);
+        a_blockA = vd_bcast(packed_blockA + 3); 
+        packed_C[3][0] = vd_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vd_fma(a_blockA, b1_blockB, packed_C[3][1]);
 
-        a_blockA = _mm512_set1_pd(packed_blockA[KC * 4]); 
-        packed_C[4][0] = dfma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = dfma(a_blockA, b1_blockB, packed_C[4][1]);
+        a_blockA = vd_bcast(packed_blockA + 4); 
+        packed_C[4][0] = vd_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vd_fma(a_blockA, b1_blockB, packed_C[4][1]);
 
-        a_blockA = _mm512_set1_pd(packed_blockA[KC * 5]); 
-        packed_C[5][0] = dfma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = dfma(a_blockA, b1_blockB, packed_C[5][1]);
+        a_blockA = vd_bcast(packed_blockA + 5); 
+        packed_C[5][0] = vd_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vd_fma(a_blockA, b1_blockB, packed_C[5][1]);
 
-        packed_blockA += 1;  /* next column */
-        packed_blockB += NC; /* next 16 elements*/
+        packed_blockA += 6;  /* next column */
+        packed_blockB += 16; /* next row */
     }
+    vd_t alpha_v = vd_set1(alpha);
+    vd_t beta_v  = vd_set1(beta);
     for(int r = 0; r < m; r++) {
-        _mm512_mask_storeu_pd(&C[r * N + 0], packed_mask_0, packed_C[r][0]);
-        _mm512_mask_storeu_pd(&C[r * N + 8], packed_mask_1, packed_C[r][1]);
+        packed_C[r][0] = vd_mul(alpha_v, packed_C[r][0]);
+        packed_C[r][1] = vd_mul(alpha_v, packed_C[r][1]);
+        if(beta != 0) {
+            packed_C[r][0] = vd_fma(beta_v, vd_maskz_loadu(packed_mask_0, &C[r * ldc + 0]), packed_C[r][0]);
+            packed_C[r][1] = vd_fma(beta_v, vd_maskz_loadu(packed_mask_1, &C[r * ldc + 8]), packed_C[r][1]);
+        }
+        if(epi != NULL) {
+            packed_C[r][0] = vd_epilogue(epi, packed_C[r][0], r, 0, packed_mask_0);
+            packed_C[r][1] = vd_epilogue(epi, packed_C[r][1], r, 8, packed_mask_1);
+        }
+        vd_mask_storeu(&C[r * ldc + 0], packed_mask_0, packed_C[r][0]);
+        vd_mask_storeu(&C[r * ldc + 8], packed_mask_1, packed_C[r][1]);
     }
 #elif INSTLEVEL >= 6 /* AVX, AVX2 */ /* 6x8 kernel */
-    __m256d packed_C[6][2]; /* 6x8 */
-    __m256d a_blockA, b0_blockB, b1_blockB;
-    __m256i packed_mask[2];
+    vd_t packed_C[6][2]; /* 6x8 */
+    vd_t a_blockA, b0_blockB, b1_blockB;
 
-    static int64_t mask[16] = {
-        -1, -1, -1, -1, -1, -1, -1, -1, 
-        0,  0,  0,  0,  0,  0,  0,  0
-    };
-
-    packed_mask[0] = _mm256_loadu_si256((__m256i_u*)&mask[8 - n + 0]);
-    packed_mask[1] = _mm256_loadu_si256((__m256i_u*)&mask[8 - n + 4]);
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = _mm256_maskload_pd(&C[r * N + 0], packed_mask[0]);
-        packed_C[r][1] = _mm256_maskload_pd(&C[r * N + 4], packed_mask[1]);
+    for (int r = 0; r < 6; r++) {
+        packed_C[r][0] = vd_zero();
+        packed_C[r][1] = vd_zero();
     }
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm256_loadu_pd(packed_blockB + 0);
-        b1_blockB = _mm256_loadu_pd(packed_blockB + 4);
+        b0_blockB = vd_loadu(packed_blockB + 0);
+        b1_blockB = vd_loadu(packed_blockB + 4);
         
-        a_blockA = _mm256_broadcast_sd(packed_blockA + (KC * 0));
-        packed_C[0][0] = dfma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = dfma(a_blockA, b1_blockB, packed_C[0][1]);
+        a_blockA = vd_bcast(packed_blockA + 0);
+        packed_C[0][0] = vd_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vd_fma(a_blockA, b1_blockB, packed_C[0][1]);
 
-        a_blockA = _mm256_broadcast_sd(packed_blockA + (KC * 1));
-        packed_C[1][0] = dfma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = dfma(a_blockA, b1_blockB, packed_C[1][1]);
+        a_blockA = vd_bcast(packed_blockA + 1);
+        packed_C[1][0] = vd_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vd_fma(a_blockA, b1_blockB, packed_C[1][1]);
 
-        a_blockA = _mm256_broadcast_sd(packed_blockA + (KC * 2));
-        packed_C[2][0] = dfma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = dfma(a_blockA, b1_blockB, packed_C[2][1]);
+        a_blockA = vd_bcast(packed_blockA + 2);
+        packed_C[2][0] = vd_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vd_fma(a_blockA, b1_blockB, packed_C[2][1]);
 
-        a_blockA = _mm256_broadcast_sd(packed_blockA + (KC * 3));
-        packed_C[3][0] = dfma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = dfma(a_blockA, b1_blockB, packed_C[3][1]);
+        a_blockA = vd_bcast(packed_blockA + 3);
+        packed_C[3][0] = vd_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vd_fma(a_blockA, b1_blockB, packed_C[3][1]);
 
-        a_blockA = _mm256_broadcast_sd(packed_blockA + (KC * 4));
-        packed_C[4][0] = dfma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = dfma(a_blockA, b1_blockB, packed_C[4][1]);
+        a_blockA = vd_bcast(packed_blockA + 4);
+        packed_C[4][0] = vd_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vd_fma(a_blockA, b1_blockB, packed_C[4][1]);
 
-        a_blockA = _mm256_broadcast_sd(packed_blockA + (KC * 5));
-        packed_C[5][0] = dfma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = dfma(a_blockA, b1_blockB, packed_C[5][1]);
+        a_blockA = vd_bcast(packed_blockA + 5);
+        packed_C[5][0] = vd_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vd_fma(a_blockA, b1_blockB, packed_C[5][1]);
 
-        packed_blockA += 1; /* next column */
-        packed_blockB += NC; /* next 16 elements*/
+        packed_blockA += 6; /* next column */
+        packed_blockB += 8; /* next row */
     }
+    vd_t alpha_v = vd_set1(alpha);
+    vd_t beta_v  = vd_set1(beta);
+    if(m == 6 && n == 8) {    /* full tile, no masking */
+        for(int r = 0; r < 6; r++) {
+            packed_C[r][0] = vd_mul(alpha_v, packed_C[r][0]);
+            packed_C[r][1] = vd_mul(alpha_v, packed_C[r][1]);
+            if(beta != 0) {
+                packed_C[r][0] = vd_fma(beta_v, vd_loadu(&C[r * ldc + 0]), packed_C[r][0]);
+                packed_C[r][1] = vd_fma(beta_v, vd_loadu(&C[r * ldc + 4]), packed_C[r][1]);
+            }
+            if(epi != NULL) {
+                packed_C[r][0] = vd_epilogue(epi, packed_C[r][0], r, 0, vd_mask(4));
+                packed_C[r][1] = vd_epilogue(epi, packed_C[r][1], r, 4, vd_mask(4));
+            }
+            vd_storeu(&C[r * ldc + 0], packed_C[r][0]);
+            vd_storeu(&C[r * ldc + 4], packed_C[r][1]);
+        }
+        return;
+    }
+
+    vd_mask_t packed_mask[2];
+    packed_mask[0] = vd_mask(n);
+    packed_mask[1] = vd_mask(n - 4);
+
     for(int r = 0; r < m; r++) {
-        _mm256_maskstore_pd(&C[r * N + 0], packed_mask[0], packed_C[r][0]);
-        _mm256_maskstore_pd(&C[r * N + 4], packed_mask[1], packed_C[r][1]);
+        packed_C[r][0] = vd_mul(alpha_v, packed_C[r][0]);
+        packed_C[r][1] = vd_mul(alpha_v, packed_C[r][1]);
+        if(beta != 0) {
+            packed_C[r][0] = vd_fma(beta_v, vd_maskz_loadu(packed_mask[0], &C[r * ldc + 0]), packed_C[r][0]);
+            packed_C[r][1] = vd_fma(beta_v, vd_maskz_loadu(packed_mask[1], &C[r * ldc + 4]), packed_C[r][1]);
+        }
+        if(epi != NULL) {
+            packed_C[r][0] = vd_epilogue(epi, packed_C[r][0], r, 0, packed_mask[0]);
+            packed_C[r][1] = vd_epilogue(epi, packed_C[r][1], r, 4, packed_mask[1]);
+        }
+        vd_mask_storeu(&C[r * ldc + 0], packed_mask[0], packed_C[r][0]);
+        vd_mask_storeu(&C[r * ldc + 4], packed_mask[1], packed_C[r][1]);
     }
 #endif // dkernel
 }
 
 void ikernel(const int* packed_blockA, const int* packed_blockB, int* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N) {
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int alpha, const int beta) {
 #if INSTLEVEL >= 8      /* AVX512F */   /* 14x32 kernel */
-    __m512i packed_C[14][2]; /* 14x32 */
-    __m512i a_blockA, b0_blockB, b1_blockB;
-    __mmask16 packed_mask_0 = (n < 16)  ? 0xFFFF >> (16 - n) : 0xFFFF;
-    __mmask16 packed_mask_1 = (n >= 16) ? 0xFFFF >> (32 - n) : 0x0000;
-
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = _mm512_maskz_loadu_epi32(packed_mask_0, &C[r * N + 0]);
-        packed_C[r][1] = _mm512_maskz_loadu_epi32(packed_mask_1, &C[r * N + 16]);
+    vi_t packed_C[14][2]; /* 14x32 */
+    vi_t a_blockA, b0_blockB, b1_blockB;
+    vi_mask_t packed_mask_0 = vi_mask(n);
+    vi_mask_t packed_mask_1 = vi_mask(n - 16);
+
+    for (int r = 0; r < 14; r++) {
+        packed_C[r][0] = vi_zero();
+        packed_C[r][1] = vi_zero();
     }
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm512_load_epi32(packed_blockB + 0);
-        b1_blockB = _mm512_load_epi32(packed_blockB + 16);
+        b0_blockB = vi_load(packed_blockB + 0);
+        b1_blockB = vi_load(packed_blockB + 16);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 0]); 
-        packed_C[0][0] = ifma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = ifma(a_blockA, b1_blockB, packed_C[0][1]);
+        a_blockA = vi_bcast(packed_blockA + 0); 
+        packed_C[0][0] = vi_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vi_fma(a_blockA, b1_blockB, packed_C[0][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 1]);  
-        packed_C[1][0] = ifma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = ifma(a_blockA, b1_blockB, packed_C[1][1]);
+        a_blockA = vi_bcast(packed_blockA + 1);  
+        packed_C[1][0] = vi_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vi_fma(a_blockA, b1_blockB, packed_C[1][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 2]); 
-        packed_C[2][0] = ifma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = ifma(a_blockA, b1_blockB, packed_C[2][1]);
+        a_blockA = vi_bcast(packed_blockA + 2); 
+        packed_C[2][0] = vi_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vi_fma(a_blockA, b1_blockB, packed_C[2][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 3]); 
-        packed_C[3][0] = ifma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = ifma(a_blockA, b1_blockB, packed_C[3][1]);
+        a_blockA = vi_bcast(packed_blockA + 3); 
+        packed_C[3][0] = vi_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vi_fma(a_blockA, b1_blockB, packed_C[3][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 4]); 
-        packed_C[4][0] = ifma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = ifma(a_blockA, b1_blockB, packed_C[4][1]);
+        a_blockA = vi_bcast(packed_blockA + 4); 
+        packed_C[4][0] = vi_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vi_fma(a_blockA, b1_blockB, packed_C[4][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 5]); 
-        packed_C[5][0] = ifma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = ifma(a_blockA, b1_blockB, packed_C[5][1]);
+        a_blockA = vi_bcast(packed_blockA + 5); 
+        packed_C[5][0] = vi_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vi_fma(a_blockA, b1_blockB, packed_C[5][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 6]); 
-        packed_C[6][0] = ifma(a_blockA, b0_blockB, packed_C[6][0]);
-        packed_C[6][1] = ifma(a_blockA, b1_blockB, packed_C[6][1]);
+        a_blockA = vi_bcast(packed_blockA + 6); 
+        packed_C[6][0] = vi_fma(a_blockA, b0_blockB, packed_C[6][0]);
+        packed_C[6][1] = vi_fma(a_blockA, b1_blockB, packed_C[6][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 7]); 
-        packed_C[7][0] = ifma(a_blockA, b0_blockB, packed_C[7][0]);
-        packed_C[7][1] = ifma(a_blockA, b1_blockB, packed_C[7][1]);
+        a_blockA = vi_bcast(packed_blockA + 7); 
+        packed_C[7][0] = vi_fma(a_blockA, b0_blockB, packed_C[7][0]);
+        packed_C[7][1] = vi_fma(a_blockA, b1_blockB, packed_C[7][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 8]); 
-        packed_C[8][0] = ifma(a_blockA, b0_blockB,packed_C[8][0]);
-        packed_C[8][1] = ifma(a_blockA, b1_blockB,packed_C[8][1]);
+        a_blockA = vi_bcast(packed_blockA + 8); 
+        packed_C[8][0] = vi_fma(a_blockA, b0_blockB,packed_C[8][0]);
+        packed_C[8][1] = vi_fma(a_blockA, b1_blockB,packed_C[8][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 9]); 
-        packed_C[9][0] = ifma(a_blockA, b0_blockB,packed_C[9][0]);
-        packed_C[9][1] = ifma(a_blockA, b1_blockB,packed_C[9][1]);
+        a_blockA = vi_bcast(packed_blockA + 9); 
+        packed_C[9][0] = vi_fma(a_blockA, b0_blockB,packed_C[9][0]);
+        packed_C[9][1] = vi_fma(a_blockA, b1_blockB,packed_C[9][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 10]); 
-        packed_C[10][0] = ifma(a_blockA, b0_blockB,packed_C[10][0]);
-        packed_C[10][1] = ifma(a_blockA, b1_blockB,packed_C[10][1]);
+        a_blockA = vi_bcast(packed_blockA + 10); 
+        packed_C[10][0] = vi_fma(a_blockA, b0_blockB,packed_C[10][0]);
+        packed_C[10][1] = vi_fma(a_blockA, b1_blockB,packed_C[10][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 11]); 
-        packed_C[11][0] = ifma(a_blockA, b0_blockB,packed_C[11][0]);
-        packed_C[11][1] = ifma(a_blockA, b1_blockB,packed_C[11][1]);
+        a_blockA = vi_bcast(packed_blockA + 11); 
+        packed_C[11][0] = vi_fma(a_blockA, b0_blockB,packed_C[11][0]);
+        packed_C[11][1] = vi_fma(a_blockA, b1_blockB,packed_C[11][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 12]); 
-        packed_C[12][0] = ifma(a_blockA, b0_blockB,packed_C[12][0]);
-        packed_C[12][1] = ifma(a_blockA, b1_blockB,packed_C[12][1]);
+        a_blockA = vi_bcast(packed_blockA + 12); 
+        packed_C[12][0] = vi_fma(a_blockA, b0_blockB,packed_C[12][0]);
+        packed_C[12][1] = vi_fma(a_blockA, b1_blockB,packed_C[12][1]);
 
-        a_blockA = _mm512_set1_epi32(packed_blockA[KC * 13]); 
-        packed_C[13][0] = ifma(a_blockA, b0_blockB,packed_C[13][0]);
-        packed_C[13][1] = ifma(a_blockA, b1_blockB,packed_C[13][1]);
+        a_blockA = vi_bcast(packed_blockA + 13); 
+        packed_C[13][0] = vi_fma(a_blockA, b0_blockB,packed_C[13][0]);
+        packed_C[13][1] = vi_fma(a_blockA, b1_blockB,packed_C[13][1]);
 
-        packed_blockA += 1;     /* next column */
-        packed_blockB += NC;    /* next 32 elements*/
+        packed_blockA += 14;    /* next column */
+        packed_blockB += 32;    /* next row */
     }
+    vi_t alpha_v = vi_set1(alpha);
+    vi_t beta_v  = vi_set1(beta);
     for(int r = 0; r < m; r++) {
-        _mm512_mask_storeu_epi32(&C[r * N + 0],  packed_mask_0, packed_C[r][0]);
-        _mm512_mask_storeu_epi32(&C[r * N + 16], packed_mask_1, packed_C[r][1]);
+        packed_C[r][0] = vi_mul(alpha_v, packed_C[r][0]);
+        packed_C[r][1] = vi_mul(alpha_v, packed_C[r][1]);
+        if(beta != 0) {
+            packed_C[r][0] = vi_fma(beta_v, vi_maskz_loadu(packed_mask_0, &C[r * ldc + 0]),  packed_C[r][0]);
+            packed_C[r][1] = vi_fma(beta_v, vi_maskz_loadu(packed_mask_1, &C[r * ldc + 16]), packed_C[r][1]);
+        }
+        vi_mask_storeu(&C[r * ldc + 0],  packed_mask_0, packed_C[r][0]);
+        vi_mask_storeu(&C[r * ldc + 16], packed_mask_1, packed_C[r][1]);
     }
 #elif INSTLEVEL >= 7    /* AVX2 */      /* 6x16 kernel */
-    __m256i packed_C[6][2]; /* 6x16 */
-    __m256i a_blockA, b0_blockB, b1_blockB;
-    __m256i packed_mask[2];
-
-    static int32_t mask[32] __attribute__((aligned(32))) = {
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
-    };
-    
-    packed_mask[0] = _mm256_loadu_si256((__m256i_u*)&mask[16 - n + 0]);
-    packed_mask[1] = _mm256_loadu_si256((__m256i_u*)&mask[16 - n + 8]);
-    
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = _mm256_maskload_epi32(&C[r * N + 0], packed_mask[0]);
-        packed_C[r][1] = _mm256_maskload_epi32(&C[r * N + 8], packed_mask[1]);
+    vi_t packed_C[6][2]; /* 6x16 */
+    vi_t a_blockA, b0_blockB, b1_blockB;
+
+    for (int r = 0; r < 6; r++) {
+        packed_C[r][0] = vi_zero();
+        packed_C[r][1] = vi_zero();
     }
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm256_loadu_si256((__m256i_u*)(packed_blockB + 0));
-        b1_blockB = _mm256_loadu_si256((__m256i_u*)(packed_blockB + 8));
+        b0_blockB = vi_loadu(packed_blockB + 0);
+        b1_blockB = vi_loadu(packed_blockB + 8);
 
-        a_blockA = _mm256_set1_epi32(packed_blockA[KC * 0]);
-        packed_C[0][0] = ifma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = ifma(a_blockA, b1_blockB, packed_C[0][1]);
+        a_blockA = vi_bcast(packed_blockA + 0);
+        packed_C[0][0] = vi_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vi_fma(a_blockA, b1_blockB, packed_C[0][1]);
 
-        a_blockA = _mm256_set1_epi32(packed_blockA[KC * 1]);
-        packed_C[1][0] = ifma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = ifma(a_blockA, b1_blockB, packed_C[1][1]);
+        a_blockA = vi_bcast(packed_blockA + 1);
+        packed_C[1][0] = vi_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vi_fma(a_blockA, b1_blockB, packed_C[1][1]);
 
-        a_blockA = _mm256_set1_epi32(packed_blockA[KC * 2]);
-        packed_C[2][0] = ifma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = ifma(a_blockA, b1_blockB, packed_C[2][1]);
+        a_blockA = vi_bcast(packed_blockA + 2);
+        packed_C[2][0] = vi_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vi_fma(a_blockA, b1_blockB, packed_C[2][1]);
 
-        a_blockA = _mm256_set1_epi32(packed_blockA[KC * 3]);
-        packed_C[3][0] = ifma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = ifma(a_blockA, b1_blockB, packed_C[3][1]);
+        a_blockA = vi_bcast(packed_blockA + 3);
+        packed_C[3][0] = vi_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vi_fma(a_blockA, b1_blockB, packed_C[3][1]);
 
-        a_blockA = _mm256_set1_epi32(packed_blockA[KC * 4]);
-        packed_C[4][0] = ifma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = ifma(a_blockA, b1_blockB, packed_C[4][1]);
+        a_blockA = vi_bcast(packed_blockA + 4);
+        packed_C[4][0] = vi_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vi_fma(a_blockA, b1_blockB, packed_C[4][1]);
 
-        a_blockA = _mm256_set1_epi32(packed_blockA[KC * 5]);
-        packed_C[5][0] = ifma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = ifma(a_blockA, b1_blockB, packed_C[5][1]);
+        a_blockA = vi_bcast(packed_blockA + 5);
+        packed_C[5][0] = vi_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vi_fma(a_blockA, b1_blockB, packed_C[5][1]);
 
-        packed_blockA += 1;     /* next column */
-        packed_blockB += NC;    /* next 16 elements*/
+        packed_blockA += 6;     /* next column */
+        packed_blockB += 16;    /* next row */
     }
+    vi_t alpha_v = vi_set1(alpha);
+    vi_t beta_v  = vi_set1(beta);
+    if(m == 6 && n == 16) {    /* full tile, no masking */
+        for(int r = 0; r < 6; r++) {
+            packed_C[r][0] = vi_mul(alpha_v, packed_C[r][0]);
+            packed_C[r][1] = vi_mul(alpha_v, packed_C[r][1]);
+            if(beta != 0) {
+                packed_C[r][0] = vi_fma(beta_v, vi_loadu(&C[r * ldc + 0]), packed_C[r][0]);
+                packed_C[r][1] = vi_fma(beta_v, vi_loadu(&C[r * ldc + 8]), packed_C[r][1]);
+            }
+            vi_storeu(&C[r * ldc + 0], packed_C[r][0]);
+            vi_storeu(&C[r * ldc + 8], packed_C[r][1]);
+        }
+        return;
+    }
+
+    vi_mask_t packed_mask[2];
+    packed_mask[0] = vi_mask(n);
+    packed_mask[1] = vi_mask(n - 8);
+
     for(int r = 0; r < m; r++) {
-        _mm256_maskstore_epi32(&C[r * N + 0], packed_mask[0], packed_C[r][0]);
-        _mm256_maskstore_epi32(&C[r * N + 8], packed_mask[1], packed_C[r][1]);
+        packed_C[r][0] = vi_mul(alpha_v, packed_C[r][0]);
+        packed_C[r][1] = vi_mul(alpha_v, packed_C[r][1]);
+        if(beta != 0) {
+            packed_C[r][0] = vi_fma(beta_v, vi_maskz_loadu(packed_mask[0], &C[r * ldc + 0]), packed_C[r][0]);
+            packed_C[r][1] = vi_fma(beta_v, vi_maskz_loadu(packed_mask[1], &C[r * ldc + 8]), packed_C[r][1]);
+        }
+        vi_mask_storeu(&C[r * ldc + 0], packed_mask[0], packed_C[r][0]);
+        vi_mask_storeu(&C[r * ldc + 8], packed_mask[1], packed_C[r][1]);
     }
 #elif INSTLEVEL >= 6 /* AVX */
-    __m128i packed_C[6][4]; /* 6x16 */
-    __m128i a_blockA;
-    __m128i b0_blockB, b1_blockB, b2_blockB, b3_blockB;
-    int8_t mask0, mask1, mask2, mask3;
-    mask0 = (n < 4)   ? 0xF >> (4 - n)  : 0xF;
-    mask1 = (n >= 4)  ? (n >= 8)  ? 0xF : 0xF >> (8 - n)  : 0x0;
-    mask2 = (n >= 8)  ? (n >= 12) ? 0xF : 0xF >> (12 - n) : 0x0;
-    mask3 = (n >= 12) ? 0xF >> (16 - n) : 0x0;
+    vi_t packed_C[6][4]; /* 6x16 */
+    vi_t a_blockA;
+    vi_t b0_blockB, b1_blockB, b2_blockB, b3_blockB;
 
-    for (int r = 0; r < m; r++) {
-        packed_C[r][0] = maskload(&C[r * N + 0],  mask0);
-        packed_C[r][1] = maskload(&C[r * N + 4],  mask1);
-        packed_C[r][2] = maskload(&C[r * N + 8],  mask2);
-        packed_C[r][3] = maskload(&C[r * N + 12], mask3);
-    }
+    for (int r = 0; r < 6; r++)
+        for(int c = 0; c < 4; c++)
+            packed_C[r][c] = vi_zero();
     for(int k = 0; k < kc; k++) {
-        b0_blockB = _mm_load_si128((__m128i_u*)(packed_blockB + 0));
-        b1_blockB = _mm_load_si128((__m128i_u*)(packed_blockB + 4));
-        b2_blockB = _mm_load_si128((__m128i_u*)(packed_blockB + 8));
-        b3_blockB = _mm_load_si128((__m128i_u*)(packed_blockB + 12));
-
-        a_blockA = _mm_set1_epi32(packed_blockA[KC * 0]);
-        packed_C[0][0] = ifma(a_blockA, b0_blockB, packed_C[0][0]);
-        packed_C[0][1] = ifma(a_blockA, b1_blockB, packed_C[0][1]);
-        packed_C[0][2] = ifma(a_blockA, b2_blockB, packed_C[0][2]);
-        packed_C[0][3] = ifma(a_blockA, b3_blockB, packed_C[0][3]);
-
-        a_blockA = _mm_set1_epi32(packed_blockA[KC * 1]);
-        packed_C[1][0] = ifma(a_blockA, b0_blockB, packed_C[1][0]);
-        packed_C[1][1] = ifma(a_blockA, b1_blockB, packed_C[1][1]);
-        packed_C[1][2] = ifma(a_blockA, b2_blockB, packed_C[1][2]);
-        packed_C[1][3] = ifma(a_blockA, b3_blockB, packed_C[1][3]);
-
-        a_blockA = _mm_set1_epi32(packed_blockA[KC * 2]);
-        packed_C[2][0] = ifma(a_blockA, b0_blockB, packed_C[2][0]);
-        packed_C[2][1] = ifma(a_blockA, b1_blockB, packed_C[2][1]);
-        packed_C[2][2] = ifma(a_blockA, b2_blockB, packed_C[2][2]);
-        packed_C[2][3] = ifma(a_blockA, b3_blockB, packed_C[2][3]);
-
-        a_blockA = _mm_set1_epi32(packed_blockA[KC * 3]);
-        packed_C[3][0] = ifma(a_blockA, b0_blockB, packed_C[3][0]);
-        packed_C[3][1] = ifma(a_blockA, b1_blockB, packed_C[3][1]);
-        packed_C[3][2] = ifma(a_blockA, b2_blockB, packed_C[3][2]);
-        packed_C[3][3] = ifma(a_blockA, b3_blockB, packed_C[3][3]);
-
-        a_blockA = _mm_set1_epi32(packed_blockA[KC * 4]);
-        packed_C[4][0] = ifma(a_blockA, b0_blockB, packed_C[4][0]);
-        packed_C[4][1] = ifma(a_blockA, b1_blockB, packed_C[4][1]);
-        packed_C[4][2] = ifma(a_blockA, b2_blockB, packed_C[4][2]);
-        packed_C[4][3] = ifma(a_blockA, b3_blockB, packed_C[4][3]);
-
-        a_blockA = _mm_set1_epi32(packed_blockA[KC * 5]);
-        packed_C[5][0] = ifma(a_blockA, b0_blockB, packed_C[5][0]);
-        packed_C[5][1] = ifma(a_blockA, b1_blockB, packed_C[5][1]);
-        packed_C[5][2] = ifma(a_blockA, b2_blockB, packed_C[5][2]);
-        packed_C[5][3] = ifma(a_blockA, b3_blockB, packed_C[5][3]);
+        b0_blockB = vi_load(packed_blockB + 0);
+        b1_blockB = vi_load(packed_blockB + 4);
+        b2_blockB = vi_load(packed_blockB + 8);
+        b3_blockB = vi_load(packed_blockB + 12);
+
+        a_blockA = vi_bcast(packed_blockA + 0);
+        packed_C[0][0] = vi_fma(a_blockA, b0_blockB, packed_C[0][0]);
+        packed_C[0][1] = vi_fma(a_blockA, b1_blockB, packed_C[0][1]);
+        packed_C[0][2] = vi_fma(a_blockA, b2_blockB, packed_C[0][2]);
+        packed_C[0][3] = vi_fma(a_blockA, b3_blockB, packed_C[0][3]);
+
+        a_blockA = vi_bcast(packed_blockA + 1);
+        packed_C[1][0] = vi_fma(a_blockA, b0_blockB, packed_C[1][0]);
+        packed_C[1][1] = vi_fma(a_blockA, b1_blockB, packed_C[1][1]);
+        packed_C[1][2] = vi_fma(a_blockA, b2_blockB, packed_C[1][2]);
+        packed_C[1][3] = vi_fma(a_blockA, b3_blockB, packed_C[1][3]);
+
+        a_blockA = vi_bcast(packed_blockA + 2);
+        packed_C[2][0] = vi_fma(a_blockA, b0_blockB, packed_C[2][0]);
+        packed_C[2][1] = vi_fma(a_blockA, b1_blockB, packed_C[2][1]);
+        packed_C[2][2] = vi_fma(a_blockA, b2_blockB, packed_C[2][2]);
+        packed_C[2][3] = vi_fma(a_blockA, b3_blockB, packed_C[2][3]);
+
+        a_blockA = vi_bcast(packed_blockA + 3);
+        packed_C[3][0] = vi_fma(a_blockA, b0_blockB, packed_C[3][0]);
+        packed_C[3][1] = vi_fma(a_blockA, b1_blockB, packed_C[3][1]);
+        packed_C[3][2] = vi_fma(a_blockA, b2_blockB, packed_C[3][2]);
+        packed_C[3][3] = vi_fma(a_blockA, b3_blockB, packed_C[3][3]);
+
+        a_blockA = vi_bcast(packed_blockA + 4);
+        packed_C[4][0] = vi_fma(a_blockA, b0_blockB, packed_C[4][0]);
+        packed_C[4][1] = vi_fma(a_blockA, b1_blockB, packed_C[4][1]);
+        packed_C[4][2] = vi_fma(a_blockA, b2_blockB, packed_C[4][2]);
+        packed_C[4][3] = vi_fma(a_blockA, b3_blockB, packed_C[4][3]);
+
+        a_blockA = vi_bcast(packed_blockA + 5);
+        packed_C[5][0] = vi_fma(a_blockA, b0_blockB, packed_C[5][0]);
+        packed_C[5][1] = vi_fma(a_blockA, b1_blockB, packed_C[5][1]);
+        packed_C[5][2] = vi_fma(a_blockA, b2_blockB, packed_C[5][2]);
+        packed_C[5][3] = vi_fma(a_blockA, b3_blockB, packed_C[5][3]);
         
-        packed_blockA += 1;     /* next column */
-        packed_blockB += NC;    /* next 16 elements*/
+        packed_blockA += 6;     /* next column */
+        packed_blockB += 16;    /* next row */
     }
+    vi_t alpha_v = vi_set1(alpha);
+    vi_t beta_v  = vi_set1(beta);
+    for (int r = 0; r < 6; r++)
+        for(int c = 0; c < 4; c++)
+            packed_C[r][c] = vi_mul(alpha_v, packed_C[r][c]);
+
+    if(m == 6 && n == 16) {    /* full tile, no masking */
+        for (int r = 0; r < 6; r++) {
+            for(int c = 0; c < 4; c++) {
+                if(beta != 0)
+                    packed_C[r][c] = vi_fma(beta_v, vi_loadu(&C[r * ldc + c * 4]), packed_C[r][c]);
+                vi_storeu(&C[r * ldc + c * 4], packed_C[r][c]);
+            }
+        }
+        return;
+    }
+
+    vi_mask_t packed_mask[4];
+    for(int c = 0; c < 4; c++)
+        packed_mask[c] = vi_mask(n - c * 4);
+
     for (int r = 0; r < m; r++) {
-        maskstore(&C[r * N + 0],  mask0, packed_C[r][0]);
-        maskstore(&C[r * N + 4],  mask1, packed_C[r][1]);
-        maskstore(&C[r * N + 8],  mask2, packed_C[r][2]);
-        maskstore(&C[r * N + 12], mask3, packed_C[r][3]);
+        for(int c = 0; c < 4; c++) {
+            if(beta != 0)
+                packed_C[r][c] = vi_fma(beta_v, vi_maskz_loadu(packed_mask[c], &C[r * ldc + c * 4]), packed_C[r][c]);
+            vi_mask_storeu(&C[r * ldc + c * 4], packed_mask[c], packed_C[r][c]);
+        }
     }
 #endif // ikernel
 }
 
 void hqkernel(const int16_t* packed_blockA, const int16_t* packed_blockB, int16_t* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N) {
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int16_t alpha, const int16_t beta) {
 #if INSTLEVEL >= 9      /* AVX512BW */
-    __m512i packed_C[30]; /* 30x32 */
-    __m512i a_blockA, b_blockB;
-    __mmask32 packed_mask = 0xFFFFFFFF >> (32 - n);
+    vhq_t packed_C[30]; /* 30x32 */
+    vhq_t a_blockA, b_blockB;
+    vhq_mask_t packed_mask = vhq_mask(n);
 
-    for (int r = 0; r < m; r++)
-        packed_C[r] = _mm512_maskz_loadu_epi16(packed_mask, &C[r * N]);
+    for (int r = 0; r < 30; r++)
+        packed_C[r] = vhq_zero();
     for(int k = 0; k < kc; k++) {
-        b_blockB = _mm512_loadu_epi16(packed_blockB);
+        b_blockB = vhq_loadu(packed_blockB);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 0]); 
-        packed_C[0] = _mm512_add_epi16(packed_C[0], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 0); 
+        packed_C[0] = vhq_fma(a_blockA, b_blockB, packed_C[0]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 1]); 
-        packed_C[1] = _mm512_add_epi16(packed_C[1], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 1); 
+        packed_C[1] = vhq_fma(a_blockA, b_blockB, packed_C[1]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 2]); 
-        packed_C[2] = _mm512_add_epi16(packed_C[2], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 2); 
+        packed_C[2] = vhq_fma(a_blockA, b_blockB, packed_C[2]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 3]); 
-        packed_C[3] = _mm512_add_epi16(packed_C[3], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 3); 
+        packed_C[3] = vhq_fma(a_blockA, b_blockB, packed_C[3]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 4]); 
-        packed_C[4] = _mm512_add_epi16(packed_C[4], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 4); 
+        packed_C[4] = vhq_fma(a_blockA, b_blockB, packed_C[4]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 5]); 
-        packed_C[5] = _mm512_add_epi16(packed_C[5], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 5); 
+        packed_C[5] = vhq_fma(a_blockA, b_blockB, packed_C[5]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 6]); 
-        packed_C[6] = _mm512_add_epi16(packed_C[6], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 6); 
+        packed_C[6] = vhq_fma(a_blockA, b_blockB, packed_C[6]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 7]); 
-        packed_C[7] = _mm512_add_epi16(packed_C[7], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 7); 
+        packed_C[7] = vhq_fma(a_blockA, b_blockB, packed_C[7]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 8]); 
-        packed_C[8] = _mm512_add_epi16(packed_C[8], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 8); 
+        packed_C[8] = vhq_fma(a_blockA, b_blockB, packed_C[8]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 9]); 
-        packed_C[9] = _mm512_add_epi16(packed_C[9], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 9); 
+        packed_C[9] = vhq_fma(a_blockA, b_blockB, packed_C[9]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 10]); 
-        packed_C[10] = _mm512_add_epi16(packed_C[10], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 10); 
+        packed_C[10] = vhq_fma(a_blockA, b_blockB, packed_C[10]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 11]); 
-        packed_C[11] = _mm512_add_epi16(packed_C[11], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 11); 
+        packed_C[11] = vhq_fma(a_blockA, b_blockB, packed_C[11]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 12]); 
-        packed_C[12] = _mm512_add_epi16(packed_C[12], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 12); 
+        packed_C[12] = vhq_fma(a_blockA, b_blockB, packed_C[12]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 13]); 
-        packed_C[13] = _mm512_add_epi16(packed_C[13], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 13); 
+        packed_C[13] = vhq_fma(a_blockA, b_blockB, packed_C[13]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 14]); 
-        packed_C[14] = _mm512_add_epi16(packed_C[14], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 14); 
+        packed_C[14] = vhq_fma(a_blockA, b_blockB, packed_C[14]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 15]); 
-        packed_C[15] = _mm512_add_epi16(packed_C[15], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 15); 
+        packed_C[15] = vhq_fma(a_blockA, b_blockB, packed_C[15]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 16]); 
-        packed_C[16] = _mm512_add_epi16(packed_C[16], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 16); 
+        packed_C[16] = vhq_fma(a_blockA, b_blockB, packed_C[16]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 17]); 
-        packed_C[17] = _mm512_add_epi16(packed_C[17], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 17); 
+        packed_C[17] = vhq_fma(a_blockA, b_blockB, packed_C[17]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 18]); 
-        packed_C[18] = _mm512_add_epi16(packed_C[18], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 18); 
+        packed_C[18] = vhq_fma(a_blockA, b_blockB, packed_C[18]);
         
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 19]); 
-        packed_C[19] = _mm512_add_epi16(packed_C[19], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 19); 
+        packed_C[19] = vhq_fma(a_blockA, b_blockB, packed_C[19]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 20]); 
-        packed_C[20] = _mm512_add_epi16(packed_C[20], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 20); 
+        packed_C[20] = vhq_fma(a_blockA, b_blockB, packed_C[20]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 21]); 
-        packed_C[21] = _mm512_add_epi16(packed_C[21], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 21); 
+        packed_C[21] = vhq_fma(a_blockA, b_blockB, packed_C[21]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 22]); 
-        packed_C[22] = _mm512_add_epi16(packed_C[22], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 22); 
+        packed_C[22] = vhq_fma(a_blockA, b_blockB, packed_C[22]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 23]); 
-        packed_C[23] = _mm512_add_epi16(packed_C[23], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 23); 
+        packed_C[23] = vhq_fma(a_blockA, b_blockB, packed_C[23]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 24]); 
-        packed_C[24] = _mm512_add_epi16(packed_C[24], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 24); 
+        packed_C[24] = vhq_fma(a_blockA, b_blockB, packed_C[24]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 25]); 
-        packed_C[25] = _mm512_add_epi16(packed_C[25], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 25); 
+        packed_C[25] = vhq_fma(a_blockA, b_blockB, packed_C[25]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 26]); 
-        packed_C[26] = _mm512_add_epi16(packed_C[26], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 26); 
+        packed_C[26] = vhq_fma(a_blockA, b_blockB, packed_C[26]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 27]); 
-        packed_C[27] = _mm512_add_epi16(packed_C[27], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 27); 
+        packed_C[27] = vhq_fma(a_blockA, b_blockB, packed_C[27]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 28]); 
-        packed_C[28] = _mm512_add_epi16(packed_C[28], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 28); 
+        packed_C[28] = vhq_fma(a_blockA, b_blockB, packed_C[28]);
 
-        a_blockA = _mm512_set1_epi16(packed_blockA[KC * 29]); 
-        packed_C[29] = _mm512_add_epi16(packed_C[29], _mm512_mullo_epi16(b_blockB, a_blockA));
+        a_blockA = vhq_bcast(packed_blockA + 29); 
+        packed_C[29] = vhq_fma(a_blockA, b_blockB, packed_C[29]);
 
-        packed_blockA += 1;     /* next column */
-        packed_blockB += NC;    /* next 32 elements*/
+        packed_blockA += 30;    /* next column */
+        packed_blockB += 32;    /* next row */
+    }
+    vhq_t alpha_v = vhq_set1(alpha);
+    vhq_t beta_v  = vhq_set1(beta);
+    for(int r = 0; r < m; r++) {
+        packed_C[r] = vhq_mul(alpha_v, packed_C[r]);
+        if(beta != 0)
+            packed_C[r] = vhq_fma(beta_v, vhq_maskz_loadu(packed_mask, &C[r * ldc]), packed_C[r]);
+        vhq_mask_storeu(&C[r * ldc],  packed_mask, packed_C[r]);
+    }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */ /* 5x32 (AVX2), 5x16 (AVX) kernel */
+    vhq_t packed_C[5][2];
+    vhq_t a_blockA, b_blockB[2];
+    vhq_mask_t packed_mask[2] = {vhq_mask(n), vhq_mask(n - VHQ_LEN)};
+
+#pragma GCC unroll 5
+    for(int r = 0; r < 5; r++)
+#pragma GCC unroll 2
+        for(int v = 0; v < 2; v++)
+            packed_C[r][v] = vhq_zero();
+    for(int k = 0; k < kc; k++) {
+#pragma GCC unroll 2
+        for(int v = 0; v < 2; v++)
+            b_blockB[v] = vhq_loadu(packed_blockB + v * VHQ_LEN);
+#pragma GCC unroll 5
+        for(int r = 0; r < 5; r++) {
+            a_blockA = vhq_bcast(packed_blockA + r);
+#pragma GCC unroll 2
+            for(int v = 0; v < 2; v++)
+                packed_C[r][v] = vhq_fma(a_blockA, b_blockB[v], packed_C[r][v]);
+        }
+        packed_blockA += 5;              /* next column */
+        packed_blockB += 2 * VHQ_LEN;    /* next row */
+    }
+    vhq_t alpha_v = vhq_set1(alpha);
+    vhq_t beta_v  = vhq_set1(beta);
+    /* constant indices keep packed_C in registers */
+#pragma GCC unroll 5
+    for(int r = 0; r < 5; r++) {
+        if(r >= m)
+            break;
+#pragma GCC unroll 2
+        for(int v = 0; v < 2; v++) {
+            packed_C[r][v] = vhq_mul(alpha_v, packed_C[r][v]);
+            if(beta != 0)
+                packed_C[r][v] = vhq_fma(beta_v, vhq_maskz_loadu(packed_mask[v], &C[r * ldc + v * VHQ_LEN]), packed_C[r][v]);
+            vhq_mask_storeu(&C[r * ldc + v * VHQ_LEN], packed_mask[v], packed_C[r][v]);
+        }
     }
-    for(int r = 0; r < m; r++)
-        _mm512_mask_storeu_epi16(&C[r * N],  packed_mask, packed_C[r]);
-#elif INSTLEVEL >= 7 /* AVX2 */
-// TODO: implement
 #endif // hqkernel
 }
 
 void qkernel(const int8_t* packed_blockA, const int8_t* packed_blockB, int8_t* C,
-              const int m, const int kc, const int KC, 
-              const int n, const int NC, const int N) {
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int8_t alpha, const int8_t beta) {
 #if INSTLEVEL >= 9      /* AVX512BW */
-    __m512i packed_C[30]; /* 30x64 */
-    __m512i a_blockA, b_blockB;
-    __mmask64 packed_mask = 0xFFFFFFFFFFFFFFFF >> (64 - n);
+    vq_t packed_C[30]; /* 30x64 */
+    vq_t a_blockA, b_blockB;
+    vq_mask_t packed_mask = vq_mask(n);
 
-    for(int r = 0; r < m; r++)
-        packed_C[r] = _mm512_maskz_loadu_epi8(packed_mask, &C[r * N]);
+    for(int r = 0; r < 30; r++)
+        packed_C[r] = vq_zero();
     for(int k = 0; k < kc; k++) {
-        b_blockB  = _mm512_loadu_epi8(packed_blockB);
+        b_blockB  = vq_loadu(packed_blockB);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 0]); 
-        packed_C[0] = qfma(a_blockA, b_blockB, packed_C[0]);
+        a_blockA = vq_bcast(packed_blockA + 0); 
+        packed_C[0] = vq_fma(a_blockA, b_blockB, packed_C[0]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 1]); 
-        packed_C[1] = qfma(a_blockA, b_blockB, packed_C[1]);
+        a_blockA = vq_bcast(packed_blockA + 1); 
+        packed_C[1] = vq_fma(a_blockA, b_blockB, packed_C[1]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 2]); 
-        packed_C[2] = qfma(a_blockA, b_blockB, packed_C[2]);
+        a_blockA = vq_bcast(packed_blockA + 2); 
+        packed_C[2] = vq_fma(a_blockA, b_blockB, packed_C[2]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 3]); 
-        packed_C[3] = qfma(a_blockA, b_blockB, packed_C[3]);
+        a_blockA = vq_bcast(packed_blockA + 3); 
+        packed_C[3] = vq_fma(a_blockA, b_blockB, packed_C[3]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 4]); 
-        packed_C[4] = qfma(a_blockA, b_blockB, packed_C[4]);
+        a_blockA = vq_bcast(packed_blockA + 4); 
+        packed_C[4] = vq_fma(a_blockA, b_blockB, packed_C[4]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 5]); 
-        packed_C[5] = qfma(a_blockA, b_blockB, packed_C[5]);
+        a_blockA = vq_bcast(packed_blockA + 5); 
+        packed_C[5] = vq_fma(a_blockA, b_blockB, packed_C[5]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 6]); 
-        packed_C[6] = qfma(a_blockA, b_blockB, packed_C[6]);
+        a_blockA = vq_bcast(packed_blockA + 6); 
+        packed_C[6] = vq_fma(a_blockA, b_blockB, packed_C[6]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 7]); 
-        packed_C[7] = qfma(a_blockA, b_blockB, packed_C[7]);
+        a_blockA = vq_bcast(packed_blockA + 7); 
+        packed_C[7] = vq_fma(a_blockA, b_blockB, packed_C[7]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 8]); 
-        packed_C[8] = qfma(a_blockA, b_blockB, packed_C[8]);
+        a_blockA = vq_bcast(packed_blockA + 8); 
+        packed_C[8] = vq_fma(a_blockA, b_blockB, packed_C[8]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 9]); 
-        packed_C[9] = qfma(a_blockA, b_blockB, packed_C[9]);
+        a_blockA = vq_bcast(packed_blockA + 9); 
+        packed_C[9] = vq_fma(a_blockA, b_blockB, packed_C[9]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 10]); 
-        packed_C[10] = qfma(a_blockA, b_blockB, packed_C[10]);
+        a_blockA = vq_bcast(packed_blockA + 10); 
+        packed_C[10] = vq_fma(a_blockA, b_blockB, packed_C[10]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 11]); 
-        packed_C[11] = qfma(a_blockA, b_blockB, packed_C[11]);
+        a_blockA = vq_bcast(packed_blockA + 11); 
+        packed_C[11] = vq_fma(a_blockA, b_blockB, packed_C[11]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 12]); 
-        packed_C[12] = qfma(a_blockA, b_blockB, packed_C[12]);
+        a_blockA = vq_bcast(packed_blockA + 12); 
+        packed_C[12] = vq_fma(a_blockA, b_blockB, packed_C[12]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 13]); 
-        packed_C[13] = qfma(a_blockA, b_blockB, packed_C[13]);
+        a_blockA = vq_bcast(packed_blockA + 13); 
+        packed_C[13] = vq_fma(a_blockA, b_blockB, packed_C[13]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 14]); 
-        packed_C[14] = qfma(a_blockA, b_blockB, packed_C[14]);
+        a_blockA = vq_bcast(packed_blockA + 14); 
+        packed_C[14] = vq_fma(a_blockA, b_blockB, packed_C[14]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 15]); 
-        packed_C[15] = qfma(a_blockA, b_blockB, packed_C[15]);
+        a_blockA = vq_bcast(packed_blockA + 15); 
+        packed_C[15] = vq_fma(a_blockA, b_blockB, packed_C[15]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 16]); 
-        packed_C[16] = qfma(a_blockA, b_blockB, packed_C[16]);
+        a_blockA = vq_bcast(packed_blockA + 16); 
+        packed_C[16] = vq_fma(a_blockA, b_blockB, packed_C[16]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 17]); 
-        packed_C[17] = qfma(a_blockA, b_blockB, packed_C[17]);
+        a_blockA = vq_bcast(packed_blockA + 17); 
+        packed_C[17] = vq_fma(a_blockA, b_blockB, packed_C[17]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 18]); 
-        packed_C[18] = qfma(a_blockA, b_blockB, packed_C[18]);
+        a_blockA = vq_bcast(packed_blockA + 18); 
+        packed_C[18] = vq_fma(a_blockA, b_blockB, packed_C[18]);
         
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 19]); 
-        packed_C[19] = qfma(a_blockA, b_blockB, packed_C[19]);
+        a_blockA = vq_bcast(packed_blockA + 19); 
+        packed_C[19] = vq_fma(a_blockA, b_blockB, packed_C[19]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 20]); 
-        packed_C[20] = qfma(a_blockA, b_blockB, packed_C[20]);
+        a_blockA = vq_bcast(packed_blockA + 20); 
+        packed_C[20] = vq_fma(a_blockA, b_blockB, packed_C[20]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 21]); 
-        packed_C[21] = qfma(a_blockA, b_blockB, packed_C[21]);
+        a_blockA = vq_bcast(packed_blockA + 21); 
+        packed_C[21] = vq_fma(a_blockA, b_blockB, packed_C[21]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 22]); 
-        packed_C[22] = qfma(a_blockA, b_blockB, packed_C[22]);
+        a_blockA = vq_bcast(packed_blockA + 22); 
+        packed_C[22] = vq_fma(a_blockA, b_blockB, packed_C[22]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 23]); 
-        packed_C[23] = qfma(a_blockA, b_blockB, packed_C[23]);
+        a_blockA = vq_bcast(packed_blockA + 23); 
+        packed_C[23] = vq_fma(a_blockA, b_blockB, packed_C[23]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 24]); 
-        packed_C[24] = qfma(a_blockA, b_blockB, packed_C[24]);
+        a_blockA = vq_bcast(packed_blockA + 24); 
+        packed_C[24] = vq_fma(a_blockA, b_blockB, packed_C[24]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 25]); 
-        packed_C[25] = qfma(a_blockA, b_blockB, packed_C[25]);
+        a_blockA = vq_bcast(packed_blockA + 25); 
+        packed_C[25] = vq_fma(a_blockA, b_blockB, packed_C[25]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 26]); 
-        packed_C[26] = qfma(a_blockA, b_blockB, packed_C[26]);
+        a_blockA = vq_bcast(packed_blockA + 26); 
+        packed_C[26] = vq_fma(a_blockA, b_blockB, packed_C[26]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 27]); 
-        packed_C[27] = qfma(a_blockA, b_blockB, packed_C[27]);
+        a_blockA = vq_bcast(packed_blockA + 27); 
+        packed_C[27] = vq_fma(a_blockA, b_blockB, packed_C[27]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 28]); 
-        packed_C[28] = qfma(a_blockA, b_blockB, packed_C[28]);
+        a_blockA = vq_bcast(packed_blockA + 28); 
+        packed_C[28] = vq_fma(a_blockA, b_blockB, packed_C[28]);
 
-        a_blockA = _mm512_set1_epi8(packed_blockA[KC * 29]); 
-        packed_C[29] = qfma(a_blockA, b_blockB, packed_C[29]);
+        a_blockA = vq_bcast(packed_blockA + 29); 
+        packed_C[29] = vq_fma(a_blockA, b_blockB, packed_C[29]);
 
-        packed_blockA += 1;     /* next column */
-        packed_blockB += NC;    /* next 32 elements*/
+        packed_blockA += 30;    /* next column */
+        packed_blockB += 64;    /* next row */
+    }
+    vq_t alpha_v = vq_set1(alpha);
+    vq_t beta_v  = vq_set1(beta);
+    for(int r = 0; r < m; r++) {
+        packed_C[r] = vq_mul(alpha_v, packed_C[r]);
+        if(beta != 0)
+            packed_C[r] = vq_fma(beta_v, vq_maskz_loadu(packed_mask, &C[r * ldc]), packed_C[r]);
+        vq_mask_storeu(&C[r * ldc],  packed_mask, packed_C[r]);
+    }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */ /* 5x32 (AVX2), 5x16 (AVX) kernel, in int16 lanes */
+    vhq_t packed_C[5][2];
+    vhq_t a_blockA, b_blockB[2];
+    vhq_mask_t packed_mask[2] = {vhq_mask(n), vhq_mask(n - VHQ_LEN)};
+
+#pragma GCC unroll 5
+    for(int r = 0; r < 5; r++)
+#pragma GCC unroll 2
+        for(int v = 0; v < 2; v++)
+            packed_C[r][v] = vhq_zero();
+    for(int k = 0; k < kc; k++) {
+#pragma GCC unroll 2
+        for(int v = 0; v < 2; v++)
+            b_blockB[v] = vq_widen(packed_blockB + v * VHQ_LEN);
+#pragma GCC unroll 5
+        for(int r = 0; r < 5; r++) {
+            a_blockA = vq_bcast_widen(packed_blockA + r);
+#pragma GCC unroll 2
+            for(int v = 0; v < 2; v++)
+                packed_C[r][v] = vhq_fma(a_blockA, b_blockB[v], packed_C[r][v]);
+        }
+        packed_blockA += 5;              /* next column */
+        packed_blockB += 2 * VHQ_LEN;    /* next row */
+    }
+    vhq_t alpha_v = vhq_set1(alpha);
+    vhq_t beta_v  = vhq_set1(beta);
+    /* constant indices keep packed_C in registers */
+#pragma GCC unroll 5
+    for(int r = 0; r < 5; r++) {
+        if(r >= m)
+            break;
+#pragma GCC unroll 2
+        for(int v = 0; v < 2; v++) {
+            packed_C[r][v] = vhq_mul(alpha_v, packed_C[r][v]);
+            if(beta != 0)
+                packed_C[r][v] = vhq_fma(beta_v, vq_maskz_widen(packed_mask[v], &C[r * ldc + v * VHQ_LEN]), packed_C[r][v]);
+            vq_mask_narrow_storeu(&C[r * ldc + v * VHQ_LEN], packed_mask[v], packed_C[r][v]);
+        }
     }
-    for(int r = 0; r < m; r++)
-        _mm512_mask_storeu_epi8(&C[r * N],  packed_mask, packed_C[r]);
-#elif INSTLEVEL >= 7 /* AVX2 */
-// TODO: implement
 #endif // qkernel
-}
\ No newline at end of file
+}
+/**
+ * uint8 x int8 -> int32 kernel of qgemm_s32, on k-groups of 4 (see [pack.c]).
+ * On the first KC block (beta == 0) C is set to the product plus row_off[r] + col_off[c],
+ * the zero-point terms, when they are given; later blocks add to C.
+ * With [rq] (qgemm_requant, a single KC block) the sums are requantized and the low
+ * bytes stored to C_q; C isn't touched.
+ *
+ * The shape depends on how many registers the dot product needs: vpdpbusd is one
+ * instruction, the vpmaddubsw fallback also keeps both halves of B and two products.
+ */
+#if INSTLEVEL >= 10     /* AVX512VNNI */
+#define QI_MR 14
+#define QI_NV 2         /* vectors per row, NR = QI_NV * VQI_LEN */
+#elif INSTLEVEL >= 9    /* AVX512BW */
+#define QI_MR 10
+#define QI_NV 2
+#elif INSTLEVEL >= 7    /* AVX2 */
+#define QI_MR 4
+#define QI_NV 2
+#elif INSTLEVEL >= 6    /* AVX */
+#define QI_MR 4
+#define QI_NV 2
+#endif
+
+void qikernel(const uint8_t* packed_blockA, const int8_t* packed_blockB, int* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const int* row_off, const int* col_off, const int beta,
+              uint8_t* C_q, const gemm_requant_t* rq) {
+#if INSTLEVEL >= 6
+    vqi_t packed_C[QI_MR][QI_NV];
+    vqi_t a_blockA, b_blockB[QI_NV];
+
+#pragma GCC unroll 16
+    for(int r = 0; r < QI_MR; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < QI_NV; v++)
+            packed_C[r][v] = vqi_zero();
+    for(int k = 0; k < kc; k += 4) {
+#pragma GCC unroll 4
+        for(int v = 0; v < QI_NV; v++)
+            b_blockB[v] = vqi_load(packed_blockB + v * VQI_LEN * 4);
+#pragma GCC unroll 16
+        for(int r = 0; r < QI_MR; r++) {
+            a_blockA = vqi_bcast4(packed_blockA + r * 4);
+#pragma GCC unroll 4
+            for(int v = 0; v < QI_NV; v++)
+                packed_C[r][v] = vqi_dot(packed_C[r][v], a_blockA, b_blockB[v]);
+        }
+        packed_blockA += QI_MR * 4;             /* next k-group */
+        packed_blockB += QI_NV * VQI_LEN * 4;
+    }
+
+    vqi_mask_t packed_mask[QI_NV];
+    vqi_t col_v[QI_NV];
+    for(int v = 0; v < QI_NV; v++) {
+        packed_mask[v] = vqi_mask(n - v * VQI_LEN);
+        col_v[v] = (beta == 0 && col_off != NULL)
+                   ? vqi_maskz_loadu(packed_mask[v], &col_off[v * VQI_LEN]) : vqi_zero();
+    }
+    /* requantization, per column or for all of them; lo and hi are the 8-bit range less zero_point */
+    vqi_t bias_v[QI_NV], zero_v = vqi_zero();
+    vqif_t scale_v[QI_NV], lo_v = vqif_set1(0), hi_v = vqif_set1(0);
+    for(int v = 0; v < QI_NV; v++)
+        scale_v[v] = vqif_set1(0), bias_v[v] = vqi_zero();
+    if(rq != NULL) {
+        for(int v = 0; v < QI_NV; v++) {
+            scale_v[v] = rq->per_channel ? vqif_maskz_loadu(packed_mask[v], &rq->scale[v * VQI_LEN])
+                                         : vqif_set1(rq->scale[0]);
+            bias_v[v] = (rq->bias == NULL) ? vqi_zero() :
+                        rq->per_channel ? vqi_maskz_loadu(packed_mask[v], &rq->bias[v * VQI_LEN])
+                                        : vqi_set1(rq->bias[0]);
+        }
+        zero_v = vqi_set1(rq->zero_point);
+        lo_v = vqif_set1((rq->out_signed ? -128 : 0) - (float)rq->zero_point);
+        hi_v = vqif_set1((rq->out_signed ? 127 : 255) - (float)rq->zero_point);
+    }
+    /* constant indices keep packed_C in registers, A bytes may alias it otherwise */
+#pragma GCC unroll 16
+    for(int r = 0; r < QI_MR; r++) {
+        if(r >= m)
+            break;
+#pragma GCC unroll 4
+        for(int v = 0; v < QI_NV; v++) {
+            if(beta != 0)
+                packed_C[r][v] = vqi_add(packed_C[r][v], vqi_maskz_loadu(packed_mask[v], &C[r * ldc + v * VQI_LEN]));
+            else if(row_off != NULL)
+                packed_C[r][v] = vqi_add(packed_C[r][v], vqi_add(col_v[v], vqi_set1(row_off[r])));
+            if(rq != NULL) {
+                vqi_t q = vqi_requant(vqi_add(packed_C[r][v], bias_v[v]), scale_v[v], lo_v, hi_v);
+                vqi_mask_storeu_q(&C_q[r * ldc + v * VQI_LEN], packed_mask[v], vqi_add(q, zero_v));
+            }
+            else
+                vqi_mask_storeu(&C[r * ldc + v * VQI_LEN], packed_mask[v], packed_C[r][v]);
+        }
+    }
+#endif // qikernel
+}
+/**
+ * int16 x int16 -> int32 kernel of hqgemm_s32, on k-pairs (see [pack.c]).
+ * C is set on the first KC block (beta == 0) and added to on the later ones.
+ *
+ * vpmaddwd adds the two products of a pair in int32, the pair (-32768, -32768) twice
+ * being the only one that wraps; the sum is exact modulo 2^32 all the same.
+ */
+#if INSTLEVEL >= 10     /* AVX512VNNI */
+#define HQI_MR 14
+#define HQI_NV 2        /* vectors per row, NR = HQI_NV * VQI_LEN */
+#elif INSTLEVEL >= 9    /* AVX512BW */
+#define HQI_MR 12
+#define HQI_NV 2
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+#define HQI_MR 6
+#define HQI_NV 2
+#endif
+
+void hqikernel(const int16_t* packed_blockA, const int16_t* packed_blockB, int* C,
+              const int m, const int kc,
+              const int n, const int ldc, const int beta) {
+#if INSTLEVEL >= 6
+    vqi_t packed_C[HQI_MR][HQI_NV];
+    vqi_t a_blockA, b_blockB[HQI_NV];
+
+#pragma GCC unroll 16
+    for(int r = 0; r < HQI_MR; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < HQI_NV; v++)
+            packed_C[r][v] = vqi_zero();
+    for(int k = 0; k < kc; k += 2) {
+#pragma GCC unroll 4
+        for(int v = 0; v < HQI_NV; v++)
+            b_blockB[v] = vhqi_load(packed_blockB + v * VQI_LEN * 2);
+#pragma GCC unroll 16
+        for(int r = 0; r < HQI_MR; r++) {
+            a_blockA = vhqi_bcast2(packed_blockA + r * 2);
+#pragma GCC unroll 4
+            for(int v = 0; v < HQI_NV; v++)
+                packed_C[r][v] = vhqi_dot(packed_C[r][v], a_blockA, b_blockB[v]);
+        }
+        packed_blockA += HQI_MR * 2;            /* next k-pair */
+        packed_blockB += HQI_NV * VQI_LEN * 2;
+    }
+
+    vqi_mask_t packed_mask[HQI_NV];
+    for(int v = 0; v < HQI_NV; v++)
+        packed_mask[v] = vqi_mask(n - v * VQI_LEN);
+    /* constant indices keep packed_C in registers */
+#pragma GCC unroll 16
+    for(int r = 0; r < HQI_MR; r++) {
+        if(r >= m)
+            break;
+#pragma GCC unroll 4
+        for(int v = 0; v < HQI_NV; v++) {
+            if(beta != 0)
+                packed_C[r][v] = vqi_add(packed_C[r][v], vqi_maskz_loadu(packed_mask[v], &C[r * ldc + v * VQI_LEN]));
+            vqi_mask_storeu(&C[r * ldc + v * VQI_LEN], packed_mask[v], packed_C[r][v]);
+        }
+    }
+#endif // hqikernel
+}
+#if INSTLEVEL >= 11     /* AVX512_BF16 */
+/**
+ * bf16 x bf16 -> fp32 kernel of bf16gemm, on k-pairs packed as for hqgemm_s32
+ * (see [pack.c]). vdpbf16ps adds the two products of a pair to the fp32 accumulator.
+ * It's used for short A only (see bf16gemm_run); otherwise bf16gemm widens to fp32
+ * while packing and runs skernel.
+ */
+#define BF_MR 14
+#define BF_NV 2         /* vectors per row, NR = BF_NV * VS_LEN */
+
+void bf16kernel(const uint16_t* packed_blockA, const uint16_t* packed_blockB, float* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const float alpha, const float beta) {
+    vs_t packed_C[BF_MR][BF_NV];
+    vbf_t a_blockA, b_blockB[BF_NV];
+
+#pragma GCC unroll 16
+    for(int r = 0; r < BF_MR; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < BF_NV; v++)
+            packed_C[r][v] = vs_zero();
+    for(int k = 0; k < kc; k += 2) {
+#pragma GCC unroll 4
+        for(int v = 0; v < BF_NV; v++)
+            b_blockB[v] = vbf_load(packed_blockB + v * VS_LEN * 2);
+#pragma GCC unroll 16
+        for(int r = 0; r < BF_MR; r++) {
+            a_blockA = vbf_bcast2(packed_blockA + r * 2);
+#pragma GCC unroll 4
+            for(int v = 0; v < BF_NV; v++)
+                packed_C[r][v] = vbf_dot(packed_C[r][v], a_blockA, b_blockB[v]);
+        }
+        packed_blockA += BF_MR * 2;             /* next k-pair */
+        packed_blockB += BF_NV * VS_LEN * 2;
+    }
+
+    vs_t alpha_v = vs_set1(alpha);
+    vs_t beta_v  = vs_set1(beta);
+    vs_mask_t packed_mask[BF_NV];
+    for(int v = 0; v < BF_NV; v++)
+        packed_mask[v] = vs_mask(n - v * VS_LEN);
+    /* constant indices keep packed_C in registers */
+#pragma GCC unroll 16
+    for(int r = 0; r < BF_MR; r++) {
+        if(r >= m)
+            break;
+#pragma GCC unroll 4
+        for(int v = 0; v < BF_NV; v++) {
+            packed_C[r][v] = vs_mul(alpha_v, packed_C[r][v]);
+            if(beta != 0)
+                packed_C[r][v] = vs_fma(beta_v, vs_maskz_loadu(packed_mask[v], &C[r * ldc + v * VS_LEN]), packed_C[r][v]);
+            vs_mask_storeu(&C[r * ldc + v * VS_LEN], packed_mask[v], packed_C[r][v]);
+        }
+    }
+}
+#endif // bf16kernel
+
+/**
+ * skernel with fp16 C (hgemm_f16): the same packed fp32 blocks and FMA loop, C is
+ * converted to fp32 on load and rounded back to fp16 on store.
+ */
+#if INSTLEVEL >= 8      /* AVX512F */
+#define H_MR 14
+#define H_NV 2          /* vectors per row, NR = H_NV * VS_LEN */
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+#define H_MR 6
+#define H_NV 2
+#endif
+
+void hkernel(const float* packed_blockA, const float* packed_blockB, uint16_t* C,
+              const int m, const int kc,
+              const int n, const int ldc,
+              const float alpha, const float beta) {
+#if INSTLEVEL >= 6
+    vs_t packed_C[H_MR][H_NV];
+    vs_t a_blockA, b_blockB[H_NV];
+
+#pragma GCC unroll 16
+    for(int r = 0; r < H_MR; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < H_NV; v++)
+            packed_C[r][v] = vs_zero();
+    for(int k = 0; k < kc; k++) {
+#pragma GCC unroll 4
+        for(int v = 0; v < H_NV; v++)
+            b_blockB[v] = vs_load(packed_blockB + v * VS_LEN);
+#pragma GCC unroll 16
+        for(int r = 0; r < H_MR; r++) {
+            a_blockA = vs_bcast(packed_blockA + r);
+#pragma GCC unroll 4
+            for(int v = 0; v < H_NV; v++)
+                packed_C[r][v] = vs_fma(a_blockA, b_blockB[v], packed_C[r][v]);
+        }
+        packed_blockA += H_MR;                  /* next column */
+        packed_blockB += H_NV * VS_LEN;         /* next row */
+    }
+
+    vs_t alpha_v = vs_set1(alpha);
+    vs_t beta_v  = vs_set1(beta);
+    vs_mask_t packed_mask[H_NV];
+    for(int v = 0; v < H_NV; v++)
+        packed_mask[v] = vs_mask(n - v * VS_LEN);
+    /* constant indices keep packed_C in registers */
+#pragma GCC unroll 16
+    for(int r = 0; r < H_MR; r++) {
+        if(r >= m)
+            break;
+#pragma GCC unroll 4
+        for(int v = 0; v < H_NV; v++) {
+            packed_C[r][v] = vs_mul(alpha_v, packed_C[r][v]);
+            if(beta != 0)
+                packed_C[r][v] = vs_fma(beta_v, vs_maskz_loadu_h(packed_mask[v], &C[r * ldc + v * VS_LEN]), packed_C[r][v]);
+            vs_mask_storeu_h(&C[r * ldc + v * VS_LEN], packed_mask[v], packed_C[r][v]);
+        }
+    }
+#endif // hkernel
+}
+
+/**
+ * GEMV kernels, for GEMMs with a single row or column (see [gemv.c]). The matrix is read
+ * once, straight from memory with no packing, so they are bound by memory bandwidth and
+ * read it row after row.
+ *
+ * *gemv_n: y = alpha * xB + beta * y for the k x n row-major B and x [incx] apart.
+ * GEMV_KT rows of B are added to y at a time, y staying in L1: the columns go in
+ * blocks of GEMV_NB bytes of y.
+ *
+ * *gemv_t: y = alpha * Ax + beta * y for the m x k row-major A, contiguous x and y
+ * [incy] apart. These are m dot products, GEMV_MT rows at a time on two accumulators
+ * each.
+ *
+ * y isn't read when beta is 0.
+ */
+#define GEMV_KT 4
+#define GEMV_MT 4
+#define GEMV_NB 8192
+
+/* rows [i, i + kt) of B, kt <= GEMV_KT, times alpha * x into y; the first rows scale y by beta */
+SIMD_INLINE void sgemv_n_rows(const float* B, const int ldb, const float* x, const int incx,
+             float* y, const int i, const int kt, const int n, const float alpha, const float beta) {
+#if INSTLEVEL >= 6
+    const float* b[GEMV_KT];
+    vs_t x_v[GEMV_KT], y_v;
+    for(int t = 0; t < kt; t++) {
+        b[t] = &B[(size_t)(i + t) * ldb];
+        x_v[t] = vs_set1(alpha * x[(i + t) * incx]);
+    }
+    const vs_t beta_v = vs_set1(beta);
+    const BOOL first = (i == 0);
+    int c = 0;
+    if(kt == GEMV_KT) {
+        for(; c + VS_LEN <= n; c += VS_LEN) {
+            y_v = (!first) ? vs_loadu(&y[c]) : (beta == 0) ? vs_zero() : vs_mul(beta_v, vs_loadu(&y[c]));
+#pragma GCC unroll 4
+            for(int t = 0; t < GEMV_KT; t++)
+                y_v = vs_fma(x_v[t], vs_loadu(b[t] + c), y_v);
+            vs_storeu(&y[c], y_v);
+        }
+    }
+    /* the last columns, and the last rows of B */
+    for(; c < n; c += VS_LEN) {
+        const vs_mask_t mask = vs_mask(n - c);
+        y_v = (!first) ? vs_maskz_loadu(mask, &y[c])
+            : (beta == 0) ? vs_zero() : vs_mul(beta_v, vs_maskz_loadu(mask, &y[c]));
+        for(int t = 0; t < kt; t++)
+            y_v = vs_fma(x_v[t], vs_maskz_loadu(mask, b[t] + c), y_v);
+        vs_mask_storeu(&y[c], mask, y_v);
+    }
+#endif // sgemv_n
+}
+
+void sgemv_n(const float* B, const int ldb, const float* x, const int incx,
+             float* y, const int k, const int n, const float alpha, const float beta) {
+    const int nb = GEMV_NB / sizeof(float);
+    for(int c = 0; c < n; c += nb) {
+        const int nc = min(nb, n - c);
+        int i = 0;
+        do {
+            sgemv_n_rows(&B[c], ldb, x, incx, &y[c], i, max(0, min(GEMV_KT, k - i)), nc, alpha, beta);
+            i += GEMV_KT;
+        } while(i < k);
+    }
+}
+
+void sgemv_t(const float* A, const int lda, const float* x, float* y, const int incy,
+             const int m, const int k, const float alpha, const float beta) {
+#if INSTLEVEL >= 6
+    vs_t acc0[GEMV_MT], acc1[GEMV_MT], x0, x1;
+    const float* a[GEMV_MT];
+    for(int r = 0; r < m; r += GEMV_MT) {
+        const int mt = min(GEMV_MT, m - r);
+        /* the last rows repeat the last row of A, from the cache */
+#pragma GCC unroll 4
+        for(int t = 0; t < GEMV_MT; t++) {
+            a[t] = &A[(size_t)(r + min(t, mt - 1)) * lda];
+            acc0[t] = vs_zero(), acc1[t] = vs_zero();
+        }
+        int i = 0;
+        for(; i + 2 * VS_LEN <= k; i += 2 * VS_LEN) {
+            x0 = vs_loadu(&x[i]), x1 = vs_loadu(&x[i + VS_LEN]);
+#pragma GCC unroll 4
+            for(int t = 0; t < GEMV_MT; t++) {
+                acc0[t] = vs_fma(vs_loadu(a[t] + i), x0, acc0[t]);
+                acc1[t] = vs_fma(vs_loadu(a[t] + i + VS_LEN), x1, acc1[t]);
+            }
+        }
+        for(; i < k; i += VS_LEN) {
+            const vs_mask_t mask = vs_mask(k - i);
+            x0 = vs_maskz_loadu(mask, &x[i]);
+#pragma GCC unroll 4
+            for(int t = 0; t < GEMV_MT; t++)
+                acc0[t] = vs_fma(vs_maskz_loadu(mask, a[t] + i), x0, acc0[t]);
+        }
+        for(int t = 0; t < mt; t++) {
+            const float dot = alpha * vs_reduce_add(vs_add(acc0[t], acc1[t]));
+            y[(r + t) * incy] = (beta == 0) ? dot : dot + beta * y[(r + t) * incy];
+        }
+    }
+#endif // sgemv_t
+}
+
+/* rows [i, i + kt) of B, kt <= GEMV_KT, times alpha * x into y; the first rows scale y by beta */
+SIMD_INLINE void dgemv_n_rows(const double* B, const int ldb, const double* x, const int incx,
+             double* y, const int i, const int kt, const int n, const double alpha, const double beta) {
+#if INSTLEVEL >= 6
+    const double* b[GEMV_KT];
+    vd_t x_v[GEMV_KT], y_v;
+    for(int t = 0; t < kt; t++) {
+        b[t] = &B[(size_t)(i + t) * ldb];
+        x_v[t] = vd_set1(alpha * x[(i + t) * incx]);
+    }
+    const vd_t beta_v = vd_set1(beta);
+    const BOOL first = (i == 0);
+    int c = 0;
+    if(kt == GEMV_KT) {
+        for(; c + VD_LEN <= n; c += VD_LEN) {
+            y_v = (!first) ? vd_loadu(&y[c]) : (beta == 0) ? vd_zero() : vd_mul(beta_v, vd_loadu(&y[c]));
+#pragma GCC unroll 4
+            for(int t = 0; t < GEMV_KT; t++)
+                y_v = vd_fma(x_v[t], vd_loadu(b[t] + c), y_v);
+            vd_storeu(&y[c], y_v);
+        }
+    }
+    /* the last columns, and the last rows of B */
+    for(; c < n; c += VD_LEN) {
+        const vd_mask_t mask = vd_mask(n - c);
+        y_v = (!first) ? vd_maskz_loadu(mask, &y[c])
+            : (beta == 0) ? vd_zero() : vd_mul(beta_v, vd_maskz_loadu(mask, &y[c]));
+        for(int t = 0; t < kt; t++)
+            y_v = vd_fma(x_v[t], vd_maskz_loadu(mask, b[t] + c), y_v);
+        vd_mask_storeu(&y[c], mask, y_v);
+    }
+#endif // dgemv_n
+}
+
+void dgemv_n(const double* B, const int ldb, const double* x, const int incx,
+             double* y, const int k, const int n, const double alpha, const double beta) {
+    const int nb = GEMV_NB / sizeof(double);
+    for(int c = 0; c < n; c += nb) {
+        const int nc = min(nb, n - c);
+        int i = 0;
+        do {
+            dgemv_n_rows(&B[c], ldb, x, incx, &y[c], i, max(0, min(GEMV_KT, k - i)), nc, alpha, beta);
+            i += GEMV_KT;
+        } while(i < k);
+    }
+}
+
+void dgemv_t(const double* A, const int lda, const double* x, double* y, const int incy,
+             const int m, const int k, const double alpha, const double beta) {
+#if INSTLEVEL >= 6
+    vd_t acc0[GEMV_MT], acc1[GEMV_MT], x0, x1;
+    const double* a[GEMV_MT];
+    for(int r = 0; r < m; r += GEMV_MT) {
+        const int mt = min(GEMV_MT, m - r);
+        /* the last rows repeat the last row of A, from the cache */
+#pragma GCC unroll 4
+        for(int t = 0; t < GEMV_MT; t++) {
+            a[t] = &A[(size_t)(r + min(t, mt - 1)) * lda];
+            acc0[t] = vd_zero(), acc1[t] = vd_zero();
+        }
+        int i = 0;
+        for(; i + 2 * VD_LEN <= k; i += 2 * VD_LEN) {
+            x0 = vd_loadu(&x[i]), x1 = vd_loadu(&x[i + VD_LEN]);
+#pragma GCC unroll 4
+            for(int t = 0; t < GEMV_MT; t++) {
+                acc0[t] = vd_fma(vd_loadu(a[t] + i), x0, acc0[t]);
+                acc1[t] = vd_fma(vd_loadu(a[t] + i + VD_LEN), x1, acc1[t]);
+            }
+        }
+        for(; i < k; i += VD_LEN) {
+            const vd_mask_t mask = vd_mask(k - i);
+            x0 = vd_maskz_loadu(mask, &x[i]);
+#pragma GCC unroll 4
+            for(int t = 0; t < GEMV_MT; t++)
+                acc0[t] = vd_fma(vd_maskz_loadu(mask, a[t] + i), x0, acc0[t]);
+        }
+        for(int t = 0; t < mt; t++) {
+            const double dot = alpha * vd_reduce_add(vd_add(acc0[t], acc1[t]));
+            y[(r + t) * incy] = (beta == 0) ? dot : dot + beta * y[(r + t) * incy];
+        }
+    }
+#endif // dgemv_t
+}
+
+/**
+ * y = xB for the k x n row-major int8 B and int16 x: qgemm_s32 with one row of A, the
+ * zero point of A already subtracted from x (see [gemv.c]). Two rows of B at a time
+ * are widened into the k-pairs of vhqi_dot, so the int32 sums are exact.
+ */
+void qigemv_n(const int16_t* x, const int8_t* B, const int ldb, int* y,
+              const int k, const int n) {
+#if INSTLEVEL >= 6
+    const vqi_mask_t all = vqi_mask(VQI_LEN);
+    const int nb = GEMV_NB / sizeof(int);
+    for(int c0 = 0; c0 < n; c0 += nb) {
+        const int nc = min(nb, n - c0);
+        const int nv = nc / VQI_LEN * VQI_LEN;      /* columns in whole vectors */
+        memset(&y[c0], 0, nc * sizeof(int));
+        for(int i = 0; i < k; i += GEMV_KT) {
+            /* k-pairs (i, i + 1) and (i + 2, i + 3), a row past k pairs with 0 */
+            const int kt = min(GEMV_KT, k - i);
+            const int8_t* b[GEMV_KT];
+            int16_t x_p[GEMV_KT];
+            for(int t = 0; t < GEMV_KT; t++) {
+                b[t] = &B[(size_t)(i + min(t, kt - 1)) * ldb + c0];
+                x_p[t] = (t < kt) ? x[i + t] : 0;
+            }
+            const vqi_t x01 = vhqi_bcast2(&x_p[0]), x23 = vhqi_bcast2(&x_p[2]);
+            for(int c = 0; c < nv; c += VQI_LEN) {
+                vqi_t y_v = vqi_loadu(&y[c0 + c]);
+                y_v = vhqi_dot(y_v, x01, vhqi_widen2(b[0] + c, b[1] + c));
+                if(kt > 2)
+                    y_v = vhqi_dot(y_v, x23, vhqi_widen2(b[2] + c, b[3] + c));
+                vqi_mask_storeu(&y[c0 + c], all, y_v);
+            }
+            for(int c = nv; c < nc; c++)
+                y[c0 + c] = (int)((uint32_t)y[c0 + c] + (uint32_t)(x_p[0] * b[0][c] + x_p[1] * b[1][c]
+                                                                + x_p[2] * b[2][c] + x_p[3] * b[3][c]));
+        }
+    }
+#endif // qigemv_n
+}
+
+/**
+ * Direct kernels for small GEMMs (see small_mnk of gemm_ctx_t): C = alpha * AB + beta * C
+ * for the M x K op(A), elements [rsA] and [csA] apart, and the K x N row-major B, read
+ * where they are. The loops of [gemm.c] are left out with the packing: tiles of C are
+ * SMALL_MR x SMALL_NV vectors, only the last column of tiles masked, and a B panel stays
+ * in L1 while the tiles of A go down it. The k loop is unrolled [ku] times, which must
+ * divide K; the shapes of GEMM_FIXED_SHAPES inline all of this with constant sizes.
+ */
+#if INSTLEVEL >= 8      /* AVX512F */
+#define SMALL_MR 8
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+#define SMALL_MR 6
+#endif
+#define SMALL_NV 2      /* vectors per row */
+
+/* one tile of [mr] rows and [n] columns, masked or not; constants once inlined */
+SIMD_INLINE void sgemm_small_tile(const int mr, const int n, const int masked, const int K, const int ku,
+        const float alpha, const float* A, const int rsA, const int csA, const float* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+#if INSTLEVEL >= 6
+    vs_t acc[SMALL_MR][SMALL_NV], a, b[SMALL_NV];
+    vs_mask_t mask[SMALL_NV];
+#pragma GCC unroll 4
+    for(int v = 0; v < SMALL_NV; v++)
+        mask[v] = vs_mask(n - v * VS_LEN);
+#pragma GCC unroll 16
+    for(int r = 0; r < mr; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < SMALL_NV; v++)
+            acc[r][v] = vs_zero();
+    for(int k0 = 0; k0 < K; k0 += ku) {
+#pragma GCC unroll 256
+        for(int k = k0; k < k0 + ku; k++) {
+#pragma GCC unroll 4
+            for(int v = 0; v < SMALL_NV; v++)
+                b[v] = masked ? vs_maskz_loadu(mask[v], &B[k * ldb + v * VS_LEN])
+                              : vs_loadu(&B[k * ldb + v * VS_LEN]);
+#pragma GCC unroll 16
+            for(int r = 0; r < mr; r++) {
+                a = vs_set1(A[r * rsA + k * csA]);
+#pragma GCC unroll 4
+                for(int v = 0; v < SMALL_NV; v++)
+                    acc[r][v] = vs_fma(a, b[v], acc[r][v]);
+            }
+        }
+    }
+    const vs_t alpha_v = vs_set1(alpha), beta_v = vs_set1(beta);
+#pragma GCC unroll 16
+    for(int r = 0; r < mr; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < SMALL_NV; v++) {
+            float* C_rv = &C[r * ldc + v * VS_LEN];
+            acc[r][v] = vs_mul(alpha_v, acc[r][v]);
+            if(beta != 0)
+                acc[r][v] = vs_fma(beta_v, masked ? vs_maskz_loadu(mask[v], C_rv) : vs_loadu(C_rv), acc[r][v]);
+            if(masked)
+                vs_mask_storeu(C_rv, mask[v], acc[r][v]);
+            else
+                vs_storeu(C_rv, acc[r][v]);
+        }
+#endif // sgemm_small
+}
+
+/* the M rows of one column of tiles */
+SIMD_INLINE void sgemm_small_panel(const int M, const int n, const int masked, const int K, const int ku,
+        const float alpha, const float* A, const int rsA, const int csA, const float* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+#if INSTLEVEL >= 6
+    const int r = M / SMALL_MR * SMALL_MR;
+    for(int i = 0; i < r; i += SMALL_MR)
+        sgemm_small_tile(SMALL_MR, n, masked, K, ku, alpha, &A[i * rsA], rsA, csA, B, ldb, beta, &C[i * ldc], ldc);
+    const float* A_r = &A[r * rsA];
+    float* C_r = &C[r * ldc];
+    switch(M - r) {     /* the last rows */
+#if SMALL_MR > 6
+        case 7: sgemm_small_tile(7, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 6: sgemm_small_tile(6, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+#endif
+        case 5: sgemm_small_tile(5, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 4: sgemm_small_tile(4, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 3: sgemm_small_tile(3, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 2: sgemm_small_tile(2, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 1: sgemm_small_tile(1, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        default: break;
+    }
+#endif // sgemm_small
+}
+
+SIMD_INLINE void sgemm_small_body(const int M, const int N, const int K, const int ku,
+        const float alpha, const float* A, const int rsA, const int csA, const float* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+#if INSTLEVEL >= 6
+    const int NR = SMALL_NV * VS_LEN, N_full = N / NR * NR;
+    for(int c = 0; c < N_full; c += NR)
+        sgemm_small_panel(M, NR, 0, K, ku, alpha, A, rsA, csA, &B[c], ldb, beta, &C[c], ldc);
+    if(N_full < N)
+        sgemm_small_panel(M, N - N_full, 1, K, ku, alpha, A, rsA, csA, &B[N_full], ldb, beta, &C[N_full], ldc);
+#endif // sgemm_small
+}
+
+void sgemm_small(const int M, const int N, const int K, const float alpha,
+        const float* A, const int rsA, const int csA, const float* B, const int ldb,
+        const float beta, float* C, const int ldc) {
+    sgemm_small_body(M, N, K, 1, alpha, A, rsA, csA, B, ldb, beta, C, ldc);
+}
+
+/* see sgemm_small_tile */
+SIMD_INLINE void dgemm_small_tile(const int mr, const int n, const int masked, const int K, const int ku,
+        const double alpha, const double* A, const int rsA, const int csA, const double* B, const int ldb,
+        const double beta, double* C, const int ldc) {
+#if INSTLEVEL >= 6
+    vd_t acc[SMALL_MR][SMALL_NV], a, b[SMALL_NV];
+    vd_mask_t mask[SMALL_NV];
+#pragma GCC unroll 4
+    for(int v = 0; v < SMALL_NV; v++)
+        mask[v] = vd_mask(n - v * VD_LEN);
+#pragma GCC unroll 16
+    for(int r = 0; r < mr; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < SMALL_NV; v++)
+            acc[r][v] = vd_zero();
+    for(int k0 = 0; k0 < K; k0 += ku) {
+#pragma GCC unroll 256
+        for(int k = k0; k < k0 + ku; k++) {
+#pragma GCC unroll 4
+            for(int v = 0; v < SMALL_NV; v++)
+                b[v] = masked ? vd_maskz_loadu(mask[v], &B[k * ldb + v * VD_LEN])
+                              : vd_loadu(&B[k * ldb + v * VD_LEN]);
+#pragma GCC unroll 16
+            for(int r = 0; r < mr; r++) {
+                a = vd_set1(A[r * rsA + k * csA]);
+#pragma GCC unroll 4
+                for(int v = 0; v < SMALL_NV; v++)
+                    acc[r][v] = vd_fma(a, b[v], acc[r][v]);
+            }
+        }
+    }
+    const vd_t alpha_v = vd_set1(alpha), beta_v = vd_set1(beta);
+#pragma GCC unroll 16
+    for(int r = 0; r < mr; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < SMALL_NV; v++) {
+            double* C_rv = &C[r * ldc + v * VD_LEN];
+            acc[r][v] = vd_mul(alpha_v, acc[r][v]);
+            if(beta != 0)
+                acc[r][v] = vd_fma(beta_v, masked ? vd_maskz_loadu(mask[v], C_rv) : vd_loadu(C_rv), acc[r][v]);
+            if(masked)
+                vd_mask_storeu(C_rv, mask[v], acc[r][v]);
+            else
+                vd_storeu(C_rv, acc[r][v]);
+        }
+#endif // dgemm_small
+}
+
+/* see sgemm_small_panel */
+SIMD_INLINE void dgemm_small_panel(const int M, const int n, const int masked, const int K, const int ku,
+        const double alpha, const double* A, const int rsA, const int csA, const double* B, const int ldb,
+        const double beta, double* C, const int ldc) {
+#if INSTLEVEL >= 6
+    const int r = M / SMALL_MR * SMALL_MR;
+    for(int i = 0; i < r; i += SMALL_MR)
+        dgemm_small_tile(SMALL_MR, n, masked, K, ku, alpha, &A[i * rsA], rsA, csA, B, ldb, beta, &C[i * ldc], ldc);
+    const double* A_r = &A[r * rsA];
+    double* C_r = &C[r * ldc];
+    switch(M - r) {     /* the last rows */
+#if SMALL_MR > 6
+        case 7: dgemm_small_tile(7, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 6: dgemm_small_tile(6, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+#endif
+        case 5: dgemm_small_tile(5, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 4: dgemm_small_tile(4, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 3: dgemm_small_tile(3, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 2: dgemm_small_tile(2, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        case 1: dgemm_small_tile(1, n, masked, K, ku, alpha, A_r, rsA, csA, B, ldb, beta, C_r, ldc); break;
+        default: break;
+    }
+#endif // dgemm_small
+}
+
+void dgemm_small(const int M, const int N, const int K, const double alpha,
+        const double* A, const int rsA, const int csA, const double* B, const int ldb,
+        const double beta, double* C, const int ldc) {
+#if INSTLEVEL >= 6
+    const int NR = SMALL_NV * VD_LEN, N_full = N / NR * NR;
+    for(int c = 0; c < N_full; c += NR)
+        dgemm_small_panel(M, NR, 0, K, 1, alpha, A, rsA, csA, &B[c], ldb, beta, &C[c], ldc);
+    if(N_full < N)
+        dgemm_small_panel(M, N - N_full, 1, K, 1, alpha, A, rsA, csA, &B[N_full], ldb, beta, &C[N_full], ldc);
+#endif // dgemm_small
+}
+
+/**
+ * Kernels for the shapes of GEMM_FIXED_SHAPES, see sgemm_fixed_find in [gemm.c]. Each
+ * shape up to GEMM_SMALL_MNK gets sgemm_small with M, N, K and the unrolling as
+ * constants, and every shape a skernel for
+ * the packed path on full MR x NR tiles with kc == KC, its k loop unrolled KU times and
+ * no masks. Tiles cut by the edges of the blocks, or of C, go to skernel.
+ */
+#if INSTLEVEL >= 8      /* AVX512F */   /* as skernel */
+#define SKERNEL_MR 14
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+#define SKERNEL_MR 6
+#endif
+#define SKERNEL_NV 2
+
+/* skernel on a full tile, with [kc] and [ku] constants once inlined */
+SIMD_INLINE void skernel_tile(const int kc, const int ku,
+        const float* packed_blockA, const float* packed_blockB, float* C, const int ldc,
+        const float alpha, const float beta, const gemm_epilogue_t* epi, const int* C_rows) {
+#if INSTLEVEL >= 6
+    vs_t acc[SKERNEL_MR][SKERNEL_NV], a, b[SKERNEL_NV];
+#pragma GCC unroll 16
+    for(int r = 0; r < SKERNEL_MR; r++)
+#pragma GCC unroll 4
+        for(int v = 0; v < SKERNEL_NV; v++)
+            acc[r][v] = vs_zero();
+    for(int k0 = 0; k0 < kc; k0 += ku) {
+#pragma GCC unroll 256
+        for(int k = k0; k < k0 + ku; k++) {
+#pragma GCC unroll 4
+            for(int v = 0; v < SKERNEL_NV; v++)
+                b[v] = vs_loadu(&packed_blockB[k * SKERNEL_NV * VS_LEN + v * VS_LEN]);
+#pragma GCC unroll 16
+            for(int r = 0; r < SKERNEL_MR; r++) {
+                a = vs_bcast(&packed_blockA[k * SKERNEL_MR + r]);
+#pragma GCC unroll 4
+                for(int v = 0; v < SKERNEL_NV; v++)
+                    acc[r][v] = vs_fma(a, b[v], acc[r][v]);
+            }
+        }
+    }
+    const vs_t alpha_v = vs_set1(alpha), beta_v = vs_set1(beta);
+#pragma GCC unroll 16
+    for(int r = 0; r < SKERNEL_MR; r++) {
+        float* C_r = &C[((C_rows != NULL) ? C_rows[r] : r) * ldc];
+#pragma GCC unroll 4
+        for(int v = 0; v < SKERNEL_NV; v++) {
+            acc[r][v] = vs_mul(alpha_v, acc[r][v]);
+            if(beta != 0)
+                acc[r][v] = vs_fma(beta_v, vs_loadu(&C_r[v * VS_LEN]), acc[r][v]);
+            if(epi != NULL)
+                acc[r][v] = vs_epilogue(epi, acc[r][v], r, v * VS_LEN, vs_mask(VS_LEN));
+            vs_storeu(&C_r[v * VS_LEN], acc[r][v]);
+        }
+    }
+#endif // skernel_tile
+}
+
+#define SGEMM_FIXED(M, N, K, KC, KU) \
+    _Static_assert((K) % (KC) == 0 && (KC) % (KU) == 0, \
+                   "GEMM_FIXED_SHAPES: KC must divide K and KU must divide KC"); \
+    static void sgemm_small_##M##x##N##x##K(const float alpha, \
+            const float* A, const int rsA, const int csA, const float* B, const int ldb, \
+            const float beta, float* C, const int ldc) { \
+        sgemm_small_body(M, N, K, KU, alpha, A, rsA, csA, B, ldb, beta, C, ldc); \
+    } \
+    static void skernel_##M##x##N##x##K(const float* packed_blockA, const float* packed_blockB, \
+            float* C, const int m, const int kc, const int n, const int ldc, \
+            const float alpha, const float beta, const gemm_epilogue_t* epi, const int* C_rows) { \
+        if(m == SKERNEL_MR && n == SKERNEL_NV * VS_LEN && kc == (KC)) \
+            skernel_tile(KC, KU, packed_blockA, packed_blockB, C, ldc, alpha, beta, epi, C_rows); \
+        else \
+            skernel(packed_blockA, packed_blockB, C, m, kc, n, ldc, alpha, beta, epi, C_rows); \
+    }
+/* shapes above the default small_mnk only get the packed kernel; the other one is dropped */
+#define SGEMM_FIXED_ENTRY(M, N, K, KC, KU) \
+    {M, N, K, KC, ((int64_t)(M) * (N) * (K) <= GEMM_SMALL_MNK) ? sgemm_small_##M##x##N##x##K : NULL, \
+     skernel_##M##x##N##x##K},
+
+#if INSTLEVEL >= 6
+GEMM_FIXED_SHAPES(SGEMM_FIXED)
+#endif
+
+/* ends with M == 0 */
+const gemm_fixed_t sgemm_fixed[] = {
+#if INSTLEVEL >= 6
+    GEMM_FIXED_SHAPES(SGEMM_FIXED_ENTRY)
+#endif
+    {0}
+};
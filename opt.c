@@ -50,9 +50,21 @@ void get_cache_size(size_t* cache_size) {
     }
 }
 
-void set_block_size(size_t* cache_size, const int NTHREADS,
+/* threads of NTHREADS sharing one of [ngroups] caches, all of them if unknown */
+static int cache_sharers(const int NTHREADS, const int ngroups) {
+    return (ngroups > 0) ? max(1, (NTHREADS + ngroups - 1) / ngroups) : NTHREADS;
+}
+
+/**
+ * Each thread's part of the MC x KC block of A has to fit in the L2 it shares with
+ * the threads on the same L2, and its part of the B panel in its L3 likewise. Without
+ * a topology every cache is taken as shared by all NTHREADS.
+ */
+void set_block_size(size_t* cache_size, const int NTHREADS, const gemm_topo_t* topo,
                     const int MR, const int NR,
                     int* MC, int* KC, int* NC, D_TYPE d_type) {
+    const int l2_sharers = cache_sharers(NTHREADS, (topo != NULL) ? topo->nl2 : 0);
+    const int l3_sharers = cache_sharers(NTHREADS, (topo != NULL) ? topo->nl3 : 0);
     float MC_f = (*MC), NC_f = (*NC);
     int d_size = 0;
     if(d_type == D_FP32)        d_size = sizeof(float);
@@ -60,19 +72,23 @@ void set_block_size(size_t* cache_size, const int NTHREADS,
     else if(d_type == D_INT32)  d_size = sizeof(int32_t);
     else if(d_type == D_INT16)  d_size = sizeof(int16_t);
     else if(d_type == D_INT8)   d_size = sizeof(int8_t);
+    else if(d_type == D_INT8_S32) d_size = sizeof(int8_t);
+    else if(d_type == D_INT16_S32) d_size = sizeof(int16_t);
+    else if(d_type == D_BF16)   d_size = sizeof(float);     /* widened, except on AVX512_BF16 */
+    else if(d_type == D_FP16)   d_size = sizeof(float);     /* widened */
 
     if(cache_size[1] != 0) {
         (*KC) = cache_size[1] / (NR * d_size);      // L1 = KC * NR
     }
     if(cache_size[2] != 0) {
         MC_f = cache_size[2] / ((*KC) * d_size);   // L2 = MC * KC
-        MC_f /= (MR * NTHREADS);
-        (*MC) = round(MC_f) * MR * NTHREADS;
+        MC_f /= (MR * l2_sharers);
+        (*MC) = max(1, round(MC_f)) * MR * NTHREADS;
     }
     if(cache_size[3] != 0) {
-        NC_f = cache_size[3] / ((*MC) * d_size);   // L3 = NC * KC
-        NC_f /= (NR * NTHREADS);
-        (*NC) = round(NC_f) * NR * NTHREADS;
+        NC_f = cache_size[3] / ((*KC) * d_size);   // L3 = NC * KC
+        NC_f /= (NR * l3_sharers);
+        (*NC) = max(1, round(NC_f)) * NR * NTHREADS;
     }
 
 #if DEBUG
@@ -86,7 +102,7 @@ void cache_opt(const int NTHREADS, const int MR, const int NR,
                int* MC, int* KC, int* NC, D_TYPE d_type) {
     size_t cache_size[32];
     get_cache_size(cache_size);
-    set_block_size(cache_size, NTHREADS, MR, NR, &(*MC), &(*KC), &(*NC), d_type);
+    set_block_size(cache_size, NTHREADS, NULL, MR, NR, &(*MC), &(*KC), &(*NC), d_type);
 #if DEBUG
     printf("L1 size: %ld bytes\n", cache_size[1]);
     printf("L2 size: %ld bytes\n", cache_size[2]);
@@ -94,16 +110,58 @@ void cache_opt(const int NTHREADS, const int MR, const int NR,
 #endif
 }
 
+/* threads a gemm call runs on, see [topo.c] */
 int get_core_num() {
-    uint32_t eax=0x1, ebx=0, ecx=0, edx=0;
+    gemm_topo_t topo;
+    get_topology(&topo);
+    return topo.nthreads;
+}
 
-    __asm__ (
-      "cpuid" 
-      : "+a" (eax) , "=b" (ebx) , "+c" (ecx) , "=d" (edx)
-    );
+/**
+ * Split NTHREADS over the loops of the 5-loop nest, BLIS style.
+ * 
+ * Threads go to the 2nd (ir, MR rows) and 1st (jr, NR columns) loops so that the
+ * busiest thread gets as few MR x NR tiles as possible. With a short M most of them
+ * land on jr, so every thread has work even when M is a single micro-panel.
+ * 
+ * When M is that short and B still has to be packed, packing B is most of the work,
+ * so the 5th loop (jc) is split instead: every thread packs and multiplies its own
+ * slab of columns with no barrier between the two.
+ */
+void set_partition(const int NTHREADS, const int M, const int N,
+                   const int MR, const int NR, const int MC, const int NC,
+                   const BOOL pack_B, gemm_part_t* part) {
+    const int m_panels = (min(M, MC) + MR - 1) / MR;
+    const int n_panels = (min(N, NC) + NR - 1) / NR;
+    part->jc_ways = 1, part->ir_ways = 1, part->jr_ways = 1;
+    if(NTHREADS <= 1)
+        return;
+
+    if(pack_B && m_panels < NTHREADS && (N + NR - 1) / NR >= 4 * NTHREADS) {
+        part->jc_ways = NTHREADS;
+        return;
+    }
+
+    long best = LONG_MAX;
+    for(int ir = 1; ir <= NTHREADS; ir++) {
+        if(NTHREADS % ir != 0)
+            continue;
+        const int jr = NTHREADS / ir;
+        const long tiles = (long)((m_panels + ir - 1) / ir) * ((n_panels + jr - 1) / jr);
+        if(tiles < best)
+            best = tiles, part->ir_ways = ir, part->jr_ways = jr;
+    }
+    /* a thread without a tile only costs a wake-up */
+    part->ir_ways = max(1, min(part->ir_ways, m_panels));
+    part->jr_ways = max(1, min(part->jr_ways, n_panels));
 
 #if DEBUG
-    printf("NTHREADS: %d\n", ((ebx >> 16) & 0xFF));
+    printf("jc: %d ir: %d jr: %d\n", part->jc_ways, part->ir_ways, part->jr_ways);
 #endif
-    return ((ebx >> 16) & 0xFF); // the number of logical processors
+}
+
+/* [start, end) of the [id]-th of [ways] near-equal parts of [0, n) */
+void set_range(const int n, const int ways, const int id, int* start, int* end) {
+    (*start) = (int)((long)n * id / ways);
+    (*end)   = (int)((long)n * (id + 1) / ways);
 }
\ No newline at end of file
@@ -6,227 +6,1185 @@
  * Description: 
  *      This file contains implementations of functions for packing blocks of matrices
  *      into a format optimized for TLB efficiency in GEMM operations.
+ * 
+ *      Blocks are packed as micro-panels (GotoBLAS/BLIS format), so a kernel reads
+ *      both of its operands strictly sequentially:
+ *        - A (mc x kc) is split into MR-row slivers. Each sliver is stored column
+ *          by column, A(r, k) at [k * MR + r].
+ *        - B (kc x nc) is split into NR-column slivers. Each sliver is stored row
+ *          by row, B(k, c) at [k * NR + c].
+ *        - Sliver i starts at [i * MR * kc] (or [i * NR * kc]).
+ *        - The last sliver is zero-padded to MR (or NR), so kernels always run the
+ *          full tile and only mask the write-back to C.
  *                                                    
 **********************************************************************************************/
 
 #include "gemm.h"
 
-void spack_blockB(const float* B, float* packed_B, const int NR, 
-                 const int nc, const int NC, const int N, 
-                 const int kc, const int NTHREADS) {
+/* how many rows of B ahead to prefetch while packing */
+#define PREFETCH_ROWS 4
+
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+/**
+ * Copy one row of a B sliver with the widest loads and stores available.
+ * B is read once per packed block, so its rows are prefetched with the NTA hint
+ * to keep them from pushing the packed blocks out of the caches.
+ */
+static inline void pack_row(void* dst, const void* src, const int bytes) {
+    char* d = (char* )dst;
+    const char* s = (const char* )src;
+    int b = 0;
+#if INSTLEVEL >= 8 /* AVX512F */
+    for(; b + 64 <= bytes; b += 64)
+        _mm512_storeu_si512((void* )(d + b), _mm512_loadu_si512((const void* )(s + b)));
+#endif
+    for(; b + 32 <= bytes; b += 32)
+        _mm256_storeu_si256((__m256i_u* )(d + b), _mm256_loadu_si256((const __m256i_u* )(s + b)));
+    if(b < bytes)
+        memcpy(d + b, s + b, bytes - b);
+}
+
+static inline void transpose8x8_ps(__m256 r[8]) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+/**
+ * Pack a full sliver of row-major 32-bit elements (float and int).
+ * Every 8 columns, the sliver is transposed in registers as 8x8 tiles; MR = 14
+ * is done as an 8-row and a 6-row tile, MR = 6 as a single 6-row tile.
+ * The shuffles only move bits, so this is exact for int as well.
+ * Row i of the sliver is row [row_idx[i]] of A if [row_idx] is set, row i otherwise.
+ */
+static void pack_sliverA_32(const float* A, const int* row_idx, float* packed_A,
+                            const int kc, const int MR, const int rs) {
+    const __m256i mask_6 = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+    const float* row_A[16];
+    int Ap_col = 0;
+
+    for(int i = 0; i < MR; i++)
+        row_A[i] = &A[((row_idx != NULL) ? row_idx[i] : i) * rs];
+    for(; Ap_col + 8 <= kc; Ap_col += 8) {
+        for(int Ap_row = 0; Ap_row < MR; Ap_row += 8) {
+            const int rows = min(8, MR - Ap_row);
+            __m256 r[8];
+            for(int i = 0; i < 8; i++)
+                r[i] = (i < rows) ? _mm256_loadu_ps(&row_A[Ap_row + i][Ap_col]) : _mm256_setzero_ps();
+            transpose8x8_ps(r);
+            for(int j = 0; j < 8; j++) {
+                if(rows == 8)
+                    _mm256_storeu_ps(&packed_A[(Ap_col + j) * MR + Ap_row], r[j]);
+                else
+                    _mm256_maskstore_ps(&packed_A[(Ap_col + j) * MR + Ap_row], mask_6, r[j]);
+            }
+        }
+    }
+    for(; Ap_col < kc; Ap_col++)
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = row_A[Ap_row][Ap_col];
+}
+
+/**
+ * Pack a full 6-row sliver of row-major doubles: rows 0-3 as a 4x4 transpose,
+ * rows 4-5 as interleaved pairs.
+ */
+static void pack_sliverA_64(const double* A, double* packed_A,
+                            const int kc, const int rs) {
+    int Ap_col = 0;
+
+    for(; Ap_col + 4 <= kc; Ap_col += 4) {
+        __m256d r0 = _mm256_loadu_pd(&A[0 * rs + Ap_col]);
+        __m256d r1 = _mm256_loadu_pd(&A[1 * rs + Ap_col]);
+        __m256d r2 = _mm256_loadu_pd(&A[2 * rs + Ap_col]);
+        __m256d r3 = _mm256_loadu_pd(&A[3 * rs + Ap_col]);
+        __m256d r4 = _mm256_loadu_pd(&A[4 * rs + Ap_col]);
+        __m256d r5 = _mm256_loadu_pd(&A[5 * rs + Ap_col]);
+
+        __m256d t0 = _mm256_unpacklo_pd(r0, r1);    /* 00 10 02 12 */
+        __m256d t1 = _mm256_unpackhi_pd(r0, r1);    /* 01 11 03 13 */
+        __m256d t2 = _mm256_unpacklo_pd(r2, r3);    /* 20 30 22 32 */
+        __m256d t3 = _mm256_unpackhi_pd(r2, r3);    /* 21 31 23 33 */
+        __m256d t4 = _mm256_unpacklo_pd(r4, r5);    /* 40 50 42 52 */
+        __m256d t5 = _mm256_unpackhi_pd(r4, r5);    /* 41 51 43 53 */
+
+        double* dst = &packed_A[Ap_col * 6];
+        _mm256_storeu_pd(dst + 0,  _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm_storeu_pd(dst + 4,     _mm256_castpd256_pd128(t4));
+        _mm256_storeu_pd(dst + 6,  _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm_storeu_pd(dst + 10,    _mm256_castpd256_pd128(t5));
+        _mm256_storeu_pd(dst + 12, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm_storeu_pd(dst + 16,    _mm256_extractf128_pd(t4, 1));
+        _mm256_storeu_pd(dst + 18, _mm256_permute2f128_pd(t1, t3, 0x31));
+        _mm_storeu_pd(dst + 22,    _mm256_extractf128_pd(t5, 1));
+    }
+    for(; Ap_col < kc; Ap_col++)
+        for(int Ap_row = 0; Ap_row < 6; Ap_row++)
+            packed_A[Ap_col * 6 + Ap_row] = A[Ap_row * rs + Ap_col];
+}
+
+/* 8 rows of 8 int16 to 8 columns: 16-bit, then 32-bit, then 64-bit pairs interleaved */
+static inline void transpose8x8_epi16(__m128i r[8]) {
+    __m128i t0 = _mm_unpacklo_epi16(r[0], r[1]);   /* 00 10 01 11 02 12 03 13 */
+    __m128i t1 = _mm_unpackhi_epi16(r[0], r[1]);   /* 04 14 05 15 06 16 07 17 */
+    __m128i t2 = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i t3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i t4 = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i t5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i t6 = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i t7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+    __m128i u0 = _mm_unpacklo_epi32(t0, t2);       /* 00 10 20 30 01 11 21 31 */
+    __m128i u1 = _mm_unpackhi_epi32(t0, t2);       /* 02 12 22 32 03 13 23 33 */
+    __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+    __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+    __m128i u4 = _mm_unpacklo_epi32(t4, t6);       /* 40 50 60 70 41 51 61 71 */
+    __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+    __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+    __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+    r[0] = _mm_unpacklo_epi64(u0, u4);
+    r[1] = _mm_unpackhi_epi64(u0, u4);
+    r[2] = _mm_unpacklo_epi64(u1, u5);
+    r[3] = _mm_unpackhi_epi64(u1, u5);
+    r[4] = _mm_unpacklo_epi64(u2, u6);
+    r[5] = _mm_unpackhi_epi64(u2, u6);
+    r[6] = _mm_unpacklo_epi64(u3, u7);
+    r[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+/**
+ * Pack a full sliver of row-major int16. Every 8 columns, the sliver is transposed in
+ * registers as 8x8 tiles, so MR = 30 is three 8-row tiles and a 6-row one, and MR = 5 a
+ * single 5-row tile; the missing rows of a tile are zero and aren't stored.
+ */
+static void pack_sliverA_16(const int16_t* A, int16_t* packed_A,
+                            const int kc, const int MR, const int rs) {
+    int Ap_col = 0;
+
+    for(; Ap_col + 8 <= kc; Ap_col += 8) {
+        for(int Ap_row = 0; Ap_row < MR; Ap_row += 8) {
+            const int rows = min(8, MR - Ap_row);
+            __m128i r[8];
+            for(int i = 0; i < 8; i++)
+                r[i] = (i < rows) ? _mm_loadu_si128((const __m128i_u* )&A[(Ap_row + i) * rs + Ap_col])
+                                  : _mm_setzero_si128();
+            transpose8x8_epi16(r);
+            for(int j = 0; j < 8; j++) {
+                int16_t* dst = &packed_A[(Ap_col + j) * MR + Ap_row];
+                if(rows == 8) {
+                    _mm_storeu_si128((__m128i_u* )dst, r[j]);
+                }
+                else {
+                    int16_t col[8];
+                    _mm_storeu_si128((__m128i_u* )col, r[j]);
+                    memcpy(dst, col, rows * sizeof(int16_t));
+                }
+            }
+        }
+    }
+    for(; Ap_col < kc; Ap_col++)
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+}
+
+/**
+ * Pack a full sliver of row-major int8, as pack_sliverA_16 does: 8 rows of 8 columns
+ * are loaded into the low halves of the registers and 8-, 16- and 32-bit pairs
+ * interleaved, after which columns 2j and 2j + 1 are the halves of one register.
+ */
+static void pack_sliverA_8(const int8_t* A, int8_t* packed_A,
+                           const int kc, const int MR, const int rs) {
+    int Ap_col = 0;
+
+    for(; Ap_col + 8 <= kc; Ap_col += 8) {
+        for(int Ap_row = 0; Ap_row < MR; Ap_row += 8) {
+            const int rows = min(8, MR - Ap_row);
+            __m128i r[8];
+            for(int i = 0; i < 8; i++)
+                r[i] = (i < rows) ? _mm_loadl_epi64((const __m128i_u* )&A[(Ap_row + i) * rs + Ap_col])
+                                  : _mm_setzero_si128();
+
+            __m128i t0 = _mm_unpacklo_epi8(r[0], r[1]);    /* 00 10 01 11 .. 07 17 */
+            __m128i t1 = _mm_unpacklo_epi8(r[2], r[3]);
+            __m128i t2 = _mm_unpacklo_epi8(r[4], r[5]);
+            __m128i t3 = _mm_unpacklo_epi8(r[6], r[7]);
+            __m128i u0 = _mm_unpacklo_epi16(t0, t1);       /* 00 10 20 30 01 11 21 31 .. 03 13 23 33 */
+            __m128i u1 = _mm_unpackhi_epi16(t0, t1);       /* columns 4-7 of rows 0-3 */
+            __m128i u2 = _mm_unpacklo_epi16(t2, t3);       /* columns 0-3 of rows 4-7 */
+            __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+            __m128i cols[4] = {
+                _mm_unpacklo_epi32(u0, u2),                 /* columns 0 and 1 */
+                _mm_unpackhi_epi32(u0, u2),                 /* columns 2 and 3 */
+                _mm_unpacklo_epi32(u1, u3),
+                _mm_unpackhi_epi32(u1, u3)
+            };
+            for(int j = 0; j < 8; j++) {
+                int8_t* dst = &packed_A[(Ap_col + j) * MR + Ap_row];
+                const __m128i col = (j % 2 == 0) ? cols[j / 2] : _mm_unpackhi_epi64(cols[j / 2], cols[j / 2]);
+                if(rows == 8) {
+                    _mm_storel_epi64((__m128i_u* )dst, col);
+                }
+                else {
+                    int8_t tmp[16];
+                    _mm_storeu_si128((__m128i_u* )tmp, col);
+                    memcpy(dst, tmp, rows * sizeof(int8_t));
+                }
+            }
+        }
+    }
+    for(; Ap_col < kc; Ap_col++)
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+}
+#endif /* INSTLEVEL */
+
+void spack_blockB(const float* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
-    for(int Bb_row = 0; Bb_row < nc; Bb_row += NR) {
-        int nr = min(NR, nc - Bb_row);
-        spack_panelB(&B[Bb_row], &packed_B[Bb_row], nr, NC, N, kc);
+    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) { /* split block to small panels */
+        int nr = min(NR, nc - Bb_col);
+        spack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
     }
 }
 
 void spack_blockA(const float* A, float* packed_A, const int MR,
-                const int mc, const int kc, const int KC, 
-                const int K, const int NTHREADS) {
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
     for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) { /* split block to small panels */
         int mr = min(MR, mc - Ab_row);
-        spack_panelA(&A[Ab_row * K], &packed_A[Ab_row * KC], mr, kc, KC, K);
+        spack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
 
-void spack_panelB(const float* B, float* packed_B, const int nr, 
-                  const int NC, const int N, const int kc) {
-    for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
-        for(int Bp_col = 0; Bp_col < nr; Bp_col++) {
-            packed_B[Bp_row * NC + Bp_col] = B[Bp_row * N + Bp_col];
-        }
-        // for (int Bp_col = nr; Bp_col < 16; Bp_col++) {
-        //     *packed_B++ = 0;
-        // }
+/* share [id] of [ways] of a block, packed by one thread of a running parallel region */
+void spack_blockB_part(const float* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        spack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
     }
 }
 
-void spack_panelA(const float* A, float* packed_A, const int mr, 
-                const int kc, const int KC, const int K) {
-    for(int Ap_row = 0; Ap_row < mr; Ap_row++) {    
-        for(int Ap_col = 0; Ap_col < kc; Ap_col++) {   
-            packed_A[Ap_row * KC + Ap_col] = A[Ap_row * K + Ap_col];
+void spack_blockA_part(const float* A, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        spack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
+    }
+}
+
+/**
+ * B(k, n) is read from B[k * rs + n * cs], so a transposed or strided B
+ * is packed directly without copying it first.
+ */
+void spack_panelB(const float* B, float* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR) {                               /* full sliver: wide copy */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            pack_row(&packed_B[Bp_row * NR], &B[Bp_row * rs], NR * sizeof(float));
         }
-        // for (int i = mr; i < 6; i++) {
-            // *packed_A++ = 0;
-        // }
+        return;
+    }
+#endif
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+            for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col * cs];
+    }
+    if(nr < NR) {                                          /* zero-pad the last sliver */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = nr; Bp_col < NR; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = 0;
+    }
+}
+
+/**
+ * A(m, k) is read from A[m * rs + k * cs].
+ */
+void spack_panelA(const float* A, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR && (MR == 6 || MR == 14)) {      /* full sliver: transpose in registers */
+        pack_sliverA_32((const float* )A, NULL, (float* )packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    if(rs == 1 && mr == MR) {                               /* columns of the sliver are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            memcpy(&packed_A[Ap_col * MR], &A[Ap_col * cs], MR * sizeof(float));
+        return;
+    }
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+            for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col * cs];
+    }
+    if(mr < MR) {                                          /* zero-pad the last sliver */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = mr; Ap_row < MR; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = 0;
+    }
+}
+
+/**
+ * spack_blockA_part on gathered rows: row r of the block is row [rows[r]] of A,
+ * so the rows are packed straight from where they are (see sgemm_gather).
+ */
+void spack_blockA_rows_part(const float* A, const int* rows, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        spack_panelA_rows(A, &rows[Ab_row], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
-void dpack_blockB(const double* B, double* packed_B, const int NR, 
-                const int nc, const int NC, const int N, 
-                const int kc, const int NTHREADS) {
+
+void spack_panelA_rows(const float* A, const int* rows, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR && (MR == 6 || MR == 14)) {      /* full sliver: transpose in registers */
+        pack_sliverA_32(A, rows, packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    for(int Ap_row = 0; Ap_row < mr; Ap_row++) {
+        const float* row_A = &A[rows[Ap_row] * rs];
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            packed_A[Ap_col * MR + Ap_row] = row_A[Ap_col * cs];
+    }
+    if(mr < MR) {                                          /* zero-pad the last sliver */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = mr; Ap_row < MR; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = 0;
+    }
+}
+
+void dpack_blockB(const double* B, double* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
-    for(int Bb_row = 0; Bb_row < nc; Bb_row += NR) {
-        int nr = min(NR, nc - Bb_row);
-        dpack_panelB(&B[Bb_row], &packed_B[Bb_row], nr, NC, N, kc);
+    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) { /* split block to small panels */
+        int nr = min(NR, nc - Bb_col);
+        dpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
     }
 }
 
 void dpack_blockA(const double* A, double* packed_A, const int MR,
-                const int mc, const int kc, const int KC, 
-                const int K, const int NTHREADS) {
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
     for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) { /* split block to small panels */
         int mr = min(MR, mc - Ab_row);
-        dpack_panelA(&A[Ab_row * K], &packed_A[Ab_row * KC], mr, kc, KC, K);
+        dpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
 
-void dpack_panelB(const double* B, double* packed_B, const int nr, 
-                const int NC, const int N, const int kc) {
-    for(int Bp_row = 0; Bp_row < kc; Bp_row++) {            /* row access */
-        for(int Bp_col = 0; Bp_col < nr; Bp_col++) {     /* Bp_col access */
-            packed_B[Bp_row * NC + Bp_col] = B[Bp_row * N + Bp_col];
-        }
-        // for (int Bp_col = nr; Bp_col < 16; Bp_col++) {
-            // *packed_B++ = 0;
-        // }
+/* share [id] of [ways] of a block, packed by one thread of a running parallel region */
+void dpack_blockB_part(const double* B, double* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        dpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
+    }
+}
+
+void dpack_blockA_part(const double* A, double* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        dpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
 
-void dpack_panelA(const double* A, double* packed_A, const int mr, 
-                const int kc, const int KC, const int K) {
-    for(int Ap_row = 0; Ap_row < mr; Ap_row++) {    /* row access */
-        for(int Ap_col = 0; Ap_col < kc; Ap_col++) {   /* col access */
-            packed_A[Ap_row * KC + Ap_col] = A[Ap_row * K + Ap_col];
+/**
+ * B(k, n) is read from B[k * rs + n * cs], so a transposed or strided B
+ * is packed directly without copying it first.
+ */
+void dpack_panelB(const double* B, double* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR) {                               /* full sliver: wide copy */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            pack_row(&packed_B[Bp_row * NR], &B[Bp_row * rs], NR * sizeof(double));
         }
-        // for (int i = mr; i < 6; i++) {
-            // *packed_A++ = 0;
-        // }
+        return;
+    }
+#endif
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+            for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col * cs];
+    }
+    if(nr < NR) {                                          /* zero-pad the last sliver */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = nr; Bp_col < NR; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = 0;
     }
 }
 
-void ipack_blockB(const int* B, int* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, 
+/**
+ * A(m, k) is read from A[m * rs + k * cs].
+ */
+void dpack_panelA(const double* A, double* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR && MR == 6) {                    /* full sliver: transpose in registers */
+        pack_sliverA_64(A, packed_A, kc, rs);
+        return;
+    }
+#endif
+    if(rs == 1 && mr == MR) {                               /* columns of the sliver are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            memcpy(&packed_A[Ap_col * MR], &A[Ap_col * cs], MR * sizeof(double));
+        return;
+    }
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+            for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col * cs];
+    }
+    if(mr < MR) {                                          /* zero-pad the last sliver */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = mr; Ap_row < MR; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = 0;
+    }
+}
+
+void ipack_blockB(const int* B, int* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
                   const int kc, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
-    for(int Bb_row = 0; Bb_row < nc; Bb_row += NR) {
-        int nr = min(NR, nc - Bb_row);
-        ipack_panelB(&B[Bb_row], &packed_B[Bb_row], nr, NC, N, kc);
+    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) { /* split block to small panels */
+        int nr = min(NR, nc - Bb_col);
+        ipack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
     }
 }
 
 void ipack_blockA(const int* A, int* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, 
-                  const int K, const int NTHREADS) {
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
     for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) { /* split block to small panels */
         int mr = min(MR, mc - Ab_row);
-        ipack_panelA(&A[Ab_row * K], &packed_A[Ab_row * KC], mr, kc, KC, K);
+        ipack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
 
-void ipack_panelB(const int* B, int* packed_B, const int nr, 
-                  const int NC, const int N, const int kc) {
-    for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
-        for(int Bp_col = 0; Bp_col < nr; Bp_col++) {
-            packed_B[Bp_row * NC + Bp_col] = B[Bp_row * N + Bp_col];
-        }
-        // for (int Bp_col = nr; Bp_col < 16; Bp_col++) {
-            // *packed_B++ = 0;
-        // }
+/* share [id] of [ways] of a block, packed by one thread of a running parallel region */
+void ipack_blockB_part(const int* B, int* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        ipack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
     }
 }
 
-void ipack_panelA(const int* A, int* packed_A, const int mr, 
-                  const int kc, const int KC, const int K) {
-    for(int Ap_row = 0; Ap_row < mr; Ap_row++) {    /* row access */
-        for(int Ap_col = 0; Ap_col < kc; Ap_col++) {   /* col access */
-            packed_A[Ap_row * KC + Ap_col] = A[Ap_row * K + Ap_col];
+void ipack_blockA_part(const int* A, int* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        ipack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
+    }
+}
+
+/**
+ * B(k, n) is read from B[k * rs + n * cs], so a transposed or strided B
+ * is packed directly without copying it first.
+ */
+void ipack_panelB(const int* B, int* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR) {                               /* full sliver: wide copy */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            pack_row(&packed_B[Bp_row * NR], &B[Bp_row * rs], NR * sizeof(int));
         }
-        // for (int i = mr; i < 6; i++) {
-            // *packed_A++ = 0;
-        // }
+        return;
+    }
+#endif
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+            for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col * cs];
+    }
+    if(nr < NR) {                                          /* zero-pad the last sliver */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = nr; Bp_col < NR; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = 0;
     }
 }
 
-void hqpack_blockB(const int16_t* B, int16_t* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, const int kc) {
-    int NTHREADS = 8; 
+/**
+ * A(m, k) is read from A[m * rs + k * cs].
+ */
+void ipack_panelA(const int* A, int* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR && (MR == 6 || MR == 14)) {      /* full sliver: transpose in registers */
+        pack_sliverA_32((const float* )A, NULL, (float* )packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    if(rs == 1 && mr == MR) {                               /* columns of the sliver are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            memcpy(&packed_A[Ap_col * MR], &A[Ap_col * cs], MR * sizeof(int));
+        return;
+    }
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+            for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col * cs];
+    }
+    if(mr < MR) {                                          /* zero-pad the last sliver */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = mr; Ap_row < MR; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = 0;
+    }
+}
+
+void hqpack_blockB(const int16_t* B, int16_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
-    for(int Bb_row = 0; Bb_row < nc; Bb_row += NR) {
-        int nr = min(NR, nc - Bb_row);
-        hqpack_panelB(&B[Bb_row], &packed_B[Bb_row], nr, NC, N, kc);
+    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) { /* split block to small panels */
+        int nr = min(NR, nc - Bb_col);
+        hqpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
     }
 }
 
 void hqpack_blockA(const int16_t* A, int16_t* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, const int K) {
-    int NTHREADS = 8; 
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
     for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) { /* split block to small panels */
         int mr = min(MR, mc - Ab_row);
-        hqpack_panelA(&A[Ab_row * K], &packed_A[Ab_row * KC], mr, kc, KC, K);
+        hqpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
 
-void hqpack_panelB(const int16_t* B, int16_t* packed_B, const int nr, 
-                  const int NC, const int N, const int kc) {
-    for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
-        for(int Bp_col = 0; Bp_col < nr; Bp_col++) {
-            packed_B[Bp_row * NC + Bp_col] = B[Bp_row * N + Bp_col];
-        }
-        // for (int Bp_col = nr; Bp_col < 16; Bp_col++) {
-            // *packed_B++ = 0;
-        // }
+/* share [id] of [ways] of a block, packed by one thread of a running parallel region */
+void hqpack_blockB_part(const int16_t* B, int16_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        hqpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
+    }
+}
+
+void hqpack_blockA_part(const int16_t* A, int16_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        hqpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
     }
 }
 
-void hqpack_panelA(const int16_t* A, int16_t* packed_A, const int mr, 
-                  const int kc, const int KC, const int K) {
-    for(int Ap_row = 0; Ap_row < mr; Ap_row++) {        /* row access */
-        for(int Ap_col = 0; Ap_col < kc; Ap_col++) {    /* col access */
-            packed_A[Ap_row * KC + Ap_col] = A[Ap_row * K + Ap_col];
+/**
+ * B(k, n) is read from B[k * rs + n * cs], so a transposed or strided B
+ * is packed directly without copying it first.
+ */
+void hqpack_panelB(const int16_t* B, int16_t* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR) {                               /* full sliver: wide copy */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            pack_row(&packed_B[Bp_row * NR], &B[Bp_row * rs], NR * sizeof(int16_t));
         }
-        // for (int i = mr; i < 6; i++) {
-            // *packed_A++ = 0;
-        // }
+        return;
+    }
+#endif
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+            for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col * cs];
+    }
+    if(nr < NR) {                                          /* zero-pad the last sliver */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = nr; Bp_col < NR; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = 0;
     }
 }
 
-void qpack_blockB(const int8_t* B, int8_t* packed_B, const int NR, 
-                  const int nc, const int NC, const int N, const int kc) {
-              int NTHREADS = 8; 
+/**
+ * A(m, k) is read from A[m * rs + k * cs].
+ */
+void hqpack_panelA(const int16_t* A, int16_t* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR) {                               /* full sliver: transpose in registers */
+        pack_sliverA_16(A, packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    if(rs == 1 && mr == MR) {                               /* columns of the sliver are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            memcpy(&packed_A[Ap_col * MR], &A[Ap_col * cs], MR * sizeof(int16_t));
+        return;
+    }
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+            for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col * cs];
+    }
+    if(mr < MR) {                                          /* zero-pad the last sliver */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = mr; Ap_row < MR; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = 0;
+    }
+}
+
+void qpack_blockB(const int8_t* B, int8_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
-    for(int Bb_row = 0; Bb_row < nc; Bb_row += NR) {
-        int nr = min(NR, nc - Bb_row);
-        qpack_panelB(&B[Bb_row], &packed_B[Bb_row], nr, NC, N, kc);
-    }          
+    for(int Bb_col = 0; Bb_col < nc; Bb_col += NR) { /* split block to small panels */
+        int nr = min(NR, nc - Bb_col);
+        qpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
+    }
 }
-            
+
 void qpack_blockA(const int8_t* A, int8_t* packed_A, const int MR,
-                  const int mc, const int kc, const int KC, const int K) {
-                 int NTHREADS = 8; 
+                  const int mc, const int kc,
+                  const int rs, const int cs, const int NTHREADS) {
 #pragma omp parallel for num_threads(NTHREADS) schedule(static)
     for(int Ab_row = 0; Ab_row < mc; Ab_row += MR) { /* split block to small panels */
         int mr = min(MR, mc - Ab_row);
-        qpack_panelA(&A[Ab_row * K], &packed_A[Ab_row * KC], mr, kc, KC, K);
-    }       
-}
-            
-void qpack_panelB(const int8_t* B, int8_t* packed_B, const int nr, 
-                  const int NC, const int N, const int kc) {
-    for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
-        for(int Bp_col = 0; Bp_col < nr; Bp_col++) {
-            packed_B[Bp_row * NC + Bp_col] = B[Bp_row * N + Bp_col];
-        }
-        // for (int Bp_col = nr; Bp_col < 16; Bp_col++) {
-            // *packed_B++ = 0;
-        // }
-    }              
-}
-            
-void qpack_panelA(const int8_t* A, int8_t* packed_A, const int mr, 
-                  const int kc, const int KC, const int K) {
-              for(int Ap_row = 0; Ap_row < mr; Ap_row++) {        /* row access */
-        for(int Ap_col = 0; Ap_col < kc; Ap_col++) {    /* col access */
-            packed_A[Ap_row * KC + Ap_col] = A[Ap_row * K + Ap_col];
-        }
-        // for (int i = mr; i < 6; i++) {
-            // *packed_A++ = 0;
-        // }
-    }          
-}
-            
+        qpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
+    }
+}
+
+/* share [id] of [ways] of a block, packed by one thread of a running parallel region */
+void qpack_blockB_part(const int8_t* B, int8_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        qpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
+    }
+}
+
+void qpack_blockA_part(const int8_t* A, int8_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        qpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
+    }
+}
+
+/**
+ * B(k, n) is read from B[k * rs + n * cs], so a transposed or strided B
+ * is packed directly without copying it first.
+ */
+void qpack_panelB(const int8_t* B, int8_t* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR) {                               /* full sliver: wide copy */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            pack_row(&packed_B[Bp_row * NR], &B[Bp_row * rs], NR * sizeof(int8_t));
+        }
+        return;
+    }
+#endif
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Bp_col = 0; Bp_col < nr; Bp_col++)
+            for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+                packed_B[Bp_row * NR + Bp_col] = B[Bp_row * rs + Bp_col * cs];
+    }
+    if(nr < NR) {                                          /* zero-pad the last sliver */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++)
+            for(int Bp_col = nr; Bp_col < NR; Bp_col++)
+                packed_B[Bp_row * NR + Bp_col] = 0;
+    }
+}
+
+/**
+ * A(m, k) is read from A[m * rs + k * cs].
+ */
+void qpack_panelA(const int8_t* A, int8_t* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR) {                               /* full sliver: transpose in registers */
+        pack_sliverA_8(A, packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    if(rs == 1 && mr == MR) {                               /* columns of the sliver are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            memcpy(&packed_A[Ap_col * MR], &A[Ap_col * cs], MR * sizeof(int8_t));
+        return;
+    }
+    if(cs == 1) {                                          /* rows are contiguous */
+        for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+            for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col];
+    }
+    else {                                                 /* columns are contiguous */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = A[Ap_row * rs + Ap_col * cs];
+    }
+    if(mr < MR) {                                          /* zero-pad the last sliver */
+        for(int Ap_col = 0; Ap_col < kc; Ap_col++)
+            for(int Ap_row = mr; Ap_row < MR; Ap_row++)
+                packed_A[Ap_col * MR + Ap_row] = 0;
+    }
+}
+/********************************************************
+ * uint8 x int8 -> int32 (qgemm_s32)
+ *
+ * k is packed in groups of 4 for vpdpbusd: an int32 lane of B holds B(k..k+3, c)
+ * and the int32 of A broadcast against it holds A(r, k..k+3).
+ *   - A(r, k) is at [(k / 4) * MR * 4 + r * 4 + k % 4]
+ *   - B(k, c) is at [(k / 4) * NR * 4 + c * 4 + k % 4]
+ * kc is zero-padded to a multiple of 4, so sliver i starts at [i * MR * kc4]
+ * (or [i * NR * kc4]) with kc4 = roundup(kc, 4).
+ ********************************************************/
+void qipack_blockB_part(const int8_t* B, int8_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    const int kc4 = (kc + 3) / 4 * 4;
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        qipack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc4], nr, NR, rs, cs, kc);
+    }
+}
+
+/* A is xor-ed with [flip] on the way, 0x80 turns int8 into uint8 + 128 */
+void qipack_blockA_part(const uint8_t* A, uint8_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const uint8_t flip, const int id, const int ways) {
+    const int kc4 = (kc + 3) / 4 * 4;
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        qipack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc4], mr, kc, MR, rs, cs, flip);
+    }
+}
+
+void qipack_panelB(const int8_t* B, int8_t* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+    int Bp_row = 0;
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR && NR % 8 == 0) {                /* full sliver: interleave 4 rows */
+        for(; Bp_row + 4 <= kc; Bp_row += 4) {
+            const int8_t* b = &B[Bp_row * rs];
+            int8_t* p = &packed_B[Bp_row * NR];
+            _mm_prefetch((const char* )&b[(PREFETCH_ROWS + 4) * rs], _MM_HINT_NTA);
+            for(int Bp_col = 0; Bp_col < NR; Bp_col += 8) {
+                __m128i r0 = _mm_loadl_epi64((const __m128i_u* )&b[0 * rs + Bp_col]);
+                __m128i r1 = _mm_loadl_epi64((const __m128i_u* )&b[1 * rs + Bp_col]);
+                __m128i r2 = _mm_loadl_epi64((const __m128i_u* )&b[2 * rs + Bp_col]);
+                __m128i r3 = _mm_loadl_epi64((const __m128i_u* )&b[3 * rs + Bp_col]);
+                __m128i r01 = _mm_unpacklo_epi8(r0, r1);    /* k0 k1 of 8 columns */
+                __m128i r23 = _mm_unpacklo_epi8(r2, r3);    /* k2 k3 of 8 columns */
+                _mm_storeu_si128((__m128i_u* )&p[Bp_col * 4 + 0],  _mm_unpacklo_epi16(r01, r23));
+                _mm_storeu_si128((__m128i_u* )&p[Bp_col * 4 + 16], _mm_unpackhi_epi16(r01, r23));
+            }
+        }
+    }
+#endif
+    const int kc4 = (kc + 3) / 4 * 4;
+    for(; Bp_row < kc4; Bp_row += 4)                        /* the rest, zero-padded */
+        for(int Bp_col = 0; Bp_col < NR; Bp_col++)
+            for(int i = 0; i < 4; i++)
+                packed_B[Bp_row * NR + Bp_col * 4 + i] = (Bp_col < nr && Bp_row + i < kc)
+                                                         ? B[(Bp_row + i) * rs + Bp_col * cs] : 0;
+}
+
+void qipack_panelA(const uint8_t* A, uint8_t* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs, const uint8_t flip) {
+    int Ap_col = 0;
+    if(cs == 1) {                                           /* 4 k of a row are contiguous */
+        const uint32_t flip4 = flip * 0x01010101u;
+        for(; Ap_col + 4 <= kc; Ap_col += 4) {
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++) {
+                uint32_t a;
+                memcpy(&a, &A[Ap_row * rs + Ap_col], sizeof(a));
+                a ^= flip4;
+                memcpy(&packed_A[Ap_col * MR + Ap_row * 4], &a, sizeof(a));
+            }
+            memset(&packed_A[Ap_col * MR + mr * 4], 0, (MR - mr) * 4);
+        }
+    }
+    const int kc4 = (kc + 3) / 4 * 4;
+    for(; Ap_col < kc4; Ap_col += 4)                        /* the rest, zero-padded */
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            for(int i = 0; i < 4; i++)
+                packed_A[Ap_col * MR + Ap_row * 4 + i] = (Ap_row < mr && Ap_col + i < kc)
+                                                         ? A[Ap_row * rs + (Ap_col + i) * cs] ^ flip : 0;
+}
+
+/********************************************************
+ * int16 x int16 -> int32 (hqgemm_s32)
+ *
+ * k is packed in pairs for vpmaddwd: an int32 lane of B holds B(k..k+1, c)
+ * and the int32 of A broadcast against it holds A(r, k..k+1).
+ *   - A(r, k) is at [(k / 2) * MR * 2 + r * 2 + k % 2]
+ *   - B(k, c) is at [(k / 2) * NR * 2 + c * 2 + k % 2]
+ * kc is zero-padded to even, so sliver i starts at [i * MR * kc2] (or [i * NR * kc2])
+ * with kc2 = roundup(kc, 2).
+ ********************************************************/
+void hqipack_blockB_part(const int16_t* B, int16_t* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    const int kc2 = (kc + 1) / 2 * 2;
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        hqipack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc2], nr, NR, rs, cs, kc);
+    }
+}
+
+void hqipack_blockA_part(const int16_t* A, int16_t* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    const int kc2 = (kc + 1) / 2 * 2;
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        hqipack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc2], mr, kc, MR, rs, cs);
+    }
+}
+
+void hqipack_panelB(const int16_t* B, int16_t* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+    int Bp_row = 0;
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR && NR % 8 == 0) {                /* full sliver: interleave 2 rows */
+        for(; Bp_row + 2 <= kc; Bp_row += 2) {
+            const int16_t* b = &B[Bp_row * rs];
+            int16_t* p = &packed_B[Bp_row * NR];
+            _mm_prefetch((const char* )&b[(PREFETCH_ROWS + 2) * rs], _MM_HINT_NTA);
+            for(int Bp_col = 0; Bp_col < NR; Bp_col += 8) {
+                __m128i r0 = _mm_loadu_si128((const __m128i_u* )&b[0 * rs + Bp_col]);
+                __m128i r1 = _mm_loadu_si128((const __m128i_u* )&b[1 * rs + Bp_col]);
+                _mm_storeu_si128((__m128i_u* )&p[Bp_col * 2 + 0], _mm_unpacklo_epi16(r0, r1));
+                _mm_storeu_si128((__m128i_u* )&p[Bp_col * 2 + 8], _mm_unpackhi_epi16(r0, r1));
+            }
+        }
+    }
+#endif
+    const int kc2 = (kc + 1) / 2 * 2;
+    for(; Bp_row < kc2; Bp_row += 2)                        /* the rest, zero-padded */
+        for(int Bp_col = 0; Bp_col < NR; Bp_col++)
+            for(int i = 0; i < 2; i++)
+                packed_B[Bp_row * NR + Bp_col * 2 + i] = (Bp_col < nr && Bp_row + i < kc)
+                                                         ? B[(Bp_row + i) * rs + Bp_col * cs] : 0;
+}
+
+void hqipack_panelA(const int16_t* A, int16_t* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+    int Ap_col = 0;
+    if(cs == 1) {                                           /* 2 k of a row are contiguous */
+        for(; Ap_col + 2 <= kc; Ap_col += 2) {
+            for(int Ap_row = 0; Ap_row < mr; Ap_row++)
+                memcpy(&packed_A[Ap_col * MR + Ap_row * 2], &A[Ap_row * rs + Ap_col], 2 * sizeof(int16_t));
+            memset(&packed_A[Ap_col * MR + mr * 2], 0, (MR - mr) * 2 * sizeof(int16_t));
+        }
+    }
+    const int kc2 = (kc + 1) / 2 * 2;
+    for(; Ap_col < kc2; Ap_col += 2)                        /* the rest, zero-padded */
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            for(int i = 0; i < 2; i++)
+                packed_A[Ap_col * MR + Ap_row * 2 + i] = (Ap_row < mr && Ap_col + i < kc)
+                                                         ? A[Ap_row * rs + (Ap_col + i) * cs] : 0;
+}
+/********************************************************
+ * bfloat16 -> fp32 (bf16gemm)
+ *
+ * A bf16 is the upper half of an fp32, so it's widened exactly by a 16-bit shift
+ * on the way into the packed blocks, which are then the fp32 blocks of sgemm and
+ * run on skernel.
+ * With AVX512_BF16 and a short A, bf16gemm keeps bf16 and packs k-pairs with
+ * hqipack_* instead, which only move bits.
+ ********************************************************/
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+/* 8 bf16 at [p] as 8 floats: each one goes into the upper half of a zeroed lane */
+static inline __m256 widen8_bf16(const uint16_t* p) {
+    const __m128i x = _mm_loadu_si128((const __m128i_u* )p);
+    const __m128 lo = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), x));
+    const __m128 hi = _mm_castsi128_ps(_mm_unpackhi_epi16(_mm_setzero_si128(), x));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+/* pack_sliverA_32 reading bf16 */
+static void pack_sliverA_bf16(const uint16_t* A, float* packed_A,
+                              const int kc, const int MR, const int rs) {
+    const __m256i mask_6 = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+    int Ap_col = 0;
+
+    for(; Ap_col + 8 <= kc; Ap_col += 8) {
+        for(int Ap_row = 0; Ap_row < MR; Ap_row += 8) {
+            const int rows = min(8, MR - Ap_row);
+            __m256 r[8];
+            for(int i = 0; i < 8; i++)
+                r[i] = (i < rows) ? widen8_bf16(&A[(Ap_row + i) * rs + Ap_col]) : _mm256_setzero_ps();
+            transpose8x8_ps(r);
+            for(int j = 0; j < 8; j++) {
+                if(rows == 8)
+                    _mm256_storeu_ps(&packed_A[(Ap_col + j) * MR + Ap_row], r[j]);
+                else
+                    _mm256_maskstore_ps(&packed_A[(Ap_col + j) * MR + Ap_row], mask_6, r[j]);
+            }
+        }
+    }
+    for(; Ap_col < kc; Ap_col++)
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = bf16_to_fp32(A[Ap_row * rs + Ap_col]);
+}
+#endif /* INSTLEVEL */
+
+void bf16pack_blockB_part(const uint16_t* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        bf16pack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
+    }
+}
+
+void bf16pack_blockA_part(const uint16_t* A, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        bf16pack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
+    }
+}
+
+void bf16pack_panelB(const uint16_t* B, float* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && nr == NR && NR % 8 == 0) {                /* full sliver: widen 8 at a time */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            for(int Bp_col = 0; Bp_col < NR; Bp_col += 8)
+                _mm256_storeu_ps(&packed_B[Bp_row * NR + Bp_col], widen8_bf16(&B[Bp_row * rs + Bp_col]));
+        }
+        return;
+    }
+#endif
+    for(int Bp_row = 0; Bp_row < kc; Bp_row++)              /* zero-padded to NR */
+        for(int Bp_col = 0; Bp_col < NR; Bp_col++)
+            packed_B[Bp_row * NR + Bp_col] = (Bp_col < nr) ? bf16_to_fp32(B[Bp_row * rs + Bp_col * cs]) : 0;
+}
+
+void bf16pack_panelA(const uint16_t* A, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if INSTLEVEL >= 6 /* AVX, AVX2, AVX512 */
+    if(cs == 1 && mr == MR && (MR == 6 || MR == 14)) {      /* full sliver: transpose in registers */
+        pack_sliverA_bf16(A, packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    for(int Ap_col = 0; Ap_col < kc; Ap_col++)              /* zero-padded to MR */
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = (Ap_row < mr) ? bf16_to_fp32(A[Ap_row * rs + Ap_col * cs]) : 0;
+}
+
+/********************************************************
+ * IEEE fp16 -> fp32 (hgemm)
+ *
+ * Converted with vcvtph2ps (F16C) on the way into the packed blocks, which are then
+ * the fp32 blocks of sgemm and run on skernel (hkernel for fp16 C). Plain AVX has
+ * no F16C and converts in software.
+ ********************************************************/
+#if defined (__F16C__)
+static inline __m256 widen8_fp16(const uint16_t* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i_u* )p));
+}
+
+/* pack_sliverA_32 reading fp16 */
+static void pack_sliverA_fp16(const uint16_t* A, float* packed_A,
+                              const int kc, const int MR, const int rs) {
+    const __m256i mask_6 = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+    int Ap_col = 0;
+
+    for(; Ap_col + 8 <= kc; Ap_col += 8) {
+        for(int Ap_row = 0; Ap_row < MR; Ap_row += 8) {
+            const int rows = min(8, MR - Ap_row);
+            __m256 r[8];
+            for(int i = 0; i < 8; i++)
+                r[i] = (i < rows) ? widen8_fp16(&A[(Ap_row + i) * rs + Ap_col]) : _mm256_setzero_ps();
+            transpose8x8_ps(r);
+            for(int j = 0; j < 8; j++) {
+                if(rows == 8)
+                    _mm256_storeu_ps(&packed_A[(Ap_col + j) * MR + Ap_row], r[j]);
+                else
+                    _mm256_maskstore_ps(&packed_A[(Ap_col + j) * MR + Ap_row], mask_6, r[j]);
+            }
+        }
+    }
+    for(; Ap_col < kc; Ap_col++)
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = fp16_to_fp32(A[Ap_row * rs + Ap_col]);
+}
+#endif // F16C
+
+void hpack_blockB_part(const uint16_t* B, float* packed_B, const int NR,
+                  const int nc, const int rs, const int cs,
+                  const int kc, const int id, const int ways) {
+    int start, end;
+    set_range((nc + NR - 1) / NR, ways, id, &start, &end);
+    for(int Bb_col = start * NR; Bb_col < min(nc, end * NR); Bb_col += NR) {
+        int nr = min(NR, nc - Bb_col);
+        hpack_panelB(&B[Bb_col * cs], &packed_B[Bb_col * kc], nr, NR, rs, cs, kc);
+    }
+}
+
+void hpack_blockA_part(const uint16_t* A, float* packed_A, const int MR,
+                  const int mc, const int kc, const int rs, const int cs,
+                  const int id, const int ways) {
+    int start, end;
+    set_range((mc + MR - 1) / MR, ways, id, &start, &end);
+    for(int Ab_row = start * MR; Ab_row < min(mc, end * MR); Ab_row += MR) {
+        int mr = min(MR, mc - Ab_row);
+        hpack_panelA(&A[Ab_row * rs], &packed_A[Ab_row * kc], mr, kc, MR, rs, cs);
+    }
+}
+
+void hpack_panelB(const uint16_t* B, float* packed_B, const int nr,
+                  const int NR, const int rs, const int cs, const int kc) {
+#if defined (__F16C__)
+    if(cs == 1 && nr == NR && NR % 8 == 0) {                /* full sliver: convert 8 at a time */
+        for(int Bp_row = 0; Bp_row < kc; Bp_row++) {
+            _mm_prefetch((const char* )&B[(Bp_row + PREFETCH_ROWS) * rs], _MM_HINT_NTA);
+            for(int Bp_col = 0; Bp_col < NR; Bp_col += 8)
+                _mm256_storeu_ps(&packed_B[Bp_row * NR + Bp_col], widen8_fp16(&B[Bp_row * rs + Bp_col]));
+        }
+        return;
+    }
+#endif
+    for(int Bp_row = 0; Bp_row < kc; Bp_row++)              /* zero-padded to NR */
+        for(int Bp_col = 0; Bp_col < NR; Bp_col++)
+            packed_B[Bp_row * NR + Bp_col] = (Bp_col < nr) ? fp16_to_fp32(B[Bp_row * rs + Bp_col * cs]) : 0;
+}
+
+void hpack_panelA(const uint16_t* A, float* packed_A, const int mr,
+                  const int kc, const int MR, const int rs, const int cs) {
+#if defined (__F16C__)
+    if(cs == 1 && mr == MR && (MR == 6 || MR == 14)) {      /* full sliver: transpose in registers */
+        pack_sliverA_fp16(A, packed_A, kc, MR, rs);
+        return;
+    }
+#endif
+    for(int Ap_col = 0; Ap_col < kc; Ap_col++)              /* zero-padded to MR */
+        for(int Ap_row = 0; Ap_row < MR; Ap_row++)
+            packed_A[Ap_col * MR + Ap_row] = (Ap_row < mr) ? fp16_to_fp32(A[Ap_row * rs + Ap_col * cs]) : 0;
+}
@@ -0,0 +1,516 @@
+/**********************************************************************************************
+ * File   : prepack.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      Pre-packed B. *gemm_pack_B packs every KC x NC block of B once, and *gemm_compute
+ *      runs the 5-loop nest in [gemm.c] on those blocks, so a call only packs A.
+ *
+ *      Blocks are stored in the order of the 5th and 4th loops. Every NC block but the
+ *      last is NC wide (a multiple of NR), so block (col, k) starts at
+ *          col * K + k * roundup(nc, NR)
+ *      elements from the start of the data.
+ *
+ *      A handle can be saved to a file and mapped back read-only by later processes, which
+ *      then skip packing and share the pages. The file is a header (format key) followed by
+ *      the packed data at a page-aligned offset:
+ *
+ *          magic "GEMMPACK", version, d_type, inst_level, NR, KC, NC, K, N, size, offset
+ *
+ *      A file whose key doesn't match the current context is ignored and B is repacked.
+ *
+**********************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gemm.h"
+
+#define PACKED_FILE_MAGIC   "GEMMPACK"
+#define PACKED_FILE_VERSION 1       /* bump whenever the packed layout changes */
+#define PACKED_FILE_OFFSET  4096
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t d_type;
+    uint32_t inst_level;
+    uint32_t NR, KC, NC;
+    uint32_t K, N;
+    uint64_t size;
+    uint64_t offset;
+} packed_file_header_t;
+
+size_t gemm_packed_offset(const gemm_packed_t* packed, const int col, const int k) {
+    const int nc = min(packed->NC, packed->N - col);
+    return (size_t)col * packed->K + (size_t)k * ((nc + packed->NR - 1) / packed->NR * packed->NR);
+}
+
+/**
+ * Bytes of the packed data, K rows of N rounded up to NR, into [size].
+ * FALSE if K or N is negative or past INT_MAX, or the bytes don't fit a size_t.
+ */
+static BOOL packed_size(const size_t elem_size, const int64_t K, const int64_t N, const int NR,
+                        size_t* size) {
+    if(K < 0 || N < 0 || K > INT_MAX || N > INT_MAX || NR <= 0 || elem_size == 0)
+        return FALSE;
+    const uint64_t N_up = (uint64_t)((N + NR - 1) / NR * NR);
+    if(K > 0 && N_up > SIZE_MAX / elem_size / (uint64_t)K)
+        return FALSE;
+    (*size) = elem_size * (size_t)K * N_up;
+    return TRUE;
+}
+
+/* element size of the packed blocks of [d_type], 0 if it can't be pre-packed */
+static size_t packed_elem_size(D_TYPE d_type) {
+    switch(d_type) {
+        case D_FP32:  return sizeof(float);
+        case D_FP64:  return sizeof(double);
+        case D_INT32: return sizeof(int);
+        case D_INT16: return sizeof(int16_t);
+        case D_INT8:  return sizeof(int8_t);
+        default:      return 0;
+    }
+}
+
+static gemm_packed_t* gemm_packed_create(gemm_ctx_t* ctx, D_TYPE d_type, const size_t elem_size,
+                                         const int K, const int N) {
+    gemm_packed_t* packed = (gemm_packed_t* )calloc(1, sizeof(gemm_packed_t));
+    if(packed == NULL)
+        return NULL;
+
+    packed->d_type = d_type;
+    packed->K = max(K, 0), packed->N = max(N, 0);
+    packed->inst_level = ctx->inst_level;
+    packed->NR = ctx->blk[d_type].NR;
+    packed->KC = ctx->blk[d_type].KC;
+    packed->NC = ctx->blk[d_type].NC;
+    if(!packed_size(elem_size, packed->K, packed->N, packed->NR, &packed->size)) {
+        free(packed);
+        return NULL;
+    }
+
+    if(packed->size > 0) {
+        packed->data = aligned_alloc(MEM_ALIGN, (packed->size + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN);
+        if(packed->data == NULL) {
+            free(packed);
+            return NULL;
+        }
+    }
+    return packed;
+}
+
+/* the kernels of [ctx] must read the blocks the way they were packed */
+static BOOL gemm_packed_fits(gemm_ctx_t* ctx, const gemm_packed_t* packed, D_TYPE d_type) {
+    return packed != NULL && packed->d_type == d_type
+        && packed->inst_level == ctx->inst_level
+        && packed->NR == ctx->blk[d_type].NR;
+}
+
+void gemm_packed_free(gemm_packed_t* packed) {
+    if(packed == NULL)
+        return;
+    if(packed->map != NULL)
+        munmap(packed->map, packed->map_size);
+    else
+        free(packed->data);
+    free(packed);
+}
+
+/**
+ * Write [packed] to [path]. The file is written next to [path] and renamed,
+ * so a process mapping [path] never sees a half-written file.
+ * Returns 0 on success, -1 on failure.
+ */
+int gemm_packed_save(const gemm_packed_t* packed, const char* path) {
+    packed_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACKED_FILE_MAGIC, sizeof(header.magic));
+    header.version = PACKED_FILE_VERSION;
+    header.d_type = packed->d_type;
+    header.inst_level = packed->inst_level;
+    header.NR = packed->NR, header.KC = packed->KC, header.NC = packed->NC;
+    header.K = packed->K, header.N = packed->N;
+    header.size = packed->size;
+    header.offset = PACKED_FILE_OFFSET;
+
+    char* tmp_path = (char* )malloc(strlen(path) + 32);
+    if(tmp_path == NULL)
+        return -1;
+    sprintf(tmp_path, "%s.%d.tmp", path, (int)getpid());
+
+    FILE* file = fopen(tmp_path, "wb");
+    if(file == NULL) {
+        free(tmp_path);
+        return -1;
+    }
+    BOOL ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fseek(file, PACKED_FILE_OFFSET, SEEK_SET) == 0
+           && (packed->size == 0 || fwrite(packed->data, packed->size, 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && (rename(tmp_path, path) == 0);
+    if(!ok)
+        remove(tmp_path);
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Map a file written by gemm_packed_save read-only.
+ * Returns NULL if the file can't be read or its key doesn't match [ctx], [d_type], [K] and [N].
+ */
+gemm_packed_t* gemm_packed_load(gemm_ctx_t* ctx, const char* path, D_TYPE d_type,
+                                const int K, const int N) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    packed_file_header_t header;
+    struct stat st;
+    size_t size = 0;
+    BOOL ok = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+           && fstat(fd, &st) == 0
+           && memcmp(header.magic, PACKED_FILE_MAGIC, sizeof(header.magic)) == 0
+           && header.version == PACKED_FILE_VERSION
+           && header.d_type == (uint32_t)d_type
+           && header.inst_level == (uint32_t)ctx->inst_level
+           && header.NR == (uint32_t)ctx->blk[d_type].NR
+           && header.KC == (uint32_t)ctx->blk[d_type].KC
+           && header.NC == (uint32_t)ctx->blk[d_type].NC
+           && header.K == (uint32_t)max(K, 0) && header.N == (uint32_t)max(N, 0)
+           && header.offset == PACKED_FILE_OFFSET
+           /* the size the key implies, so the kernels never read past the mapping */
+           && packed_size(packed_elem_size(d_type), header.K, header.N, header.NR, &size)
+           && header.size == size
+           && (uint64_t)st.st_size >= header.offset + header.size;
+    if(!ok) {
+        close(fd);
+        return NULL;
+    }
+
+    gemm_packed_t* packed = (gemm_packed_t* )calloc(1, sizeof(gemm_packed_t));
+    if(packed == NULL) {
+        close(fd);
+        return NULL;
+    }
+    packed->d_type = d_type;
+    packed->K = header.K, packed->N = header.N;
+    packed->inst_level = header.inst_level;
+    packed->NR = header.NR, packed->KC = header.KC, packed->NC = header.NC;
+    packed->size = header.size;
+
+    packed->map_size = header.offset + header.size;
+    packed->map = mmap(NULL, packed->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(packed->map == MAP_FAILED) {
+        free(packed);
+        return NULL;
+    }
+    packed->data = (char* )packed->map + header.offset;
+    return packed;
+}
+
+gemm_packed_t* sgemm_pack_B(const float* B, const int K, const int N) {
+    return sgemm_pack_B_ctx(gemm_ctx_default(), B, K, N);
+}
+
+gemm_packed_t* sgemm_pack_B_ctx(gemm_ctx_t* ctx, const float* B, const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_create(ctx, D_FP32, sizeof(float), K, N);
+    if(packed == NULL)
+        return NULL;
+
+    for(int Bm_col = 0; Bm_col < packed->N; Bm_col += packed->NC) {
+        const int nc = min(packed->NC, packed->N - Bm_col);
+        for(int k = 0; k < packed->K; k += packed->KC) {
+            const int kc = min(packed->KC, packed->K - k);
+            ctx->isa->s.pack_blockB(&B[(size_t)k * N + Bm_col], (float* )packed->data + gemm_packed_offset(packed, Bm_col, k),
+                         packed->NR, nc, N, 1, kc, ctx->NTHREADS);
+        }
+    }
+    return packed;
+}
+
+gemm_packed_t* sgemm_pack_B_file(const char* path, const float* B, const int K, const int N) {
+    return sgemm_pack_B_file_ctx(gemm_ctx_default(), path, B, K, N);
+}
+
+/**
+ * Map the packed B saved at [path], or pack [B] and save it there when the file is
+ * missing or has another key. [B] may be NULL if the file is known to be up to date.
+ */
+gemm_packed_t* sgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const float* B,
+               const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_load(ctx, path, D_FP32, K, N);
+    if(packed != NULL || B == NULL)
+        return packed;
+
+    packed = sgemm_pack_B_ctx(ctx, B, K, N);
+    if(packed != NULL)
+        gemm_packed_save(packed, path);     /* the handle is usable even if saving fails */
+    return packed;
+}
+
+int sgemm_compute(const float* A, const gemm_packed_t* packed, float* C, const int M) {
+    return sgemm_compute_ctx(gemm_ctx_default(), A, packed, C, M);
+}
+
+/**
+ * C += A * B, with A (M x K) and C (M x N) row-major and B from sgemm_pack_B.
+ * Returns -1 if [packed] wasn't made for this data type and kernel.
+ */
+int sgemm_compute_ctx(gemm_ctx_t* ctx, const float* A, const gemm_packed_t* packed,
+               float* C, const int M) {
+    if(!gemm_packed_fits(ctx, packed, D_FP32))
+        return -1;
+    if(M <= 0 || packed->N == 0 || packed->K == 0)
+        return 0;
+
+    sgemm_run(ctx, M, packed->N, packed->K, 1, A, packed->K, 1,
+        NULL, 0, 0, packed, 1, C, packed->N, NULL, NULL, NULL);
+    return 0;
+}
+
+gemm_packed_t* dgemm_pack_B(const double* B, const int K, const int N) {
+    return dgemm_pack_B_ctx(gemm_ctx_default(), B, K, N);
+}
+
+gemm_packed_t* dgemm_pack_B_ctx(gemm_ctx_t* ctx, const double* B, const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_create(ctx, D_FP64, sizeof(double), K, N);
+    if(packed == NULL)
+        return NULL;
+
+    for(int Bm_col = 0; Bm_col < packed->N; Bm_col += packed->NC) {
+        const int nc = min(packed->NC, packed->N - Bm_col);
+        for(int k = 0; k < packed->K; k += packed->KC) {
+            const int kc = min(packed->KC, packed->K - k);
+            ctx->isa->d.pack_blockB(&B[(size_t)k * N + Bm_col], (double* )packed->data + gemm_packed_offset(packed, Bm_col, k),
+                         packed->NR, nc, N, 1, kc, ctx->NTHREADS);
+        }
+    }
+    return packed;
+}
+
+gemm_packed_t* dgemm_pack_B_file(const char* path, const double* B, const int K, const int N) {
+    return dgemm_pack_B_file_ctx(gemm_ctx_default(), path, B, K, N);
+}
+
+/**
+ * Map the packed B saved at [path], or pack [B] and save it there when the file is
+ * missing or has another key. [B] may be NULL if the file is known to be up to date.
+ */
+gemm_packed_t* dgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const double* B,
+               const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_load(ctx, path, D_FP64, K, N);
+    if(packed != NULL || B == NULL)
+        return packed;
+
+    packed = dgemm_pack_B_ctx(ctx, B, K, N);
+    if(packed != NULL)
+        gemm_packed_save(packed, path);     /* the handle is usable even if saving fails */
+    return packed;
+}
+
+int dgemm_compute(const double* A, const gemm_packed_t* packed, double* C, const int M) {
+    return dgemm_compute_ctx(gemm_ctx_default(), A, packed, C, M);
+}
+
+/**
+ * C += A * B, with A (M x K) and C (M x N) row-major and B from dgemm_pack_B.
+ * Returns -1 if [packed] wasn't made for this data type and kernel.
+ */
+int dgemm_compute_ctx(gemm_ctx_t* ctx, const double* A, const gemm_packed_t* packed,
+               double* C, const int M) {
+    if(!gemm_packed_fits(ctx, packed, D_FP64))
+        return -1;
+    if(M <= 0 || packed->N == 0 || packed->K == 0)
+        return 0;
+
+    dgemm_run(ctx, M, packed->N, packed->K, 1, A, packed->K, 1,
+        NULL, 0, 0, packed, 1, C, packed->N, NULL);
+    return 0;
+}
+
+gemm_packed_t* igemm_pack_B(const int* B, const int K, const int N) {
+    return igemm_pack_B_ctx(gemm_ctx_default(), B, K, N);
+}
+
+gemm_packed_t* igemm_pack_B_ctx(gemm_ctx_t* ctx, const int* B, const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_create(ctx, D_INT32, sizeof(int), K, N);
+    if(packed == NULL)
+        return NULL;
+
+    for(int Bm_col = 0; Bm_col < packed->N; Bm_col += packed->NC) {
+        const int nc = min(packed->NC, packed->N - Bm_col);
+        for(int k = 0; k < packed->K; k += packed->KC) {
+            const int kc = min(packed->KC, packed->K - k);
+            ctx->isa->i.pack_blockB(&B[(size_t)k * N + Bm_col], (int* )packed->data + gemm_packed_offset(packed, Bm_col, k),
+                         packed->NR, nc, N, 1, kc, ctx->NTHREADS);
+        }
+    }
+    return packed;
+}
+
+gemm_packed_t* igemm_pack_B_file(const char* path, const int* B, const int K, const int N) {
+    return igemm_pack_B_file_ctx(gemm_ctx_default(), path, B, K, N);
+}
+
+/**
+ * Map the packed B saved at [path], or pack [B] and save it there when the file is
+ * missing or has another key. [B] may be NULL if the file is known to be up to date.
+ */
+gemm_packed_t* igemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const int* B,
+               const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_load(ctx, path, D_INT32, K, N);
+    if(packed != NULL || B == NULL)
+        return packed;
+
+    packed = igemm_pack_B_ctx(ctx, B, K, N);
+    if(packed != NULL)
+        gemm_packed_save(packed, path);     /* the handle is usable even if saving fails */
+    return packed;
+}
+
+int igemm_compute(const int* A, const gemm_packed_t* packed, int* C, const int M) {
+    return igemm_compute_ctx(gemm_ctx_default(), A, packed, C, M);
+}
+
+/**
+ * C += A * B, with A (M x K) and C (M x N) row-major and B from igemm_pack_B.
+ * Returns -1 if [packed] wasn't made for this data type and kernel.
+ */
+int igemm_compute_ctx(gemm_ctx_t* ctx, const int* A, const gemm_packed_t* packed,
+               int* C, const int M) {
+    if(!gemm_packed_fits(ctx, packed, D_INT32))
+        return -1;
+    if(M <= 0 || packed->N == 0 || packed->K == 0)
+        return 0;
+
+    igemm_run(ctx, M, packed->N, packed->K, 1, A, packed->K, 1,
+        NULL, 0, 0, packed, 1, C, packed->N);
+    return 0;
+}
+
+gemm_packed_t* hqgemm_pack_B(const int16_t* B, const int K, const int N) {
+    return hqgemm_pack_B_ctx(gemm_ctx_default(), B, K, N);
+}
+
+gemm_packed_t* hqgemm_pack_B_ctx(gemm_ctx_t* ctx, const int16_t* B, const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_create(ctx, D_INT16, sizeof(int16_t), K, N);
+    if(packed == NULL)
+        return NULL;
+
+    for(int Bm_col = 0; Bm_col < packed->N; Bm_col += packed->NC) {
+        const int nc = min(packed->NC, packed->N - Bm_col);
+        for(int k = 0; k < packed->K; k += packed->KC) {
+            const int kc = min(packed->KC, packed->K - k);
+            ctx->isa->hq.pack_blockB(&B[(size_t)k * N + Bm_col], (int16_t* )packed->data + gemm_packed_offset(packed, Bm_col, k),
+                         packed->NR, nc, N, 1, kc, ctx->NTHREADS);
+        }
+    }
+    return packed;
+}
+
+gemm_packed_t* hqgemm_pack_B_file(const char* path, const int16_t* B, const int K, const int N) {
+    return hqgemm_pack_B_file_ctx(gemm_ctx_default(), path, B, K, N);
+}
+
+/**
+ * Map the packed B saved at [path], or pack [B] and save it there when the file is
+ * missing or has another key. [B] may be NULL if the file is known to be up to date.
+ */
+gemm_packed_t* hqgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const int16_t* B,
+               const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_load(ctx, path, D_INT16, K, N);
+    if(packed != NULL || B == NULL)
+        return packed;
+
+    packed = hqgemm_pack_B_ctx(ctx, B, K, N);
+    if(packed != NULL)
+        gemm_packed_save(packed, path);     /* the handle is usable even if saving fails */
+    return packed;
+}
+
+int hqgemm_compute(const int16_t* A, const gemm_packed_t* packed, int16_t* C, const int M) {
+    return hqgemm_compute_ctx(gemm_ctx_default(), A, packed, C, M);
+}
+
+/**
+ * C += A * B, with A (M x K) and C (M x N) row-major and B from hqgemm_pack_B.
+ * Returns -1 if [packed] wasn't made for this data type and kernel.
+ */
+int hqgemm_compute_ctx(gemm_ctx_t* ctx, const int16_t* A, const gemm_packed_t* packed,
+               int16_t* C, const int M) {
+    if(!gemm_packed_fits(ctx, packed, D_INT16))
+        return -1;
+    if(M <= 0 || packed->N == 0 || packed->K == 0)
+        return 0;
+
+    hqgemm_run(ctx, M, packed->N, packed->K, 1, A, packed->K, 1,
+        NULL, 0, 0, packed, 1, C, packed->N);
+    return 0;
+}
+
+gemm_packed_t* qgemm_pack_B(const int8_t* B, const int K, const int N) {
+    return qgemm_pack_B_ctx(gemm_ctx_default(), B, K, N);
+}
+
+gemm_packed_t* qgemm_pack_B_ctx(gemm_ctx_t* ctx, const int8_t* B, const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_create(ctx, D_INT8, sizeof(int8_t), K, N);
+    if(packed == NULL)
+        return NULL;
+
+    for(int Bm_col = 0; Bm_col < packed->N; Bm_col += packed->NC) {
+        const int nc = min(packed->NC, packed->N - Bm_col);
+        for(int k = 0; k < packed->K; k += packed->KC) {
+            const int kc = min(packed->KC, packed->K - k);
+            ctx->isa->q.pack_blockB(&B[(size_t)k * N + Bm_col], (int8_t* )packed->data + gemm_packed_offset(packed, Bm_col, k),
+                         packed->NR, nc, N, 1, kc, ctx->NTHREADS);
+        }
+    }
+    return packed;
+}
+
+gemm_packed_t* qgemm_pack_B_file(const char* path, const int8_t* B, const int K, const int N) {
+    return qgemm_pack_B_file_ctx(gemm_ctx_default(), path, B, K, N);
+}
+
+/**
+ * Map the packed B saved at [path], or pack [B] and save it there when the file is
+ * missing or has another key. [B] may be NULL if the file is known to be up to date.
+ */
+gemm_packed_t* qgemm_pack_B_file_ctx(gemm_ctx_t* ctx, const char* path, const int8_t* B,
+               const int K, const int N) {
+    gemm_packed_t* packed = gemm_packed_load(ctx, path, D_INT8, K, N);
+    if(packed != NULL || B == NULL)
+        return packed;
+
+    packed = qgemm_pack_B_ctx(ctx, B, K, N);
+    if(packed != NULL)
+        gemm_packed_save(packed, path);     /* the handle is usable even if saving fails */
+    return packed;
+}
+
+int qgemm_compute(const int8_t* A, const gemm_packed_t* packed, int8_t* C, const int M) {
+    return qgemm_compute_ctx(gemm_ctx_default(), A, packed, C, M);
+}
+
+/**
+ * C += A * B, with A (M x K) and C (M x N) row-major and B from qgemm_pack_B.
+ * Returns -1 if [packed] wasn't made for this data type and kernel.
+ */
+int qgemm_compute_ctx(gemm_ctx_t* ctx, const int8_t* A, const gemm_packed_t* packed,
+               int8_t* C, const int M) {
+    if(!gemm_packed_fits(ctx, packed, D_INT8))
+        return -1;
+    if(M <= 0 || packed->N == 0 || packed->K == 0)
+        return 0;
+
+    qgemm_run(ctx, M, packed->N, packed->K, 1, A, packed->K, 1,
+        NULL, 0, 0, packed, 1, C, packed->N);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,815 @@
+/**********************************************************************************************
+ * File   : simd.h
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      SIMD vector layer the kernels are written against. Every operation is a
+ *      static always-inline function, so a kernel compiles to plain load/broadcast/FMA
+ *      chains with no calls in its inner loop.
+ *
+ *      The prefix is the data type, as for the kernels: vs_ float, vd_ double,
+ *      vi_ int32, vhq_ int16, vq_ int8. The widest registers INSTLEVEL allows are used,
+ *      and [VS_LEN] etc. give the lanes per vector. Per data type:
+ *
+ *          zero()                  all lanes 0
+ *          load(p), loadu(p)       aligned / unaligned load
+ *          storeu(p, v)            unaligned store
+ *          set1(x), bcast(p)       broadcast a value / the value at p
+ *          add(a, b), mul(a, b)
+ *          fma(a, b, c)            a * b + c
+ *          mask(n)                 the first n lanes, all or none out of [0, LEN]
+ *          maskz_loadu(m, p)       load the lanes of m, 0 elsewhere
+ *          mask_storeu(p, m, v)    store the lanes of m
+ *
+ *      loadu_h(p), storeu_h(p, v), maskz_loadu_h(m, p) and mask_storeu_h(p, m, v) of
+ *      vs_ read and write fp16 (F16C, in software on plain AVX).
+ *
+ *      vs_ and vd_ also have max(a, b), min(a, b), div(a, b) and exp(x) for the
+ *      activations of the kernel epilogue, and reduce_add(v), the sum of the lanes.
+ *
+ *      Below AVX512BW vhq_ masks are lane counts and int8 is multiplied in int16 lanes,
+ *      see vq_widen.
+ *
+ *      vqi_ is the uint8 x int8 -> int32 dot product of qgemm_s32: every int32 lane
+ *      holds 4 consecutive k of one column, and dot(acc, a, b) adds the 4 products
+ *      of each lane to acc.
+ *      requant(x, scale, lo, hi) rounds x * scale in fp32 (vqif_ lanes, half to even) and
+ *      clamps it to [lo, hi]; mask_storeu_q(p, m, v) stores the low byte of the lanes of m.
+ *
+ *      vhqi_ is the int16 x int16 -> int32 dot product of hqgemm_s32 (vpmaddwd, vpdpwssd)
+ *      on the same registers, with 2 consecutive k per int32 lane.
+ *
+ *      vbf_ is the bfloat16 x bfloat16 -> fp32 dot product of bf16gemm (vdpbf16ps), with
+ *      2 consecutive k per fp32 lane of the vs_ registers. AVX512_BF16 only.
+ *
+ *      Only the files compiled per ISA (see [isa.h]) include it. A new instruction set
+ *      is added here once, next to the others.
+ *
+ * Notice:
+ *  - Int8 multiplication is not supported by Intel, so it's done with int16 operations.
+ *  - Integer FMA is a multiply and an add.
+ *
+**********************************************************************************************/
+
+#ifndef SIMD_H
+#define SIMD_H 1
+
+#pragma once
+
+#include "sse.h"
+
+#define SIMD_INLINE static inline __attribute__((always_inline))
+
+/********************************************************
+ *
+ *          FP32
+ *
+*********************************************************/
+#if INSTLEVEL >= 8      /* AVX512F */
+#define VS_LEN 16
+typedef __m512    vs_t;
+typedef __mmask16 vs_mask_t;
+
+SIMD_INLINE vs_t vs_zero()                              { return _mm512_setzero_ps(); }
+SIMD_INLINE vs_t vs_load(const float* p)                { return _mm512_load_ps(p); }
+SIMD_INLINE vs_t vs_loadu(const float* p)               { return _mm512_loadu_ps(p); }
+SIMD_INLINE void vs_storeu(float* p, vs_t v)            { _mm512_storeu_ps(p, v); }
+SIMD_INLINE vs_t vs_set1(const float x)                 { return _mm512_set1_ps(x); }
+SIMD_INLINE vs_t vs_bcast(const float* p)               { return _mm512_set1_ps(*p); }
+SIMD_INLINE vs_t vs_add(vs_t a, vs_t b)                 { return _mm512_add_ps(a, b); }
+SIMD_INLINE vs_t vs_mul(vs_t a, vs_t b)                 { return _mm512_mul_ps(a, b); }
+SIMD_INLINE vs_t vs_fma(vs_t a, vs_t b, vs_t c)         { return _mm512_fmadd_ps(a, b, c); }
+SIMD_INLINE vs_mask_t vs_mask(const int n) {
+    return (n >= 16) ? 0xFFFF : (n <= 0) ? 0 : (vs_mask_t)((1u << n) - 1);
+}
+SIMD_INLINE vs_t vs_maskz_loadu(vs_mask_t m, const float* p)    { return _mm512_maskz_loadu_ps(m, p); }
+SIMD_INLINE void vs_mask_storeu(float* p, vs_mask_t m, vs_t v)  { _mm512_mask_storeu_ps(p, m, v); }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+#define VS_LEN 8
+typedef __m256  vs_t;
+typedef __m256i vs_mask_t;
+
+SIMD_INLINE vs_t vs_zero()                              { return _mm256_setzero_ps(); }
+SIMD_INLINE vs_t vs_load(const float* p)                { return _mm256_load_ps(p); }
+SIMD_INLINE vs_t vs_loadu(const float* p)               { return _mm256_loadu_ps(p); }
+SIMD_INLINE void vs_storeu(float* p, vs_t v)            { _mm256_storeu_ps(p, v); }
+SIMD_INLINE vs_t vs_set1(const float x)                 { return _mm256_set1_ps(x); }
+SIMD_INLINE vs_t vs_bcast(const float* p)               { return _mm256_broadcast_ss(p); }
+SIMD_INLINE vs_t vs_add(vs_t a, vs_t b)                 { return _mm256_add_ps(a, b); }
+SIMD_INLINE vs_t vs_mul(vs_t a, vs_t b)                 { return _mm256_mul_ps(a, b); }
+#if defined (__FMA__)
+SIMD_INLINE vs_t vs_fma(vs_t a, vs_t b, vs_t c)         { return _mm256_fmadd_ps(a, b, c); }
+#else  // No FMA
+SIMD_INLINE vs_t vs_fma(vs_t a, vs_t b, vs_t c)         { return _mm256_add_ps(c, _mm256_mul_ps(a, b)); }
+#endif // FMA
+SIMD_INLINE vs_mask_t vs_mask(const int n) {
+    static const int32_t mask[16] __attribute__((aligned(32))) = {
+        -1, -1, -1, -1, -1, -1, -1, -1,
+        0,  0,  0,  0,  0,  0,  0,  0
+    };
+    return _mm256_loadu_si256((const __m256i_u*)&mask[8 - min(max(n, 0), 8)]);
+}
+SIMD_INLINE vs_t vs_maskz_loadu(vs_mask_t m, const float* p)    { return _mm256_maskload_ps(p, m); }
+SIMD_INLINE void vs_mask_storeu(float* p, vs_mask_t m, vs_t v)  { _mm256_maskstore_ps(p, m, v); }
+#endif              /* INSTLEVEL */
+
+/* fp16 in memory, fp32 in registers (hkernel) */
+#if INSTLEVEL >= 8      /* AVX512F */
+SIMD_INLINE int vs_mask_len(vs_mask_t m)                { return __builtin_popcount(m); }
+SIMD_INLINE vs_t vs_loadu_h(const uint16_t* p) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i_u*)p));
+}
+SIMD_INLINE void vs_storeu_h(uint16_t* p, vs_t v) {
+    _mm256_storeu_si256((__m256i_u*)p, _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+SIMD_INLINE int vs_mask_len(vs_mask_t m) {
+    return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+}
+#if defined (__F16C__)
+SIMD_INLINE vs_t vs_loadu_h(const uint16_t* p)          { return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i_u*)p)); }
+SIMD_INLINE void vs_storeu_h(uint16_t* p, vs_t v) {
+    _mm_storeu_si128((__m128i_u*)p, _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+#else  // No F16C
+SIMD_INLINE vs_t vs_loadu_h(const uint16_t* p) {
+    float buf[VS_LEN];
+    for(int i = 0; i < VS_LEN; i++)
+        buf[i] = fp16_to_fp32(p[i]);
+    return vs_loadu(buf);
+}
+SIMD_INLINE void vs_storeu_h(uint16_t* p, vs_t v) {
+    float buf[VS_LEN];
+    vs_storeu(buf, v);
+    for(int i = 0; i < VS_LEN; i++)
+        p[i] = fp32_to_fp16(buf[i]);
+}
+#endif // F16C
+#endif              /* INSTLEVEL */
+#if INSTLEVEL >= 6
+/* edge tiles go through a buffer */
+SIMD_INLINE vs_t vs_maskz_loadu_h(vs_mask_t m, const uint16_t* p) {
+    const int len = vs_mask_len(m);
+    if(len == VS_LEN)
+        return vs_loadu_h(p);
+    uint16_t buf[VS_LEN] = {0};
+    memcpy(buf, p, len * sizeof(uint16_t));
+    return vs_loadu_h(buf);
+}
+SIMD_INLINE void vs_mask_storeu_h(uint16_t* p, vs_mask_t m, vs_t v) {
+    const int len = vs_mask_len(m);
+    if(len == VS_LEN) {
+        vs_storeu_h(p, v);
+        return;
+    }
+    uint16_t buf[VS_LEN];
+    vs_storeu_h(buf, v);
+    memcpy(p, buf, len * sizeof(uint16_t));
+}
+#endif              /* INSTLEVEL */
+
+/* activations of the gemm_epilogue_t epilogue */
+#if INSTLEVEL >= 8      /* AVX512F */
+SIMD_INLINE vs_t vs_max(vs_t a, vs_t b)                 { return _mm512_max_ps(a, b); }
+SIMD_INLINE vs_t vs_min(vs_t a, vs_t b)                 { return _mm512_min_ps(a, b); }
+SIMD_INLINE vs_t vs_div(vs_t a, vs_t b)                 { return _mm512_div_ps(a, b); }
+SIMD_INLINE vs_t vs_round(vs_t a) {
+    return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+/* 2^n for integral n in [-126, 127] */
+SIMD_INLINE vs_t vs_pow2i(vs_t n)                       { return _mm512_scalef_ps(_mm512_set1_ps(1), n); }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+SIMD_INLINE vs_t vs_max(vs_t a, vs_t b)                 { return _mm256_max_ps(a, b); }
+SIMD_INLINE vs_t vs_min(vs_t a, vs_t b)                 { return _mm256_min_ps(a, b); }
+SIMD_INLINE vs_t vs_div(vs_t a, vs_t b)                 { return _mm256_div_ps(a, b); }
+SIMD_INLINE vs_t vs_round(vs_t a) {
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+/* 2^n for integral n in [-126, 127], built in the exponent bits */
+SIMD_INLINE vs_t vs_pow2i(vs_t n) {
+    __m256i e = _mm256_cvtps_epi32(n);
+#if INSTLEVEL >= 7      /* AVX2 */
+    e = _mm256_slli_epi32(_mm256_add_epi32(e, _mm256_set1_epi32(127)), 23);
+#else                   /* AVX, two 128-bit halves */
+    __m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(e), _mm_set1_epi32(127)), 23);
+    __m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(e, 1), _mm_set1_epi32(127)), 23);
+    e = _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1);
+#endif
+    return _mm256_castsi256_ps(e);
+}
+#endif              /* INSTLEVEL */
+#if INSTLEVEL >= 6
+/**
+ * e^x as in Cephes expf: x = n ln2 + r with |r| <= ln2 / 2, e^r by a degree 7 polynomial.
+ * Within 2 ulp; x is clamped so that 2^n stays a normal number.
+ */
+SIMD_INLINE vs_t vs_exp(vs_t x) {
+    x = vs_min(vs_max(x, vs_set1(-87.3f)), vs_set1(88.3f));
+    vs_t n = vs_round(vs_mul(x, vs_set1(1.44269504088896341f)));
+    vs_t r = vs_fma(n, vs_set1(-0.693359375f), x);      /* ln2 in two parts */
+    r = vs_fma(n, vs_set1(2.12194440e-4f), r);
+
+    vs_t p = vs_set1(1.9875691500e-4f);
+    p = vs_fma(p, r, vs_set1(1.3981999507e-3f));
+    p = vs_fma(p, r, vs_set1(8.3334519073e-3f));
+    p = vs_fma(p, r, vs_set1(4.1665795894e-2f));
+    p = vs_fma(p, r, vs_set1(1.6666665459e-1f));
+    p = vs_fma(p, r, vs_set1(5.0000001201e-1f));
+    p = vs_fma(p, vs_mul(r, r), vs_add(r, vs_set1(1)));
+    return vs_mul(p, vs_pow2i(n));
+}
+#endif              /* INSTLEVEL */
+
+/* sum of the lanes, for the dot products of sgemv_t */
+#if INSTLEVEL >= 8      /* AVX512F */
+SIMD_INLINE float vs_reduce_add(vs_t v)                 { return _mm512_reduce_add_ps(v); }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+SIMD_INLINE float vs_reduce_add(vs_t v) {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    return _mm_cvtss_f32(_mm_add_ss(x, _mm_movehdup_ps(x)));
+}
+#endif              /* INSTLEVEL */
+
+/********************************************************
+ *
+ *          FP64
+ *
+*********************************************************/
+#if INSTLEVEL >= 8      /* AVX512F */
+#define VD_LEN 8
+typedef __m512d  vd_t;
+typedef __mmask8 vd_mask_t;
+
+SIMD_INLINE vd_t vd_zero()                              { return _mm512_setzero_pd(); }
+SIMD_INLINE vd_t vd_load(const double* p)               { return _mm512_load_pd(p); }
+SIMD_INLINE vd_t vd_loadu(const double* p)              { return _mm512_loadu_pd(p); }
+SIMD_INLINE void vd_storeu(double* p, vd_t v)           { _mm512_storeu_pd(p, v); }
+SIMD_INLINE vd_t vd_set1(const double x)                { return _mm512_set1_pd(x); }
+SIMD_INLINE vd_t vd_bcast(const double* p)              { return _mm512_set1_pd(*p); }
+SIMD_INLINE vd_t vd_add(vd_t a, vd_t b)                 { return _mm512_add_pd(a, b); }
+SIMD_INLINE vd_t vd_mul(vd_t a, vd_t b)                 { return _mm512_mul_pd(a, b); }
+SIMD_INLINE vd_t vd_fma(vd_t a, vd_t b, vd_t c)         { return _mm512_fmadd_pd(a, b, c); }
+SIMD_INLINE vd_mask_t vd_mask(const int n) {
+    return (n >= 8) ? 0xFF : (n <= 0) ? 0 : (vd_mask_t)((1u << n) - 1);
+}
+SIMD_INLINE vd_t vd_maskz_loadu(vd_mask_t m, const double* p)   { return _mm512_maskz_loadu_pd(m, p); }
+SIMD_INLINE void vd_mask_storeu(double* p, vd_mask_t m, vd_t v) { _mm512_mask_storeu_pd(p, m, v); }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+#define VD_LEN 4
+typedef __m256d vd_t;
+typedef __m256i vd_mask_t;
+
+SIMD_INLINE vd_t vd_zero()                              { return _mm256_setzero_pd(); }
+SIMD_INLINE vd_t vd_load(const double* p)               { return _mm256_load_pd(p); }
+SIMD_INLINE vd_t vd_loadu(const double* p)              { return _mm256_loadu_pd(p); }
+SIMD_INLINE void vd_storeu(double* p, vd_t v)           { _mm256_storeu_pd(p, v); }
+SIMD_INLINE vd_t vd_set1(const double x)                { return _mm256_set1_pd(x); }
+SIMD_INLINE vd_t vd_bcast(const double* p)              { return _mm256_broadcast_sd(p); }
+SIMD_INLINE vd_t vd_add(vd_t a, vd_t b)                 { return _mm256_add_pd(a, b); }
+SIMD_INLINE vd_t vd_mul(vd_t a, vd_t b)                 { return _mm256_mul_pd(a, b); }
+#if defined (__FMA__)
+SIMD_INLINE vd_t vd_fma(vd_t a, vd_t b, vd_t c)         { return _mm256_fmadd_pd(a, b, c); }
+#else  // No FMA
+SIMD_INLINE vd_t vd_fma(vd_t a, vd_t b, vd_t c)         { return _mm256_add_pd(c, _mm256_mul_pd(a, b)); }
+#endif // FMA
+SIMD_INLINE vd_mask_t vd_mask(const int n) {
+    static const int64_t mask[8] __attribute__((aligned(32))) = {
+        -1, -1, -1, -1,
+        0,  0,  0,  0
+    };
+    return _mm256_loadu_si256((const __m256i_u*)&mask[4 - min(max(n, 0), 4)]);
+}
+SIMD_INLINE vd_t vd_maskz_loadu(vd_mask_t m, const double* p)   { return _mm256_maskload_pd(p, m); }
+SIMD_INLINE void vd_mask_storeu(double* p, vd_mask_t m, vd_t v) { _mm256_maskstore_pd(p, m, v); }
+#endif              /* INSTLEVEL */
+
+/* activations of the gemm_epilogue_t epilogue */
+#if INSTLEVEL >= 8      /* AVX512F */
+SIMD_INLINE vd_t vd_max(vd_t a, vd_t b)                 { return _mm512_max_pd(a, b); }
+SIMD_INLINE vd_t vd_min(vd_t a, vd_t b)                 { return _mm512_min_pd(a, b); }
+SIMD_INLINE vd_t vd_div(vd_t a, vd_t b)                 { return _mm512_div_pd(a, b); }
+SIMD_INLINE vd_t vd_round(vd_t a) {
+    return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+/* 2^n for integral n in [-1022, 1023] */
+SIMD_INLINE vd_t vd_pow2i(vd_t n)                       { return _mm512_scalef_pd(_mm512_set1_pd(1), n); }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+SIMD_INLINE vd_t vd_max(vd_t a, vd_t b)                 { return _mm256_max_pd(a, b); }
+SIMD_INLINE vd_t vd_min(vd_t a, vd_t b)                 { return _mm256_min_pd(a, b); }
+SIMD_INLINE vd_t vd_div(vd_t a, vd_t b)                 { return _mm256_div_pd(a, b); }
+SIMD_INLINE vd_t vd_round(vd_t a) {
+    return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+/**
+ * 2^n for integral n in [-1022, 1023]: n + 1023 lands in the low mantissa bits of
+ * n + 1023 + 2^52, and is shifted into the exponent.
+ */
+SIMD_INLINE vd_t vd_pow2i(vd_t n) {
+    __m256i e = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(4503599627370496.0 + 1023)));
+#if INSTLEVEL >= 7      /* AVX2 */
+    e = _mm256_slli_epi64(e, 52);
+#else                   /* AVX, two 128-bit halves */
+    __m128i lo = _mm_slli_epi64(_mm256_castsi256_si128(e), 52);
+    __m128i hi = _mm_slli_epi64(_mm256_extractf128_si256(e, 1), 52);
+    e = _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1);
+#endif
+    return _mm256_castsi256_pd(e);
+}
+#endif              /* INSTLEVEL */
+#if INSTLEVEL >= 6
+/* e^x, x = n ln2 + r as vs_exp, e^r by its Taylor series up to r^13 */
+SIMD_INLINE vd_t vd_exp(vd_t x) {
+    static const double coef[14] = {
+        1.0 / 6227020800, 1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880,
+        1.0 / 40320, 1.0 / 5040, 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6, 1.0 / 2, 1, 1
+    };
+    x = vd_min(vd_max(x, vd_set1(-708)), vd_set1(709));
+    vd_t n = vd_round(vd_mul(x, vd_set1(1.4426950408889634)));
+    vd_t r = vd_fma(n, vd_set1(-6.93145751953125e-1), x);             /* ln2 in two parts */
+    r = vd_fma(n, vd_set1(-1.42860682030941723212e-6), r);
+
+    vd_t p = vd_set1(coef[0]);
+#pragma GCC unroll 16
+    for(int i = 1; i < 14; i++)
+        p = vd_fma(p, r, vd_set1(coef[i]));
+    return vd_mul(p, vd_pow2i(n));
+}
+#endif              /* INSTLEVEL */
+
+/* see vs_reduce_add */
+#if INSTLEVEL >= 8      /* AVX512F */
+SIMD_INLINE double vd_reduce_add(vd_t v)                { return _mm512_reduce_add_pd(v); }
+#elif INSTLEVEL >= 6    /* AVX, AVX2 */
+SIMD_INLINE double vd_reduce_add(vd_t v) {
+    __m128d x = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+}
+#endif              /* INSTLEVEL */
+
+/********************************************************
+ *
+ *          INT32
+ *
+*********************************************************/
+#if INSTLEVEL >= 8      /* AVX512F */
+#define VI_LEN 16
+typedef __m512i   vi_t;
+typedef __mmask16 vi_mask_t;
+
+SIMD_INLINE vi_t vi_zero()                              { return _mm512_setzero_si512(); }
+SIMD_INLINE vi_t vi_load(const int* p)                  { return _mm512_load_epi32(p); }
+SIMD_INLINE vi_t vi_loadu(const int* p)                 { return _mm512_loadu_epi32(p); }
+SIMD_INLINE void vi_storeu(int* p, vi_t v)              { _mm512_storeu_epi32(p, v); }
+SIMD_INLINE vi_t vi_set1(const int x)                   { return _mm512_set1_epi32(x); }
+SIMD_INLINE vi_t vi_bcast(const int* p)                 { return _mm512_set1_epi32(*p); }
+SIMD_INLINE vi_t vi_add(vi_t a, vi_t b)                 { return _mm512_add_epi32(a, b); }
+SIMD_INLINE vi_t vi_mul(vi_t a, vi_t b)                 { return _mm512_mullo_epi32(a, b); }
+SIMD_INLINE vi_t vi_fma(vi_t a, vi_t b, vi_t c)         { return _mm512_add_epi32(c, _mm512_mullo_epi32(a, b)); }
+SIMD_INLINE vi_mask_t vi_mask(const int n) {
+    return (n >= 16) ? 0xFFFF : (n <= 0) ? 0 : (vi_mask_t)((1u << n) - 1);
+}
+SIMD_INLINE vi_t vi_maskz_loadu(vi_mask_t m, const int* p)      { return _mm512_maskz_loadu_epi32(m, p); }
+SIMD_INLINE void vi_mask_storeu(int* p, vi_mask_t m, vi_t v)    { _mm512_mask_storeu_epi32(p, m, v); }
+#elif INSTLEVEL >= 7    /* AVX2 */
+#define VI_LEN 8
+typedef __m256i vi_t;
+typedef __m256i vi_mask_t;
+
+SIMD_INLINE vi_t vi_zero()                              { return _mm256_setzero_si256(); }
+SIMD_INLINE vi_t vi_load(const int* p)                  { return _mm256_load_si256((const __m256i*)p); }
+SIMD_INLINE vi_t vi_loadu(const int* p)                 { return _mm256_loadu_si256((const __m256i_u*)p); }
+SIMD_INLINE void vi_storeu(int* p, vi_t v)              { _mm256_storeu_si256((__m256i_u*)p, v); }
+SIMD_INLINE vi_t vi_set1(const int x)                   { return _mm256_set1_epi32(x); }
+SIMD_INLINE vi_t vi_bcast(const int* p)                 { return _mm256_set1_epi32(*p); }
+SIMD_INLINE vi_t vi_add(vi_t a, vi_t b)                 { return _mm256_add_epi32(a, b); }
+SIMD_INLINE vi_t vi_mul(vi_t a, vi_t b)                 { return _mm256_mullo_epi32(a, b); }
+SIMD_INLINE vi_t vi_fma(vi_t a, vi_t b, vi_t c)         { return _mm256_add_epi32(c, _mm256_mullo_epi32(a, b)); }
+SIMD_INLINE vi_mask_t vi_mask(const int n) {
+    static const int32_t mask[16] __attribute__((aligned(32))) = {
+        -1, -1, -1, -1, -1, -1, -1, -1,
+        0,  0,  0,  0,  0,  0,  0,  0
+    };
+    return _mm256_loadu_si256((const __m256i_u*)&mask[8 - min(max(n, 0), 8)]);
+}
+SIMD_INLINE vi_t vi_maskz_loadu(vi_mask_t m, const int* p)      { return _mm256_maskload_epi32(p, m); }
+SIMD_INLINE void vi_mask_storeu(int* p, vi_mask_t m, vi_t v)    { _mm256_maskstore_epi32(p, m, v); }
+#elif INSTLEVEL >= 6    /* AVX, integers in 128-bit registers */
+#define VI_LEN 4
+typedef __m128i vi_t;
+typedef __m128i vi_mask_t;
+
+SIMD_INLINE vi_t vi_zero()                              { return _mm_setzero_si128(); }
+SIMD_INLINE vi_t vi_load(const int* p)                  { return _mm_load_si128((const __m128i*)p); }
+SIMD_INLINE vi_t vi_loadu(const int* p)                 { return _mm_loadu_si128((const __m128i_u*)p); }
+SIMD_INLINE void vi_storeu(int* p, vi_t v)              { _mm_storeu_si128((__m128i_u*)p, v); }
+SIMD_INLINE vi_t vi_set1(const int x)                   { return _mm_set1_epi32(x); }
+SIMD_INLINE vi_t vi_bcast(const int* p)                 { return _mm_set1_epi32(*p); }
+SIMD_INLINE vi_t vi_add(vi_t a, vi_t b)                 { return _mm_add_epi32(a, b); }
+SIMD_INLINE vi_t vi_mul(vi_t a, vi_t b)                 { return _mm_mullo_epi32(a, b); }
+SIMD_INLINE vi_t vi_fma(vi_t a, vi_t b, vi_t c)         { return _mm_add_epi32(c, _mm_mullo_epi32(a, b)); }
+SIMD_INLINE vi_mask_t vi_mask(const int n) {
+    static const int32_t mask[8] __attribute__((aligned(16))) = {
+        -1, -1, -1, -1,
+        0,  0,  0,  0
+    };
+    return _mm_loadu_si128((const __m128i_u*)&mask[4 - min(max(n, 0), 4)]);
+}
+/* AVX has no integer masked move, the float one moves the same bits */
+SIMD_INLINE vi_t vi_maskz_loadu(vi_mask_t m, const int* p) {
+    return _mm_castps_si128(_mm_maskload_ps((const float*)p, m));
+}
+SIMD_INLINE void vi_mask_storeu(int* p, vi_mask_t m, vi_t v) {
+    _mm_maskstore_ps((float*)p, m, _mm_castsi128_ps(v));
+}
+#endif              /* INSTLEVEL */
+
+/********************************************************
+ *
+ *          INT16
+ *
+*********************************************************/
+#if INSTLEVEL >= 9      /* AVX512BW */
+#define VHQ_LEN 32
+typedef __m512i   vhq_t;
+typedef __mmask32 vhq_mask_t;
+
+SIMD_INLINE vhq_t vhq_zero()                            { return _mm512_setzero_si512(); }
+SIMD_INLINE vhq_t vhq_load(const int16_t* p)            { return _mm512_load_si512(p); }
+SIMD_INLINE vhq_t vhq_loadu(const int16_t* p)           { return _mm512_loadu_epi16(p); }
+SIMD_INLINE void vhq_storeu(int16_t* p, vhq_t v)        { _mm512_storeu_epi16(p, v); }
+SIMD_INLINE vhq_t vhq_set1(const int16_t x)             { return _mm512_set1_epi16(x); }
+SIMD_INLINE vhq_t vhq_bcast(const int16_t* p)           { return _mm512_set1_epi16(*p); }
+SIMD_INLINE vhq_t vhq_add(vhq_t a, vhq_t b)             { return _mm512_add_epi16(a, b); }
+SIMD_INLINE vhq_t vhq_mul(vhq_t a, vhq_t b)             { return _mm512_mullo_epi16(a, b); }
+SIMD_INLINE vhq_t vhq_fma(vhq_t a, vhq_t b, vhq_t c)    { return _mm512_add_epi16(c, _mm512_mullo_epi16(a, b)); }
+SIMD_INLINE vhq_mask_t vhq_mask(const int n) {
+    return (n >= 32) ? 0xFFFFFFFF : (n <= 0) ? 0 : (vhq_mask_t)((1u << n) - 1);
+}
+SIMD_INLINE vhq_t vhq_maskz_loadu(vhq_mask_t m, const int16_t* p)    { return _mm512_maskz_loadu_epi16(m, p); }
+SIMD_INLINE void vhq_mask_storeu(int16_t* p, vhq_mask_t m, vhq_t v)  { _mm512_mask_storeu_epi16(p, m, v); }
+#elif INSTLEVEL >= 7    /* AVX2 */
+#define VHQ_LEN 16
+typedef __m256i vhq_t;
+
+SIMD_INLINE vhq_t vhq_zero()                            { return _mm256_setzero_si256(); }
+SIMD_INLINE vhq_t vhq_load(const int16_t* p)            { return _mm256_load_si256((const __m256i*)p); }
+SIMD_INLINE vhq_t vhq_loadu(const int16_t* p)           { return _mm256_loadu_si256((const __m256i_u*)p); }
+SIMD_INLINE void vhq_storeu(int16_t* p, vhq_t v)        { _mm256_storeu_si256((__m256i_u*)p, v); }
+SIMD_INLINE vhq_t vhq_set1(const int16_t x)             { return _mm256_set1_epi16(x); }
+SIMD_INLINE vhq_t vhq_bcast(const int16_t* p)           { return _mm256_set1_epi16(*p); }
+SIMD_INLINE vhq_t vhq_add(vhq_t a, vhq_t b)             { return _mm256_add_epi16(a, b); }
+SIMD_INLINE vhq_t vhq_mul(vhq_t a, vhq_t b)             { return _mm256_mullo_epi16(a, b); }
+SIMD_INLINE vhq_t vhq_fma(vhq_t a, vhq_t b, vhq_t c)    { return _mm256_add_epi16(c, _mm256_mullo_epi16(a, b)); }
+#elif INSTLEVEL >= 6    /* AVX, integers in 128-bit registers */
+#define VHQ_LEN 8
+typedef __m128i vhq_t;
+
+SIMD_INLINE vhq_t vhq_zero()                            { return _mm_setzero_si128(); }
+SIMD_INLINE vhq_t vhq_load(const int16_t* p)            { return _mm_load_si128((const __m128i*)p); }
+SIMD_INLINE vhq_t vhq_loadu(const int16_t* p)           { return _mm_loadu_si128((const __m128i_u*)p); }
+SIMD_INLINE void vhq_storeu(int16_t* p, vhq_t v)        { _mm_storeu_si128((__m128i_u*)p, v); }
+SIMD_INLINE vhq_t vhq_set1(const int16_t x)             { return _mm_set1_epi16(x); }
+SIMD_INLINE vhq_t vhq_bcast(const int16_t* p)           { return _mm_set1_epi16(*p); }
+SIMD_INLINE vhq_t vhq_add(vhq_t a, vhq_t b)             { return _mm_add_epi16(a, b); }
+SIMD_INLINE vhq_t vhq_mul(vhq_t a, vhq_t b)             { return _mm_mullo_epi16(a, b); }
+SIMD_INLINE vhq_t vhq_fma(vhq_t a, vhq_t b, vhq_t c)    { return _mm_add_epi16(c, _mm_mullo_epi16(a, b)); }
+#endif              /* INSTLEVEL */
+
+#if INSTLEVEL >= 6 && INSTLEVEL < 9
+/* no word masked moves before AVX512BW: the mask is a lane count, a partial vector goes through a buffer */
+typedef int vhq_mask_t;
+
+SIMD_INLINE vhq_mask_t vhq_mask(const int n)            { return min(max(n, 0), VHQ_LEN); }
+SIMD_INLINE vhq_t vhq_maskz_loadu(vhq_mask_t m, const int16_t* p) {
+    if(m == VHQ_LEN)
+        return vhq_loadu(p);
+    int16_t buf[VHQ_LEN] = {0};
+    memcpy(buf, p, m * sizeof(int16_t));
+    return vhq_loadu(buf);
+}
+SIMD_INLINE void vhq_mask_storeu(int16_t* p, vhq_mask_t m, vhq_t v) {
+    if(m == VHQ_LEN) {
+        vhq_storeu(p, v);
+        return;
+    }
+    int16_t buf[VHQ_LEN];
+    vhq_storeu(buf, v);
+    memcpy(p, buf, m * sizeof(int16_t));
+}
+#endif              /* INSTLEVEL */
+
+/********************************************************
+ *
+ *          INT8
+ *
+*********************************************************/
+#if INSTLEVEL >= 9      /* AVX512BW */
+#define VQ_LEN 64
+typedef __m512i   vq_t;
+typedef __mmask64 vq_mask_t;
+
+SIMD_INLINE vq_t vq_zero()                              { return _mm512_setzero_si512(); }
+SIMD_INLINE vq_t vq_load(const int8_t* p)               { return _mm512_load_si512(p); }
+SIMD_INLINE vq_t vq_loadu(const int8_t* p)              { return _mm512_loadu_epi8(p); }
+SIMD_INLINE void vq_storeu(int8_t* p, vq_t v)           { _mm512_storeu_epi8(p, v); }
+SIMD_INLINE vq_t vq_set1(const int8_t x)                { return _mm512_set1_epi8(x); }
+SIMD_INLINE vq_t vq_bcast(const int8_t* p)              { return _mm512_set1_epi8(*p); }
+SIMD_INLINE vq_t vq_add(vq_t a, vq_t b)                 { return _mm512_add_epi8(a, b); }
+/* low bytes of the int16 products, even and odd bytes apart */
+SIMD_INLINE vq_t vq_mul(vq_t a, vq_t b) {
+    __m512i a_odd_hi = _mm512_and_si512(a, _mm512_set1_epi16(0xff00));
+
+    __m512i mul_even = _mm512_mullo_epi16(a, b);            /* with high garbage */
+    __m512i mul_odd  = _mm512_maddubs_epi16(b, a_odd_hi);   /* at the bottom of i16 elements */
+    __m512i mul_odd_shifted = _mm512_slli_epi16(mul_odd, 0x8);
+
+    return _mm512_mask_blend_epi8(0xAAAAAAAAAAAAAAAA, mul_even, mul_odd_shifted);
+}
+SIMD_INLINE vq_t vq_fma(vq_t a, vq_t b, vq_t c)         { return _mm512_add_epi8(c, vq_mul(a, b)); }
+SIMD_INLINE vq_mask_t vq_mask(const int n) {
+    return (n >= 64) ? 0xFFFFFFFFFFFFFFFF : (n <= 0) ? 0 : (vq_mask_t)((1ull << n) - 1);
+}
+SIMD_INLINE vq_t vq_maskz_loadu(vq_mask_t m, const int8_t* p)   { return _mm512_maskz_loadu_epi8(m, p); }
+SIMD_INLINE void vq_mask_storeu(int8_t* p, vq_mask_t m, vq_t v) { _mm512_mask_storeu_epi8(p, m, v); }
+#elif INSTLEVEL >= 7    /* AVX2 */
+#define VQ_LEN 32
+typedef __m256i vq_t;
+
+SIMD_INLINE vq_t vq_zero()                              { return _mm256_setzero_si256(); }
+SIMD_INLINE vq_t vq_load(const int8_t* p)               { return _mm256_load_si256((const __m256i*)p); }
+SIMD_INLINE vq_t vq_loadu(const int8_t* p)              { return _mm256_loadu_si256((const __m256i_u*)p); }
+SIMD_INLINE void vq_storeu(int8_t* p, vq_t v)           { _mm256_storeu_si256((__m256i_u*)p, v); }
+SIMD_INLINE vq_t vq_set1(const int8_t x)                { return _mm256_set1_epi8(x); }
+SIMD_INLINE vq_t vq_bcast(const int8_t* p)              { return _mm256_set1_epi8(*p); }
+SIMD_INLINE vq_t vq_add(vq_t a, vq_t b)                 { return _mm256_add_epi8(a, b); }
+/* low bytes of the int16 products, even and odd bytes apart */
+SIMD_INLINE vq_t vq_mul(vq_t a, vq_t b) {
+    __m256i a_odd_hi = _mm256_and_si256(a, _mm256_set1_epi16(0xff00));
+
+    __m256i mul_even = _mm256_mullo_epi16(a, b);
+    __m256i mul_odd  = _mm256_maddubs_epi16(a_odd_hi, b);
+    __m256i mul_odd_shifted = _mm256_slli_epi16(mul_odd, 0x8);
+
+    return _mm256_blendv_epi8(mul_odd_shifted, mul_even, _mm256_set1_epi16(0xF0));
+}
+SIMD_INLINE vq_t vq_fma(vq_t a, vq_t b, vq_t c)         { return _mm256_add_epi8(c, vq_mul(a, b)); }
+#endif              /* INSTLEVEL */
+
+#if INSTLEVEL >= 6 && INSTLEVEL < 9
+/**
+ * Without AVX512BW the int8 kernel multiplies and adds in the int16 lanes of vhq_t:
+ * the low byte of an int16 product or sum is the int8 one, so the int8 result is
+ * the low bytes at the end.
+ */
+SIMD_INLINE vhq_t vq_widen(const int8_t* p) {           /* VHQ_LEN int8, sign extended */
+#if INSTLEVEL >= 7      /* AVX2 */
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i_u*)p));
+#else
+    return _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i_u*)p));
+#endif
+}
+/* the byte at p in both bytes of every lane; the low byte of a product is the same */
+SIMD_INLINE vhq_t vq_bcast_widen(const int8_t* p) {
+#if INSTLEVEL >= 7      /* AVX2 */
+    return _mm256_set1_epi8(*p);
+#else
+    return _mm_set1_epi8(*p);
+#endif
+}
+SIMD_INLINE vhq_t vq_maskz_widen(vhq_mask_t m, const int8_t* p) {
+    if(m == VHQ_LEN)
+        return vq_widen(p);
+    int8_t buf[VHQ_LEN] = {0};
+    memcpy(buf, p, m * sizeof(int8_t));
+    return vq_widen(buf);
+}
+/* store the low bytes of the first m lanes */
+SIMD_INLINE void vq_mask_narrow_storeu(int8_t* p, vhq_mask_t m, vhq_t v) {
+    int8_t buf[16];
+#if INSTLEVEL >= 7      /* AVX2 */
+    __m256i low = _mm256_and_si256(v, _mm256_set1_epi16(0xFF));
+    __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(low), _mm256_extracti128_si256(low, 1));
+    if(m == VHQ_LEN) {
+        _mm_storeu_si128((__m128i_u*)p, packed);
+        return;
+    }
+    _mm_storeu_si128((__m128i_u*)buf, packed);
+#else
+    __m128i low = _mm_and_si128(v, _mm_set1_epi16(0xFF));
+    __m128i packed = _mm_packus_epi16(low, low);
+    if(m == VHQ_LEN) {
+        _mm_storel_epi64((__m128i_u*)p, packed);
+        return;
+    }
+    _mm_storeu_si128((__m128i_u*)buf, packed);
+#endif
+    memcpy(p, buf, m * sizeof(int8_t));
+}
+#endif              /* INSTLEVEL */
+
+/********************************************************
+ *
+ *          UINT8 x INT8 -> INT32
+ *
+*********************************************************/
+#if INSTLEVEL >= 9      /* AVX512BW */
+#define VQI_LEN 16
+typedef __m512i   vqi_t;
+typedef __mmask16 vqi_mask_t;
+
+SIMD_INLINE vqi_t vqi_zero()                            { return _mm512_setzero_si512(); }
+SIMD_INLINE vqi_t vqi_load(const int8_t* p)             { return _mm512_load_si512(p); }
+SIMD_INLINE vqi_t vqi_loadu(const int* p)               { return _mm512_loadu_si512(p); }
+SIMD_INLINE vqi_t vqi_set1(const int x)                 { return _mm512_set1_epi32(x); }
+SIMD_INLINE vqi_t vqi_add(vqi_t a, vqi_t b)             { return _mm512_add_epi32(a, b); }
+SIMD_INLINE vqi_mask_t vqi_mask(const int n) {
+    return (n >= 16) ? 0xFFFF : (n <= 0) ? 0 : (vqi_mask_t)((1u << n) - 1);
+}
+SIMD_INLINE vqi_t vqi_maskz_loadu(vqi_mask_t m, const int* p)   { return _mm512_maskz_loadu_epi32(m, p); }
+SIMD_INLINE void vqi_mask_storeu(int* p, vqi_mask_t m, vqi_t v) { _mm512_mask_storeu_epi32(p, m, v); }
+typedef __m512 vqif_t;
+SIMD_INLINE vqif_t vqif_set1(const float x)             { return _mm512_set1_ps(x); }
+SIMD_INLINE vqif_t vqif_maskz_loadu(vqi_mask_t m, const float* p)   { return _mm512_maskz_loadu_ps(m, p); }
+SIMD_INLINE vqi_t vqi_requant(vqi_t x, vqif_t scale, vqif_t lo, vqif_t hi) {
+    __m512 y = _mm512_mul_ps(_mm512_cvtepi32_ps(x), scale);
+    return _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(y, lo), hi));
+}
+SIMD_INLINE void vqi_mask_storeu_q(uint8_t* p, vqi_mask_t m, vqi_t v) { _mm512_mask_cvtepi32_storeu_epi8(p, m, v); }
+#if INSTLEVEL >= 10     /* AVX512VNNI */
+SIMD_INLINE vqi_t vqi_dot(vqi_t acc, vqi_t a, vqi_t b)  { return _mm512_dpbusd_epi32(acc, a, b); }
+#else
+/**
+ * vpmaddubsw saturates when both products of a pair are large, so the even and odd
+ * bytes of b go in separately: a single u8 x s8 product always fits in int16.
+ * b is the same for every row of a kernel, so its halves are computed once per k.
+ */
+SIMD_INLINE vqi_t vqi_dot(vqi_t acc, vqi_t a, vqi_t b) {
+    const __m512i ones = _mm512_set1_epi16(1);
+    __m512i even = _mm512_maddubs_epi16(a, _mm512_and_si512(b, _mm512_set1_epi16(0x00FF)));
+    __m512i odd  = _mm512_maddubs_epi16(a, _mm512_and_si512(b, _mm512_set1_epi16((short)0xFF00)));
+    acc = _mm512_add_epi32(acc, _mm512_madd_epi16(even, ones));
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(odd, ones));
+}
+#endif // VNNI
+#elif INSTLEVEL >= 7    /* AVX2, and AVX512F without byte instructions */
+#define VQI_LEN 8
+typedef __m256i vqi_t;
+typedef __m256i vqi_mask_t;
+
+SIMD_INLINE vqi_t vqi_zero()                            { return _mm256_setzero_si256(); }
+SIMD_INLINE vqi_t vqi_load(const int8_t* p)             { return _mm256_load_si256((const __m256i*)p); }
+SIMD_INLINE vqi_t vqi_loadu(const int* p)               { return _mm256_loadu_si256((const __m256i_u*)p); }
+SIMD_INLINE vqi_t vqi_set1(const int x)                 { return _mm256_set1_epi32(x); }
+SIMD_INLINE vqi_t vqi_add(vqi_t a, vqi_t b)             { return _mm256_add_epi32(a, b); }
+SIMD_INLINE vqi_mask_t vqi_mask(const int n) {
+    static const int32_t mask[16] __attribute__((aligned(32))) = {
+        -1, -1, -1, -1, -1, -1, -1, -1,
+        0,  0,  0,  0,  0,  0,  0,  0
+    };
+    return _mm256_loadu_si256((const __m256i_u*)&mask[8 - min(max(n, 0), 8)]);
+}
+SIMD_INLINE vqi_t vqi_maskz_loadu(vqi_mask_t m, const int* p)   { return _mm256_maskload_epi32(p, m); }
+SIMD_INLINE void vqi_mask_storeu(int* p, vqi_mask_t m, vqi_t v) { _mm256_maskstore_epi32(p, m, v); }
+typedef __m256 vqif_t;
+SIMD_INLINE vqif_t vqif_set1(const float x)             { return _mm256_set1_ps(x); }
+SIMD_INLINE vqif_t vqif_maskz_loadu(vqi_mask_t m, const float* p)   { return _mm256_maskload_ps(p, m); }
+SIMD_INLINE vqi_t vqi_requant(vqi_t x, vqif_t scale, vqif_t lo, vqif_t hi) {
+    __m256 y = _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale);
+    return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(y, lo), hi));
+}
+SIMD_INLINE void vqi_mask_storeu_q(uint8_t* p, vqi_mask_t m, vqi_t v) {
+    const __m256i low = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i bytes = _mm256_shuffle_epi8(v, low);
+    __m128i q = _mm_unpacklo_epi32(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+    const int len = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    if(len == VQI_LEN) {
+        _mm_storel_epi64((__m128i_u*)p, q);
+        return;
+    }
+    uint8_t buf[16];
+    _mm_storeu_si128((__m128i_u*)buf, q);
+    memcpy(p, buf, len);
+}
+/* even and odd bytes apart, see the AVX512BW version */
+SIMD_INLINE vqi_t vqi_dot(vqi_t acc, vqi_t a, vqi_t b) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i even = _mm256_maddubs_epi16(a, _mm256_and_si256(b, _mm256_set1_epi16(0x00FF)));
+    __m256i odd  = _mm256_maddubs_epi16(a, _mm256_and_si256(b, _mm256_set1_epi16((short)0xFF00)));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(even, ones));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(odd, ones));
+}
+#elif INSTLEVEL >= 6    /* AVX, integers in 128-bit registers */
+#define VQI_LEN 4
+typedef __m128i vqi_t;
+typedef __m128i vqi_mask_t;
+
+SIMD_INLINE vqi_t vqi_zero()                            { return _mm_setzero_si128(); }
+SIMD_INLINE vqi_t vqi_load(const int8_t* p)             { return _mm_load_si128((const __m128i*)p); }
+SIMD_INLINE vqi_t vqi_loadu(const int* p)               { return _mm_loadu_si128((const __m128i_u*)p); }
+SIMD_INLINE vqi_t vqi_set1(const int x)                 { return _mm_set1_epi32(x); }
+SIMD_INLINE vqi_t vqi_add(vqi_t a, vqi_t b)             { return _mm_add_epi32(a, b); }
+SIMD_INLINE vqi_mask_t vqi_mask(const int n)            { return vi_mask(n); }
+SIMD_INLINE vqi_t vqi_maskz_loadu(vqi_mask_t m, const int* p)   { return vi_maskz_loadu(m, p); }
+SIMD_INLINE void vqi_mask_storeu(int* p, vqi_mask_t m, vqi_t v) { vi_mask_storeu(p, m, v); }
+typedef __m128 vqif_t;
+SIMD_INLINE vqif_t vqif_set1(const float x)             { return _mm_set1_ps(x); }
+SIMD_INLINE vqif_t vqif_maskz_loadu(vqi_mask_t m, const float* p)   { return _mm_maskload_ps(p, m); }
+SIMD_INLINE vqi_t vqi_requant(vqi_t x, vqif_t scale, vqif_t lo, vqif_t hi) {
+    __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(x), scale);
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(y, lo), hi));
+}
+SIMD_INLINE void vqi_mask_storeu_q(uint8_t* p, vqi_mask_t m, vqi_t v) {
+    const __m128i low = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const int32_t q = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, low));
+    memcpy(p, &q, __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m))));
+}
+/* even and odd bytes apart, see the AVX512BW version */
+SIMD_INLINE vqi_t vqi_dot(vqi_t acc, vqi_t a, vqi_t b) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i even = _mm_maddubs_epi16(a, _mm_and_si128(b, _mm_set1_epi16(0x00FF)));
+    __m128i odd  = _mm_maddubs_epi16(a, _mm_and_si128(b, _mm_set1_epi16((short)0xFF00)));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(even, ones));
+    return _mm_add_epi32(acc, _mm_madd_epi16(odd, ones));
+}
+#endif              /* INSTLEVEL */
+
+/* the 4 bytes of k-group [p] in every int32 lane */
+SIMD_INLINE vqi_t vqi_bcast4(const uint8_t* p) {
+    int32_t x;
+    memcpy(&x, p, sizeof(x));
+    return vqi_set1(x);
+}
+
+/********************************************************
+ *
+ *          INT16 x INT16 -> INT32
+ *
+*********************************************************/
+/* on the vqi_ registers, with 2 consecutive k of one column in every int32 lane */
+SIMD_INLINE vqi_t vhqi_load(const int16_t* p)           { return vqi_load((const int8_t*)p); }
+#if INSTLEVEL >= 10     /* AVX512VNNI */
+SIMD_INLINE vqi_t vhqi_dot(vqi_t acc, vqi_t a, vqi_t b) { return _mm512_dpwssd_epi32(acc, a, b); }
+#elif INSTLEVEL >= 9    /* AVX512BW */
+SIMD_INLINE vqi_t vhqi_dot(vqi_t acc, vqi_t a, vqi_t b) { return _mm512_add_epi32(acc, _mm512_madd_epi16(a, b)); }
+#elif INSTLEVEL >= 7    /* AVX2, and AVX512F without word instructions */
+SIMD_INLINE vqi_t vhqi_dot(vqi_t acc, vqi_t a, vqi_t b) { return _mm256_add_epi32(acc, _mm256_madd_epi16(a, b)); }
+#elif INSTLEVEL >= 6    /* AVX */
+SIMD_INLINE vqi_t vhqi_dot(vqi_t acc, vqi_t a, vqi_t b) { return _mm_add_epi32(acc, _mm_madd_epi16(a, b)); }
+#endif              /* INSTLEVEL */
+
+/* the 2 int16 of k-pair [p] in every int32 lane */
+SIMD_INLINE vqi_t vhqi_bcast2(const int16_t* p) {
+    int32_t x;
+    memcpy(&x, p, sizeof(x));
+    return vqi_set1(x);
+}
+
+/**
+ * VQI_LEN int8 columns of two rows widened to the int16 k-pairs of vhqi_dot: lane c
+ * holds (p0[c], p1[c]). For the unpacked B of qigemv_n.
+ */
+#if INSTLEVEL >= 9      /* AVX512BW */
+SIMD_INLINE vqi_t vhqi_widen2(const int8_t* p0, const int8_t* p1) {
+    __m128i r0 = _mm_loadu_si128((const __m128i_u*)p0), r1 = _mm_loadu_si128((const __m128i_u*)p1);
+    __m256i pairs = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(r0, r1)),
+                                            _mm_unpackhi_epi8(r0, r1), 1);
+    return _mm512_cvtepi8_epi16(pairs);
+}
+#elif INSTLEVEL >= 7    /* AVX2, and AVX512F without word instructions */
+SIMD_INLINE vqi_t vhqi_widen2(const int8_t* p0, const int8_t* p1) {
+    __m128i r0 = _mm_loadl_epi64((const __m128i_u*)p0), r1 = _mm_loadl_epi64((const __m128i_u*)p1);
+    return _mm256_cvtepi8_epi16(_mm_unpacklo_epi8(r0, r1));
+}
+#elif INSTLEVEL >= 6    /* AVX */
+SIMD_INLINE vqi_t vhqi_widen2(const int8_t* p0, const int8_t* p1) {
+    int32_t x0, x1;
+    memcpy(&x0, p0, sizeof(x0));
+    memcpy(&x1, p1, sizeof(x1));
+    return _mm_cvtepi8_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(x0), _mm_cvtsi32_si128(x1)));
+}
+#endif              /* INSTLEVEL */
+
+/********************************************************
+ *
+ *          BF16 x BF16 -> FP32
+ *
+*********************************************************/
+#if INSTLEVEL >= 11     /* AVX512_BF16 */
+/* on the vs_ registers, with 2 consecutive k of one column in every fp32 lane */
+typedef __m512bh vbf_t;
+
+SIMD_INLINE vbf_t vbf_load(const uint16_t* p)           { return (vbf_t)_mm512_load_si512((const void*)p); }
+SIMD_INLINE vs_t vbf_dot(vs_t acc, vbf_t a, vbf_t b)    { return _mm512_dpbf16_ps(acc, a, b); }
+
+/* the 2 bf16 of k-pair [p] in every fp32 lane */
+SIMD_INLINE vbf_t vbf_bcast2(const uint16_t* p) {
+    int32_t x;
+    memcpy(&x, p, sizeof(x));
+    return (vbf_t)_mm512_set1_epi32(x);
+}
+#endif              /* INSTLEVEL */
+
+#endif // SIMD_H
@@ -37,10 +37,13 @@
 // 8:  AVX512F
 // 9:  AVX512BW
 // 10: AVX512VNNI
+// 11: AVX512_BF16
 
 // TODO: Define another macros (or not...?)
  #ifndef INSTLEVEL
-  #if defined (__AVX512VNNI__)
+  #if defined (__AVX512BF16__) && defined (__AVX512VNNI__)
+     #define INSTLEVEL 11
+  #elif defined (__AVX512VNNI__)
      #define INSTLEVEL 10
   #elif defined (__AVX512BW__) /* && defined (__AVX512VL__) */
      #define INSTLEVEL 9
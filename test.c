@@ -1,5 +1,15 @@
+#define _GNU_SOURCE
+
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "test.h"
 
+#define PACKED_TEST_FILE "gemm_packed_test.bin"
+#define BATCH_TEST_SIZE 5      /* GEMMs per batched call */
+#define SMALL_TEST_M 9         /* one past the largest SMALL_MR, see [kernel.c] */
+
 void sgemm_test(const int M, const int N, const int K, const int niter,
                 const int range, const int bound, FILE* file, BOOL console_flag) {
     int error_num = 0;
@@ -296,203 +306,2740 @@ int error_num = 0;
     }
 }
 
-uint64_t timer() {
-    struct timespec start;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
-    return (uint64_t)start.tv_sec * 1000000000 + (uint64_t)start.tv_nsec;
-}
+/* timed qgemm_s32, checked once per size with zero points and with a signed A too */
+void qgemm_s32_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag) {
+int error_num = 0;
 
-/********************************************************
- *                                                      
- *          Naive GEMM
- *                                                      
-*********************************************************/
-BOOL naive_sgemm(const float* A, const float* B, const float* C,
-                const int M, const int N, const int K) {
-    for(int r = 0; r < M; r++) {
-        for(int c = 0; c < N; c++) {
-            float sum = 0;
-            for (int k = 0; k < K; k++)
-                sum += (A[r * K + k] * B[k * N + c]);
-            if(sum != C[r * N + c])
-                return FALSE;
-        }
-    }
-    return TRUE;
-}
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        BOOL is_valid_gemm = FALSE;
+        double exec_times[3]  = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
+        double gflops[3]      = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
 
-BOOL naive_dgemm(const double* A, const double* B, const double* C,
-                const int M, const int N, const int K) {
-    for(int r = 0; r < M; r++) {
-        for(int c = 0; c < N; c++) {
-            double sum = 0;
-            for (int k = 0; k < K; k++)
-                sum += (A[r * K + k] * B[k * N + c]);
-            if(sum != C[r * N + c])
-                return FALSE;
-        }
-    }
-    return TRUE;
-}
+        uint8_t* A = (uint8_t *)malloc(m * k * sizeof(uint8_t));
+        int8_t* B = (int8_t *)malloc(k * n * sizeof(int8_t));
+        int32_t* C = (int32_t *)malloc(m * n * sizeof(int32_t));
 
-BOOL naive_igemm(const int* A, const int* B, const int* C,
-                 const int M, const int N, const int K) {
-    for(int r = 0; r < M; r++) {
-        for(int c = 0; c < N; c++) {
-            int sum = 0;
-            for (int k = 0; k < K; k++)
-                sum += (A[r * K + k] * B[k * N + c]);
-            if(sum != C[r * N + c])
-                return FALSE;
-        }
-    }
-    return TRUE;
-}
+        for(int i = 0; i < niter; i++) {
+            memset(C, 0, sizeof(int32_t) * m * n);
 
-BOOL naive_hqgemm(const int16_t* A, const int16_t* B, const int16_t* C,
-                const int M, const int N, const int K) {
-    for(int r = 0; r < M; r++) {
-        for(int c = 0; c < N; c++) {
-            int16_t sum = 0;
-            for (int k = 0; k < K; k++)
-                sum += (A[r * K + k] * B[k * N + c]);
-            if(sum != C[r * N + c])
-                return FALSE;
-        }
-    }
-    return TRUE;
-}
+            uint8_get_rand_mat(m, k, A, bound);
+            int8_get_rand_mat(k, n, B, bound);
 
-BOOL naive_qgemm(const int8_t* A, const int8_t* B, const int8_t* C,
-                const int M, const int N, const int K) {
-    for(int r = 0; r < M; r++) {
-        for(int c = 0; c < N; c++) {
-            int8_t sum = 0;
-            for (int k = 0; k < K; k++)
-                sum += (A[r * K + k] * B[k * N + c]);
-            if(sum != C[r * N + c])
-                return FALSE;
-        }
-    }
-    return TRUE;                 
-}
-            
-/********************************************************
- *                                                      
- *          Generate Random Matrix                                 
- *                                                      
-*********************************************************/
-void int32_get_rand_mat(int row, int col, int32_t* mat, int bound) {
-    srand(time(NULL));
-    for (int r = 0; r < row; r++)
-        for (int c = 0; c < col; c++) {
-            int32_t num = rand() % bound;
-            mat[r * col + c] = num<=bound/2 ? -num : num;
-        }
-}
+            double FLOP = 2 * (double)m * n * k;
 
-void fp32_get_rand_mat(int row, int col, float* mat, int bound) {
-    srand(time(NULL));
-    for (int r = 0; r < row; r++)
-        for (int c = 0; c < col; c++) {
-            float num = rand() % bound;
-            mat[r * col + c] = num<=bound/2 ? -num : num;
-        }
-}
+            uint64_t start = timer();
+            qgemm_s32(A, B, C, m, n, k);
+            uint64_t end = timer();
+            double elapsed = (end - start) * 1e-9;
+            double FLOPS = FLOP / elapsed;
 
-void fp64_get_rand_mat(int row, int col, double* mat, int bound) {
-    srand(time(NULL));
-    for (int r = 0; r < row; r++)
-        for (int c = 0; c < col; c++) {
-            double num = rand() % bound;
-            mat[r * col + c] = num<=bound/2 ? -num : num;
-        }
-}
+            if(i == 0) {
+                is_valid_gemm = naive_qgemm_s32(A, 0, B, 0, C, m, n, k, FALSE);
 
-void int16_get_rand_mat(int row, int col, int16_t* mat, int bound) {
-    srand(time(NULL));
-    for (int r = 0; r < row; r++)
-        for (int c = 0; c < col; c++) {
-            int16_t num = rand() % bound;
-            mat[r * col + c] = num<=bound/2 ? -num : num;
-        }
-}
+                const int32_t a_zero = bound / 2, b_zero = -(bound / 4);
+                qgemm_s32_ex(m, n, k, A, k, a_zero, B, n, b_zero, C, n);
+                is_valid_gemm = is_valid_gemm && naive_qgemm_s32(A, a_zero, B, b_zero, C, m, n, k, FALSE);
 
-void int8_get_rand_mat(int row, int col, int8_t* mat, int bound) {
-    srand(time(NULL));
-    for (int r = 0; r < row; r++)
-        for (int c = 0; c < col; c++) {
-            int8_t num = rand() % bound;
-            mat[r * col + c] = num<=bound/2 ? -num : num;
+                qgemm_s8s8_s32((const int8_t* )A, B, C, m, n, k);
+                is_valid_gemm = is_valid_gemm && naive_qgemm_s32(A, 0, B, 0, C, m, n, k, TRUE);
+            }
+
+            // if range is not 0, don't print each results
+            if(range == 0) {
+                printf("Exec. time = %.3lfms\n", elapsed * 1000);
+                printf("GFLOPS = %.3lf\n", FLOPS / 1e9);
+            }
+
+            exec_times[0] += (elapsed * 1000);
+            exec_times[1] = (exec_times[1] < (elapsed * 1000) ? (elapsed * 1000) : exec_times[1]);
+            exec_times[2] = (exec_times[2] > (elapsed * 1000) ? (elapsed * 1000) : exec_times[2]);
+
+            gflops[0] += (FLOPS / 1e9);
+            gflops[1] = (gflops[1] < (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[1]);
+            gflops[2] = (gflops[2] > (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[2]);
         }
-}
+        free(A);
+        free(B);
+        free(C);
 
-/********************************************************
- *                                                      
- *          Matrix Print                                
- *                                                      
-*********************************************************/
-void int32_print(int row, int col, int32_t* mat) {
-    printf("INT32 Matrix Print\n");
-    for(int r=0; r<row; r++) {
-        for (int c=0; c<col; c++) 
-            printf("%3d ", mat[r *col + c]);
-        printf("\n");
+        if(!is_valid_gemm) error_num++;
+        if(console_flag) print_console(m, k, n, niter, exec_times, gflops, is_valid_gemm);
+        if(file != NULL) print_file(m, k, n, niter, exec_times, gflops, is_valid_gemm, file);
     }
-    printf("\n");
-}
-
-void fp32_print(int row, int col, float* mat) {
-    printf("FP32 Matrix Print\n");
-    for(int r=0; r<row; r++) {
-        for (int c=0; c<col; c++) 
-            printf("%5.2f ", mat[r * col + c]);
-        printf("\n");
     }
-    printf("\n");
-}
-
-void fp64_print(int row, int col, double* mat) {
-    printf("FP64 Matrix Print\n");
-    for(int r=0; r<row; r++) {
-        for (int c=0; c<col; c++) 
-            printf("%5.2lf ", mat[r * col + c]);
-        printf("\n");
     }
-    printf("\n");
 }
 
-void print_console(const int M, const int K, const int N, const int niter, 
-                   const double* exec_time, const double* gflops, const BOOL is_valid_gemm) {
-    printf("════════════════════════════════════════════════\n\n");
-    printf("A: %dx%d B: %dx%d C: %dx%d\n\n", M, K, K, N, M, N);
-    printf("GEMM Test on %d Iterations\n", niter);
-    printf("%s\n\n", (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+void hqgemm_s32_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag) {
+int error_num = 0;
 
-    printf("AVG Exec. Time: %5.3lfms\n",     exec_time[0] / niter);
-    printf("MAX Exec. Time: %5.3lfms\n",     exec_time[1]);
-    printf("MIN Exec. Time: %5.3lfms\n\n",   exec_time[2]);
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        BOOL is_valid_gemm = FALSE;
+        double exec_times[3]  = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
+        double gflops[3]      = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
 
-    printf("AVG GFLOPS : %5.3lf\n",   gflops[0] / niter);
-    printf("MAX GFLOPS : %5.3lf\n",   gflops[1]);
-    printf("MIN GFLOPS : %5.3lf\n\n", gflops[2]);
-    printf("════════════════════════════════════════════════\n");
-}
+        int16_t* A = (int16_t *)malloc(m * k * sizeof(int16_t));
+        int16_t* B = (int16_t *)malloc(k * n * sizeof(int16_t));
+        int32_t* C = (int32_t *)malloc(m * n * sizeof(int32_t));
 
-void print_file(const int M, const int K, const int N, const int niter,
-                   const double* exec_time, const double* gflops, 
-                   const BOOL is_valid_gemm, FILE* file) {
-    fprintf(file, "════════════════════════════════════════════════\n\n");
-    fprintf(file, "A: %dx%d B: %dx%d C: %dx%d\n\n", M, K, K, N, M, N);
-    fprintf(file, "GEMM Test on %d Iterations\n", niter);
-    fprintf(file, "%s\n\n", (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+        for(int i = 0; i < niter; i++) {
+            memset(C, 0, sizeof(int32_t) * m * n);
 
-    fprintf(file, "AVG Exec. Time: %5.3lfms\n",     exec_time[0] / niter);
-    fprintf(file, "MAX Exec. Time: %5.3lfms\n",     exec_time[1]);
-    fprintf(file, "MIN Exec. Time: %5.3lfms\n\n",   exec_time[2]);
+            int16_get_rand_mat(m, k, A, bound);
+            int16_get_rand_mat(k, n, B, bound);
 
-    fprintf(file, "AVG GFLOPS : %5.3lf\n",   gflops[0] / niter);
-    fprintf(file, "MAX GFLOPS : %5.3lf\n",   gflops[1]);
-    fprintf(file, "MIN GFLOPS : %5.3lf\n\n", gflops[2]);
-    fprintf(file, "════════════════════════════════════════════════\n");
+            double FLOP = 2 * (double)m * n * k;
+
+            uint64_t start = timer();
+            hqgemm_s32(A, B, C, m, n, k);
+            uint64_t end = timer();
+            double elapsed = (end - start) * 1e-9;
+            double FLOPS = FLOP / elapsed;
+
+            if(i == 0) {
+                is_valid_gemm = naive_hqgemm_s32(A, k, B, n, C, n, m, n, k);
+
+                /* the extremes, where the pairs of vpmaddwd wrap */
+                int16_t* A_ext = (int16_t *)malloc(m * (k + 3) * sizeof(int16_t));
+                int16_t* B_ext = (int16_t *)malloc(k * (n + 5) * sizeof(int16_t));
+                int32_t* C_ext = (int32_t *)malloc(m * (n + 7) * sizeof(int32_t));
+                for(int e = 0; e < m * (k + 3); e++)
+                    A_ext[e] = (e % 3 == 0) ? INT16_MAX : INT16_MIN;
+                for(int e = 0; e < k * (n + 5); e++)
+                    B_ext[e] = (e % 5 == 0) ? INT16_MAX : INT16_MIN;
+                hqgemm_s32_ex(m, n, k, A_ext, k + 3, B_ext, n + 5, C_ext, n + 7);
+                is_valid_gemm = is_valid_gemm
+                                && naive_hqgemm_s32(A_ext, k + 3, B_ext, n + 5, C_ext, n + 7, m, n, k);
+                free(A_ext);
+                free(B_ext);
+                free(C_ext);
+            }
+
+            // if range is not 0, don't print each results
+            if(range == 0) {
+                printf("Exec. time = %.3lfms\n", elapsed * 1000);
+                printf("GFLOPS = %.3lf\n", FLOPS / 1e9);
+            }
+
+            exec_times[0] += (elapsed * 1000);
+            exec_times[1] = (exec_times[1] < (elapsed * 1000) ? (elapsed * 1000) : exec_times[1]);
+            exec_times[2] = (exec_times[2] > (elapsed * 1000) ? (elapsed * 1000) : exec_times[2]);
+
+            gflops[0] += (FLOPS / 1e9);
+            gflops[1] = (gflops[1] < (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[1]);
+            gflops[2] = (gflops[2] > (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[2]);
+        }
+        free(A);
+        free(B);
+        free(C);
+
+        if(!is_valid_gemm) error_num++;
+        if(console_flag) print_console(m, k, n, niter, exec_times, gflops, is_valid_gemm);
+        if(file != NULL) print_file(m, k, n, niter, exec_times, gflops, is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void bf16gemm_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag) {
+    int error_num = 0;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        BOOL is_valid_gemm = FALSE;
+        double exec_times[3]  = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
+        double gflops[3]      = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
+
+        uint16_t* A = (uint16_t *)malloc(m * k * sizeof(uint16_t));
+        uint16_t* B = (uint16_t *)malloc(k * n * sizeof(uint16_t));
+        float* C = (float *)malloc(m * n * sizeof(float));
+
+        for(int i = 0; i < niter; i++) {
+            memset(C, 0, sizeof(float) * m * n);
+
+            bf16_get_rand_mat(m, k, A, bound);
+            bf16_get_rand_mat(k, n, B, bound);
+
+            double FLOP = 2 * (double)m * n * k;
+
+            uint64_t start = timer();
+            bf16gemm(A, B, C, m, n, k);
+            uint64_t end = timer();
+            double elapsed = (end - start) * 1e-9;
+            double FLOPS = FLOP / elapsed;
+
+            if(i == 0) is_valid_gemm = naive_bf16gemm(A, B, C, m, n, k);
+
+            // if range is not 0, don't print each results
+            if(range == 0) {
+                printf("Exec. time = %.3lfms\n", elapsed * 1000);
+                printf("GFLOPS = %.3lf\n", FLOPS / 1e9);
+            }
+
+            exec_times[0] += (elapsed * 1000);
+            exec_times[1] = (exec_times[1] < (elapsed * 1000) ? (elapsed * 1000) : exec_times[1]);
+            exec_times[2] = (exec_times[2] > (elapsed * 1000) ? (elapsed * 1000) : exec_times[2]);
+
+            gflops[0] += (FLOPS / 1e9);
+            gflops[1] = (gflops[1] < (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[1]);
+            gflops[2] = (gflops[2] > (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[2]);
+        }
+        free(A);
+        free(B);
+        free(C);
+
+        if(!is_valid_gemm) error_num++;
+        if(console_flag) print_console(m, k, n, niter, exec_times, gflops, is_valid_gemm);
+        if(file != NULL) print_file(m, k, n, niter, exec_times, gflops, is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void hgemm_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag) {
+    int error_num = 0;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        BOOL is_valid_gemm = FALSE;
+        double exec_times[3]  = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
+        double gflops[3]      = {0, __FLT_MIN__, __FLT_MAX__};    /* avg max min */
+
+        uint16_t* A = (uint16_t *)malloc(m * k * sizeof(uint16_t));
+        uint16_t* B = (uint16_t *)malloc(k * n * sizeof(uint16_t));
+        float* C = (float *)malloc(m * n * sizeof(float));
+
+        for(int i = 0; i < niter; i++) {
+            memset(C, 0, sizeof(float) * m * n);
+
+            fp16_get_rand_mat(m, k, A, bound);
+            fp16_get_rand_mat(k, n, B, bound);
+
+            double FLOP = 2 * (double)m * n * k;
+
+            uint64_t start = timer();
+            hgemm(A, B, C, m, n, k);
+            uint64_t end = timer();
+            double elapsed = (end - start) * 1e-9;
+            double FLOPS = FLOP / elapsed;
+
+            if(i == 0) {
+                is_valid_gemm = naive_hgemm(A, B, C, m, n, k);
+
+                /* fp16 C; entries of 0 and -1 keep every partial sum exact in fp16 up to K = 2048 */
+                uint16_t* C_h = (uint16_t *)malloc(m * n * sizeof(uint16_t));
+                memset(C_h, 0, sizeof(uint16_t) * m * n);
+                fp16_get_rand_mat(m, k, A, min(bound, 2));
+                fp16_get_rand_mat(k, n, B, min(bound, 2));
+                hgemm_f16(A, B, C_h, m, n, k);
+                for(int e = 0; e < m * n; e++)
+                    C[e] = fp16_to_fp32(C_h[e]);
+                is_valid_gemm = is_valid_gemm && naive_hgemm(A, B, C, m, n, k);
+                free(C_h);
+            }
+
+            // if range is not 0, don't print each results
+            if(range == 0) {
+                printf("Exec. time = %.3lfms\n", elapsed * 1000);
+                printf("GFLOPS = %.3lf\n", FLOPS / 1e9);
+            }
+
+            exec_times[0] += (elapsed * 1000);
+            exec_times[1] = (exec_times[1] < (elapsed * 1000) ? (elapsed * 1000) : exec_times[1]);
+            exec_times[2] = (exec_times[2] > (elapsed * 1000) ? (elapsed * 1000) : exec_times[2]);
+
+            gflops[0] += (FLOPS / 1e9);
+            gflops[1] = (gflops[1] < (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[1]);
+            gflops[2] = (gflops[2] > (FLOPS / 1e9) ? (FLOPS / 1e9) : gflops[2]);
+        }
+        free(A);
+        free(B);
+        free(C);
+
+        if(!is_valid_gemm) error_num++;
+        if(console_flag) print_console(m, k, n, niter, exec_times, gflops, is_valid_gemm);
+        if(file != NULL) print_file(m, k, n, niter, exec_times, gflops, is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void sgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const float alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int tb = 0; tb < 2; tb++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE transA = transes[ta], transB = transes[tb];
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? m : k, A_col = (transA == T_NO_TRANS) ? k : m;
+        int B_row = (transB == T_NO_TRANS) ? k : n, B_col = (transB == T_NO_TRANS) ? n : k;
+        if(layout == L_COL_MAJOR) {
+            int tmp;
+            tmp = A_row; A_row = A_col; A_col = tmp;
+            tmp = B_row; B_row = B_col; B_col = tmp;
+        }
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        float* A = (float *)malloc(A_row * lda * sizeof(float));
+        float* B = (float *)malloc(B_row * ldb * sizeof(float));
+        float* C = (float *)malloc(C_row * ldc * sizeof(float));
+        float* C_ref = (float *)malloc(C_row * ldc * sizeof(float));
+
+        fp32_get_rand_mat(A_row, lda, A, bound);
+        fp32_get_rand_mat(B_row, ldb, B, bound);
+        fp32_get_rand_mat(C_row, ldc, C, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(float));
+
+        sgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        naive_sgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C[r * ldc + c] != C_ref[r * ldc + c])
+                    is_valid_gemm = FALSE;
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+
+        if(console_flag) print_ex_console(m, k, n, layout, transA, transB, is_valid_gemm);
+        if(file != NULL) print_ex_file(m, k, n, layout, transA, transB, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+/* sgemm_gather with A rows repeated, C rows reversed, each list on its own and both */
+void sgemm_gather_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const char* mode_names[3] = {"A_rows", "C_rows", "A_rows C_rows"};
+    const float alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int mode = 0; mode < 3; mode++) {
+        TRANSPOSE transA = transes[ta];
+        const int A_src = m + 5, C_src = m + 3;     /* rows of op(A) and C to pick from */
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? A_src : k, A_col = (transA == T_NO_TRANS) ? k : A_src;
+        int lda = A_col + 3, ldb = n + 5, ldc = n + 7;
+
+        float* A = (float *)malloc(A_row * lda * sizeof(float));
+        float* B = (float *)malloc(k * ldb * sizeof(float));
+        float* C = (float *)malloc(C_src * ldc * sizeof(float));
+        float* C_ref = (float *)malloc(C_src * ldc * sizeof(float));
+        float* A_dense = (float *)malloc((m * k + 1) * sizeof(float));
+        float* C_dense = (float *)malloc((m * ldc + 1) * sizeof(float));
+        int* A_rows = (int *)malloc(m * sizeof(int));
+        int* C_rows = (int *)malloc(m * sizeof(int));
+
+        fp32_get_rand_mat(A_row, lda, A, bound);
+        fp32_get_rand_mat(k, ldb, B, bound);
+        fp32_get_rand_mat(C_src, ldc, C, bound);
+        memcpy(C_ref, C, C_src * ldc * sizeof(float));
+        for(int r = 0; r < m; r++) {
+            A_rows[r] = (mode != 1) ? (r * 7 + 3) % A_src : r;
+            C_rows[r] = (mode != 0) ? C_src - 1 - r : r;
+        }
+
+        sgemm_gather(transA, T_NO_TRANS, m, n, k, alpha, A, lda, (mode != 1) ? A_rows : NULL,
+                     B, ldb, beta, C, ldc, (mode != 0) ? C_rows : NULL);
+
+        /* the copies sgemm_gather saves: gather, multiply, scatter */
+        for(int r = 0; r < m; r++) {
+            for(int c = 0; c < k; c++)
+                A_dense[r * k + c] = (transA == T_NO_TRANS) ? A[A_rows[r] * lda + c] : A[c * lda + A_rows[r]];
+            memcpy(&C_dense[r * ldc], &C_ref[C_rows[r] * ldc], ldc * sizeof(float));
+        }
+        naive_sgemm_ex(L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A_dense, k, B, ldb,
+                       beta, C_dense, ldc);
+        for(int r = 0; r < m; r++)
+            memcpy(&C_ref[C_rows[r] * ldc], &C_dense[r * ldc], ldc * sizeof(float));
+
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < C_src * ldc; i++)
+            if(C[i] != C_ref[i])
+                is_valid_gemm = FALSE;
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+        free(A_dense);
+        free(C_dense);
+        free(A_rows);
+        free(C_rows);
+
+        char name[64];
+        snprintf(name, sizeof(name), "sgemm_gather %s %s", (transA == T_NO_TRANS) ? "N" : "T", mode_names[mode]);
+        if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+}
+
+/* element i of a vector of [len] elements, [inc] apart as in BLAS */
+#define VEC_AT(v, len, inc, i) (v)[((inc) < 0) ? ((len) - 1 - (i)) * -(inc) : (i) * (inc)]
+
+/* sgemv with every layout and transpose, contiguous and strided x and y, the negative stride from the end */
+void sgemv_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const int incs[2][2] = {{1, 1}, {2, -3}};
+    const float alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int s = 0; s < 2; s++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE trans = transes[ta];
+        const int incx = incs[s][0], incy = incs[s][1];
+        const int x_len = (trans == T_NO_TRANS) ? n : m, y_len = (trans == T_NO_TRANS) ? m : n;
+
+        /* stored shape, with a padded leading dimension */
+        int A_row = (layout == L_ROW_MAJOR) ? m : n, A_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3;
+        const int x_size = x_len * abs(incx) + 1, y_size = y_len * abs(incy) + 1;
+
+        float* A = (float *)malloc(A_row * lda * sizeof(float));
+        float* x = (float *)malloc(x_size * sizeof(float));
+        float* y = (float *)malloc(y_size * sizeof(float));
+        float* y_ref = (float *)malloc(y_size * sizeof(float));
+
+        fp32_get_rand_mat(A_row, lda, A, bound);
+        fp32_get_rand_mat(1, x_size, x, bound);
+        fp32_get_rand_mat(1, y_size, y, bound);
+        memcpy(y_ref, y, y_size * sizeof(float));
+
+        sgemv(layout, trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+
+        for(int i = 0; i < y_len; i++) {
+            float sum = 0;
+            for(int j = 0; j < x_len; j++) {
+                const int r = (trans == T_NO_TRANS) ? i : j, c = (trans == T_NO_TRANS) ? j : i;
+                const float a = (layout == L_ROW_MAJOR) ? A[r * lda + c] : A[c * lda + r];
+                sum += a * VEC_AT(x, x_len, incx, j);
+            }
+            VEC_AT(y_ref, y_len, incy, i) = alpha * sum + beta * VEC_AT(y_ref, y_len, incy, i);
+        }
+
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < y_size; i++)
+            if(y[i] != y_ref[i])
+                is_valid_gemm = FALSE;
+
+        free(A);
+        free(x);
+        free(y);
+        free(y_ref);
+
+        char name[64];
+        snprintf(name, sizeof(name), "sgemv %s %s incx %d incy %d", (layout == L_ROW_MAJOR) ? "row" : "col",
+                 (trans == T_NO_TRANS) ? "N" : "T", incx, incy);
+        if(console_flag) print_check_console(m, n, 1, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, n, 1, name, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+}
+
+/**
+ * Every shape of GEMM_FIXED_SHAPES on the packed path, and on the small path if it has
+ * a kernel there, against the generic kernels: a context whose ISA lists no shapes.
+ * The entries are integers, so both are exact.
+ */
+void sgemm_fixed_test(const int bound, FILE* file, BOOL console_flag) {
+    const float alpha = 2, beta = -1;
+    gemm_ctx_t* ctx = gemm_ctx_create();
+    gemm_ctx_t* ctx_ref = gemm_ctx_create();
+    if(ctx == NULL || ctx_ref == NULL) {
+        gemm_ctx_destroy(ctx);
+        gemm_ctx_destroy(ctx_ref);
+        return;
+    }
+    static const gemm_fixed_t no_shapes[1];
+    gemm_isa_t isa_ref = *ctx->isa;
+    isa_ref.s.fixed = no_shapes;
+    ctx_ref->isa = &isa_ref;
+
+    for(const gemm_fixed_t* fixed = ctx->isa->s.fixed; fixed->M != 0; fixed++) {
+        const int m = fixed->M, n = fixed->N, k = fixed->K;
+        float* A = (float *)malloc((size_t)m * k * sizeof(float));
+        float* B = (float *)malloc((size_t)k * n * sizeof(float));
+        float* C = (float *)malloc((size_t)m * n * sizeof(float));
+        float* C_ref = (float *)malloc((size_t)m * n * sizeof(float));
+        float* C_init = (float *)malloc((size_t)m * n * sizeof(float));
+
+        fp32_get_rand_mat(m, k, A, bound);
+        fp32_get_rand_mat(k, n, B, bound);
+        fp32_get_rand_mat(m, n, C_init, bound);
+
+        for(int small = (fixed->small != NULL); small >= 0; small--) {
+            ctx->small_mnk = ctx_ref->small_mnk = small ? (int64_t)m * n * k : 0;
+            memcpy(C, C_init, (size_t)m * n * sizeof(float));
+            memcpy(C_ref, C_init, (size_t)m * n * sizeof(float));
+            sgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A, k, B, n, beta, C, n);
+            sgemm_ex_ctx(ctx_ref, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A, k, B, n, beta, C_ref, n);
+
+            BOOL is_valid_gemm = TRUE;
+            for(size_t j = 0; j < (size_t)m * n; j++)
+                if(C[j] != C_ref[j])
+                    is_valid_gemm = FALSE;
+            const char* name = small ? "sgemm fixed small" : "sgemm fixed packed";
+            if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+            if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+        }
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+        free(C_init);
+    }
+    gemm_ctx_destroy(ctx);
+    gemm_ctx_destroy(ctx_ref);
+}
+
+/**
+ * The unpacked small path (see *gemm_small) against the packed one, each forced through
+ * small_mnk: every M up to one past the largest SMALL_MR, N with masked edges, op(A)
+ * transposed and strided, alpha other than 1, and beta = 0 over a C of NaNs, which has to
+ * be overwritten rather than scaled. small_mnk = 0 has to send the call to the nest.
+ */
+void sgemm_small_test(const int bound, FILE* file, BOOL console_flag) {
+    const int ns[4] = {3, 19, 32, 37}, ks[3] = {1, 5, 16};
+    const float alphas[2] = {1, -2}, betas[2] = {0, 3};
+    gemm_ctx_t* ctx = gemm_ctx_create();
+    gemm_ctx_t* ctx_ref = gemm_ctx_create();
+    if(ctx == NULL || ctx_ref == NULL) {
+        gemm_ctx_destroy(ctx);
+        gemm_ctx_destroy(ctx_ref);
+        return;
+    }
+    /* the generic small kernel, not one of GEMM_FIXED_SHAPES */
+    static const gemm_fixed_t no_shapes[1];
+    gemm_isa_t isa = *ctx->isa;
+    isa.s.fixed = no_shapes;
+    ctx->isa = &isa;
+    ctx->small_mnk = INT64_MAX;
+    ctx_ref->small_mnk = 0;
+
+    for(int ta = 0; ta < 2; ta++) {
+    for(int ab = 0; ab < 4; ab++) {
+        const TRANSPOSE transA = ta ? T_TRANS : T_NO_TRANS;
+        const float alpha = alphas[ab / 2], beta = betas[ab % 2];
+        BOOL is_valid_gemm = TRUE;
+
+        for(int m = 1; m <= SMALL_TEST_M; m++) {
+        for(int ni = 0; ni < 4; ni++) {
+        for(int ki = 0; ki < 3; ki++) {
+            const int n = ns[ni], k = ks[ki];
+            /* padded leading dimensions */
+            const int A_row = ta ? k : m, lda = (ta ? m : k) + 3, ldb = n + 2, ldc = n + 1;
+            float* A = (float *)malloc(A_row * lda * sizeof(float));
+            float* B = (float *)malloc(k * ldb * sizeof(float));
+            float* C = (float *)malloc(m * ldc * sizeof(float));
+            float* C_ref = (float *)malloc(m * ldc * sizeof(float));
+
+            fp32_get_rand_mat(A_row, lda, A, bound);
+            fp32_get_rand_mat(k, ldb, B, bound);
+            if(beta == 0)
+                for(int e = 0; e < m * ldc; e++)
+                    C[e] = NAN;
+            else
+                fp32_get_rand_mat(m, ldc, C, bound);
+            memcpy(C_ref, C, m * ldc * sizeof(float));
+
+            sgemm_ex_ctx(ctx, L_ROW_MAJOR, transA, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+            sgemm_ex_ctx(ctx_ref, L_ROW_MAJOR, transA, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+            /* the padding of C is left alone, NaN or not */
+            for(int r = 0; r < m; r++)
+                for(int c = 0; c < ldc; c++)
+                    if((c < n) ? (C[r * ldc + c] != C_ref[r * ldc + c])
+                               : (memcmp(&C[r * ldc + c], &C_ref[r * ldc + c], sizeof(float)) != 0))
+                        is_valid_gemm = FALSE;
+
+            free(A);
+            free(B);
+            free(C);
+            free(C_ref);
+        }
+        }
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "sgemm small %s alpha %g beta %g%s", ta ? "T" : "N",
+                 (double)alpha, (double)beta, (beta == 0) ? " over NaN" : "");
+        if(console_flag) print_check_console(SMALL_TEST_M, ks[2], ns[3], name, is_valid_gemm);
+        if(file != NULL) print_check_file(SMALL_TEST_M, ks[2], ns[3], name, is_valid_gemm, file);
+    }
+    }
+
+    /* on up to small_mnk, off above it and at 0: only the packed path opens a region */
+    const int m = 4, n = 19, k = 5;
+    float* A = (float *)calloc(m * k, sizeof(float));
+    float* B = (float *)calloc(k * n, sizeof(float));
+    float* C = (float *)calloc(m * n, sizeof(float));
+    const int64_t small_mnks[3] = {(int64_t)m * n * k, (int64_t)m * n * k - 1, 0};
+    ctx->collect_stats = TRUE;
+    for(int i = 0; i < 3; i++) {
+        ctx->small_mnk = small_mnks[i];
+        gemm_stats_reset(ctx);
+        sgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS, m, n, k, 1, A, k, B, n, 0, C, n);
+        const BOOL is_valid_gemm = (ctx->stats.regions == ((i == 0) ? 0 : 1));
+
+        char name[64];
+        snprintf(name, sizeof(name), "sgemm small_mnk %lld %s", (long long)small_mnks[i],
+                 (i == 0) ? "unpacked" : "packed");
+        if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+    }
+    free(A);
+    free(B);
+    free(C);
+
+    gemm_ctx_destroy(ctx);
+    gemm_ctx_destroy(ctx_ref);
+}
+
+/**
+ * gemm_ws_reserve when an allocation fails: FALSE with nothing recorded for that
+ * buffer, so the next call that can be served allocates it again.
+ */
+void gemm_ws_test(FILE* file, BOOL console_flag) {
+    gemm_ws_t ws;
+    memset(&ws, 0, sizeof(gemm_ws_t));
+
+    BOOL is_valid = (!gemm_ws_reserve(&ws, SIZE_MAX / 2, 0) && ws.packed_A == NULL && ws.size_A == 0);
+    is_valid = is_valid && gemm_ws_reserve(&ws, 256, 256)
+               && ws.packed_A != NULL && ws.size_A >= 256 && ws.packed_B != NULL && ws.size_B >= 256;
+    is_valid = is_valid && !gemm_ws_reserve(&ws, 256, SIZE_MAX / 2)
+               && ws.packed_A != NULL && ws.packed_B == NULL && ws.size_B == 0;
+    free(ws.packed_A);
+    free(ws.packed_B);
+
+    if(console_flag) print_check_console(0, 0, 0, "gemm_ws_reserve out of memory", is_valid);
+    if(file != NULL) print_check_file(0, 0, 0, "gemm_ws_reserve out of memory", is_valid, file);
+}
+
+/* write [text] to [root]/[path], making the directories on the way */
+static void fixture_write(const char* root, const char* path, const char* text) {
+    char full[512];
+    snprintf(full, sizeof(full), "%s/%s", root, path);
+    for(char* p = strchr(full + strlen(root) + 1, '/'); p != NULL; p = strchr(p + 1, '/')) {
+        (*p) = '\0';
+        mkdir(full, 0755);
+        (*p) = '/';
+    }
+    FILE* file = fopen(full, "w");
+    if(file == NULL)
+        return;
+    fputs(text, file);
+    fclose(file);
+}
+
+static int fixture_remove(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    return remove(path);
+}
+
+/**
+ * A sysfs with CPUs 0-3,8,10-11 allowed, 0 and 1 SMT siblings, an L2 per core, an L3
+ * for 0-3 and one for 8-11, and those two as NUMA nodes if [numa].
+ */
+static void topo_fixture(const char* root, const BOOL numa) {
+    static const int cpus[7] = {0, 1, 2, 3, 8, 10, 11};
+    fixture_write(root, "proc/self/status", "Name:\ttt\nCpus_allowed_list:\t0-3,8,10-11\n");
+    for(int i = 0; i < 7; i++) {
+        const int cpu = cpus[i];
+        char path[256], core[16];
+        if(cpu <= 1) snprintf(core, sizeof(core), "0-1\n");
+        else         snprintf(core, sizeof(core), "%d\n", cpu);
+        const char* l3 = (cpu <= 3) ? "0-3\n" : "8-11\n";
+
+        snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        fixture_write(root, path, core);
+        snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/topology/package_cpus_list", cpu);
+        fixture_write(root, path, "0-3,8-11\n");
+        for(int index = 0; index < 3; index++) {
+            const char* level[3] = {"1\n", "2\n", "3\n"};
+            snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+            fixture_write(root, path, level[index]);
+            snprintf(path, sizeof(path), "sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list",
+                     cpu, index);
+            fixture_write(root, path, (index < 2) ? core : l3);
+        }
+    }
+    if(numa) {
+        fixture_write(root, "sys/devices/system/node/node0/cpulist", "0-3\n");
+        fixture_write(root, "sys/devices/system/node/node1/cpulist", "8-11\n");
+    }
+}
+
+/**
+ * get_topology_at over fixture trees: the cpulist ranges, the cache and NUMA groups,
+ * a 4-CPU cgroup v2 quota, nested v2 and v1 cgroups whose tighter quota sits higher up
+ * and the GEMM_NUM_THREADS override. GEMM_NUM_THREADS is put back afterwards.
+ */
+void topology_test(FILE* file, BOOL console_flag) {
+    const char* env = getenv("GEMM_NUM_THREADS");
+    char* saved = (env != NULL) ? strdup(env) : NULL;
+
+    for(int t = 0; t < 5; t++) {
+        char root[] = "/tmp/gemm_topo_XXXXXX";
+        if(mkdtemp(root) == NULL)
+            break;
+        topo_fixture(root, t == 0);
+        unsetenv("GEMM_NUM_THREADS");
+
+        const char* name = "";
+        gemm_topo_t topo;
+        BOOL is_valid = FALSE;
+        switch(t) {
+            case 0:
+                name = "topology cpulist 0-3,8,10-11, L2, L3, NUMA";
+                get_topology_at(&topo, root);
+                is_valid = (topo.ncpus == 7 && topo.ncores == 6 && topo.smt == 1
+                            && topo.npackages == 1 && topo.nl2 == 6 && topo.nl3 == 2
+                            && topo.nnuma == 2 && topo.quota == 0 && topo.nthreads == 3);
+                break;
+            case 1:
+                name = "topology cgroup v2 quota 4";
+                fixture_write(root, "proc/self/cgroup", "0::/a\n");
+                fixture_write(root, "sys/fs/cgroup/a/cpu.max", "350000 100000\n");
+                get_topology_at(&topo, root);
+                is_valid = (topo.quota == 4 && topo.nthreads == 4);
+                break;
+            case 2:
+                name = "topology cgroup v2 nested";
+                fixture_write(root, "proc/self/cgroup", "0::/a/b/c\n");
+                fixture_write(root, "sys/fs/cgroup/cpu.max", "max 100000\n");
+                fixture_write(root, "sys/fs/cgroup/a/cpu.max", "250000 100000\n");
+                fixture_write(root, "sys/fs/cgroup/a/b/c/cpu.max", "600000 100000\n");
+                get_topology_at(&topo, root);
+                is_valid = (topo.quota == 3 && topo.nthreads == 3);
+                break;
+            case 3:
+                name = "topology cgroup v1 nested";
+                fixture_write(root, "proc/self/cgroup", "5:memory:/m\n4:cpu,cpuacct:/x/y\n0::/\n");
+                fixture_write(root, "sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us", "-1\n");
+                fixture_write(root, "sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us", "100000\n");
+                fixture_write(root, "sys/fs/cgroup/cpu,cpuacct/x/cpu.cfs_quota_us", "200000\n");
+                fixture_write(root, "sys/fs/cgroup/cpu,cpuacct/x/cpu.cfs_period_us", "100000\n");
+                fixture_write(root, "sys/fs/cgroup/cpu,cpuacct/x/y/cpu.cfs_quota_us", "500000\n");
+                fixture_write(root, "sys/fs/cgroup/cpu,cpuacct/x/y/cpu.cfs_period_us", "100000\n");
+                get_topology_at(&topo, root);
+                is_valid = (topo.quota == 2 && topo.nthreads == 2);
+                break;
+            case 4:
+                name = "topology GEMM_NUM_THREADS=5";
+                fixture_write(root, "proc/self/cgroup", "0::/a\n");
+                fixture_write(root, "sys/fs/cgroup/a/cpu.max", "350000 100000\n");
+                setenv("GEMM_NUM_THREADS", "5", 1);
+                get_topology_at(&topo, root);
+                is_valid = (topo.quota == 4 && topo.nthreads == 5);
+                break;
+        }
+        nftw(root, fixture_remove, 16, FTW_DEPTH | FTW_PHYS);
+
+        if(console_flag) print_check_console(0, 0, 0, name, is_valid);
+        if(file != NULL) print_check_file(0, 0, 0, name, is_valid, file);
+    }
+
+    if(saved != NULL)
+        setenv("GEMM_NUM_THREADS", saved, 1);
+    else
+        unsetenv("GEMM_NUM_THREADS");
+    free(saved);
+}
+
+void dgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const double alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int tb = 0; tb < 2; tb++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE transA = transes[ta], transB = transes[tb];
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? m : k, A_col = (transA == T_NO_TRANS) ? k : m;
+        int B_row = (transB == T_NO_TRANS) ? k : n, B_col = (transB == T_NO_TRANS) ? n : k;
+        if(layout == L_COL_MAJOR) {
+            int tmp;
+            tmp = A_row; A_row = A_col; A_col = tmp;
+            tmp = B_row; B_row = B_col; B_col = tmp;
+        }
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        double* A = (double *)malloc(A_row * lda * sizeof(double));
+        double* B = (double *)malloc(B_row * ldb * sizeof(double));
+        double* C = (double *)malloc(C_row * ldc * sizeof(double));
+        double* C_ref = (double *)malloc(C_row * ldc * sizeof(double));
+
+        fp64_get_rand_mat(A_row, lda, A, bound);
+        fp64_get_rand_mat(B_row, ldb, B, bound);
+        fp64_get_rand_mat(C_row, ldc, C, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(double));
+
+        dgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        naive_dgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C[r * ldc + c] != C_ref[r * ldc + c])
+                    is_valid_gemm = FALSE;
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+
+        if(console_flag) print_ex_console(m, k, n, layout, transA, transB, is_valid_gemm);
+        if(file != NULL) print_ex_file(m, k, n, layout, transA, transB, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+/* dgemv with every layout and transpose, contiguous and strided x and y, the negative stride from the end */
+void dgemv_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const int incs[2][2] = {{1, 1}, {2, -3}};
+    const double alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int s = 0; s < 2; s++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE trans = transes[ta];
+        const int incx = incs[s][0], incy = incs[s][1];
+        const int x_len = (trans == T_NO_TRANS) ? n : m, y_len = (trans == T_NO_TRANS) ? m : n;
+
+        /* stored shape, with a padded leading dimension */
+        int A_row = (layout == L_ROW_MAJOR) ? m : n, A_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3;
+        const int x_size = x_len * abs(incx) + 1, y_size = y_len * abs(incy) + 1;
+
+        double* A = (double *)malloc(A_row * lda * sizeof(double));
+        double* x = (double *)malloc(x_size * sizeof(double));
+        double* y = (double *)malloc(y_size * sizeof(double));
+        double* y_ref = (double *)malloc(y_size * sizeof(double));
+
+        fp64_get_rand_mat(A_row, lda, A, bound);
+        fp64_get_rand_mat(1, x_size, x, bound);
+        fp64_get_rand_mat(1, y_size, y, bound);
+        memcpy(y_ref, y, y_size * sizeof(double));
+
+        dgemv(layout, trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+
+        for(int i = 0; i < y_len; i++) {
+            double sum = 0;
+            for(int j = 0; j < x_len; j++) {
+                const int r = (trans == T_NO_TRANS) ? i : j, c = (trans == T_NO_TRANS) ? j : i;
+                const double a = (layout == L_ROW_MAJOR) ? A[r * lda + c] : A[c * lda + r];
+                sum += a * VEC_AT(x, x_len, incx, j);
+            }
+            VEC_AT(y_ref, y_len, incy, i) = alpha * sum + beta * VEC_AT(y_ref, y_len, incy, i);
+        }
+
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < y_size; i++)
+            if(y[i] != y_ref[i])
+                is_valid_gemm = FALSE;
+
+        free(A);
+        free(x);
+        free(y);
+        free(y_ref);
+
+        char name[64];
+        snprintf(name, sizeof(name), "dgemv %s %s incx %d incy %d", (layout == L_ROW_MAJOR) ? "row" : "col",
+                 (trans == T_NO_TRANS) ? "N" : "T", incx, incy);
+        if(console_flag) print_check_console(m, n, 1, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, n, 1, name, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+}
+
+/**
+ * The unpacked small path (see *gemm_small) against the packed one, each forced through
+ * small_mnk: every M up to one past the largest SMALL_MR, N with masked edges, op(A)
+ * transposed and strided, alpha other than 1, and beta = 0 over a C of NaNs, which has to
+ * be overwritten rather than scaled. small_mnk = 0 has to send the call to the nest.
+ */
+void dgemm_small_test(const int bound, FILE* file, BOOL console_flag) {
+    const int ns[4] = {3, 19, 32, 37}, ks[3] = {1, 5, 16};
+    const double alphas[2] = {1, -2}, betas[2] = {0, 3};
+    gemm_ctx_t* ctx = gemm_ctx_create();
+    gemm_ctx_t* ctx_ref = gemm_ctx_create();
+    if(ctx == NULL || ctx_ref == NULL) {
+        gemm_ctx_destroy(ctx);
+        gemm_ctx_destroy(ctx_ref);
+        return;
+    }
+    ctx->small_mnk = INT64_MAX;
+    ctx_ref->small_mnk = 0;
+
+    for(int ta = 0; ta < 2; ta++) {
+    for(int ab = 0; ab < 4; ab++) {
+        const TRANSPOSE transA = ta ? T_TRANS : T_NO_TRANS;
+        const double alpha = alphas[ab / 2], beta = betas[ab % 2];
+        BOOL is_valid_gemm = TRUE;
+
+        for(int m = 1; m <= SMALL_TEST_M; m++) {
+        for(int ni = 0; ni < 4; ni++) {
+        for(int ki = 0; ki < 3; ki++) {
+            const int n = ns[ni], k = ks[ki];
+            /* padded leading dimensions */
+            const int A_row = ta ? k : m, lda = (ta ? m : k) + 3, ldb = n + 2, ldc = n + 1;
+            double* A = (double *)malloc(A_row * lda * sizeof(double));
+            double* B = (double *)malloc(k * ldb * sizeof(double));
+            double* C = (double *)malloc(m * ldc * sizeof(double));
+            double* C_ref = (double *)malloc(m * ldc * sizeof(double));
+
+            fp64_get_rand_mat(A_row, lda, A, bound);
+            fp64_get_rand_mat(k, ldb, B, bound);
+            if(beta == 0)
+                for(int e = 0; e < m * ldc; e++)
+                    C[e] = NAN;
+            else
+                fp64_get_rand_mat(m, ldc, C, bound);
+            memcpy(C_ref, C, m * ldc * sizeof(double));
+
+            dgemm_ex_ctx(ctx, L_ROW_MAJOR, transA, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+            dgemm_ex_ctx(ctx_ref, L_ROW_MAJOR, transA, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+            /* the padding of C is left alone, NaN or not */
+            for(int r = 0; r < m; r++)
+                for(int c = 0; c < ldc; c++)
+                    if((c < n) ? (C[r * ldc + c] != C_ref[r * ldc + c])
+                               : (memcmp(&C[r * ldc + c], &C_ref[r * ldc + c], sizeof(double)) != 0))
+                        is_valid_gemm = FALSE;
+
+            free(A);
+            free(B);
+            free(C);
+            free(C_ref);
+        }
+        }
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "dgemm small %s alpha %g beta %g%s", ta ? "T" : "N",
+                 (double)alpha, (double)beta, (beta == 0) ? " over NaN" : "");
+        if(console_flag) print_check_console(SMALL_TEST_M, ks[2], ns[3], name, is_valid_gemm);
+        if(file != NULL) print_check_file(SMALL_TEST_M, ks[2], ns[3], name, is_valid_gemm, file);
+    }
+    }
+
+    /* on up to small_mnk, off above it and at 0: only the packed path opens a region */
+    const int m = 4, n = 19, k = 5;
+    double* A = (double *)calloc(m * k, sizeof(double));
+    double* B = (double *)calloc(k * n, sizeof(double));
+    double* C = (double *)calloc(m * n, sizeof(double));
+    const int64_t small_mnks[3] = {(int64_t)m * n * k, (int64_t)m * n * k - 1, 0};
+    ctx->collect_stats = TRUE;
+    for(int i = 0; i < 3; i++) {
+        ctx->small_mnk = small_mnks[i];
+        gemm_stats_reset(ctx);
+        dgemm_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS, m, n, k, 1, A, k, B, n, 0, C, n);
+        const BOOL is_valid_gemm = (ctx->stats.regions == ((i == 0) ? 0 : 1));
+
+        char name[64];
+        snprintf(name, sizeof(name), "dgemm small_mnk %lld %s", (long long)small_mnks[i],
+                 (i == 0) ? "unpacked" : "packed");
+        if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+    }
+    free(A);
+    free(B);
+    free(C);
+
+    gemm_ctx_destroy(ctx);
+    gemm_ctx_destroy(ctx_ref);
+}
+
+void hqgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const int16_t alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int tb = 0; tb < 2; tb++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE transA = transes[ta], transB = transes[tb];
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? m : k, A_col = (transA == T_NO_TRANS) ? k : m;
+        int B_row = (transB == T_NO_TRANS) ? k : n, B_col = (transB == T_NO_TRANS) ? n : k;
+        if(layout == L_COL_MAJOR) {
+            int tmp;
+            tmp = A_row; A_row = A_col; A_col = tmp;
+            tmp = B_row; B_row = B_col; B_col = tmp;
+        }
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        int16_t* A = (int16_t *)malloc(A_row * lda * sizeof(int16_t));
+        int16_t* B = (int16_t *)malloc(B_row * ldb * sizeof(int16_t));
+        int16_t* C = (int16_t *)malloc(C_row * ldc * sizeof(int16_t));
+        int16_t* C_ref = (int16_t *)malloc(C_row * ldc * sizeof(int16_t));
+
+        int16_get_rand_mat(A_row, lda, A, bound);
+        int16_get_rand_mat(B_row, ldb, B, bound);
+        int16_get_rand_mat(C_row, ldc, C, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(int16_t));
+
+        hqgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        naive_hqgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C[r * ldc + c] != C_ref[r * ldc + c])
+                    is_valid_gemm = FALSE;
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+
+        if(console_flag) print_ex_console(m, k, n, layout, transA, transB, is_valid_gemm);
+        if(file != NULL) print_ex_file(m, k, n, layout, transA, transB, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+void qgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const int8_t alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int tb = 0; tb < 2; tb++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE transA = transes[ta], transB = transes[tb];
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? m : k, A_col = (transA == T_NO_TRANS) ? k : m;
+        int B_row = (transB == T_NO_TRANS) ? k : n, B_col = (transB == T_NO_TRANS) ? n : k;
+        if(layout == L_COL_MAJOR) {
+            int tmp;
+            tmp = A_row; A_row = A_col; A_col = tmp;
+            tmp = B_row; B_row = B_col; B_col = tmp;
+        }
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        int8_t* A = (int8_t *)malloc(A_row * lda * sizeof(int8_t));
+        int8_t* B = (int8_t *)malloc(B_row * ldb * sizeof(int8_t));
+        int8_t* C = (int8_t *)malloc(C_row * ldc * sizeof(int8_t));
+        int8_t* C_ref = (int8_t *)malloc(C_row * ldc * sizeof(int8_t));
+
+        int8_get_rand_mat(A_row, lda, A, bound);
+        int8_get_rand_mat(B_row, ldb, B, bound);
+        int8_get_rand_mat(C_row, ldc, C, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(int8_t));
+
+        qgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        naive_qgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C[r * ldc + c] != C_ref[r * ldc + c])
+                    is_valid_gemm = FALSE;
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+
+        if(console_flag) print_ex_console(m, k, n, layout, transA, transB, is_valid_gemm);
+        if(file != NULL) print_ex_file(m, k, n, layout, transA, transB, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+void bf16gemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const float alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int tb = 0; tb < 2; tb++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE transA = transes[ta], transB = transes[tb];
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? m : k, A_col = (transA == T_NO_TRANS) ? k : m;
+        int B_row = (transB == T_NO_TRANS) ? k : n, B_col = (transB == T_NO_TRANS) ? n : k;
+        if(layout == L_COL_MAJOR) {
+            int tmp;
+            tmp = A_row; A_row = A_col; A_col = tmp;
+            tmp = B_row; B_row = B_col; B_col = tmp;
+        }
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        uint16_t* A = (uint16_t *)malloc(A_row * lda * sizeof(uint16_t));
+        uint16_t* B = (uint16_t *)malloc(B_row * ldb * sizeof(uint16_t));
+        float* C = (float *)malloc(C_row * ldc * sizeof(float));
+        float* C_ref = (float *)malloc(C_row * ldc * sizeof(float));
+
+        bf16_get_rand_mat(A_row, lda, A, bound);
+        bf16_get_rand_mat(B_row, ldb, B, bound);
+        fp32_get_rand_mat(C_row, ldc, C, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(float));
+
+        bf16gemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        naive_bf16gemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C[r * ldc + c] != C_ref[r * ldc + c])
+                    is_valid_gemm = FALSE;
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+
+        if(console_flag) print_ex_console(m, k, n, layout, transA, transB, is_valid_gemm);
+        if(file != NULL) print_ex_file(m, k, n, layout, transA, transB, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+void hgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const TRANSPOSE transes[2] = {T_NO_TRANS, T_TRANS};
+    const float alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int ta = 0; ta < 2; ta++) {
+    for(int tb = 0; tb < 2; tb++) {
+        LAYOUT layout = layouts[l];
+        TRANSPOSE transA = transes[ta], transB = transes[tb];
+
+        /* stored shapes, with padded leading dimensions */
+        int A_row = (transA == T_NO_TRANS) ? m : k, A_col = (transA == T_NO_TRANS) ? k : m;
+        int B_row = (transB == T_NO_TRANS) ? k : n, B_col = (transB == T_NO_TRANS) ? n : k;
+        if(layout == L_COL_MAJOR) {
+            int tmp;
+            tmp = A_row; A_row = A_col; A_col = tmp;
+            tmp = B_row; B_row = B_col; B_col = tmp;
+        }
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        uint16_t* A = (uint16_t *)malloc(A_row * lda * sizeof(uint16_t));
+        uint16_t* B = (uint16_t *)malloc(B_row * ldb * sizeof(uint16_t));
+        float* C = (float *)malloc(C_row * ldc * sizeof(float));
+        float* C_ref = (float *)malloc(C_row * ldc * sizeof(float));
+
+        fp16_get_rand_mat(A_row, lda, A, bound);
+        fp16_get_rand_mat(B_row, ldb, B, bound);
+        fp32_get_rand_mat(C_row, ldc, C, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(float));
+
+        hgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        naive_hgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C[r * ldc + c] != C_ref[r * ldc + c])
+                    is_valid_gemm = FALSE;
+
+        /* fp16 C; entries of 0 and -1 keep C exact in fp16 up to K = 1023 */
+        uint16_t* C_h = (uint16_t *)malloc(C_row * ldc * sizeof(uint16_t));
+        fp16_get_rand_mat(A_row, lda, A, min(bound, 2));
+        fp16_get_rand_mat(B_row, ldb, B, min(bound, 2));
+        fp16_get_rand_mat(C_row, ldc, C_h, min(bound, 2));
+        for(int e = 0; e < C_row * ldc; e++)
+            C_ref[e] = fp16_to_fp32(C_h[e]);
+        hgemm_f16_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_h, ldc);
+        naive_hgemm_ex(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+        for(int r = 0; r < C_row; r++)
+            for(int c = 0; c < ldc; c++)
+                if(C_h[r * ldc + c] != fp32_to_fp16(C_ref[r * ldc + c]))
+                    is_valid_gemm = FALSE;
+        free(C_h);
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+
+        if(console_flag) print_ex_console(m, k, n, layout, transA, transB, is_valid_gemm);
+        if(file != NULL) print_ex_file(m, k, n, layout, transA, transB, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+/**
+ * hgemm_f16 with K over two KC blocks: B holds +256 in the first half of K and -256 in
+ * the second, plus c % 7, so a partial sum stored in fp16 after the first block would
+ * overflow while the fp32 result, K * (c % 7), is exact in fp16.
+ */
+void hgemm_f16_test(FILE* file, BOOL console_flag) {
+    gemm_ctx_t* ctx = gemm_ctx_create();
+    if(ctx == NULL)
+        return;
+    const int KC = ctx->blk[D_FP16].KC;
+    const int m = 5, n = 37, k = (2 * KC / 8 + 1) * 8;
+
+    uint16_t* A = (uint16_t *)malloc(m * k * sizeof(uint16_t));
+    uint16_t* B = (uint16_t *)malloc(k * n * sizeof(uint16_t));
+    uint16_t* C_h = (uint16_t *)malloc(m * n * sizeof(uint16_t));
+    float* C_ref = (float *)malloc(m * n * sizeof(float));
+
+    for(int e = 0; e < m * k; e++)
+        A[e] = fp32_to_fp16(1);
+    for(int p = 0; p < k; p++)
+        for(int c = 0; c < n; c++)
+            B[p * n + c] = fp32_to_fp16(((p < k / 2) ? 256 : -256) + c % 7);
+    memset(C_h, 0, m * n * sizeof(uint16_t));
+    for(int r = 0; r < m; r++)
+        for(int c = 0; c < n; c++) {
+            float sum = 0;
+            for(int p = 0; p < k; p++)
+                sum += fp16_to_fp32(A[r * k + p]) * fp16_to_fp32(B[p * n + c]);
+            C_ref[r * n + c] = sum;
+        }
+
+    hgemm_f16_ex_ctx(ctx, L_ROW_MAJOR, T_NO_TRANS, T_NO_TRANS, m, n, k, 1, A, k, B, n, 0, C_h, n);
+
+    BOOL is_valid_gemm = TRUE;
+    for(int e = 0; e < m * n; e++)
+        if(C_h[e] != fp32_to_fp16(C_ref[e]))
+            is_valid_gemm = FALSE;
+
+    free(A);
+    free(B);
+    free(C_h);
+    free(C_ref);
+    gemm_ctx_destroy(ctx);
+
+    if(console_flag) print_check_console(m, k, n, "hgemm_f16 K > KC", is_valid_gemm);
+    if(file != NULL) print_check_file(m, k, n, "hgemm_f16 K > KC", is_valid_gemm, file);
+}
+
+void sgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        float* A = (float *)malloc(m * k * sizeof(float));
+        float* B = (float *)malloc(k * n * sizeof(float));
+        float* C = (float *)malloc(m * n * sizeof(float));
+
+        fp32_get_rand_mat(k, n, B, bound);
+        gemm_packed_t* packed = sgemm_pack_B(B, k, n);
+
+        /* the same handle twice, with a new A each time */
+        BOOL is_valid_gemm = (packed != NULL);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            fp32_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(float) * m * n);
+            is_valid_gemm = (sgemm_compute(A, packed, C, m) == 0)
+                            && naive_sgemm(A, B, C, m, n, k);
+        }
+        gemm_packed_free(packed);
+
+        /* saved to a file by the first call, mapped without B by the second */
+        remove(PACKED_TEST_FILE);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            packed = sgemm_pack_B_file(PACKED_TEST_FILE, (i == 0) ? B : NULL, k, n);
+            fp32_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(float) * m * n);
+            is_valid_gemm = (packed != NULL) && (i == 0 || packed->map != NULL)
+                            && (sgemm_compute(A, packed, C, m) == 0)
+                            && naive_sgemm(A, B, C, m, n, k);
+            gemm_packed_free(packed);
+        }
+        remove(PACKED_TEST_FILE);
+
+        /* a file whose size field is short of what its key implies is not mapped */
+        packed = sgemm_pack_B(B, k, n);
+        if(is_valid_gemm && packed != NULL && packed->size > 0) {
+            packed->size -= sizeof(float);
+            is_valid_gemm = (gemm_packed_save(packed, PACKED_TEST_FILE) == 0)
+                            && (gemm_packed_load(gemm_ctx_default(), PACKED_TEST_FILE, D_FP32, k, n) == NULL);
+            packed->size += sizeof(float);
+        }
+        /* nor one whose K * N overflows, and such a B isn't packed at all */
+        if(is_valid_gemm && packed != NULL) {
+            const int K_saved = packed->K, N_saved = packed->N;
+            packed->K = INT_MAX, packed->N = INT_MAX;
+            is_valid_gemm = (gemm_packed_save(packed, PACKED_TEST_FILE) == 0)
+                            && (gemm_packed_load(gemm_ctx_default(), PACKED_TEST_FILE, D_FP32, INT_MAX, INT_MAX) == NULL)
+                            && (sgemm_pack_B(NULL, INT_MAX, INT_MAX) == NULL);
+            packed->K = K_saved, packed->N = N_saved;
+        }
+        gemm_packed_free(packed);
+        remove(PACKED_TEST_FILE);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "sgemm_compute", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "sgemm_compute", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void dgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        double* A = (double *)malloc(m * k * sizeof(double));
+        double* B = (double *)malloc(k * n * sizeof(double));
+        double* C = (double *)malloc(m * n * sizeof(double));
+
+        fp64_get_rand_mat(k, n, B, bound);
+        gemm_packed_t* packed = dgemm_pack_B(B, k, n);
+
+        /* the same handle twice, with a new A each time */
+        BOOL is_valid_gemm = (packed != NULL);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            fp64_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(double) * m * n);
+            is_valid_gemm = (dgemm_compute(A, packed, C, m) == 0)
+                            && naive_dgemm(A, B, C, m, n, k);
+        }
+        gemm_packed_free(packed);
+
+        /* saved to a file by the first call, mapped without B by the second */
+        remove(PACKED_TEST_FILE);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            packed = dgemm_pack_B_file(PACKED_TEST_FILE, (i == 0) ? B : NULL, k, n);
+            fp64_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(double) * m * n);
+            is_valid_gemm = (packed != NULL) && (i == 0 || packed->map != NULL)
+                            && (dgemm_compute(A, packed, C, m) == 0)
+                            && naive_dgemm(A, B, C, m, n, k);
+            gemm_packed_free(packed);
+        }
+        remove(PACKED_TEST_FILE);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "dgemm_compute", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "dgemm_compute", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void igemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int* A = (int *)malloc(m * k * sizeof(int));
+        int* B = (int *)malloc(k * n * sizeof(int));
+        int* C = (int *)malloc(m * n * sizeof(int));
+
+        int32_get_rand_mat(k, n, B, bound);
+        gemm_packed_t* packed = igemm_pack_B(B, k, n);
+
+        /* the same handle twice, with a new A each time */
+        BOOL is_valid_gemm = (packed != NULL);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            int32_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(int) * m * n);
+            is_valid_gemm = (igemm_compute(A, packed, C, m) == 0)
+                            && naive_igemm(A, B, C, m, n, k);
+        }
+        gemm_packed_free(packed);
+
+        /* saved to a file by the first call, mapped without B by the second */
+        remove(PACKED_TEST_FILE);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            packed = igemm_pack_B_file(PACKED_TEST_FILE, (i == 0) ? B : NULL, k, n);
+            int32_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(int) * m * n);
+            is_valid_gemm = (packed != NULL) && (i == 0 || packed->map != NULL)
+                            && (igemm_compute(A, packed, C, m) == 0)
+                            && naive_igemm(A, B, C, m, n, k);
+            gemm_packed_free(packed);
+        }
+        remove(PACKED_TEST_FILE);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "igemm_compute", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "igemm_compute", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void hqgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int16_t* A = (int16_t *)malloc(m * k * sizeof(int16_t));
+        int16_t* B = (int16_t *)malloc(k * n * sizeof(int16_t));
+        int16_t* C = (int16_t *)malloc(m * n * sizeof(int16_t));
+
+        int16_get_rand_mat(k, n, B, bound);
+        gemm_packed_t* packed = hqgemm_pack_B(B, k, n);
+
+        /* the same handle twice, with a new A each time */
+        BOOL is_valid_gemm = (packed != NULL);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            int16_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(int16_t) * m * n);
+            is_valid_gemm = (hqgemm_compute(A, packed, C, m) == 0)
+                            && naive_hqgemm(A, B, C, m, n, k);
+        }
+        gemm_packed_free(packed);
+
+        /* saved to a file by the first call, mapped without B by the second */
+        remove(PACKED_TEST_FILE);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            packed = hqgemm_pack_B_file(PACKED_TEST_FILE, (i == 0) ? B : NULL, k, n);
+            int16_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(int16_t) * m * n);
+            is_valid_gemm = (packed != NULL) && (i == 0 || packed->map != NULL)
+                            && (hqgemm_compute(A, packed, C, m) == 0)
+                            && naive_hqgemm(A, B, C, m, n, k);
+            gemm_packed_free(packed);
+        }
+        remove(PACKED_TEST_FILE);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "hqgemm_compute", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "hqgemm_compute", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void qgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int8_t* A = (int8_t *)malloc(m * k * sizeof(int8_t));
+        int8_t* B = (int8_t *)malloc(k * n * sizeof(int8_t));
+        int8_t* C = (int8_t *)malloc(m * n * sizeof(int8_t));
+
+        int8_get_rand_mat(k, n, B, bound);
+        gemm_packed_t* packed = qgemm_pack_B(B, k, n);
+
+        /* the same handle twice, with a new A each time */
+        BOOL is_valid_gemm = (packed != NULL);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            int8_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(int8_t) * m * n);
+            is_valid_gemm = (qgemm_compute(A, packed, C, m) == 0)
+                            && naive_qgemm(A, B, C, m, n, k);
+        }
+        gemm_packed_free(packed);
+
+        /* saved to a file by the first call, mapped without B by the second */
+        remove(PACKED_TEST_FILE);
+        for(int i = 0; i < 2 && is_valid_gemm; i++) {
+            packed = qgemm_pack_B_file(PACKED_TEST_FILE, (i == 0) ? B : NULL, k, n);
+            int8_get_rand_mat(m, k, A, bound);
+            memset(C, 0, sizeof(int8_t) * m * n);
+            is_valid_gemm = (packed != NULL) && (i == 0 || packed->map != NULL)
+                            && (qgemm_compute(A, packed, C, m) == 0)
+                            && naive_qgemm(A, B, C, m, n, k);
+            gemm_packed_free(packed);
+        }
+        remove(PACKED_TEST_FILE);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "qgemm_compute", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "qgemm_compute", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void sgemm_epi_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const char* bias_names[3] = {"no-bias", "row-bias", "col-bias"};
+    const char* act_names[4] = {"none", "relu", "gelu", "silu"};
+    /* small enough that the activations aren't flat */
+    const float alpha = 0.125, beta = 0.5;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int b = BIAS_NONE; b <= BIAS_COL; b++) {
+    for(int a = ACT_NONE; a <= ACT_SILU; a++) {
+    for(int clamp = 0; clamp < 2; clamp++) {
+        LAYOUT layout = layouts[l];
+        int A_row = (layout == L_ROW_MAJOR) ? m : k, A_col = (layout == L_ROW_MAJOR) ? k : m;
+        int B_row = (layout == L_ROW_MAJOR) ? k : n, B_col = (layout == L_ROW_MAJOR) ? n : k;
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        float* A = (float *)malloc(A_row * lda * sizeof(float));
+        float* B = (float *)malloc(B_row * ldb * sizeof(float));
+        float* C = (float *)malloc(C_row * ldc * sizeof(float));
+        float* C_ref = (float *)malloc(C_row * ldc * sizeof(float));
+        float* bias = (float *)malloc(max(m, n) * sizeof(float));
+
+        fp32_get_rand_mat(A_row, lda, A, bound);
+        fp32_get_rand_mat(B_row, ldb, B, bound);
+        fp32_get_rand_mat(C_row, ldc, C, bound);
+        fp32_get_rand_mat(1, max(m, n), bias, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(float));
+
+        const gemm_epilogue_t epi = {(BIAS_MODE)b, bias, (ACTIVATION)a, (BOOL)clamp, -2, 6};
+        sgemm_ex_epi(layout, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, &epi);
+        naive_sgemm_ex(layout, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++) {
+            for(int c = 0; c < ldc; c++) {
+                float ref = C_ref[r * ldc + c];
+                if(c < C_col)   /* (r, c) of C is (c, r) in column-major */
+                    ref = (layout == L_ROW_MAJOR) ? naive_sepilogue(&epi, ref, r, c)
+                                                  : naive_sepilogue(&epi, ref, c, r);
+                if(fabs(C[r * ldc + c] - ref) > 1e-5 * fmax(1, fabs(ref)))
+                    is_valid_gemm = FALSE;
+            }
+        }
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+        free(bias);
+
+        char name[64];
+        snprintf(name, sizeof(name), "sgemm_ex_epi %s %s %s%s", (layout == L_ROW_MAJOR) ? "row" : "col",
+                 bias_names[b], act_names[a], clamp ? " clamp" : "");
+        if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+void dgemm_epi_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const LAYOUT layouts[2] = {L_ROW_MAJOR, L_COL_MAJOR};
+    const char* bias_names[3] = {"no-bias", "row-bias", "col-bias"};
+    const char* act_names[4] = {"none", "relu", "gelu", "silu"};
+    /* small enough that the activations aren't flat */
+    const double alpha = 0.125, beta = 0.5;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int l = 0; l < 2; l++) {
+    for(int b = BIAS_NONE; b <= BIAS_COL; b++) {
+    for(int a = ACT_NONE; a <= ACT_SILU; a++) {
+    for(int clamp = 0; clamp < 2; clamp++) {
+        LAYOUT layout = layouts[l];
+        int A_row = (layout == L_ROW_MAJOR) ? m : k, A_col = (layout == L_ROW_MAJOR) ? k : m;
+        int B_row = (layout == L_ROW_MAJOR) ? k : n, B_col = (layout == L_ROW_MAJOR) ? n : k;
+        int C_row = (layout == L_ROW_MAJOR) ? m : n, C_col = (layout == L_ROW_MAJOR) ? n : m;
+        int lda = A_col + 3, ldb = B_col + 5, ldc = C_col + 7;
+
+        double* A = (double *)malloc(A_row * lda * sizeof(double));
+        double* B = (double *)malloc(B_row * ldb * sizeof(double));
+        double* C = (double *)malloc(C_row * ldc * sizeof(double));
+        double* C_ref = (double *)malloc(C_row * ldc * sizeof(double));
+        double* bias = (double *)malloc(max(m, n) * sizeof(double));
+
+        fp64_get_rand_mat(A_row, lda, A, bound);
+        fp64_get_rand_mat(B_row, ldb, B, bound);
+        fp64_get_rand_mat(C_row, ldc, C, bound);
+        fp64_get_rand_mat(1, max(m, n), bias, bound);
+        memcpy(C_ref, C, C_row * ldc * sizeof(double));
+
+        const gemm_epilogue_t epi = {(BIAS_MODE)b, bias, (ACTIVATION)a, (BOOL)clamp, -2, 6};
+        dgemm_ex_epi(layout, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, &epi);
+        naive_dgemm_ex(layout, T_NO_TRANS, T_NO_TRANS, m, n, k, alpha, A, lda, B, ldb, beta, C_ref, ldc);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < C_row; r++) {
+            for(int c = 0; c < ldc; c++) {
+                double ref = C_ref[r * ldc + c];
+                if(c < C_col)   /* (r, c) of C is (c, r) in column-major */
+                    ref = (layout == L_ROW_MAJOR) ? naive_depilogue(&epi, ref, r, c)
+                                                  : naive_depilogue(&epi, ref, c, r);
+                if(fabs(C[r * ldc + c] - ref) > 1e-12 * fmax(1, fabs(ref)))
+                    is_valid_gemm = FALSE;
+            }
+        }
+
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+        free(bias);
+
+        char name[64];
+        snprintf(name, sizeof(name), "dgemm_ex_epi %s %s %s%s", (layout == L_ROW_MAJOR) ? "row" : "col",
+                 bias_names[b], act_names[a], clamp ? " clamp" : "");
+        if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+void sgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        float* A = (float *)malloc(BATCH_TEST_SIZE * m * k * sizeof(float));
+        float* B = (float *)malloc(BATCH_TEST_SIZE * k * n * sizeof(float));
+        float* C = (float *)malloc(BATCH_TEST_SIZE * m * n * sizeof(float));
+        const float* A_array[BATCH_TEST_SIZE];
+        const float* B_array[BATCH_TEST_SIZE];
+        float* C_array[BATCH_TEST_SIZE];
+
+        fp32_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        fp32_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(float) * BATCH_TEST_SIZE * m * n);
+        sgemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_sgemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(float) * BATCH_TEST_SIZE * m * n);
+        sgemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_sgemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "sgemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "sgemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void dgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        double* A = (double *)malloc(BATCH_TEST_SIZE * m * k * sizeof(double));
+        double* B = (double *)malloc(BATCH_TEST_SIZE * k * n * sizeof(double));
+        double* C = (double *)malloc(BATCH_TEST_SIZE * m * n * sizeof(double));
+        const double* A_array[BATCH_TEST_SIZE];
+        const double* B_array[BATCH_TEST_SIZE];
+        double* C_array[BATCH_TEST_SIZE];
+
+        fp64_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        fp64_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(double) * BATCH_TEST_SIZE * m * n);
+        dgemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_dgemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(double) * BATCH_TEST_SIZE * m * n);
+        dgemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_dgemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "dgemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "dgemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void igemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int* A = (int *)malloc(BATCH_TEST_SIZE * m * k * sizeof(int));
+        int* B = (int *)malloc(BATCH_TEST_SIZE * k * n * sizeof(int));
+        int* C = (int *)malloc(BATCH_TEST_SIZE * m * n * sizeof(int));
+        const int* A_array[BATCH_TEST_SIZE];
+        const int* B_array[BATCH_TEST_SIZE];
+        int* C_array[BATCH_TEST_SIZE];
+
+        int32_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        int32_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(int) * BATCH_TEST_SIZE * m * n);
+        igemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_igemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(int) * BATCH_TEST_SIZE * m * n);
+        igemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_igemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "igemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "igemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void hqgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int16_t* A = (int16_t *)malloc(BATCH_TEST_SIZE * m * k * sizeof(int16_t));
+        int16_t* B = (int16_t *)malloc(BATCH_TEST_SIZE * k * n * sizeof(int16_t));
+        int16_t* C = (int16_t *)malloc(BATCH_TEST_SIZE * m * n * sizeof(int16_t));
+        const int16_t* A_array[BATCH_TEST_SIZE];
+        const int16_t* B_array[BATCH_TEST_SIZE];
+        int16_t* C_array[BATCH_TEST_SIZE];
+
+        int16_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        int16_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(int16_t) * BATCH_TEST_SIZE * m * n);
+        hqgemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_hqgemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(int16_t) * BATCH_TEST_SIZE * m * n);
+        hqgemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_hqgemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "hqgemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "hqgemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void qgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int8_t* A = (int8_t *)malloc(BATCH_TEST_SIZE * m * k * sizeof(int8_t));
+        int8_t* B = (int8_t *)malloc(BATCH_TEST_SIZE * k * n * sizeof(int8_t));
+        int8_t* C = (int8_t *)malloc(BATCH_TEST_SIZE * m * n * sizeof(int8_t));
+        const int8_t* A_array[BATCH_TEST_SIZE];
+        const int8_t* B_array[BATCH_TEST_SIZE];
+        int8_t* C_array[BATCH_TEST_SIZE];
+
+        int8_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        int8_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(int8_t) * BATCH_TEST_SIZE * m * n);
+        qgemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_qgemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(int8_t) * BATCH_TEST_SIZE * m * n);
+        qgemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_qgemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "qgemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "qgemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void qgemm_s32_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        uint8_t* A = (uint8_t *)malloc(BATCH_TEST_SIZE * m * k * sizeof(uint8_t));
+        int8_t* B = (int8_t *)malloc(BATCH_TEST_SIZE * k * n * sizeof(int8_t));
+        int32_t* C = (int32_t *)malloc(BATCH_TEST_SIZE * m * n * sizeof(int32_t));
+        const uint8_t* A_array[BATCH_TEST_SIZE];
+        const int8_t* B_array[BATCH_TEST_SIZE];
+        int32_t* C_array[BATCH_TEST_SIZE];
+
+        uint8_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        int8_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(int32_t) * BATCH_TEST_SIZE * m * n);
+        qgemm_s32_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_qgemm_s32(A_array[i], 0, B_array[i], 0, C_array[i], m, n, k, FALSE);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(int32_t) * BATCH_TEST_SIZE * m * n);
+        qgemm_s32_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_qgemm_s32(&A[i * m * k], 0, B, 0, &C[i * m * n], m, n, k, FALSE);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "qgemm_s32_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "qgemm_s32_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void hqgemm_s32_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        int16_t* A = (int16_t *)malloc(BATCH_TEST_SIZE * m * k * sizeof(int16_t));
+        int16_t* B = (int16_t *)malloc(BATCH_TEST_SIZE * k * n * sizeof(int16_t));
+        int32_t* C = (int32_t *)malloc(BATCH_TEST_SIZE * m * n * sizeof(int32_t));
+        const int16_t* A_array[BATCH_TEST_SIZE];
+        const int16_t* B_array[BATCH_TEST_SIZE];
+        int32_t* C_array[BATCH_TEST_SIZE];
+
+        int16_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        int16_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(int32_t) * BATCH_TEST_SIZE * m * n);
+        hqgemm_s32_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_hqgemm_s32(A_array[i], k, B_array[i], n, C_array[i], n, m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(int32_t) * BATCH_TEST_SIZE * m * n);
+        hqgemm_s32_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_hqgemm_s32(&A[i * m * k], k, B, n, &C[i * m * n], n, m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "hqgemm_s32_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "hqgemm_s32_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void bf16gemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        uint16_t* A = (uint16_t *)malloc(BATCH_TEST_SIZE * m * k * sizeof(uint16_t));
+        uint16_t* B = (uint16_t *)malloc(BATCH_TEST_SIZE * k * n * sizeof(uint16_t));
+        float* C = (float *)malloc(BATCH_TEST_SIZE * m * n * sizeof(float));
+        const uint16_t* A_array[BATCH_TEST_SIZE];
+        const uint16_t* B_array[BATCH_TEST_SIZE];
+        float* C_array[BATCH_TEST_SIZE];
+
+        bf16_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        bf16_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(float) * BATCH_TEST_SIZE * m * n);
+        bf16gemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_bf16gemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(float) * BATCH_TEST_SIZE * m * n);
+        bf16gemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_bf16gemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "bf16gemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "bf16gemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+void hgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        uint16_t* A = (uint16_t *)malloc(BATCH_TEST_SIZE * m * k * sizeof(uint16_t));
+        uint16_t* B = (uint16_t *)malloc(BATCH_TEST_SIZE * k * n * sizeof(uint16_t));
+        float* C = (float *)malloc(BATCH_TEST_SIZE * m * n * sizeof(float));
+        const uint16_t* A_array[BATCH_TEST_SIZE];
+        const uint16_t* B_array[BATCH_TEST_SIZE];
+        float* C_array[BATCH_TEST_SIZE];
+
+        fp16_get_rand_mat(BATCH_TEST_SIZE * m, k, A, bound);
+        fp16_get_rand_mat(BATCH_TEST_SIZE * k, n, B, bound);
+
+        /* pointer arrays, in reverse order */
+        for(int i = 0; i < BATCH_TEST_SIZE; i++) {
+            A_array[i] = &A[(BATCH_TEST_SIZE - 1 - i) * m * k];
+            B_array[i] = &B[(BATCH_TEST_SIZE - 1 - i) * k * n];
+            C_array[i] = &C[(BATCH_TEST_SIZE - 1 - i) * m * n];
+        }
+        memset(C, 0, sizeof(float) * BATCH_TEST_SIZE * m * n);
+        hgemm_batched(A_array, B_array, C_array, m, n, k, BATCH_TEST_SIZE);
+        BOOL is_valid_gemm = TRUE;
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_hgemm(A_array[i], B_array[i], C_array[i], m, n, k);
+
+        /* strided, with one B for the whole batch */
+        memset(C, 0, sizeof(float) * BATCH_TEST_SIZE * m * n);
+        hgemm_strided_batched(A, (size_t)m * k, B, 0, C, (size_t)m * n, m, n, k, BATCH_TEST_SIZE);
+        for(int i = 0; i < BATCH_TEST_SIZE; i++)
+            is_valid_gemm = is_valid_gemm && naive_hgemm(&A[i * m * k], B, &C[i * m * n], m, n, k);
+
+        free(A);
+        free(B);
+        free(C);
+
+        if(console_flag) print_check_console(m, k, n, "hgemm_batched", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "hgemm_batched", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+/* sgemm_grouped on problems of different M, every layout and transpose among them */
+void sgemm_grouped_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    const int count = 8;
+    const float alpha = 2, beta = -1;
+
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+        gemm_problem_t problems[8];
+        float* C_ref[8];
+        for(int p = 0; p < count; p++) {
+            gemm_problem_t* pr = &problems[p];
+            pr->layout = (p % 2 == 0) ? L_ROW_MAJOR : L_COL_MAJOR;
+            pr->transA = ((p / 2) % 2 == 0) ? T_NO_TRANS : T_TRANS;
+            pr->transB = ((p / 4) % 2 == 0) ? T_NO_TRANS : T_TRANS;
+            pr->M = m * (p + 1) / 3, pr->N = n, pr->K = k;
+            pr->alpha = alpha, pr->beta = beta;
+
+            /* stored shapes, with padded leading dimensions */
+            int A_row = (pr->transA == T_NO_TRANS) ? pr->M : k, A_col = (pr->transA == T_NO_TRANS) ? k : pr->M;
+            int B_row = (pr->transB == T_NO_TRANS) ? k : n, B_col = (pr->transB == T_NO_TRANS) ? n : k;
+            if(pr->layout == L_COL_MAJOR) {
+                int tmp;
+                tmp = A_row; A_row = A_col; A_col = tmp;
+                tmp = B_row; B_row = B_col; B_col = tmp;
+            }
+            int C_row = (pr->layout == L_ROW_MAJOR) ? pr->M : n, C_col = (pr->layout == L_ROW_MAJOR) ? n : pr->M;
+            pr->lda = A_col + 3, pr->ldb = B_col + 5, pr->ldc = C_col + 7;
+
+            float* A = (float *)malloc((A_row * pr->lda + 1) * sizeof(float));
+            float* B = (float *)malloc((B_row * pr->ldb + 1) * sizeof(float));
+            float* C = (float *)malloc((C_row * pr->ldc + 1) * sizeof(float));
+            C_ref[p] = (float *)malloc((C_row * pr->ldc + 1) * sizeof(float));
+            fp32_get_rand_mat(A_row, pr->lda, A, bound);
+            fp32_get_rand_mat(B_row, pr->ldb, B, bound);
+            fp32_get_rand_mat(C_row, pr->ldc, C, bound);
+            memcpy(C_ref[p], C, C_row * pr->ldc * sizeof(float));
+            pr->A = A, pr->B = B, pr->C = C;
+
+            naive_sgemm_ex(pr->layout, pr->transA, pr->transB, pr->M, n, k,
+                alpha, A, pr->lda, B, pr->ldb, beta, C_ref[p], pr->ldc);
+        }
+
+        sgemm_grouped(problems, count);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int p = 0; p < count; p++) {
+            const gemm_problem_t* pr = &problems[p];
+            int C_row = (pr->layout == L_ROW_MAJOR) ? pr->M : n;
+            for(int i = 0; i < C_row * pr->ldc; i++)
+                if(pr->C[i] != C_ref[p][i])
+                    is_valid_gemm = FALSE;
+            free((float* )pr->A);
+            free((float* )pr->B);
+            free(pr->C);
+            free(C_ref[p]);
+        }
+
+        if(console_flag) print_check_console(m, k, n, "sgemm_grouped", is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, "sgemm_grouped", is_valid_gemm, file);
+    }
+    }
+    }
+}
+
+/* qgemm_requant per tensor and per channel, with and without bias, to int8 and uint8 */
+void qgemm_requant_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag) {
+    for(int m = M; m < (M + range); m++) {
+    for(int n = N; n < (N + range); n++) {
+    for(int k = K; k < (K + range); k++) {
+    for(int per_channel = 0; per_channel < 2; per_channel++) {
+    for(int has_bias = 0; has_bias < 2; has_bias++) {
+    for(int out_signed = 0; out_signed < 2; out_signed++) {
+        const int32_t a_zero = bound / 2, b_zero = -(bound / 4);
+        const int ldc = n + 7;
+
+        uint8_t* A = (uint8_t *)malloc(m * k * sizeof(uint8_t));
+        int8_t* B = (int8_t *)malloc(k * n * sizeof(int8_t));
+        uint8_t* C = (uint8_t *)malloc(m * ldc * sizeof(uint8_t));
+        float* scale = (float *)malloc(n * sizeof(float));
+        int32_t* bias = (int32_t *)malloc(n * sizeof(int32_t));
+
+        uint8_get_rand_mat(m, k, A, bound);
+        int8_get_rand_mat(k, n, B, bound);
+        memset(C, 0xAB, m * ldc * sizeof(uint8_t));
+        /* wide enough to saturate some outputs and round the others */
+        for(int c = 0; c < n; c++) {
+            scale[c] = (1 + rand() % 16) / (4.0f * max(k, 1));
+            bias[c] = rand() % (4 * k + 1) - 2 * k;
+        }
+
+        const gemm_requant_t rq = {scale, has_bias ? bias : NULL, (BOOL)per_channel,
+                                   out_signed ? -3 : 120, (BOOL)out_signed};
+        qgemm_requant(m, n, k, A, k, a_zero, B, n, b_zero, C, ldc, &rq);
+
+        BOOL is_valid_gemm = TRUE;
+        for(int r = 0; r < m; r++) {
+            for(int c = 0; c < ldc; c++) {
+                uint8_t ref = 0xAB;
+                if(c < n) {
+                    int32_t sum = 0;
+                    for(int i = 0; i < k; i++)
+                        sum += (A[r * k + i] - a_zero) * (B[i * n + c] - b_zero);
+                    ref = naive_requant(&rq, sum, c);
+                }
+                if(C[r * ldc + c] != ref)
+                    is_valid_gemm = FALSE;
+            }
+        }
+
+        free(A);
+        free(B);
+        free(C);
+        free(scale);
+        free(bias);
+
+        char name[64];
+        snprintf(name, sizeof(name), "qgemm_requant %s%s %s", per_channel ? "per-channel" : "per-tensor",
+                 has_bias ? " bias" : "", out_signed ? "int8" : "uint8");
+        if(console_flag) print_check_console(m, k, n, name, is_valid_gemm);
+        if(file != NULL) print_check_file(m, k, n, name, is_valid_gemm, file);
+    }
+    }
+    }
+    }
+    }
+    }
+}
+
+uint64_t timer() {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+    return (uint64_t)start.tv_sec * 1000000000 + (uint64_t)start.tv_nsec;
+}
+
+/********************************************************
+ *                                                      
+ *          Naive GEMM
+ *                                                      
+*********************************************************/
+BOOL naive_sgemm(const float* A, const float* B, const float* C,
+                const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            float sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (A[r * K + k] * B[k * N + c]);
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL naive_bf16gemm(const uint16_t* A, const uint16_t* B, const float* C,
+                const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            float sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (bf16_to_fp32(A[r * K + k]) * bf16_to_fp32(B[k * N + c]));
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL naive_hgemm(const uint16_t* A, const uint16_t* B, const float* C,
+                const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            float sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (fp16_to_fp32(A[r * K + k]) * fp16_to_fp32(B[k * N + c]));
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL naive_dgemm(const double* A, const double* B, const double* C,
+                const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            double sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (A[r * K + k] * B[k * N + c]);
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL naive_igemm(const int* A, const int* B, const int* C,
+                 const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            int sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (A[r * K + k] * B[k * N + c]);
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL naive_hqgemm(const int16_t* A, const int16_t* B, const int16_t* C,
+                const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            int16_t sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (A[r * K + k] * B[k * N + c]);
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL naive_qgemm(const int8_t* A, const int8_t* B, const int8_t* C,
+                const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            int8_t sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (A[r * K + k] * B[k * N + c]);
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;                 
+}
+            
+/* (A - a_zero)(B - b_zero) in int32; A is read as int8 when [a_signed] */
+BOOL naive_qgemm_s32(const uint8_t* A, const int32_t a_zero, const int8_t* B, const int32_t b_zero,
+                const int32_t* C, const int M, const int N, const int K, const BOOL a_signed) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            int32_t sum = 0;
+            for (int k = 0; k < K; k++) {
+                int32_t a = a_signed ? (int8_t)A[r * K + k] : A[r * K + k];
+                sum += (a - a_zero) * (B[k * N + c] - b_zero);
+            }
+            if(sum != C[r * N + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* in int32 wrapping arithmetic, as the kernel */
+BOOL naive_hqgemm_s32(const int16_t* A, const int lda, const int16_t* B, const int ldb,
+                const int32_t* C, const int ldc, const int M, const int N, const int K) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            uint32_t sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += (uint32_t)((int32_t)A[r * lda + k] * B[k * ldb + c]);
+            if((int32_t)sum != C[r * ldc + c])
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* gemm_requant_t on the int32 [acc] of column [c] */
+uint8_t naive_requant(const gemm_requant_t* rq, const int32_t acc, const int c) {
+    const int i = rq->per_channel ? c : 0;
+    float y = (float)(acc + ((rq->bias != NULL) ? rq->bias[i] : 0)) * rq->scale[i];
+    int32_t q = (int32_t)rintf(y) + rq->zero_point;
+    const int32_t lo = rq->out_signed ? -128 : 0, hi = rq->out_signed ? 127 : 255;
+    return (uint8_t)((q < lo) ? lo : (q > hi) ? hi : q);
+}
+
+/* gemm_epilogue_t on element (r, c) of C, in double */
+float naive_sepilogue(const gemm_epilogue_t* epi, const float x, const int r, const int c) {
+    double bias = 0;
+    if(epi->bias_mode != BIAS_NONE)
+        bias = ((const float* )epi->bias)[(epi->bias_mode == BIAS_ROW) ? r : c];
+    return (float)naive_depilogue(&(gemm_epilogue_t){BIAS_ROW, &bias, epi->act, epi->clamp,
+                                  epi->clamp_min, epi->clamp_max}, x, 0, 0);
+}
+
+double naive_depilogue(const gemm_epilogue_t* epi, double x, const int r, const int c) {
+    if(epi->bias_mode != BIAS_NONE)
+        x += ((const double* )epi->bias)[(epi->bias_mode == BIAS_ROW) ? r : c];
+    if(epi->act == ACT_RELU)
+        x = fmax(x, 0);
+    else if(epi->act == ACT_GELU)
+        x = 0.5 * x * (1 + tanh(0.7978845608028654 * (x + 0.044715 * x * x * x)));
+    else if(epi->act == ACT_SILU)
+        x = x / (1 + exp(-x));
+    if(epi->clamp)
+        x = fmin(fmax(x, epi->clamp_min), epi->clamp_max);
+    return x;
+}
+
+void naive_sgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const float alpha, const float* A, const int lda,
+                const float* B, const int ldb,
+                const float beta, float* C, const int ldc) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            float sum = 0;
+            for (int k = 0; k < K; k++) {
+                float a, b;
+                if(layout == L_ROW_MAJOR) {
+                    a = (transA == T_NO_TRANS) ? A[r * lda + k] : A[k * lda + r];
+                    b = (transB == T_NO_TRANS) ? B[k * ldb + c] : B[c * ldb + k];
+                }
+                else {
+                    a = (transA == T_NO_TRANS) ? A[k * lda + r] : A[r * lda + k];
+                    b = (transB == T_NO_TRANS) ? B[c * ldb + k] : B[k * ldb + c];
+                }
+                sum += a * b;
+            }
+            float* c_rc = (layout == L_ROW_MAJOR) ? &C[r * ldc + c] : &C[c * ldc + r];
+            (*c_rc) = alpha * sum + beta * (*c_rc);
+        }
+    }
+}
+
+void naive_bf16gemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const float alpha, const uint16_t* A, const int lda,
+                const uint16_t* B, const int ldb,
+                const float beta, float* C, const int ldc) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            float sum = 0;
+            for (int k = 0; k < K; k++) {
+                uint16_t a, b;
+                if(layout == L_ROW_MAJOR) {
+                    a = (transA == T_NO_TRANS) ? A[r * lda + k] : A[k * lda + r];
+                    b = (transB == T_NO_TRANS) ? B[k * ldb + c] : B[c * ldb + k];
+                }
+                else {
+                    a = (transA == T_NO_TRANS) ? A[k * lda + r] : A[r * lda + k];
+                    b = (transB == T_NO_TRANS) ? B[c * ldb + k] : B[k * ldb + c];
+                }
+                sum += bf16_to_fp32(a) * bf16_to_fp32(b);
+            }
+            float* c_rc = (layout == L_ROW_MAJOR) ? &C[r * ldc + c] : &C[c * ldc + r];
+            (*c_rc) = alpha * sum + beta * (*c_rc);
+        }
+    }
+}
+
+void naive_hgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const float alpha, const uint16_t* A, const int lda,
+                const uint16_t* B, const int ldb,
+                const float beta, float* C, const int ldc) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            float sum = 0;
+            for (int k = 0; k < K; k++) {
+                uint16_t a, b;
+                if(layout == L_ROW_MAJOR) {
+                    a = (transA == T_NO_TRANS) ? A[r * lda + k] : A[k * lda + r];
+                    b = (transB == T_NO_TRANS) ? B[k * ldb + c] : B[c * ldb + k];
+                }
+                else {
+                    a = (transA == T_NO_TRANS) ? A[k * lda + r] : A[r * lda + k];
+                    b = (transB == T_NO_TRANS) ? B[c * ldb + k] : B[k * ldb + c];
+                }
+                sum += fp16_to_fp32(a) * fp16_to_fp32(b);
+            }
+            float* c_rc = (layout == L_ROW_MAJOR) ? &C[r * ldc + c] : &C[c * ldc + r];
+            (*c_rc) = alpha * sum + beta * (*c_rc);
+        }
+    }
+}
+
+void naive_dgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const double alpha, const double* A, const int lda,
+                const double* B, const int ldb,
+                const double beta, double* C, const int ldc) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            double sum = 0;
+            for (int k = 0; k < K; k++) {
+                double a, b;
+                if(layout == L_ROW_MAJOR) {
+                    a = (transA == T_NO_TRANS) ? A[r * lda + k] : A[k * lda + r];
+                    b = (transB == T_NO_TRANS) ? B[k * ldb + c] : B[c * ldb + k];
+                }
+                else {
+                    a = (transA == T_NO_TRANS) ? A[k * lda + r] : A[r * lda + k];
+                    b = (transB == T_NO_TRANS) ? B[c * ldb + k] : B[k * ldb + c];
+                }
+                sum += a * b;
+            }
+            double* c_rc = (layout == L_ROW_MAJOR) ? &C[r * ldc + c] : &C[c * ldc + r];
+            (*c_rc) = alpha * sum + beta * (*c_rc);
+        }
+    }
+}
+
+void naive_hqgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const int16_t alpha, const int16_t* A, const int lda,
+                const int16_t* B, const int ldb,
+                const int16_t beta, int16_t* C, const int ldc) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            int sum = 0;
+            for (int k = 0; k < K; k++) {
+                int a, b;
+                if(layout == L_ROW_MAJOR) {
+                    a = (transA == T_NO_TRANS) ? A[r * lda + k] : A[k * lda + r];
+                    b = (transB == T_NO_TRANS) ? B[k * ldb + c] : B[c * ldb + k];
+                }
+                else {
+                    a = (transA == T_NO_TRANS) ? A[k * lda + r] : A[r * lda + k];
+                    b = (transB == T_NO_TRANS) ? B[c * ldb + k] : B[k * ldb + c];
+                }
+                sum += a * b;
+            }
+            int16_t* c_rc = (layout == L_ROW_MAJOR) ? &C[r * ldc + c] : &C[c * ldc + r];
+            (*c_rc) = (int16_t)(alpha * sum + beta * (*c_rc));      /* wraps like the kernel */
+        }
+    }
+}
+
+void naive_qgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const int8_t alpha, const int8_t* A, const int lda,
+                const int8_t* B, const int ldb,
+                const int8_t beta, int8_t* C, const int ldc) {
+    for(int r = 0; r < M; r++) {
+        for(int c = 0; c < N; c++) {
+            int sum = 0;
+            for (int k = 0; k < K; k++) {
+                int a, b;
+                if(layout == L_ROW_MAJOR) {
+                    a = (transA == T_NO_TRANS) ? A[r * lda + k] : A[k * lda + r];
+                    b = (transB == T_NO_TRANS) ? B[k * ldb + c] : B[c * ldb + k];
+                }
+                else {
+                    a = (transA == T_NO_TRANS) ? A[k * lda + r] : A[r * lda + k];
+                    b = (transB == T_NO_TRANS) ? B[c * ldb + k] : B[k * ldb + c];
+                }
+                sum += a * b;
+            }
+            int8_t* c_rc = (layout == L_ROW_MAJOR) ? &C[r * ldc + c] : &C[c * ldc + r];
+            (*c_rc) = (int8_t)(alpha * sum + beta * (*c_rc));      /* wraps like the kernel */
+        }
+    }
+}
+
+/********************************************************
+ *                                                      
+ *          Generate Random Matrix                                 
+ *                                                      
+*********************************************************/
+void int32_get_rand_mat(int row, int col, int32_t* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            int32_t num = rand() % bound;
+            mat[r * col + c] = num<=bound/2 ? -num : num;
+        }
+}
+
+void fp32_get_rand_mat(int row, int col, float* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            float num = rand() % bound;
+            mat[r * col + c] = num<=bound/2 ? -num : num;
+        }
+}
+
+void fp64_get_rand_mat(int row, int col, double* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            double num = rand() % bound;
+            mat[r * col + c] = num<=bound/2 ? -num : num;
+        }
+}
+
+/* small integers, exact in bf16 */
+void bf16_get_rand_mat(int row, int col, uint16_t* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            float num = rand() % bound;
+            mat[r * col + c] = fp32_to_bf16(num<=bound/2 ? -num : num);
+        }
+}
+
+/* small integers, exact in fp16 */
+void fp16_get_rand_mat(int row, int col, uint16_t* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            float num = rand() % bound;
+            mat[r * col + c] = fp32_to_fp16(num<=bound/2 ? -num : num);
+        }
+}
+
+void int16_get_rand_mat(int row, int col, int16_t* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            int16_t num = rand() % bound;
+            mat[r * col + c] = num<=bound/2 ? -num : num;
+        }
+}
+
+void int8_get_rand_mat(int row, int col, int8_t* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++) {
+            int8_t num = rand() % bound;
+            mat[r * col + c] = num<=bound/2 ? -num : num;
+        }
+}
+
+void uint8_get_rand_mat(int row, int col, uint8_t* mat, int bound) {
+    srand(time(NULL));
+    for (int r = 0; r < row; r++)
+        for (int c = 0; c < col; c++)
+            mat[r * col + c] = rand() % bound;
+}
+
+/********************************************************
+ *                                                      
+ *          Matrix Print                                
+ *                                                      
+*********************************************************/
+void int32_print(int row, int col, int32_t* mat) {
+    printf("INT32 Matrix Print\n");
+    for(int r=0; r<row; r++) {
+        for (int c=0; c<col; c++) 
+            printf("%3d ", mat[r *col + c]);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+void fp32_print(int row, int col, float* mat) {
+    printf("FP32 Matrix Print\n");
+    for(int r=0; r<row; r++) {
+        for (int c=0; c<col; c++) 
+            printf("%5.2f ", mat[r * col + c]);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+void fp64_print(int row, int col, double* mat) {
+    printf("FP64 Matrix Print\n");
+    for(int r=0; r<row; r++) {
+        for (int c=0; c<col; c++) 
+            printf("%5.2lf ", mat[r * col + c]);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+void print_console(const int M, const int K, const int N, const int niter, 
+                   const double* exec_time, const double* gflops, const BOOL is_valid_gemm) {
+    printf("════════════════════════════════════════════════\n\n");
+    printf("A: %dx%d B: %dx%d C: %dx%d\n\n", M, K, K, N, M, N);
+    printf("GEMM Test on %d Iterations\n", niter);
+    printf("%s\n\n", (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+
+    printf("AVG Exec. Time: %5.3lfms\n",     exec_time[0] / niter);
+    printf("MAX Exec. Time: %5.3lfms\n",     exec_time[1]);
+    printf("MIN Exec. Time: %5.3lfms\n\n",   exec_time[2]);
+
+    printf("AVG GFLOPS : %5.3lf\n",   gflops[0] / niter);
+    printf("MAX GFLOPS : %5.3lf\n",   gflops[1]);
+    printf("MIN GFLOPS : %5.3lf\n\n", gflops[2]);
+    printf("════════════════════════════════════════════════\n");
+}
+
+void print_file(const int M, const int K, const int N, const int niter,
+                   const double* exec_time, const double* gflops, 
+                   const BOOL is_valid_gemm, FILE* file) {
+    fprintf(file, "════════════════════════════════════════════════\n\n");
+    fprintf(file, "A: %dx%d B: %dx%d C: %dx%d\n\n", M, K, K, N, M, N);
+    fprintf(file, "GEMM Test on %d Iterations\n", niter);
+    fprintf(file, "%s\n\n", (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+
+    fprintf(file, "AVG Exec. Time: %5.3lfms\n",     exec_time[0] / niter);
+    fprintf(file, "MAX Exec. Time: %5.3lfms\n",     exec_time[1]);
+    fprintf(file, "MIN Exec. Time: %5.3lfms\n\n",   exec_time[2]);
+
+    fprintf(file, "AVG GFLOPS : %5.3lf\n",   gflops[0] / niter);
+    fprintf(file, "MAX GFLOPS : %5.3lf\n",   gflops[1]);
+    fprintf(file, "MIN GFLOPS : %5.3lf\n\n", gflops[2]);
+    fprintf(file, "════════════════════════════════════════════════\n");
+}
+
+static const char* ex_name(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB) {
+    static const char* names[8] = {
+        "RowMajor NN", "RowMajor NT", "RowMajor TN", "RowMajor TT",
+        "ColMajor NN", "ColMajor NT", "ColMajor TN", "ColMajor TT"
+    };
+    return names[(layout == L_COL_MAJOR) * 4 + (transA == T_TRANS) * 2 + (transB == T_TRANS)];
+}
+
+void print_ex_console(const int M, const int K, const int N, const LAYOUT layout,
+                      const TRANSPOSE transA, const TRANSPOSE transB, const BOOL is_valid_gemm) {
+    printf("A: %dx%d B: %dx%d C: %dx%d %s %s\n", M, K, K, N, M, N, 
+           ex_name(layout, transA, transB),
+           (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+}
+
+void print_ex_file(const int M, const int K, const int N, const LAYOUT layout,
+                   const TRANSPOSE transA, const TRANSPOSE transB, 
+                   const BOOL is_valid_gemm, FILE* file) {
+    fprintf(file, "A: %dx%d B: %dx%d C: %dx%d %s %s\n", M, K, K, N, M, N, 
+            ex_name(layout, transA, transB),
+            (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+}
+
+void print_check_console(const int M, const int K, const int N, const char* name,
+                         const BOOL is_valid_gemm) {
+    printf("A: %dx%d B: %dx%d C: %dx%d %s %s\n", M, K, K, N, M, N, name,
+           (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
+}
+
+void print_check_file(const int M, const int K, const int N, const char* name,
+                      const BOOL is_valid_gemm, FILE* file) {
+    fprintf(file, "A: %dx%d B: %dx%d C: %dx%d %s %s\n", M, K, K, N, M, N, name,
+            (is_valid_gemm == TRUE) ? "[Valid GEMM]" : "[Invalid GEMM!]");
 }
\ No newline at end of file
@@ -15,6 +15,78 @@ void hqgemm_test(const int M, const int N, const int K, const int niter,
                 const int range, const int bound, FILE* file, BOOL console_flag);
 void qgemm_test(const int M, const int N, const int K, const int niter,
                 const int range, const int bound, FILE* file, BOOL console_flag);
+void qgemm_s32_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag);
+void hqgemm_s32_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag);
+void bf16gemm_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag);
+void hgemm_test(const int M, const int N, const int K, const int niter,
+                const int range, const int bound, FILE* file, BOOL console_flag);
+
+void sgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void sgemm_gather_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void sgemv_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void sgemm_fixed_test(const int bound, FILE* file, BOOL console_flag);
+void sgemm_small_test(const int bound, FILE* file, BOOL console_flag);
+void gemm_ws_test(FILE* file, BOOL console_flag);
+void topology_test(FILE* file, BOOL console_flag);
+void dgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void dgemv_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void dgemm_small_test(const int bound, FILE* file, BOOL console_flag);
+void hqgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void qgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void bf16gemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void hgemm_ex_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void hgemm_f16_test(FILE* file, BOOL console_flag);
+
+void sgemm_epi_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void dgemm_epi_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void qgemm_requant_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+
+void sgemm_grouped_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void sgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void dgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void igemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void hqgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void qgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void qgemm_s32_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void hqgemm_s32_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void bf16gemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void hgemm_batched_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+
+void sgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void dgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void igemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void hqgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
+void qgemm_packed_test(const int M, const int N, const int K, const int range,
+                const int bound, FILE* file, BOOL console_flag);
 
 uint64_t timer();
 
@@ -28,12 +100,56 @@ BOOL naive_hqgemm(const int16_t* A, const int16_t* B, const int16_t* C,
                 const int M, const int N, const int K);
 BOOL naive_qgemm(const int8_t* A, const int8_t* B, const int8_t* C,
                 const int M, const int N, const int K);
+BOOL naive_qgemm_s32(const uint8_t* A, const int32_t a_zero, const int8_t* B, const int32_t b_zero,
+                const int32_t* C, const int M, const int N, const int K, const BOOL a_signed);
+BOOL naive_hqgemm_s32(const int16_t* A, const int lda, const int16_t* B, const int ldb,
+                const int32_t* C, const int ldc, const int M, const int N, const int K);
+BOOL naive_bf16gemm(const uint16_t* A, const uint16_t* B, const float* C,
+                const int M, const int N, const int K);
+BOOL naive_hgemm(const uint16_t* A, const uint16_t* B, const float* C,
+                const int M, const int N, const int K);
+uint8_t naive_requant(const gemm_requant_t* rq, const int32_t acc, const int c);
+float naive_sepilogue(const gemm_epilogue_t* epi, const float x, const int r, const int c);
+double naive_depilogue(const gemm_epilogue_t* epi, double x, const int r, const int c);
+void naive_sgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const float alpha, const float* A, const int lda,
+                const float* B, const int ldb,
+                const float beta, float* C, const int ldc);
+void naive_dgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const double alpha, const double* A, const int lda,
+                const double* B, const int ldb,
+                const double beta, double* C, const int ldc);
+void naive_hqgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const int16_t alpha, const int16_t* A, const int lda,
+                const int16_t* B, const int ldb,
+                const int16_t beta, int16_t* C, const int ldc);
+void naive_qgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const int8_t alpha, const int8_t* A, const int lda,
+                const int8_t* B, const int ldb,
+                const int8_t beta, int8_t* C, const int ldc);
+void naive_bf16gemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const float alpha, const uint16_t* A, const int lda,
+                const uint16_t* B, const int ldb,
+                const float beta, float* C, const int ldc);
+void naive_hgemm_ex(const LAYOUT layout, const TRANSPOSE transA, const TRANSPOSE transB,
+                const int M, const int N, const int K,
+                const float alpha, const uint16_t* A, const int lda,
+                const uint16_t* B, const int ldb,
+                const float beta, float* C, const int ldc);
 
 void fp32_get_rand_mat(int row, int col, float* mat, int bound);
 void fp64_get_rand_mat(int row, int col, double* mat, int bound);
 void int32_get_rand_mat(int row, int col, int32_t* mat, int bound);
 void int16_get_rand_mat(int row, int col, int16_t* mat, int bound);
 void int8_get_rand_mat(int row, int col, int8_t* mat, int bound);
+void uint8_get_rand_mat(int row, int col, uint8_t* mat, int bound);
+void bf16_get_rand_mat(int row, int col, uint16_t* mat, int bound);
+void fp16_get_rand_mat(int row, int col, uint16_t* mat, int bound);
 
 /********************************************************
  *                                                      
@@ -49,5 +165,14 @@ void print_console(const int M, const int K, const int N, const int niter,
 void print_file(const int M, const int K, const int N, const int niter,
                 const double* exec_time, const double* gflops, 
                 const BOOL is_valid_gemm, FILE* file);
+void print_ex_console(const int M, const int K, const int N, const LAYOUT layout,
+                      const TRANSPOSE transA, const TRANSPOSE transB, const BOOL is_valid_gemm);
+void print_ex_file(const int M, const int K, const int N, const LAYOUT layout,
+                   const TRANSPOSE transA, const TRANSPOSE transB, 
+                   const BOOL is_valid_gemm, FILE* file);
+void print_check_console(const int M, const int K, const int N, const char* name,
+                         const BOOL is_valid_gemm);
+void print_check_file(const int M, const int K, const int N, const char* name,
+                      const BOOL is_valid_gemm, FILE* file);
 
 #endif // TEST_H
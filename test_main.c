@@ -18,12 +18,10 @@ static D_TYPE parse_dtype(char* dtype) {
     else if(!strcmp(dtype, "int32") || !strcmp(dtype, "i"))
         return D_INT32;
     else if(!strcmp(dtype, "hfloat") || !strcmp(dtype, "h")) {
-        fprintf(stderr, "Unsupported datatype. Use --help for usage.\n");
-        exit(EXIT_FAILURE);
+        return D_FP16;
     }
     else if(!strcmp(dtype, "bfloat") || !strcmp(dtype, "bf")) {
-        fprintf(stderr, "Unsupported datatype. Use --help for usage.\n");
-        exit(EXIT_FAILURE);
+        return D_BF16;
     }
     else if(!strcmp(dtype, "int16") || !strcmp(dtype, "hq")) {
         return D_INT16;
@@ -31,6 +29,12 @@ static D_TYPE parse_dtype(char* dtype) {
     else if(!strcmp(dtype, "int8") || !strcmp(dtype, "q")) {
         return D_INT8;
     }
+    else if(!strcmp(dtype, "int8s32") || !strcmp(dtype, "qi")) {
+        return D_INT8_S32;
+    }
+    else if(!strcmp(dtype, "int16s32") || !strcmp(dtype, "hqi")) {
+        return D_INT16_S32;
+    }
     else {
         fprintf(stderr, "Unknown datatype. Use --help for usage.\n");
         exit(EXIT_FAILURE);
@@ -68,10 +72,12 @@ static void help() {
     fprintf(stderr, "                         s:  float \n");
     fprintf(stderr, "                         d:  double\n");
     fprintf(stderr, "                         i:  int32 \n");
-    fprintf(stderr, "                         q:  int16 \n");
-    fprintf(stderr, "                         hq: int8  \n");
-    fprintf(stderr, "                         h:  hfloat " "[Unsupported]\n");
-    fprintf(stderr, "                         bf: bfloat " "[Unsupported]\n");
+    fprintf(stderr, "                         hq: int16 \n");
+    fprintf(stderr, "                         q:  int8  \n");
+    fprintf(stderr, "                         qi: uint8 x int8 -> int32 (qgemm_s32)\n");
+    fprintf(stderr, "                         hqi: int16 x int16 -> int32 (hqgemm_s32)\n");
+    fprintf(stderr, "                         h:  fp16 x fp16 -> fp32 / fp16 (hgemm, hgemm_f16)\n");
+    fprintf(stderr, "                         bf: bfloat16 x bfloat16 -> fp32 (bf16gemm)\n");
     fprintf(stderr, "  -i, --iter=<num>       Number of iteration for each M, K, N \n");
     fprintf(stderr, "  -m, --M=<size>         Matrix size M for C(MxN) = A(MxK) X B(KxN) " "Default: 1024\n");
     fprintf(stderr, "  -k, --K=<size>         Matrix size K for C(MxN) = A(MxK) X B(KxN) " "Default: 1024\n");
@@ -83,6 +89,31 @@ static void help() {
     fprintf(stderr, "  -b, --bound=<num>      Bound for generating random matrix value \n");
     fprintf(stderr, "  -f, --file=<filename>  Print the GEMM output to <filename>\n");
     fprintf(stderr, "  -p, --print            Print the GEMM output to console \n");
+    fprintf(stderr, "  -x, --ex               Test the BLAS-style interface of the data type\n");
+    fprintf(stderr, "                         *gemm_ex:     every layout and transpose, padded leading\n");
+    fprintf(stderr, "                                       dimensions, alpha and beta\n");
+    fprintf(stderr, "                         hgemm_f16:    fp16 C rounded once over a long K\n");
+    fprintf(stderr, "                         sgemm_gather: gathered and scattered rows\n");
+    fprintf(stderr, "                         *gemv:        contiguous and strided vectors\n");
+    fprintf(stderr, "                         sgemm fixed:  the shapes of GEMM_FIXED_SHAPES\n");
+    fprintf(stderr, "                         *gemm small:  the unpacked path against the packed one\n");
+    fprintf(stderr, "                         workspace:    a failed allocation is not recorded\n");
+    fprintf(stderr, "                         topology:     cpulists, cgroup quotas, GEMM_NUM_THREADS\n");
+    fprintf(stderr, "  -w, --packed           Test the pre-packed B interface (*gemm_pack_B, *gemm_compute),\n");
+    fprintf(stderr, "                         in memory and saved to / mapped from a file\n");
+    fprintf(stderr, "  -e, --epilogue         Test the fused epilogue (sgemm_ex_epi, dgemm_ex_epi) with every\n");
+    fprintf(stderr, "                         bias mode and activation, with and without the clamp\n");
+    fprintf(stderr, "                         and the int8 requantization (qgemm_requant) per tensor and\n");
+    fprintf(stderr, "                         per channel\n");
+    fprintf(stderr, "  -B, --batched          Test the batched interface (*gemm_batched, *gemm_strided_batched)\n");
+    fprintf(stderr, "                         and sgemm_grouped\n");
+    fprintf(stderr, "\nEnvironment:\n");
+    fprintf(stderr, "  GEMM_NUM_THREADS=<num> Threads per GEMM call " "Default: physical cores allowed\n");
+    fprintf(stderr, "  GEMM_SMALL_MNK=<num>   M * N * K up to which sgemm and dgemm run unpacked, 0 for never "
+                    "Default: 262144\n");
+    fprintf(stderr, "  GEMM_ISA=<isa>         Highest ISA dispatched to: avx, avx2, avx512f, avx512bw, vnni or bf16;\n");
+    fprintf(stderr, "                         an unknown value is ignored "
+                    "Default: the best the CPU supports\n");
 }
 
 int main(int argc, char* argv[]) {
@@ -90,6 +121,10 @@ int main(int argc, char* argv[]) {
     int M = 1024, N = 1024 , K = 1024;
     int niter = 1, range = 1, bound = 5;
     BOOL console_flag = FALSE;
+    BOOL ex_flag = FALSE;
+    BOOL packed_flag = FALSE;
+    BOOL epi_flag = FALSE;
+    BOOL batched_flag = FALSE;
     FILE* file = NULL;
     D_TYPE dtype = D_FP32;
 
@@ -103,11 +138,15 @@ int main(int argc, char* argv[]) {
         {"bound",   required_argument, 0, 'b'},
         {"file",    required_argument, 0, 'f'},
         {"print",   no_argument,       0, 'p'},
+        {"ex",      no_argument,       0, 'x'},
+        {"packed",  no_argument,       0, 'w'},
+        {"epilogue",no_argument,       0, 'e'},
+        {"batched", no_argument,       0, 'B'},
         {"help",    no_argument,       0, 'h'},
         {0, 0, 0, 0}                     
     };
 
-    while((opt = getopt_long(argc, argv, "t:m:k:n:i:r:b:f:p:h", long_options, NULL)) != -1) {
+    while((opt = getopt_long(argc, argv, "t:m:k:n:i:r:b:f:p:xweBh", long_options, NULL)) != -1) {
         switch (opt) {
             case 't':
                 dtype = parse_dtype(optarg);
@@ -139,6 +178,18 @@ int main(int argc, char* argv[]) {
             case 'p':
                 console_flag = TRUE;
                 break;
+            case 'x':
+                ex_flag = TRUE;
+                break;
+            case 'w':
+                packed_flag = TRUE;
+                break;
+            case 'e':
+                epi_flag = TRUE;
+                break;
+            case 'B':
+                batched_flag = TRUE;
+                break;
             case 'f':
                 if((file = fopen(optarg, "a")) == NULL) {
                     perror("[Error]: File open failed\n");
@@ -159,12 +210,103 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if(ex_flag) {
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_ex_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_gather_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemv_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_fixed_test(bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_small_test(bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            gemm_ws_test(file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            topology_test(file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP64)
+            dgemm_ex_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP64)
+            dgemv_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP64)
+            dgemm_small_test(bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT16)
+            hqgemm_ex_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT8)
+            qgemm_ex_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_BF16)
+            bf16gemm_ex_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP16)
+            hgemm_ex_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP16)
+            hgemm_f16_test(file, console_flag);
+        if(file != NULL) fclose(file);
+        return 0;
+    }
+
+    if(epi_flag) {
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_epi_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP64)
+            dgemm_epi_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT8_S32)
+            qgemm_requant_test(M, N, K, range, bound, file, console_flag);
+        if(file != NULL) fclose(file);
+        return 0;
+    }
+
+    if(batched_flag) {
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_grouped_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP64)
+            dgemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT32)
+            igemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT16)
+            hqgemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT8)
+            qgemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT8_S32)
+            qgemm_s32_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT16_S32)
+            hqgemm_s32_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_BF16)
+            bf16gemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP16)
+            hgemm_batched_test(M, N, K, range, bound, file, console_flag);
+        if(file != NULL) fclose(file);
+        return 0;
+    }
+
+    if(packed_flag) {
+        if(dtype == D_ALL || dtype == D_FP32)
+            sgemm_packed_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_FP64)
+            dgemm_packed_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT32)
+            igemm_packed_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT16)
+            hqgemm_packed_test(M, N, K, range, bound, file, console_flag);
+        if(dtype == D_ALL || dtype == D_INT8)
+            qgemm_packed_test(M, N, K, range, bound, file, console_flag);
+        if(file != NULL) fclose(file);
+        return 0;
+    }
+
     switch(dtype) {
         case D_ALL: {
             sgemm_test(M, N, K, niter, range, bound, file, console_flag);
             dgemm_test(M, N, K, niter, range, bound, file, console_flag);
             igemm_test(M, N, K, niter, range, bound, file, console_flag);
+            hqgemm_test(M, N, K, niter, range, bound, file, console_flag);
             qgemm_test(M, N, K, niter, range, bound, file, console_flag);
+            qgemm_s32_test(M, N, K, niter, range, bound, file, console_flag);
+            hqgemm_s32_test(M, N, K, niter, range, bound, file, console_flag);
+            bf16gemm_test(M, N, K, niter, range, bound, file, console_flag);
+            hgemm_test(M, N, K, niter, range, bound, file, console_flag);
             break;
         }
         case D_FP32: {
@@ -187,6 +329,22 @@ int main(int argc, char* argv[]) {
             qgemm_test(M, N, K, niter, range, bound, file, console_flag);
             break;
         }
+        case D_INT8_S32: {
+            qgemm_s32_test(M, N, K, niter, range, bound, file, console_flag);
+            break;
+        }
+        case D_INT16_S32: {
+            hqgemm_s32_test(M, N, K, niter, range, bound, file, console_flag);
+            break;
+        }
+        case D_BF16: {
+            bf16gemm_test(M, N, K, niter, range, bound, file, console_flag);
+            break;
+        }
+        case D_FP16: {
+            hgemm_test(M, N, K, niter, range, bound, file, console_flag);
+            break;
+        }
         default: {
             fprintf(stderr, "[Error]: Unknown datatype.\n");
             fprintf(stderr, "Use --help for usage.\n");
@@ -0,0 +1,312 @@
+/**********************************************************************************************
+ * File   : topo.c
+ * Author : kdh
+ * Github : https://github.com/kdhrepos/gemm.h
+ *
+ * Description:
+ *      CPU topology of the running process, read from the affinity mask,
+ *      /sys/devices/system/cpu, /sys/devices/system/node and the cgroup CPU quota.
+ *
+ *      Only CPUs in the affinity mask are counted, so taskset, cpusets and container
+ *      limits are respected. GEMM runs one thread per physical core, since SMT siblings
+ *      share the FMA units, never more threads than the cgroup quota allows, and no more
+ *      than one NUMA node has cores: the packed blocks of A and B are shared by every
+ *      thread and live in one node's memory. The L2 and L3 groups size MC and NC, see
+ *      set_block_size in [opt.c].
+ *
+ *      GEMM_NUM_THREADS in the environment overrides the thread count.
+ *
+**********************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "gemm.h"
+
+#define SYS_CPU  "/sys/devices/system/cpu"
+#define SYS_NODE "/sys/devices/system/node"
+
+/* parse a cpulist such as "0-3,8,10-11" into [set] */
+static void parse_cpulist(const char* list, cpu_set_t* set) {
+    CPU_ZERO(set);
+    char* p = (char* )list;
+    while(isdigit((unsigned char)*p)) {
+        long first = strtol(p, &p, 10), last = first;
+        if(*p == '-')
+            last = strtol(p + 1, &p, 10);
+        for(long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, set);
+        if(*p == ',')
+            p++;
+    }
+}
+
+/* read the cpulist on the first line of [path] into [set] */
+static BOOL read_cpulist(const char* path, cpu_set_t* set) {
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+        return FALSE;
+
+    char buf[4096];
+    BOOL ok = (fgets(buf, sizeof(buf), file) != NULL);
+    fclose(file);
+    if(ok)
+        parse_cpulist(buf, set);
+    return ok;
+}
+
+/**
+ * The CPUs this process may run on: the affinity mask, or under a fixture [root] the
+ * Cpus_allowed_list of its proc/self/status.
+ */
+static BOOL read_affinity(const char* root, cpu_set_t* allowed) {
+    if(root[0] == '\0')
+        return (sched_getaffinity(0, sizeof(cpu_set_t), allowed) == 0);
+
+    char path[512], line[4096];
+    snprintf(path, sizeof(path), "%s/proc/self/status", root);
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+        return FALSE;
+    BOOL found = FALSE;
+    while(!found && fgets(line, sizeof(line), file) != NULL) {
+        if(strncmp(line, "Cpus_allowed_list:", 18) == 0) {
+            parse_cpulist(line + 18 + strspn(line + 18, " \t"), allowed);
+            found = TRUE;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+static int first_cpu(const cpu_set_t* set) {
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if(CPU_ISSET(cpu, set))
+            return cpu;
+    return -1;
+}
+
+/**
+ * Count the groups of allowed CPUs that share something, e.g. a core or a package.
+ * [list] is the sysfs file, relative to the CPU directory, listing the CPUs a CPU
+ * shares it with; a group is named by its first CPU.
+ */
+static int count_groups(const char* root, const cpu_set_t* allowed, const char* list) {
+    cpu_set_t seen;
+    CPU_ZERO(&seen);
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(!CPU_ISSET(cpu, allowed))
+            continue;
+        char path[512];
+        cpu_set_t group;
+        snprintf(path, sizeof(path), "%s" SYS_CPU "/cpu%d/%s", root, cpu, list);
+        if(!read_cpulist(path, &group))
+            return 0;
+        CPU_SET(first_cpu(&group), &seen);
+    }
+    return CPU_COUNT(&seen);
+}
+
+/* groups sharing the cache of [level], found through cache/index*\/level */
+static int count_cache_groups(const char* root, const cpu_set_t* allowed, const int level) {
+    for(int index = 0; index < 8; index++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s" SYS_CPU "/cpu%d/cache/index%d/level",
+                 root, first_cpu(allowed), index);
+        FILE* file = fopen(path, "r");
+        if(file == NULL)
+            return 0;
+        int file_level = 0;
+        BOOL ok = (fscanf(file, "%d", &file_level) == 1);
+        fclose(file);
+        if(ok && file_level == level) {
+            snprintf(path, sizeof(path), "cache/index%d/shared_cpu_list", index);
+            return count_groups(root, allowed, path);
+        }
+    }
+    return 0;
+}
+
+static int count_numa_nodes(const char* root, const cpu_set_t* allowed) {
+    int nnuma = 0;
+    char node_dir[512];
+    snprintf(node_dir, sizeof(node_dir), "%s" SYS_NODE, root);
+    for(int node = 0; node < 1024; node++) {
+        char path[600];
+        cpu_set_t cpus, both;
+        snprintf(path, sizeof(path), "%s/node%d/cpulist", node_dir, node);
+        if(!read_cpulist(path, &cpus)) {
+            if(access(node_dir, F_OK) != 0 || node > 0)
+                break;
+            continue;
+        }
+        CPU_AND(&both, &cpus, allowed);
+        if(CPU_COUNT(&both) > 0)
+            nnuma++;
+    }
+    return nnuma;
+}
+
+/* the cgroup v1 directories the cpu controller may be mounted on */
+static const char* v1_mounts[2] = {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"};
+
+/**
+ * Path of the cgroup this process is in, from /proc/self/cgroup: the v1 hierarchy
+ * of [controller], or the v2 one ("0::") if [controller] is NULL. The root is "".
+ */
+static BOOL read_cgroup(const char* root, const char* controller, char* cgroup, const int size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/proc/self/cgroup", root);
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+        return FALSE;
+
+    char line[600];
+    BOOL found = FALSE;
+    while(!found && fgets(line, sizeof(line), file) != NULL) {
+        /* hierarchy-ID:controller-list:cgroup-path */
+        char* names = strchr(line, ':');
+        char* dir = (names != NULL) ? strchr(names + 1, ':') : NULL;
+        if(dir == NULL)
+            continue;
+        (*names++) = '\0', (*dir++) = '\0';
+        dir[strcspn(dir, "\n")] = '\0';
+
+        if(controller == NULL)
+            found = (strcmp(line, "0") == 0 && names[0] == '\0');
+        else {
+            char* save = NULL;
+            for(char* name = strtok_r(names, ",", &save); name != NULL && !found;
+                name = strtok_r(NULL, ",", &save))
+                found = (strcmp(name, controller) == 0);
+        }
+        if(found)
+            snprintf(cgroup, size, "%s", (strcmp(dir, "/") == 0) ? "" : dir);
+    }
+    fclose(file);
+    return found;
+}
+
+/* cut the last component off [cgroup], FALSE once it is the root */
+static BOOL parent_cgroup(char* cgroup) {
+    char* slash = strrchr(cgroup, '/');
+    if(slash == NULL)
+        return FALSE;
+    (*slash) = '\0';
+    return TRUE;
+}
+
+static BOOL read_long(const char* path, long* value) {
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+        return FALSE;
+    BOOL ok = (fscanf(file, "%ld", value) == 1);
+    fclose(file);
+    return ok;
+}
+
+/* CPUs a [quota] per [period] grants, rounded up, folded into the tighter [limit] */
+static int min_quota(const int limit, const long quota, const long period) {
+    if(quota <= 0 || period <= 0)
+        return limit;
+    const int cpus = (int)((quota + period - 1) / period);
+    return (limit == 0) ? cpus : min(limit, cpus);
+}
+
+/**
+ * CPUs granted by the cgroup CFS quota, rounded up; 0 without a quota.
+ * A parent's quota caps all of its children, so every level from the process's own
+ * cgroup up to the root is read and the tightest one wins. Levels missing from the
+ * mount, as above a container's cgroup namespace, are skipped.
+ */
+static int read_cpu_quota(const char* root) {
+    char cgroup[512], path[1024];
+    int quota = 0;
+
+    /* cgroup v2 */
+    BOOL v2 = FALSE;
+    if(!read_cgroup(root, NULL, cgroup, sizeof(cgroup)))
+        cgroup[0] = '\0';
+    do {
+        snprintf(path, sizeof(path), "%s/sys/fs/cgroup%s/cpu.max", root, cgroup);
+        FILE* file = fopen(path, "r");
+        if(file == NULL)
+            continue;
+        char limit[32] = "";
+        long period = 0;
+        if(fscanf(file, "%31s %ld", limit, &period) == 2 && strcmp(limit, "max") != 0)
+            quota = min_quota(quota, atol(limit), period);
+        fclose(file);
+        v2 = TRUE;
+    } while(parent_cgroup(cgroup));
+    if(v2)
+        return quota;
+
+    /* cgroup v1 */
+    for(int i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), "%s%s", root, v1_mounts[i]);
+        if(access(path, F_OK) != 0)
+            continue;
+        if(!read_cgroup(root, "cpu", cgroup, sizeof(cgroup)))
+            cgroup[0] = '\0';
+        do {
+            long cfs_quota = -1, cfs_period = 0;
+            snprintf(path, sizeof(path), "%s%s%s/cpu.cfs_quota_us", root, v1_mounts[i], cgroup);
+            if(!read_long(path, &cfs_quota))
+                continue;
+            snprintf(path, sizeof(path), "%s%s%s/cpu.cfs_period_us", root, v1_mounts[i], cgroup);
+            if(read_long(path, &cfs_period))
+                quota = min_quota(quota, cfs_quota, cfs_period);
+        } while(parent_cgroup(cgroup));
+        return quota;
+    }
+    return 0;
+}
+
+void get_topology(gemm_topo_t* topo) {
+    get_topology_at(topo, NULL);
+}
+
+void get_topology_at(gemm_topo_t* topo, const char* root) {
+    memset(topo, 0, sizeof(gemm_topo_t));
+    if(root == NULL)
+        root = "";
+
+    cpu_set_t allowed;
+    if(!read_affinity(root, &allowed)) {
+        CPU_ZERO(&allowed);
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for(long cpu = 0; cpu < max(n, 1) && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &allowed);
+    }
+    topo->ncpus = CPU_COUNT(&allowed);
+
+    topo->ncores = count_groups(root, &allowed, "topology/thread_siblings_list");
+    if(topo->ncores == 0)                   /* no sysfs, assume no SMT */
+        topo->ncores = topo->ncpus;
+    topo->smt = max(1, topo->ncpus / topo->ncores);
+    topo->npackages = max(1, count_groups(root, &allowed, "topology/package_cpus_list"));
+    topo->nl2 = count_cache_groups(root, &allowed, 2);
+    topo->nl3 = count_cache_groups(root, &allowed, 3);
+    topo->nnuma = max(1, count_numa_nodes(root, &allowed));
+    topo->quota = read_cpu_quota(root);
+
+    topo->nthreads = topo->ncores;
+    if(topo->quota > 0)
+        topo->nthreads = min(topo->nthreads, topo->quota);
+    if(topo->nnuma > 1)                     /* the cores of one node */
+        topo->nthreads = min(topo->nthreads, (topo->ncores + topo->nnuma - 1) / topo->nnuma);
+
+    const char* env = getenv("GEMM_NUM_THREADS");
+    if(env != NULL && atoi(env) > 0)
+        topo->nthreads = atoi(env);
+    topo->nthreads = max(1, topo->nthreads);
+
+#if DEBUG
+    printf("CPUs: %d cores: %d SMT: %d packages: %d L2: %d L3: %d NUMA: %d quota: %d\n",
+           topo->ncpus, topo->ncores, topo->smt, topo->npackages,
+           topo->nl2, topo->nl3, topo->nnuma, topo->quota);
+#endif
+}
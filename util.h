@@ -31,8 +31,70 @@ typedef short BOOL;
 #define FALSE 0
 
 #define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
 
-typedef enum {D_ALL, D_FP32, D_FP64, D_INT32, D_INT8, D_INT16} D_TYPE;
+typedef enum {D_ALL, D_FP32, D_FP64, D_INT32, D_INT8, D_INT16, D_INT8_S32, D_INT16_S32, D_BF16, D_FP16, D_NUM} D_TYPE;
+
+/* bfloat16 and IEEE half, as the uint16_t bits bf16gemm and hgemm take */
+
+/* a bf16 is the upper half of an fp32 */
+static inline float bf16_to_fp32(const uint16_t x) {
+    const uint32_t bits = (uint32_t)x << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/* rounded to nearest even, as the hardware converts */
+static inline uint16_t fp32_to_bf16(const float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+/* vcvtph2ps without F16C */
+static inline float fp16_to_fp32(const uint16_t h) {
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F, mant = h & 0x3FF, bits;
+    if(exp == 0x1F)                         /* inf, NaN */
+        bits = sign | 0x7F800000 | (mant << 13);
+    else if(exp != 0)                       /* normal */
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    else if(mant == 0)                      /* zero */
+        bits = sign;
+    else {                                  /* subnormal, normalized in fp32 */
+        exp = 113;
+        while(!(mant & 0x400))
+            mant <<= 1, exp--;
+        bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/* vcvtps2ph without F16C, rounded to nearest even */
+static inline uint16_t fp32_to_fp16(const float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const uint32_t abs_bits = bits & 0x7FFFFFFF;
+    if(abs_bits > 0x7F800000)               /* NaN, kept quiet */
+        return sign | 0x7E00;
+    if(abs_bits >= 0x477FF000)              /* inf, or rounds up to it */
+        return sign | 0x7C00;
+    if(abs_bits >= 0x38800000) {            /* normal: rebias the exponent, round the mantissa */
+        const uint32_t rebias = abs_bits - 0x38000000;
+        return sign | (uint16_t)((rebias + 0xFFF + ((rebias >> 13) & 1)) >> 13);
+    }
+    /* subnormal: adding 0.5f lines the half mantissa up with the low bits and rounds it */
+    float t;
+    memcpy(&t, &abs_bits, sizeof(t));
+    t += 0.5f;
+    memcpy(&bits, &t, sizeof(bits));
+    return sign | (uint16_t)(bits - 0x3F000000);
+}
 
 #define DEBUG FALSE
 